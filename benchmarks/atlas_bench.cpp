@@ -0,0 +1,193 @@
+// Glyph atlas packing efficiency and build time.
+//
+// Usage: phantom_atlas_bench [font.ttf] [cjk-font.ttf]
+// Packs ASCII and ASCII plus Latin-1 at several pixel sizes with the
+// skyline packer and compares the result with the old single-row layout
+// (one row, both sides rounded up to powers of two). With a CJK font the
+// first 3500 unified ideographs are packed from it; without one, boxes of
+// the same shape (nearly full-em squares) stand in for them. Real fonts
+// are built twice, on one rasterizing thread and on all cores.
+
+#include "rendering/core/font_loader.h"
+#include "rendering/core/atlas_packer.h"
+#include "utils/logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace phantom;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int PADDING = 2;
+constexpr u32 CJK_FIRST = 0x4E00;
+constexpr u32 CJK_COUNT = 3500;
+const float SIZES[] = {16.0f, 24.0f, 32.0f, 48.0f};
+
+bool readFile(const std::string& path, std::vector<u8>& out) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) {
+        return false;
+    }
+    out.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    return static_cast<bool>(file.read(reinterpret_cast<char*>(out.data()), out.size()));
+}
+
+int nextPowerOf2(int n) {
+    int p = 1;
+    while (p < n) {
+        p <<= 1;
+    }
+    return p;
+}
+
+// Share of the atlas covered by glyph pixels, and the same for the old
+// single-row layout of the same glyphs
+void coverage(const FontAtlas& atlas, double& skyline, double& row) {
+    u64 glyphArea = 0;
+    int rowWidth = PADDING;
+    int rowHeight = 0;
+    for (const Glyph& glyph : atlas.glyphs) {
+        glyphArea += static_cast<u64>(glyph.width) * glyph.height;
+        rowWidth += glyph.width + PADDING;
+        rowHeight = std::max(rowHeight, glyph.height);
+    }
+    skyline = static_cast<double>(glyphArea) / (static_cast<double>(atlas.width) * atlas.height);
+    row = static_cast<double>(glyphArea) / (static_cast<double>(nextPowerOf2(rowWidth)) * nextPowerOf2(rowHeight + 4));
+}
+
+void printHeader() {
+    std::printf("%-16s %6s %7s %12s %9s %9s %9s %9s\n", "charset", "size", "glyphs", "atlas", "skyline", "one row", "1 thr ms", "build ms");
+}
+
+// Milliseconds to build the atlas, or a negative value on failure
+double buildAtlas(FontLoader& loader, const std::vector<u8>& font, const std::vector<u32>& charset,
+                  float size, u32 threads) {
+    loader.setPadding(PADDING);
+    loader.setCharset(charset);
+    loader.setRasterThreads(threads);
+
+    auto start = Clock::now();
+    if (!loader.loadFromMemory(font, size)) {
+        return -1.0;
+    }
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+bool runFont(const char* name, const std::vector<u8>& font, const std::vector<u32>& charset, float size) {
+    FontLoader serial;
+    FontLoader loader;
+    double serialMs = buildAtlas(serial, font, charset, size, 1);
+    double ms = buildAtlas(loader, font, charset, size, 0);
+    if (serialMs < 0.0 || ms < 0.0) {
+        std::fprintf(stderr, "%s at %.0f px failed\n", name, size);
+        return false;
+    }
+
+    const FontAtlas& atlas = loader.getAtlas();
+    double skyline, row;
+    coverage(atlas, skyline, row);
+
+    char dims[32];
+    std::snprintf(dims, sizeof(dims), "%dx%d", atlas.width, atlas.height);
+    std::printf("%-16s %6.0f %7zu %12s %8.1f%% %8.1f%% %9.2f %9.2f\n",
+                name, size, atlas.glyphs.size(), dims, skyline * 100.0, row * 100.0, serialMs, ms);
+    return true;
+}
+
+// CJK-shaped boxes: 80-98% of the em in both directions
+void runSyntheticCjk(float size) {
+    std::mt19937 rng(static_cast<u32>(size));
+    std::uniform_real_distribution<float> extent(0.80f, 0.98f);
+
+    std::vector<PackRect> rects(CJK_COUNT);
+    u64 glyphArea = 0;
+    for (PackRect& rect : rects) {
+        rect.width = static_cast<int>(size * extent(rng));
+        rect.height = static_cast<int>(size * extent(rng));
+        glyphArea += static_cast<u64>(rect.width) * rect.height;
+    }
+
+    SkylinePacker packer;
+    auto start = Clock::now();
+    int side = packSquare(packer, rects, PADDING, 16, 8192);
+    double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    int height = (packer.getUsedHeight() + 3) / 4 * 4;
+
+    char dims[32];
+    std::snprintf(dims, sizeof(dims), "%dx%d", side, height);
+    std::printf("%-16s %6.0f %7u %12s %8.1f%% %9s %9s %9.2f\n",
+                "CJK (synthetic)", size, CJK_COUNT, dims,
+                100.0 * glyphArea / (static_cast<double>(side) * height), "-", "-", ms);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Logger::setConsoleOutput(false);
+    Logger::setFileOutput(false);
+
+    std::string fontPath;
+    if (argc > 1) {
+        fontPath = argv[1];
+    } else {
+#ifdef PHANTOM_BENCH_FONT
+        fontPath = PHANTOM_BENCH_FONT;
+#else
+        std::fprintf(stderr, "usage: %s font.ttf [cjk-font.ttf]\n", argv[0]);
+        return EXIT_FAILURE;
+#endif
+    }
+
+    std::vector<u8> font;
+    if (!readFile(fontPath, font)) {
+        std::fprintf(stderr, "cannot read %s\n", fontPath.c_str());
+        return EXIT_FAILURE;
+    }
+
+    std::vector<u32> ascii;
+    for (u32 codepoint = 32; codepoint <= 126; codepoint++) {
+        ascii.push_back(codepoint);
+    }
+    std::vector<u32> latin1 = ascii;
+    for (u32 codepoint = 0xA0; codepoint <= 0xFF; codepoint++) {
+        latin1.push_back(codepoint);
+    }
+
+    printHeader();
+    bool ok = true;
+    for (float size : SIZES) {
+        ok = runFont("ASCII", font, ascii, size) && ok;
+        ok = runFont("ASCII+Latin-1", font, latin1, size) && ok;
+    }
+
+    if (argc > 2) {
+        std::vector<u8> cjkFont;
+        if (!readFile(argv[2], cjkFont)) {
+            std::fprintf(stderr, "cannot read %s\n", argv[2]);
+            return EXIT_FAILURE;
+        }
+        std::vector<u32> cjk;
+        for (u32 i = 0; i < CJK_COUNT; i++) {
+            cjk.push_back(CJK_FIRST + i);
+        }
+        for (float size : SIZES) {
+            ok = runFont("CJK", cjkFont, cjk, size) && ok;
+        }
+    } else {
+        for (float size : SIZES) {
+            runSyntheticCjk(size);
+        }
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
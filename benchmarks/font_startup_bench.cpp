@@ -0,0 +1,151 @@
+// Font startup time with and without the on-disk atlas cache.
+//
+// Usage: phantom_font_startup_bench [font.ttf] [directory]
+//
+// Loads the font the way the application does (48 px distance field, and
+// a coverage atlas for comparison) for printable ASCII and for ASCII plus
+// Latin-1, and reports the median time of:
+//   rasterize   no cache directory: read the file and rasterize everything
+//   cold        empty cache: rasterize and write the cache file
+//   warm        cache hit: read the file and map the cached atlas
+// Cache files go to a fresh subdirectory of the given directory (default:
+// the system temp directory), which is removed afterwards. The exit status
+// is non-zero if a warm load does not reproduce the rasterized atlas.
+
+#include "rendering/core/font_loader.h"
+#include "utils/logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <vector>
+
+using namespace phantom;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr double MIN_SECONDS = 0.3;     // Repeat each measurement at least this long
+constexpr int MIN_RUNS = 3;
+constexpr float FONT_SIZE = 48.0f;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Median wall time of fn() in milliseconds
+template <typename Fn>
+double medianMillis(Fn fn) {
+    std::vector<double> samples;
+    Clock::time_point start = Clock::now();
+    while (static_cast<int>(samples.size()) < MIN_RUNS || secondsSince(start) < MIN_SECONDS) {
+        Clock::time_point run = Clock::now();
+        fn();
+        samples.push_back(secondsSince(run) * 1e3);
+    }
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+bool load(FontLoader& loader, const std::string& fontPath, const std::vector<u32>& charset,
+          GlyphFormat format, const std::string& cacheDir) {
+    loader.setFormat(format);
+    loader.setCharset(charset);
+    loader.setAtlasCacheDirectory(cacheDir);
+    return loader.loadFromFile(fontPath, FONT_SIZE);
+}
+
+bool sameAtlas(const FontAtlas& a, const FontAtlas& b) {
+    if (a.width != b.width || a.height != b.height || a.bitmap != b.bitmap || a.glyphs.size() != b.glyphs.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.glyphs.size(); i++) {
+        const Glyph& x = a.glyphs[i];
+        const Glyph& y = b.glyphs[i];
+        if (x.codepoint != y.codepoint || x.atlasX != y.atlasX || x.atlasY != y.atlasY ||
+            x.width != y.width || x.height != y.height || x.advance != y.advance) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool run(const char* name, const std::string& fontPath, const std::vector<u32>& charset,
+         GlyphFormat format, const std::string& cacheDir) {
+    std::error_code ec;
+    bool ok = true;
+
+    double rasterize = medianMillis([&] {
+        FontLoader loader;
+        ok = load(loader, fontPath, charset, format, "") && ok;
+    });
+
+    double cold = medianMillis([&] {
+        std::filesystem::remove_all(cacheDir, ec);
+        std::filesystem::create_directories(cacheDir, ec);
+        FontLoader loader;
+        ok = load(loader, fontPath, charset, format, cacheDir) && ok;
+    });
+
+    double warm = medianMillis([&] {
+        FontLoader loader;
+        ok = load(loader, fontPath, charset, format, cacheDir) && ok;
+    });
+
+    FontLoader reference;
+    FontLoader cached;
+    ok = load(reference, fontPath, charset, format, "") && load(cached, fontPath, charset, format, cacheDir) && ok;
+    bool match = ok && sameAtlas(reference.getAtlas(), cached.getAtlas());
+
+    std::printf("%-16s %-9s %7zu %12.2f %10.2f %10.2f %8.1fx %s\n",
+                name, format == GlyphFormat::SDF ? "SDF" : "coverage", reference.getAtlas().glyphs.size(),
+                rasterize, cold, warm, warm > 0.0 ? rasterize / warm : 0.0, match ? "" : "MISMATCH");
+    return match;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Logger::setConsoleOutput(false);
+    Logger::setFileOutput(false);
+
+    std::string fontPath;
+    if (argc > 1) {
+        fontPath = argv[1];
+    } else {
+#ifdef PHANTOM_BENCH_FONT
+        fontPath = PHANTOM_BENCH_FONT;
+#else
+        std::fprintf(stderr, "usage: %s font.ttf [directory]\n", argv[0]);
+        return EXIT_FAILURE;
+#endif
+    }
+
+    std::error_code ec;
+    std::filesystem::path base = argc > 2 ? std::filesystem::path(argv[2]) : std::filesystem::temp_directory_path(ec);
+    std::string cacheDir = (base / "phantom_font_startup_bench").string();
+
+    std::vector<u32> ascii;
+    for (u32 codepoint = 32; codepoint <= 126; codepoint++) {
+        ascii.push_back(codepoint);
+    }
+    std::vector<u32> latin1 = ascii;
+    for (u32 codepoint = 0xA0; codepoint <= 0xFF; codepoint++) {
+        latin1.push_back(codepoint);
+    }
+
+    std::printf("%-16s %-9s %7s %12s %10s %10s %9s\n", "charset", "format", "glyphs", "rasterize ms", "cold ms", "warm ms", "speedup");
+    bool ok = true;
+    for (GlyphFormat format : {GlyphFormat::SDF, GlyphFormat::Coverage}) {
+        ok = run("ASCII", fontPath, ascii, format, cacheDir) && ok;
+        ok = run("ASCII+Latin-1", fontPath, latin1, format, cacheDir) && ok;
+    }
+
+    std::filesystem::remove_all(cacheDir, ec);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,137 @@
+// Glyph fragmentation patterns: span speed and how much seeds differ.
+//
+// Usage: phantom_fragment_bench
+//
+// Reports the time per column of GlyphFragmenter::getFragmentModes against
+// one getFragmentMode call per column, and the share of Bottom modes. Then,
+// for pairs of seeds (neighbours, single high bits, random), over the
+// first LINES lines of COLUMNS columns:
+//   differ   positions whose mode differs between the two seeds
+//   shared   rows of the second seed that also occur as a row, at any
+//            line, of the first: a seed that only reorders rows shares all
+// The exit status is non-zero if a span disagrees with getFragmentMode or
+// two seeds share any row.
+
+#include "rendering/core/glyph_fragmenter.h"
+#include "utils/logger.h"
+
+#include <bitset>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+using namespace phantom;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t LINES = 4096;
+constexpr size_t COLUMNS = 128;
+constexpr int RUNS = 50;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Modes of the whole grid, one span per line
+std::vector<std::vector<uint64_t>> grid(const GlyphFragmenter& fragmenter) {
+    std::vector<std::vector<uint64_t>> rows(LINES);
+    for (size_t line = 0; line < LINES; line++) {
+        fragmenter.getFragmentModes(line, 0, COLUMNS, rows[line]);
+    }
+    return rows;
+}
+
+// Spans match getFragmentMode bit for bit; prints the speed of both
+bool runSpeed() {
+    GlyphFragmenter fragmenter(0x9E3779B9u);
+    bool ok = true;
+    size_t bottom = 0;
+    std::vector<uint64_t> bits;
+    for (size_t line = 0; line < LINES; line++) {
+        fragmenter.getFragmentModes(line, 0, COLUMNS, bits);
+        for (size_t column = 0; column < COLUMNS; column++) {
+            FragmentMode mode = GlyphFragmenter::modeAt(bits, column);
+            ok = ok && mode == fragmenter.getFragmentMode(line, column);
+            bottom += mode == FragmentMode::Bottom;
+        }
+    }
+
+    uint64_t sink = 0;
+    Clock::time_point start = Clock::now();
+    for (int run = 0; run < RUNS; run++) {
+        for (size_t line = 0; line < LINES; line++) {
+            fragmenter.getFragmentModes(line, 0, COLUMNS, bits);
+            sink += bits[0];
+        }
+    }
+    const double spanNs = secondsSince(start) * 1e9 / (static_cast<double>(RUNS) * LINES * COLUMNS);
+
+    start = Clock::now();
+    for (size_t line = 0; line < LINES; line++) {
+        for (size_t column = 0; column < COLUMNS; column++) {
+            sink += static_cast<uint64_t>(fragmenter.getFragmentMode(line, column));
+        }
+    }
+    const double callNs = secondsSince(start) * 1e9 / (static_cast<double>(LINES) * COLUMNS);
+
+    std::printf("%-24s %10.2f ns/column\n", "span", spanNs);
+    std::printf("%-24s %10.2f ns/column\n", "per-column call", callNs);
+    std::printf("%-24s %10.1f %%\n", "bottom", bottom * 100.0 / (LINES * COLUMNS));
+    std::printf("%-24s %10s\n", "span matches call", ok ? "yes" : "NO");
+    return ok && sink != 1;
+}
+
+// Compare the grids of two seeds; false if they share a row
+bool runSeeds(uint32_t first, uint32_t second) {
+    const std::vector<std::vector<uint64_t>> a = grid(GlyphFragmenter(first));
+    const std::vector<std::vector<uint64_t>> b = grid(GlyphFragmenter(second));
+
+    size_t differ = 0;
+    for (size_t line = 0; line < LINES; line++) {
+        for (size_t word = 0; word < a[line].size(); word++) {
+            differ += std::bitset<64>(a[line][word] ^ b[line][word]).count();
+        }
+    }
+
+    std::set<std::vector<uint64_t>> rows(a.begin(), a.end());
+    size_t shared = 0;
+    for (const std::vector<uint64_t>& row : b) {
+        shared += rows.count(row);
+    }
+
+    std::printf("%08X %08X       %9.1f %% %9zu / %zu\n", first, second,
+                differ * 100.0 / (LINES * COLUMNS), shared, LINES);
+    return shared == 0;
+}
+
+} // namespace
+
+int main() {
+    Logger::setConsoleOutput(false);
+    Logger::setFileOutput(false);
+
+    bool ok = runSpeed();
+
+    std::vector<std::pair<uint32_t, uint32_t>> pairs = {
+        {0, 1}, {1, 2}, {0, 2}, {0x12345678u, 0x12345679u}, {0, 0x80000000u}, {0x0000FFFFu, 0x0001FFFFu},
+    };
+    std::mt19937 random(12345);
+    for (int i = 0; i < 4; i++) {
+        uint32_t first = random();
+        pairs.emplace_back(first, random());
+    }
+
+    std::printf("\n%-8s %-8s       %11s %9s\n", "seed", "seed", "differ", "shared");
+    for (const auto& pair : pairs) {
+        ok = runSeeds(pair.first, pair.second) && ok;
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
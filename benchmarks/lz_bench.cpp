@@ -0,0 +1,158 @@
+// Compression ratio and throughput of the in-tree LZ codec.
+//
+// Usage: phantom_lz_bench [file...]
+// Without arguments the project's Markdown documents are used as a prose
+// corpus. Each file is cut into swap-sized blocks, like a snapshot would be.
+
+#include "utils/lz_codec.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace phantom;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t BLOCK_SIZE = 256 * 1024;   // Same as SWAP_V2_BLOCK_SIZE
+constexpr double MIN_SECONDS = 0.5;         // Repeat each measurement at least this long
+
+struct Result {
+    size_t rawSize = 0;
+    size_t compressedSize = 0;
+    double compressMBps = 0.0;
+    double decompressMBps = 0.0;
+    bool verified = false;
+};
+
+bool readFile(const std::string& path, std::string& out) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    std::stringstream ss;
+    ss << file.rdbuf();
+    out = ss.str();
+    return true;
+}
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+Result run(const std::string& corpus) {
+    Result result;
+    result.rawSize = corpus.size();
+
+    const u8* src = reinterpret_cast<const u8*>(corpus.data());
+    const size_t blockCount = (corpus.size() + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+    LzCompressor compressor;
+    std::vector<std::vector<u8>> blocks(blockCount);
+    for (size_t i = 0; i < blockCount; i++) {
+        blocks[i].resize(lzCompressBound(BLOCK_SIZE));
+    }
+    std::vector<size_t> sizes(blockCount);
+
+    auto compressAll = [&]() {
+        size_t total = 0;
+        for (size_t i = 0; i < blockCount; i++) {
+            size_t offset = i * BLOCK_SIZE;
+            size_t length = std::min(BLOCK_SIZE, corpus.size() - offset);
+            sizes[i] = compressor.compress(src + offset, length, blocks[i].data(), blocks[i].size());
+            total += sizes[i];
+        }
+        return total;
+    };
+
+    size_t iterations = 0;
+    Clock::time_point start = Clock::now();
+    do {
+        result.compressedSize = compressAll();
+        iterations++;
+    } while (secondsSince(start) < MIN_SECONDS);
+    result.compressMBps = (double(corpus.size()) * iterations / (1024.0 * 1024.0)) / secondsSince(start);
+
+    std::string decoded(corpus.size(), '\0');
+    u8* dst = reinterpret_cast<u8*>(&decoded[0]);
+
+    bool ok = true;
+    iterations = 0;
+    start = Clock::now();
+    do {
+        for (size_t i = 0; i < blockCount; i++) {
+            size_t offset = i * BLOCK_SIZE;
+            size_t length = std::min(BLOCK_SIZE, corpus.size() - offset);
+            ok &= lzDecompress(blocks[i].data(), sizes[i], dst + offset, length);
+        }
+        iterations++;
+    } while (secondsSince(start) < MIN_SECONDS);
+    result.decompressMBps = (double(corpus.size()) * iterations / (1024.0 * 1024.0)) / secondsSince(start);
+
+    result.verified = ok && decoded == corpus;
+    return result;
+}
+
+void printResult(const char* name, const Result& r) {
+    double ratio = r.rawSize ? double(r.compressedSize) / double(r.rawSize) : 0.0;
+    std::printf("%-28s %10zu %10zu %7.1f%% %10.1f %10.1f %s\n",
+                name, r.rawSize, r.compressedSize, ratio * 100.0,
+                r.compressMBps, r.decompressMBps, r.verified ? "ok" : "MISMATCH");
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++) {
+        paths.push_back(argv[i]);
+    }
+
+    if (paths.empty()) {
+#ifdef PHANTOM_BENCH_CORPUS_DIR
+        const char* docs[] = {"README.md", "README_LINUX.md", "README_ANDROID.md", "BUILD_WINDOWS.md", "ROADMAP.md"};
+        for (const char* doc : docs) {
+            paths.push_back(std::string(PHANTOM_BENCH_CORPUS_DIR) + "/" + doc);
+        }
+#else
+        std::fprintf(stderr, "usage: %s file...\n", argv[0]);
+        return EXIT_FAILURE;
+#endif
+    }
+
+    std::printf("%-28s %10s %10s %8s %10s %10s\n", "corpus", "raw", "packed", "ratio", "comp MB/s", "dec MB/s");
+
+    std::string combined;
+    bool allVerified = true;
+
+    for (const std::string& path : paths) {
+        std::string corpus;
+        if (!readFile(path, corpus)) {
+            std::fprintf(stderr, "cannot read %s\n", path.c_str());
+            return EXIT_FAILURE;
+        }
+
+        Result r = run(corpus);
+        allVerified &= r.verified;
+
+        size_t slash = path.find_last_of("/\\");
+        printResult(slash == std::string::npos ? path.c_str() : path.c_str() + slash + 1, r);
+
+        combined += corpus;
+    }
+
+    if (paths.size() > 1) {
+        Result r = run(combined);
+        allVerified &= r.verified;
+        printResult("(all)", r);
+    }
+
+    return allVerified ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,689 @@
+// Latency and throughput of the persistence paths, and recovery under
+// injected storage faults.
+//
+// Usage: phantom_persistence_bench [--quick] [--bench-only | --faults-only] [directory]
+//
+// The benchmark writes and reads swap snapshots and documents of several
+// sizes in each format, with and without fsync, times journal commits
+// under each durability policy, and measures what a long version history
+// of a novel-sized document costs on disk. The fault suite replays a
+// scripted editing session while the FaultInjector cuts writes short, runs
+// out of space or "crashes" at byte offsets spread over the whole session,
+// and checks that recovery reads back a state the session actually went
+// through. The exit status is non-zero if any check fails.
+//
+// Files are created in the given directory (default: the system temp
+// directory), so point it at the disk you want to measure.
+
+#include "persistence/autosave.h"
+#include "persistence/document_file.h"
+#include "persistence/durable_file.h"
+#include "persistence/edit_journal.h"
+#include "persistence/encryption.h"
+#include "persistence/fault_injection.h"
+#include "persistence/io_engine.h"
+#include "persistence/recovery_scanner.h"
+#include "persistence/swap_file.h"
+#include "persistence/version_history.h"
+#include "core/buffer.h"
+#include "core/cursor.h"
+#include "utils/logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace phantom;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr double MIN_SECONDS = 0.3;     // Repeat each measurement at least this long
+constexpr int MIN_RUNS = 3;
+constexpr u32 BENCH_KDF_ITERATIONS = 1000;  // The KDF runs once per session; not what is measured here
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Median wall time of fn() in microseconds
+template <typename Fn>
+double medianMicros(Fn fn) {
+    std::vector<double> samples;
+    Clock::time_point start = Clock::now();
+    while (static_cast<int>(samples.size()) < MIN_RUNS || secondsSince(start) < MIN_SECONDS) {
+        Clock::time_point run = Clock::now();
+        fn();
+        samples.push_back(secondsSince(run) * 1e6);
+    }
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+double mbPerSecond(size_t bytes, double micros) {
+    return micros > 0.0 ? (bytes / (1024.0 * 1024.0)) / (micros / 1e6) : 0.0;
+}
+
+std::string sizeLabel(size_t bytes) {
+    char label[32];
+    if (bytes >= 1024 * 1024) {
+        std::snprintf(label, sizeof(label), "%zu MiB", bytes / (1024 * 1024));
+    } else {
+        std::snprintf(label, sizeof(label), "%zu KiB", bytes / 1024);
+    }
+    return label;
+}
+
+// Prose-like text: words, sentences and paragraphs
+std::string makeProse(size_t size, u32 seed) {
+    static const char* WORDS[] = {
+        "the", "writer", "kept", "a", "quiet", "room", "where", "every", "page", "was",
+        "read", "twice", "before", "morning", "light", "came", "through", "old", "window", "and",
+        "nothing", "else", "mattered", "much", "to", "her", "story", "of", "long", "winter",
+    };
+    constexpr size_t WORD_COUNT = sizeof(WORDS) / sizeof(WORDS[0]);
+
+    std::mt19937 rng(seed);
+    std::string text;
+    text.reserve(size + 16);
+    while (text.size() < size) {
+        text += WORDS[rng() % WORD_COUNT];
+        u32 r = rng() % 100;
+        text += r < 2 ? ".\n\n" : r < 10 ? ". " : " ";
+    }
+    text.resize(size);
+    return text;
+}
+
+struct Paths {
+    std::string document;
+    std::string swap;
+    std::string journal;
+
+    explicit Paths(const std::string& directory, const char* name) {
+        document = (std::filesystem::path(directory) / name).string();
+        SwapFile swapFile(document);
+        swap = swapFile.getSwapFilePath();
+        journal = swapFile.getJournalFilePath();
+    }
+
+    void removeAll() const {
+        for (const std::string& path : {document, swap, journal}) {
+            std::remove(path.c_str());
+            std::remove((path + ".tmp").c_str());
+        }
+    }
+};
+
+// ============================================================================
+// Benchmark
+// ============================================================================
+
+void benchSnapshots(const Paths& paths, const std::vector<size_t>& sizes, const EncryptionKey& key) {
+    std::printf("\nSwap snapshots (write = encode + write, read = read + decode)\n");
+    std::printf("%-8s %-10s %-10s %12s %10s %12s %10s %12s\n",
+                "size", "format", "sync", "write p50", "MB/s", "read p50", "MB/s", "on disk");
+
+    auto encryption = std::shared_ptr<const EncryptionKey>(&key, [](const EncryptionKey*) {});
+
+    for (size_t size : sizes) {
+        TextBuffer buffer;
+        buffer.assign(makeProse(size, 1));
+        Cursor cursor;
+
+        for (bool encrypted : {false, true}) {
+            SwapFile swapFile(paths.document);
+            if (encrypted) {
+                swapFile.setEncryption(encryption);
+            }
+
+            for (bool sync : {false, true}) {
+                double write = medianMicros([&]() { swapFile.write(buffer, cursor, 1, sync); });
+
+                TextBuffer restored;
+                Cursor restoredCursor;
+                double read = medianMicros([&]() { swapFile.read(restored, restoredCursor); });
+                if (restored.length() != buffer.length()) {
+                    std::printf("  read back %zu of %zu bytes\n", restored.length(), buffer.length());
+                }
+
+                std::printf("%-8s %-10s %-10s %9.0f us %10.0f %9.0f us %10.0f %12llu\n",
+                            sizeLabel(size).c_str(), encrypted ? "v2+crypt" : "v2",
+                            sync ? "synced" : "none", write, mbPerSecond(size, write), read, mbPerSecond(size, read),
+                            static_cast<unsigned long long>(std::filesystem::file_size(paths.swap)));
+            }
+            swapFile.remove();
+        }
+    }
+}
+
+void benchDocuments(const Paths& paths, const std::vector<size_t>& sizes, const EncryptionKey& key) {
+    std::printf("\nDocuments (save = atomic replace, load = decode into the buffer's string)\n");
+    std::printf("%-8s %-10s %-10s %12s %10s %12s %10s\n", "size", "format", "sync", "save p50", "MB/s", "load p50", "MB/s");
+
+    struct Variant {
+        const char* name;
+        DocumentFormat format;
+    };
+    Variant variants[3];
+    variants[0].name = "utf-8";
+    variants[1].name = "crlf+bom";
+    variants[1].format.crlf = true;
+    variants[1].format.utf8Bom = true;
+    variants[2].name = "encrypted";
+    variants[2].format.encrypted = true;
+
+    for (size_t size : sizes) {
+        std::string text = makeProse(size, 2);
+        TextSegments segments{text.data(), text.size() / 2, text.data() + text.size() / 2, text.size() - text.size() / 2};
+
+        for (const Variant& variant : variants) {
+            for (bool sync : {false, true}) {
+                double save = medianMicros([&]() {
+                    DocumentFile::save(paths.document, segments, variant.format, sync, &key);
+                });
+
+                std::string loaded;
+                DocumentFormat format;
+                double load = medianMicros([&]() { DocumentFile::load(paths.document, loaded, format, nullptr, &key); });
+                if (loaded != text) {
+                    std::printf("  loaded text differs\n");
+                }
+
+                std::printf("%-8s %-10s %-10s %9.0f us %10.0f %9.0f us %10.0f\n",
+                            sizeLabel(size).c_str(), variant.name, sync ? "synced" : "none",
+                            save, mbPerSecond(size, save), load, mbPerSecond(size, load));
+            }
+        }
+        std::remove(paths.document.c_str());
+    }
+}
+
+void benchJournal(const Paths& paths) {
+    constexpr int COMMITS = 200;
+
+    std::printf("\nJournal commits (one typed word each, %d commits)\n", COMMITS);
+    std::printf("%-12s %12s %12s %12s\n", "policy", "p50", "p99", "max");
+
+    for (DurabilityPolicy policy : {DurabilityPolicy::None, DurabilityPolicy::Batched, DurabilityPolicy::EverySave}) {
+        EditJournal journal(paths.journal);
+        journal.reset(1, policy != DurabilityPolicy::None);
+
+        std::vector<double> samples;
+        size_t position = 0;
+        for (int i = 0; i < COMMITS; i++) {
+            journal.recordInsert(position, "quietly ", 8);
+            position += 8;
+
+            Clock::time_point start = Clock::now();
+            journal.commit();
+            // Batched syncs at most every 10 s, which this loop never reaches
+            if (policy == DurabilityPolicy::EverySave) {
+                journal.sync();
+            }
+            samples.push_back(secondsSince(start) * 1e6);
+        }
+
+        std::sort(samples.begin(), samples.end());
+        std::printf("%-12s %9.0f us %9.0f us %9.0f us\n", durabilityPolicyName(policy),
+                    samples[samples.size() / 2], samples[samples.size() * 99 / 100], samples.back());
+        journal.remove();
+    }
+}
+
+void benchHistory(const Paths& paths, size_t size, int versions) {
+    constexpr int EDITS_PER_VERSION = 3;
+
+    std::printf("\nVersion history (%s document, %d versions, %d scattered edits each)\n",
+                sizeLabel(size).c_str(), versions, EDITS_PER_VERSION);
+
+    std::string base = SwapFile(paths.document).getHistoryBasePath();
+    VersionHistory history(base);
+    std::remove(history.getPackFilePath().c_str());
+    std::remove(history.getIndexFilePath().c_str());
+    if (!history.open()) {
+        std::printf("  could not open the history files\n");
+        return;
+    }
+
+    // Each version replaces or inserts a sentence at a few random places,
+    // the way a revision pass over a manuscript touches it
+    std::mt19937 rng(7);
+    std::string text = makeProse(size, 3);
+    std::string phrase = makeProse(4096, 4);
+    std::vector<double> commits;
+    for (int v = 0; v < versions; v++) {
+        for (int e = 0; e < EDITS_PER_VERSION; e++) {
+            size_t position = rng() % text.size();
+            size_t length = 20 + rng() % 60;
+            if (rng() % 2) {
+                text.replace(position, std::min(length, text.size() - position), phrase, rng() % 4000, length);
+            } else {
+                text.insert(position, phrase, rng() % 4000, length);
+            }
+        }
+        Clock::time_point start = Clock::now();
+        history.commit(text, static_cast<u64>(v));
+        commits.push_back(secondsSince(start) * 1e6);
+    }
+    std::sort(commits.begin(), commits.end());
+
+    HistoryStats stats = history.getStats();
+    u64 onDisk = stats.packBytes + stats.indexBytes;
+    std::printf("on disk: %.1f MiB (pack %.1f MiB, index %.0f KiB), %.2fx the document, %zu unique chunks\n",
+                onDisk / (1024.0 * 1024.0), stats.packBytes / (1024.0 * 1024.0), stats.indexBytes / 1024.0,
+                static_cast<double>(onDisk) / text.size(), stats.uniqueChunks);
+    std::printf("commit p50 %.0f us, p99 %.0f us\n", commits[commits.size() / 2], commits[commits.size() * 99 / 100]);
+
+    for (size_t index : {size_t(0), history.getVersionCount() / 2, history.getVersionCount() - 1}) {
+        std::string restored;
+        double restore = medianMicros([&]() { history.restore(index, restored); });
+        std::printf("restore version %zu: %.0f us (%.0f MB/s)%s\n", index, restore, mbPerSecond(restored.size(), restore),
+                    index + 1 == history.getVersionCount() && restored != text ? ", text differs" : "");
+    }
+
+    std::remove(history.getPackFilePath().c_str());
+    std::remove(history.getIndexFilePath().c_str());
+}
+
+// ============================================================================
+// Fault injection
+// ============================================================================
+
+// One step of the scripted session: an edit (committed to the journal) or a checkpoint
+struct Step {
+    bool checkpoint = false;
+    bool insert = false;
+    size_t position = 0;
+    std::string text;
+    size_t length = 0;
+};
+
+struct Script {
+    std::string initial;
+    std::vector<Step> steps;
+    std::vector<std::string> states;    // Text after each step
+};
+
+Script makeScript(u32 seed, size_t steps) {
+    std::mt19937 rng(seed);
+    Script script;
+    script.initial = makeProse(24 * 1024, seed);
+
+    std::string text = script.initial;
+    auto push = [&](const Step& step) {
+        if (!step.checkpoint) {
+            if (step.insert) {
+                text.insert(step.position, step.text);
+            } else {
+                text.erase(step.position, step.length);
+            }
+        }
+        script.steps.push_back(step);
+        script.states.push_back(text);
+    };
+
+    // The session's base snapshot
+    Step base;
+    base.checkpoint = true;
+    push(base);
+
+    while (script.steps.size() < steps) {
+        u32 r = rng() % 100;
+        Step step;
+        if (r < 10) {
+            step.checkpoint = true;
+            push(step);
+        } else if (r < 15) {
+            // Typed and deleted again, then saved: the checkpoint finds nothing new
+            step.insert = true;
+            step.position = rng() % (text.size() + 1);
+            step.text = makeProse(1 + rng() % 64, rng());
+            push(step);
+            Step undo;
+            undo.position = step.position;
+            undo.length = step.text.size();
+            push(undo);
+            Step save;
+            save.checkpoint = true;
+            push(save);
+        } else if (r < 70 || text.empty()) {
+            step.insert = true;
+            step.position = rng() % (text.size() + 1);
+            step.text = makeProse(r < 20 ? 16 * 1024 + rng() % 16384 : 1 + rng() % 200, rng());
+            push(step);
+        } else {
+            step.position = rng() % text.size();
+            step.length = std::min<size_t>(1 + rng() % 60, text.size() - step.position);
+            push(step);
+        }
+    }
+    return script;
+}
+
+// What the editor would hold after a restart: snapshot plus journal
+std::string recover(const Paths& paths, const std::shared_ptr<const EncryptionKey>& key, bool& hasSnapshot) {
+    SwapFile swapFile(paths.document);
+    EditJournal journal(paths.journal);
+    swapFile.setEncryption(key);
+    journal.setEncryption(key);
+
+    TextBuffer buffer;
+    Cursor cursor;
+    u32 generation = 0;
+    RecoveryReport report;
+
+    hasSnapshot = swapFile.exists() && swapFile.read(buffer, cursor, &generation, &report);
+    if (hasSnapshot && report.headerIntact) {
+        journal.continueFrom(generation);
+        journal.replay(buffer, cursor, generation);
+    }
+    return buffer.getText();
+}
+
+struct SessionResult {
+    int lastSaved = -1;     // Last step whose save succeeded
+    int lastRun = -1;       // Last step attempted
+    bool allSaved = true;
+};
+
+// Run the script like Autosave would: a failed journal commit forces the
+// next save to be a checkpoint. Stops at a simulated crash.
+SessionResult runSession(const Script& script, const Paths& paths, const std::shared_ptr<const EncryptionKey>& key) {
+    TextBuffer buffer;
+    Cursor cursor;
+    std::mutex bufferMutex;
+    SwapFile swapFile(paths.document);
+    EditJournal journal(paths.journal);
+    swapFile.setEncryption(key);
+    journal.setEncryption(key);
+    Autosave autosave(&swapFile, &journal, buffer, cursor, bufferMutex);
+
+    buffer.assign(script.initial);
+
+    SessionResult result;
+    bool needCheckpoint = true;
+
+    for (size_t i = 0; i < script.steps.size(); i++) {
+        const Step& step = script.steps[i];
+        if (!step.checkpoint) {
+            std::lock_guard<std::mutex> lock(bufferMutex);
+            if (step.insert) {
+                buffer.insert(step.position, step.text);
+                journal.recordInsert(step.position, step.text.data(), step.text.size());
+            } else {
+                buffer.erase(step.position, step.length);
+                journal.recordErase(step.position, step.length);
+            }
+        }
+
+        result.lastRun = static_cast<int>(i);
+        bool ok = (step.checkpoint || needCheckpoint) ? autosave.checkpoint() : journal.commit();
+        if (ok) {
+            result.lastSaved = static_cast<int>(i);
+            needCheckpoint = false;
+        } else {
+            result.allSaved = false;
+            needCheckpoint = true;
+            if (FaultInjector::get().hasCrashed()) {
+                break;
+            }
+        }
+    }
+    return result;
+}
+
+// Recovered text must be the state after one of steps [lastSaved, lastRun];
+// before the first snapshot there may be nothing at all
+bool checkRecovery(const Script& script, const SessionResult& session, const Paths& paths,
+                   const std::shared_ptr<const EncryptionKey>& key, const char* what, u64 offset) {
+    bool hasSnapshot = false;
+    std::string text = recover(paths, key, hasSnapshot);
+
+    if (!hasSnapshot && session.lastSaved < 0) {
+        return true;
+    }
+    for (int i = std::max(session.lastSaved, 0); i <= session.lastRun; i++) {
+        if (script.states[i] == text) {
+            return true;
+        }
+    }
+
+    std::printf("  FAIL %s at byte %llu: recovered %zu bytes, not the state after any of steps %d-%d\n",
+                what, static_cast<unsigned long long>(offset), text.size(), session.lastSaved, session.lastRun);
+    return false;
+}
+
+struct FaultTotals {
+    int runs = 0;
+    int failures = 0;
+};
+
+void crashSweep(const Script& script, const Paths& paths, const std::shared_ptr<const EncryptionKey>& key,
+                int points, FaultTotals& totals) {
+    const char* what = key ? "crash (encrypted)" : "crash";
+
+    // A fault-free run tells how many bytes the session writes
+    paths.removeAll();
+    FaultInjector::get().arm(FaultKind::Crash, ~0ull);
+    runSession(script, paths, key);
+    u64 total = FaultInjector::get().bytesWritten();
+    FaultInjector::get().disarm();
+
+    std::mt19937_64 rng(total);
+    int failures = 0;
+    for (int i = 0; i < points; i++) {
+        // Evenly spread, jittered so the offsets don't line up with block sizes
+        u64 offset = total * i / points + (total / points ? rng() % (total / points) : 0);
+
+        paths.removeAll();
+        FaultInjector::get().arm(FaultKind::Crash, offset);
+        SessionResult session = runSession(script, paths, key);
+        FaultInjector::get().disarm();
+
+        failures += checkRecovery(script, session, paths, key, what, offset) ? 0 : 1;
+    }
+
+    std::printf("%-24s %4d crash points over %llu bytes: %s\n", what, points,
+                static_cast<unsigned long long>(total), failures ? "FAILED" : "all recovered");
+    totals.runs += points;
+    totals.failures += failures;
+}
+
+void noSpaceSweep(const Script& script, const Paths& paths, const std::shared_ptr<const EncryptionKey>& key,
+                  int points, FaultTotals& totals) {
+    paths.removeAll();
+    FaultInjector::get().arm(FaultKind::Crash, ~0ull);
+    runSession(script, paths, key);
+    u64 total = FaultInjector::get().bytesWritten();
+    FaultInjector::get().disarm();
+
+    int failures = 0;
+    for (int i = 0; i < points; i++) {
+        u64 offset = total * (i + 1) / (points + 1);
+
+        // The disk fills up part way through and stays full
+        paths.removeAll();
+        FaultInjector::get().arm(FaultKind::NoSpace, offset);
+        SessionResult session = runSession(script, paths, key);
+        FaultInjector::get().disarm();
+        bool ok = checkRecovery(script, session, paths, key, "ENOSPC", offset);
+
+        // Once space is freed, the next checkpoint must bring everything back
+        SessionResult after;
+        after.lastSaved = after.lastRun = static_cast<int>(script.steps.size()) - 1;
+        {
+            TextBuffer buffer;
+            Cursor cursor;
+            std::mutex bufferMutex;
+            SwapFile swapFile(paths.document);
+            EditJournal journal(paths.journal);
+            swapFile.setEncryption(key);
+            journal.setEncryption(key);
+            Autosave autosave(&swapFile, &journal, buffer, cursor, bufferMutex);
+            buffer.assign(script.states.back());
+            ok = autosave.checkpoint() && ok;
+        }
+        ok = checkRecovery(script, after, paths, key, "ENOSPC, space freed", offset) && ok;
+        failures += ok ? 0 : 1;
+    }
+
+    std::printf("%-24s %4d fill points: %s\n", key ? "ENOSPC (encrypted)" : "ENOSPC", points,
+                failures ? "FAILED" : "all recovered");
+    totals.runs += points;
+    totals.failures += failures;
+}
+
+void shortWriteRuns(const Script& script, const Paths& paths, const std::shared_ptr<const EncryptionKey>& key,
+                    int runs, FaultTotals& totals) {
+    int failures = 0;
+    for (int i = 0; i < runs; i++) {
+        paths.removeAll();
+        FaultInjector::get().arm(FaultKind::ShortWrites, 0, static_cast<u32>(i + 1));
+        SessionResult session = runSession(script, paths, key);
+
+        // Documents go through writev with many spans (CRLF); that must survive short writes too
+        const std::string& text = script.states.back();
+        TextSegments segments{text.data(), text.size() / 3, text.data() + text.size() / 3, text.size() - text.size() / 3};
+        DocumentFormat format;
+        format.crlf = (i & 1) != 0;
+        format.encrypted = key != nullptr;
+        bool saved = DocumentFile::save(paths.document, segments, format, true, key.get());
+        FaultInjector::get().disarm();
+
+        std::string loaded;
+        DocumentFormat loadedFormat;
+        bool ok = session.allSaved && saved && DocumentFile::load(paths.document, loaded, loadedFormat, nullptr, key.get()) &&
+                  loaded == text;
+        if (!ok) {
+            std::printf("  FAIL short writes (run %d): a save failed or the document differs\n", i);
+        }
+        ok = checkRecovery(script, session, paths, key, "short writes", 0) && ok;
+        failures += ok ? 0 : 1;
+    }
+
+    std::printf("%-24s %4d sessions: %s\n", key ? "short writes (encrypted)" : "short writes", runs,
+                failures ? "FAILED" : "all saved and recovered");
+    totals.runs += runs;
+    totals.failures += failures;
+}
+
+void documentCrashSweep(const Paths& paths, const std::shared_ptr<const EncryptionKey>& key, int points,
+                        FaultTotals& totals) {
+    std::string before = makeProse(300 * 1024, 5);
+    std::string after = makeProse(310 * 1024, 6);
+    TextSegments beforeSegments{before.data(), before.size(), nullptr, 0};
+    TextSegments afterSegments{after.data(), after.size() / 2, after.data() + after.size() / 2, after.size() - after.size() / 2};
+    DocumentFormat format;
+    format.crlf = true;
+    format.encrypted = key != nullptr;
+
+    paths.removeAll();
+    DocumentFile::save(paths.document, beforeSegments, format, false, key.get());
+    FaultInjector::get().arm(FaultKind::Crash, ~0ull);
+    DocumentFile::save(paths.document, afterSegments, format, true, key.get());
+    u64 total = FaultInjector::get().bytesWritten();
+    FaultInjector::get().disarm();
+
+    int failures = 0;
+    for (int i = 0; i < points; i++) {
+        u64 offset = total * i / points;
+        DocumentFile::save(paths.document, beforeSegments, format, false, key.get());
+
+        FaultInjector::get().arm(FaultKind::Crash, offset);
+        DocumentFile::save(paths.document, afterSegments, format, true, key.get());
+        FaultInjector::get().disarm();
+
+        std::string loaded;
+        DocumentFormat loadedFormat;
+        if (!DocumentFile::load(paths.document, loaded, loadedFormat, nullptr, key.get()) ||
+            (loaded != before && loaded != after)) {
+            std::printf("  FAIL document save crash at byte %llu: neither the old nor the new text\n",
+                        static_cast<unsigned long long>(offset));
+            failures++;
+        }
+    }
+
+    std::printf("%-24s %4d crash points: %s\n", key ? "doc save (encrypted)" : "doc save", points,
+                failures ? "FAILED" : "old or new text intact");
+    totals.runs += points;
+    totals.failures += failures;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    bool quick = false;
+    bool runBench = true;
+    bool runFaults = true;
+    std::string directory = std::filesystem::temp_directory_path().string();
+
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--quick") == 0) {
+            quick = true;
+        } else if (std::strcmp(argv[i], "--bench-only") == 0) {
+            runFaults = false;
+        } else if (std::strcmp(argv[i], "--faults-only") == 0) {
+            runBench = false;
+        } else if (argv[i][0] == '-') {
+            std::fprintf(stderr, "usage: %s [--quick] [--bench-only | --faults-only] [directory]\n", argv[0]);
+            return EXIT_FAILURE;
+        } else {
+            directory = argv[i];
+        }
+    }
+
+    // Failed saves are the point of the fault suite; keep their errors off the console
+    Logger::setConsoleOutput(false);
+    Logger::setFileOutput(false);
+
+    IoEngine::get().start();
+    std::printf("Directory: %s\nI/O backend: %s\n", directory.c_str(), ioBackendName(IoEngine::get().getBackend()));
+
+    EncryptionKey key("phantom-bench", BENCH_KDF_ITERATIONS);
+    auto sharedKey = std::shared_ptr<const EncryptionKey>(&key, [](const EncryptionKey*) {});
+
+    Paths benchPaths(directory, "phantom_bench.txt");
+    Paths faultPaths(directory, "phantom_faults.txt");
+
+    if (runBench) {
+        std::vector<size_t> sizes = {64 * 1024, 1024 * 1024, 16 * 1024 * 1024};
+        if (!quick) {
+            sizes.push_back(64 * 1024 * 1024);
+        }
+        benchSnapshots(benchPaths, sizes, key);
+        benchDocuments(benchPaths, sizes, key);
+        benchJournal(benchPaths);
+        benchHistory(benchPaths, 5 * 1024 * 1024, quick ? 200 : 1000);
+        benchPaths.removeAll();
+    }
+
+    FaultTotals totals;
+    if (runFaults) {
+        std::printf("\nFault injection\n");
+        Script script = makeScript(42, quick ? 60 : 120);
+        int points = quick ? 40 : 200;
+
+        for (const std::shared_ptr<const EncryptionKey>& encryption : {std::shared_ptr<const EncryptionKey>(), sharedKey}) {
+            crashSweep(script, faultPaths, encryption, encryption ? points / 2 : points, totals);
+            noSpaceSweep(script, faultPaths, encryption, quick ? 4 : 12, totals);
+            shortWriteRuns(script, faultPaths, encryption, quick ? 2 : 6, totals);
+            documentCrashSweep(faultPaths, encryption, quick ? 20 : 60, totals);
+        }
+        faultPaths.removeAll();
+
+        std::printf("\n%d fault runs, %d failed\n", totals.runs, totals.failures);
+    }
+
+    IoEngine::get().stop();
+    return totals.failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
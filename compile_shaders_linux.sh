@@ -37,6 +37,11 @@ echo "Compiling text.frag..."
 $COMPILER $COMPILER_ARGS shaders/text.frag -o shaders/text_frag.spv
 echo "  text_frag.spv created"
 
+# Compile distance field fragment shader
+echo "Compiling text_sdf.frag..."
+$COMPILER $COMPILER_ARGS shaders/text_sdf.frag -o shaders/text_sdf_frag.spv
+echo "  text_sdf_frag.spv created"
+
 echo ""
 echo "Shaders compiled successfully!"
 echo "Now run ./copy_assets_linux.sh to copy them to the build directory."
@@ -37,6 +37,16 @@ if %errorlevel% neq 0 (
 )
 echo   text_frag.spv created
 
+REM Compile distance field fragment shader
+echo Compiling text_sdf.frag...
+%GLSLC% shaders/text_sdf.frag -o shaders/text_sdf_frag.spv
+if %errorlevel% neq 0 (
+    echo ERROR: Failed to compile text_sdf.frag
+    pause
+    exit /b 1
+)
+echo   text_sdf_frag.spv created
+
 echo.
 echo Shaders compiled successfully!
 echo Now run copy_assets_windows.bat to copy them to the build directory.
@@ -11,6 +11,7 @@ echo "Compiling shaders in $SHADER_DIR..."
 # Compile text shaders
 glslangValidator -V "$SHADER_DIR/text.vert" -o "$SHADER_DIR/text_vert.spv"
 glslangValidator -V "$SHADER_DIR/text.frag" -o "$SHADER_DIR/text_frag.spv"
+glslangValidator -V "$SHADER_DIR/text_sdf.frag" -o "$SHADER_DIR/text_sdf_frag.spv"
 
 echo "Shaders compiled successfully!"
 ls -lh "$SHADER_DIR"/*.spv
@@ -2,30 +2,19 @@
 
 // Input from vertex shader
 layout(location = 0) in vec2 fragTexCoord;
-layout(location = 1) flat in uint fragMode;
-layout(location = 2) in float fragOpacity;
+layout(location = 1) in float fragOpacity;
+layout(location = 2) flat in uint fragPage;
 
 // Output color
 layout(location = 0) out vec4 outColor;
 
-// Font atlas texture (grayscale)
-layout(binding = 0) uniform sampler2D fontAtlas;
+// Glyph cache pages (grayscale), one array layer per page
+layout(binding = 0) uniform sampler2DArray fontAtlas;
 
 void main() {
-    vec2 adjustedTexCoord = fragTexCoord;
-
-    // Fragmentación: mostrar solo mitad superior, inferior, o completo
-    if (fragMode == 0) {
-        // Mitad superior: Y de 0.0 a 0.5
-        adjustedTexCoord.y *= 0.5;
-    } else if (fragMode == 1) {
-        // Mitad inferior: Y de 0.5 a 1.0
-        adjustedTexCoord.y = 0.5 + adjustedTexCoord.y * 0.5;
-    }
-    // fragMode == 2 (None): usar texCoord sin modificar
-
-    // Sample the alpha from the atlas with adjusted coordinates
-    float alpha = texture(fontAtlas, adjustedTexCoord).r;
+    // Fragmentation is applied to the texture coordinates on the CPU: a
+    // half glyph arrives as that half of its atlas rectangle.
+    float alpha = texture(fontAtlas, vec3(fragTexCoord, float(fragPage))).r;
 
     // Apply opacity from push constant
     alpha *= fragOpacity;
@@ -2,13 +2,13 @@
 
 // Vertex attributes
 layout(location = 0) in vec2 inPosition;    // Screen position
-layout(location = 1) in vec2 inTexCoord;    // Texture coordinates
-layout(location = 2) in uint inFragmentMode; // 0=top, 1=bottom
+layout(location = 1) in vec2 inTexCoord;    // Texture coordinates (fragmentation already applied)
+layout(location = 2) in uint inPage;        // Glyph cache page
 
 // Output to fragment shader
 layout(location = 0) out vec2 fragTexCoord;
-layout(location = 1) flat out uint fragMode;
-layout(location = 2) out float fragOpacity;
+layout(location = 1) out float fragOpacity;
+layout(location = 2) flat out uint fragPage;
 
 // Push constants for transformation
 layout(push_constant) uniform PushConstants {
@@ -19,6 +19,6 @@ layout(push_constant) uniform PushConstants {
 void main() {
     gl_Position = pc.projection * vec4(inPosition, 0.0, 1.0);
     fragTexCoord = inTexCoord;
-    fragMode = inFragmentMode;
     fragOpacity = pc.opacity;
+    fragPage = inPage;
 }
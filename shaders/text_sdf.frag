@@ -0,0 +1,29 @@
+#version 450
+
+// Input from vertex shader
+layout(location = 0) in vec2 fragTexCoord;
+layout(location = 1) in float fragOpacity;
+layout(location = 2) flat in uint fragPage;
+
+// Output color
+layout(location = 0) out vec4 outColor;
+
+// Glyph cache pages holding signed distance fields (0.5 on the outline),
+// one array layer per page
+layout(binding = 0) uniform sampler2DArray fontAtlas;
+
+void main() {
+    // Fragmentation is applied to the texture coordinates on the CPU: a
+    // half glyph arrives as that half of its atlas rectangle.
+    // Distance to the outline; the edge is antialiased over one screen
+    // pixel whatever the text scale, so zooming needs no new atlas
+    float distance = texture(fontAtlas, vec3(fragTexCoord, float(fragPage))).r;
+    float edgeWidth = max(fwidth(distance), 1e-4);
+    float alpha = smoothstep(0.5 - edgeWidth * 0.5, 0.5 + edgeWidth * 0.5, distance);
+
+    // Apply opacity from push constant
+    alpha *= fragOpacity;
+
+    // Output white text with sampled alpha
+    outColor = vec4(1.0, 1.0, 1.0, alpha);
+}
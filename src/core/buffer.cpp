@@ -1,6 +1,8 @@
 #include "buffer.h"
 #include "utils/logger.h"
 #include <algorithm>
+#include <cstring>
+#include <utility>
 
 namespace phantom {
 
@@ -21,24 +23,19 @@ void TextBuffer::moveGap(size_t position) {
     if (position < gapStart_) {
         // Move gap left
         size_t count = gapStart_ - position;
-        size_t gapSize = gapEnd_ - gapStart_;
 
-        // Move text from [position, gapStart) to [gapEnd - count, gapEnd)
-        for (size_t i = 0; i < count; i++) {
-            buffer_[gapEnd_ - count + i] = buffer_[position + i];
-        }
+        // Move text from [position, gapStart) to [gapEnd - count, gapEnd).
+        // The ranges overlap when count exceeds the gap size.
+        std::memmove(&buffer_[gapEnd_ - count], &buffer_[position], count);
 
         gapEnd_ -= count;
         gapStart_ -= count;
     } else {
         // Move gap right
         size_t count = position - gapStart_;
-        size_t gapSize = gapEnd_ - gapStart_;
 
         // Move text from [gapEnd, gapEnd + count) to [gapStart, gapStart + count)
-        for (size_t i = 0; i < count; i++) {
-            buffer_[gapStart_ + i] = buffer_[gapEnd_ + i];
-        }
+        std::memmove(&buffer_[gapStart_], &buffer_[gapEnd_], count);
 
         gapStart_ += count;
         gapEnd_ += count;
@@ -80,6 +77,7 @@ void TextBuffer::insert(size_t position, char ch) {
 
     buffer_[gapStart_] = ch;
     gapStart_++;
+    noteEdit(gapStart_ - 1, 0, 1);
 
     LOG_TRACE(LogCategory::BUFFER, "Insert '%c' at pos %zu", ch, position);
 }
@@ -97,6 +95,7 @@ void TextBuffer::insert(size_t position, const std::string& text) {
     }
 
     gapStart_ += text.length();
+    noteEdit(gapStart_ - text.length(), 0, text.length());
 
     LOG_TRACE(LogCategory::BUFFER, "Insert \"%s\" (%zu chars) at pos %zu",
         text.c_str(), text.length(), position);
@@ -112,6 +111,7 @@ void TextBuffer::erase(size_t position, size_t length) {
 
     moveGap(position);
     gapEnd_ += length;
+    noteEdit(position, length, 0);
 
     LOG_TRACE(LogCategory::BUFFER, "Erase %zu chars at pos %zu", length, position);
 }
@@ -119,9 +119,24 @@ void TextBuffer::erase(size_t position, size_t length) {
 void TextBuffer::clear() {
     gapStart_ = 0;
     gapEnd_ = buffer_.size();
+    editSpan_ = EditSpan();
+    editSpan_.changed = true;
+    editSpan_.replaced = true;
     LOG_DEBUG(LogCategory::BUFFER, "Buffer cleared");
 }
 
+void TextBuffer::assign(std::string text) {
+    size_t length = text.size();
+    buffer_ = std::move(text);
+    buffer_.resize(length + INITIAL_GAP_SIZE);
+    gapStart_ = length;
+    gapEnd_ = buffer_.size();
+    editSpan_ = EditSpan();
+    editSpan_.changed = true;
+    editSpan_.replaced = true;
+    LOG_DEBUG(LogCategory::BUFFER, "Buffer assigned: %zu bytes", length);
+}
+
 size_t TextBuffer::length() const {
     return buffer_.size() - (gapEnd_ - gapStart_);
 }
@@ -130,15 +145,9 @@ std::string TextBuffer::getText() const {
     std::string result;
     result.reserve(length());
 
-    // Text before gap
-    for (size_t i = 0; i < gapStart_; i++) {
-        result += buffer_[i];
-    }
-
-    // Text after gap
-    for (size_t i = gapEnd_; i < buffer_.size(); i++) {
-        result += buffer_[i];
-    }
+    // Text before gap, then text after gap
+    result.append(buffer_, 0, gapStart_);
+    result.append(buffer_, gapEnd_, std::string::npos);
 
     return result;
 }
@@ -172,6 +181,41 @@ char TextBuffer::getChar(size_t position) const {
     }
 }
 
+TextSegments TextBuffer::getSegments() const {
+    TextSegments segments;
+    segments.before = buffer_.data();
+    segments.beforeLength = gapStart_;
+    segments.after = buffer_.data() + gapEnd_;
+    segments.afterLength = buffer_.size() - gapEnd_;
+    return segments;
+}
+
+EditSpan TextBuffer::takeEditSpan() {
+    EditSpan span = editSpan_;
+    editSpan_ = EditSpan();
+    return span;
+}
+
+void TextBuffer::noteEdit(size_t position, size_t removed, size_t inserted) {
+    EditSpan& span = editSpan_;
+    if (span.replaced) {
+        return;
+    }
+
+    if (!span.changed) {
+        span.changed = true;
+        span.begin = position;
+        span.end = position + inserted;
+        span.delta = static_cast<i64>(inserted) - static_cast<i64>(removed);
+        return;
+    }
+
+    // Grow the span to cover both; text past the old span shifts with the edit
+    span.begin = std::min(span.begin, position);
+    span.end = span.end >= position + removed ? span.end - removed + inserted : position + inserted;
+    span.delta += static_cast<i64>(inserted) - static_cast<i64>(removed);
+}
+
 std::string TextBuffer::getLine(size_t lineNumber) const {
     size_t start = lineStartPosition(lineNumber);
     size_t end = lineEndPosition(lineNumber);
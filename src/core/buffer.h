@@ -7,6 +7,25 @@
 
 namespace phantom {
 
+// The text on either side of the gap, in document order (no copy).
+// Pointers are invalidated by any modification of the buffer.
+struct TextSegments {
+    const char* before;
+    size_t beforeLength;
+    const char* after;
+    size_t afterLength;
+};
+
+// Where the text changed since the span was last taken. Text before begin
+// is untouched; text from end on is the old text shifted by delta.
+struct EditSpan {
+    bool changed = false;
+    bool replaced = false;      // assign()/clear(): none of the old text is known to remain
+    size_t begin = 0;
+    size_t end = 0;
+    i64 delta = 0;
+};
+
 // Simple gap buffer implementation for text editing
 // Optimized for cursor-based insertion/deletion
 class TextBuffer {
@@ -20,6 +39,10 @@ public:
     void erase(size_t position, size_t length = 1);
     void clear();
 
+    // Replace the whole content (bulk load, e.g. from a swap file).
+    // Takes ownership of the string to avoid a second copy.
+    void assign(std::string text);
+
     // Queries
     size_t length() const;
     std::string getText() const;
@@ -27,6 +50,11 @@ public:
     std::string getLine(size_t lineNumber) const;
     size_t getLineCount() const;
     char getChar(size_t position) const;
+    TextSegments getSegments() const;
+
+    // Return the span edited since the previous call and start a new one.
+    // Lets persistence rehash only what changed; callers hold the buffer lock.
+    EditSpan takeEditSpan();
 
     // Cursor utilities
     size_t lineStartPosition(size_t lineNumber) const;
@@ -37,10 +65,12 @@ public:
 private:
     void moveGap(size_t position);
     void expandGap(size_t minSize);
+    void noteEdit(size_t position, size_t removed, size_t inserted);
 
     std::string buffer_;
     size_t gapStart_;
     size_t gapEnd_;
+    EditSpan editSpan_;
 
     static constexpr size_t INITIAL_GAP_SIZE = 128;
     static constexpr size_t MIN_GAP_SIZE = 64;
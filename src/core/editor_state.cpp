@@ -1,22 +1,37 @@
 #include "editor_state.h"
 #include "persistence/swap_file.h"
+#include "persistence/edit_journal.h"
 #include "persistence/autosave.h"
+#include "persistence/version_history.h"
+#include "persistence/io_engine.h"
+#include "persistence/recovery_scanner.h"
+#include "persistence/encryption.h"
 #include "ui/revision_mode.h"
 #include "ui/confirmation_dialog.h"
 #include "utils/logger.h"
 
+#include <algorithm>
+#include <ctime>
+
 namespace phantom {
 
 EditorState::EditorState(const std::string& filePath)
+    : filePath_(filePath)
+    , documentModified_(false)
 {
     LOG_DEBUG(LogCategory::INIT, "EditorState created with file: %s",
               filePath.empty() ? "(untitled)" : filePath.c_str());
 
-    // Create swap file manager
+    // Create swap file manager and the edit journal that sits next to it
     swapFile_ = std::make_unique<SwapFile>(filePath);
+    journal_ = std::make_unique<EditJournal>(swapFile_->getJournalFilePath());
+    history_ = std::make_unique<VersionHistory>(swapFile_->getHistoryBasePath());
 
     // Create autosave manager (but don't start it yet)
-    autosave_ = std::make_unique<Autosave>(swapFile_.get(), buffer_, cursor_);
+    autosave_ = std::make_unique<Autosave>(swapFile_.get(), journal_.get(), buffer_, cursor_, bufferMutex_);
+    if (!filePath_.empty()) {
+        autosave_->setDocumentSaver([this]() { return saveDocument(); });
+    }
 
     // Create UI components
     revisionMode_ = std::make_unique<RevisionMode>();
@@ -34,6 +49,13 @@ EditorState::~EditorState() {
 
 void EditorState::startAutosave() {
     if (autosave_) {
+        // History is optional: without it autosave still protects the session.
+        // Its pack is not encrypted, so it is skipped for encrypted documents.
+        if (encryption_) {
+            LOG_INFO(LogCategory::PERSISTENCE, "Version history is off while encryption is enabled");
+        } else if (history_->open()) {
+            autosave_->setVersionHistory(history_.get());
+        }
         autosave_->start();
         LOG_INFO(LogCategory::PERSISTENCE, "Autosave started");
     }
@@ -52,15 +74,222 @@ void EditorState::saveNow() {
     }
 }
 
+bool EditorState::enableEncryption(const std::string& passphrase) {
+    auto key = std::make_shared<const EncryptionKey>(passphrase);
+    if (!key->isValid()) {
+        return false;
+    }
+
+    encryption_ = key;
+    swapFile_->setEncryption(key);
+    journal_->setEncryption(key);
+    documentFormat_.encrypted = true;
+    return true;
+}
+
+bool EditorState::loadDocument() {
+    if (filePath_.empty() || !DocumentFile::exists(filePath_)) {
+        return false;
+    }
+
+    // Decode outside the lock; the buffer takes over the string without a copy
+    std::string text;
+    DocumentFormat format;
+    if (!DocumentFile::load(filePath_, text, format, nullptr, encryption_.get())) {
+        return false;
+    }
+    if (encryption_ && !format.encrypted) {
+        LOG_INFO(LogCategory::PERSISTENCE, "%s will be saved encrypted", filePath_.c_str());
+        format.encrypted = true;
+    }
+
+    std::lock_guard<std::mutex> lock(bufferMutex_);
+    documentFormat_ = format;
+    buffer_.assign(std::move(text));
+    cursor_.setPosition(buffer_.length());
+    documentModified_.store(false);
+    return true;
+}
+
+bool EditorState::saveDocument() {
+    if (filePath_.empty()) {
+        return false;
+    }
+
+    // Only the encode runs under the lock; the engine does the write, sync and rename
+    std::vector<u8> image;
+    {
+        std::lock_guard<std::mutex> lock(bufferMutex_);
+        documentModified_.store(false);
+        if (!DocumentFile::encode(buffer_.getSegments(), documentFormat_, image, encryption_.get())) {
+            documentModified_.store(true);
+            return false;
+        }
+    }
+
+    // Autosave runs this on its own thread and needs the outcome, so it waits here
+    if (!IoEngine::get().writeFileAtomically(filePath_, std::move(image), true).get().ok) {
+        documentModified_.store(true);
+        return false;
+    }
+    return true;
+}
+
+bool EditorState::saveDocumentIfModified() {
+    if (filePath_.empty() || !documentModified_.load()) {
+        return true;
+    }
+    return saveDocument();
+}
+
+bool EditorState::hasRecoveryData() const {
+    return swapFile_ && swapFile_->exists();
+}
+
 bool EditorState::loadFromSwapFile() {
-    if (swapFile_ && swapFile_->exists()) {
-        LOG_INFO(LogCategory::PERSISTENCE, "Loading from swap file");
-        return swapFile_->read(buffer_, cursor_);
+    if (!hasRecoveryData()) {
+        return false;
+    }
+
+    LOG_INFO(LogCategory::PERSISTENCE, "Loading from swap file");
+
+    std::lock_guard<std::mutex> lock(bufferMutex_);
+
+    u32 generation = 0;
+    RecoveryReport report;
+    if (!swapFile_->read(buffer_, cursor_, &generation, &report)) {
+        return false;
+    }
+
+    // The recovered text is not what is on disk; keep the file's BOM and line breaks for the next save
+    documentModified_.store(true);
+    if (!filePath_.empty()) {
+        DocumentFile::detectFormat(filePath_, documentFormat_, encryption_.get());
+    }
+    documentFormat_.encrypted = documentFormat_.encrypted || encryption_ != nullptr;
+
+    if (!report.headerIntact) {
+        // Without the snapshot's generation the journal cannot be matched to
+        // it, and a later snapshot could reuse its generation and replay it
+        LOG_WARN(LogCategory::PERSISTENCE, "Swap header lost; edits after the last snapshot are not replayed");
+        journal_->remove();
+        return true;
+    }
+
+    // Re-apply the edits made after the snapshot
+    journal_->continueFrom(generation);
+    return journal_->replay(buffer_, cursor_, generation);
+}
+
+void EditorState::removeRecoveryFiles() {
+    if (swapFile_->exists()) {
+        swapFile_->remove();
+    }
+    if (journal_->exists()) {
+        journal_->remove();
+    }
+}
+
+bool EditorState::restoreOlderVersion() {
+    std::string current;
+    {
+        std::lock_guard<std::mutex> lock(bufferMutex_);
+        current = buffer_.getText();
+    }
+
+    size_t index = historyPosition_;
+    if (index == NOT_BROWSING) {
+        // A no-op when autosave already recorded this text, and when history is off
+        history_->commit(current, static_cast<u64>(std::time(nullptr)));
+        index = history_->getVersionCount();
+    }
+
+    while (index > 0) {
+        if (restoreVersion(--index, current)) {
+            return true;
+        }
+    }
+    LOG_INFO(LogCategory::PERSISTENCE, "No older version to restore");
+    return false;
+}
+
+bool EditorState::restoreNewerVersion() {
+    if (historyPosition_ == NOT_BROWSING) {
+        return false;
+    }
+
+    std::string current;
+    {
+        std::lock_guard<std::mutex> lock(bufferMutex_);
+        current = buffer_.getText();
     }
+
+    for (size_t index = historyPosition_ + 1; index < history_->getVersionCount(); index++) {
+        if (restoreVersion(index, current)) {
+            return true;
+        }
+    }
+    LOG_INFO(LogCategory::PERSISTENCE, "No newer version to restore");
     return false;
 }
 
+bool EditorState::restoreVersion(size_t index, const std::string& current) {
+    std::string text;
+    if (!history_->restore(index, text)) {
+        LOG_ERROR(LogCategory::PERSISTENCE, "Failed to restore history version %zu", index);
+        return false;
+    }
+    // Versions equal to the text on screen would look like nothing happened
+    if (text == current) {
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(bufferMutex_);
+        journal_->recordErase(0, buffer_.length());
+        journal_->recordInsert(0, text.data(), text.size());
+        size_t position = std::min(cursor_.getPosition(), text.size());
+        buffer_.assign(std::move(text));
+        cursor_.setPosition(position);
+    }
+
+    markDirty();
+    historyPosition_ = index;
+    LOG_INFO(LogCategory::PERSISTENCE, "Restored history version %zu of %zu", index + 1, history_->getVersionCount());
+    return true;
+}
+
+void EditorState::insertChar(char ch) {
+    {
+        std::lock_guard<std::mutex> lock(bufferMutex_);
+        size_t pos = cursor_.getPosition();
+        buffer_.insert(pos, ch);
+        cursor_.setPosition(pos + 1);
+        journal_->recordInsert(pos, &ch, 1);
+    }
+    opacityManager_.onActivity(); // Notify activity
+    markDirty();
+}
+
+void EditorState::deleteChar() {
+    if (cursor_.getPosition() == 0) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(bufferMutex_);
+        size_t pos = cursor_.getPosition() - 1;
+        buffer_.erase(pos, 1);
+        cursor_.setPosition(pos);
+        journal_->recordErase(pos, 1);
+    }
+    opacityManager_.onActivity(); // Notify activity
+    markDirty();
+}
+
 void EditorState::markDirty() {
+    historyPosition_ = NOT_BROWSING;
+    documentModified_.store(true);
     if (autosave_) {
         autosave_->markDirty();
     }
@@ -4,15 +4,21 @@
 #include "buffer.h"
 #include "cursor.h"
 #include "rendering/core/opacity_manager.h"
+#include "persistence/document_file.h"
 #include <memory>
 #include <string>
+#include <mutex>
+#include <atomic>
 
 namespace phantom {
 
 class SwapFile;
+class EditJournal;
 class Autosave;
+class VersionHistory;
 class RevisionMode;
 class ConfirmationDialog;
+class EncryptionKey;
 
 // Simple editor state that holds buffer, cursor, opacity manager, persistence, and UI state
 class EditorState {
@@ -30,7 +36,9 @@ public:
     const OpacityManager& getOpacityManager() const { return opacityManager_; }
 
     SwapFile* getSwapFile() { return swapFile_.get(); }
+    EditJournal* getJournal() { return journal_.get(); }
     Autosave* getAutosave() { return autosave_.get(); }
+    VersionHistory* getVersionHistory() { return history_.get(); }
 
     RevisionMode* getRevisionMode() { return revisionMode_.get(); }
     ConfirmationDialog* getConfirmationDialog() { return confirmationDialog_.get(); }
@@ -39,25 +47,38 @@ public:
     void startAutosave();
     void stopAutosave();
     void saveNow();
+
+    // The document itself (empty path: untitled, only the swap file is kept)
+    const std::string& getFilePath() const { return filePath_; }
+    const DocumentFormat& getDocumentFormat() const { return documentFormat_; }
+    bool loadDocument();
+    bool saveDocument();
+
+    // Save on exit; true if there was nothing to save or the save succeeded
+    bool saveDocumentIfModified();
+
+    // Encrypt the swap file, journal and saved document with a key derived
+    // from passphrase. Call before recovery or loading so encrypted files
+    // can be read. Version history is not kept while encryption is on.
+    bool enableEncryption(const std::string& passphrase);
+    bool isEncrypted() const { return encryption_ != nullptr; }
+
+    // Version history: replace the text with the version before (or after)
+    // the one restored last. Browsing starts from the newest version that
+    // differs from the text, and the text it replaces is recorded first so
+    // restoreNewerVersion() can return to it. A restore is an ordinary edit,
+    // journaled and saved like typing; typing ends browsing.
+    bool restoreOlderVersion();
+    bool restoreNewerVersion();
+
+    // Crash recovery: swap snapshot plus the edit journal written after it
+    bool hasRecoveryData() const;
     bool loadFromSwapFile();
+    void removeRecoveryFiles();
 
     // Convenience methods
-    void insertChar(char ch) {
-        buffer_.insert(cursor_.getPosition(), ch);
-        cursor_.setPosition(cursor_.getPosition() + 1);
-        opacityManager_.onActivity(); // Notify activity
-        markDirty();
-    }
-
-    void deleteChar() {
-        if (cursor_.getPosition() > 0) {
-            size_t pos = cursor_.getPosition() - 1;
-            buffer_.erase(pos, 1);
-            cursor_.setPosition(pos);
-            opacityManager_.onActivity(); // Notify activity
-            markDirty();
-        }
-    }
+    void insertChar(char ch);
+    void deleteChar();
 
     void moveCursor(size_t newPosition) {
         cursor_.setPosition(newPosition);
@@ -66,13 +87,27 @@ public:
 
 private:
     void markDirty();
+    bool restoreVersion(size_t index, const std::string& current);
+
+    static constexpr size_t NOT_BROWSING = static_cast<size_t>(-1);
+
+    std::string filePath_;
+    DocumentFormat documentFormat_;
+    std::atomic<bool> documentModified_;
 
     TextBuffer buffer_;
     Cursor cursor_;
     OpacityManager opacityManager_;
 
+    // Guards buffer_/cursor_ against the autosave thread taking snapshots
+    std::mutex bufferMutex_;
+
     std::unique_ptr<SwapFile> swapFile_;
+    std::unique_ptr<EditJournal> journal_;
+    std::unique_ptr<VersionHistory> history_;
+    size_t historyPosition_ = NOT_BROWSING;   // Version last restored
     std::unique_ptr<Autosave> autosave_;
+    std::shared_ptr<const EncryptionKey> encryption_;
 
     std::unique_ptr<RevisionMode> revisionMode_;
     std::unique_ptr<ConfirmationDialog> confirmationDialog_;
@@ -2,15 +2,27 @@
 #include "rendering/vulkan/vk_renderer.h"
 #include "rendering/vulkan/vk_text_renderer.h"
 #include "rendering/core/font_loader.h"
+#include "rendering/core/glyph_cache.h"
+#include "rendering/core/embedded_font.h"
 #include "core/editor_state.h"
 #include "persistence/swap_file.h"
+#include "persistence/io_engine.h"
+#include "persistence/document_file.h"
 #include "ui/revision_mode.h"
 #include "ui/confirmation_dialog.h"
 #include "utils/logger.h"
+#include "utils/secure_memory.h"
 #include "phantom_writer/version.h"
 
+#include <algorithm>
 #include <cstdlib>
+#include <memory>
 #include <chrono>
+#include <cmath>
+#include <future>
+#include <string>
+#include <utility>
+#include <vector>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -23,7 +35,7 @@ void showWindowsError(const char* message) {
 }
 #endif
 
-int main() {
+int main(int argc, char** argv) {
     // Initialize logger
     phantom::Logger::init("phantom_writer.log");
 
@@ -48,6 +60,9 @@ int main() {
     LOG_INFO(phantom::LogCategory::INIT, "Platform: Unknown");
 #endif
 
+    // Start the I/O engine for persistence
+    phantom::IoEngine::get().start();
+
     // Create platform context
     LOG_INFO(phantom::LogCategory::INIT, "Creating platform context");
     phantom::PlatformContext platform = phantom::createPlatformContext();
@@ -93,8 +108,33 @@ int main() {
     // Load font
     LOG_INFO(phantom::LogCategory::INIT, "Loading font");
     phantom::FontLoader fontLoader;
+    bool fontLoaded = false;
+
+    // Finished atlases are kept in the config directory, so later launches
+    // with the same font (and zoom sizes of it) map one file instead of
+    // rasterizing
+    if (platform.fileSystem) {
+        std::string atlasCacheDir = platform.fileSystem->getConfigDirectory();
+        platform.fileSystem->createDirectory(atlasCacheDir);
+        atlasCacheDir += platform.fileSystem->getPathSeparator();
+        atlasCacheDir += "atlas_cache";
+        platform.fileSystem->createDirectory(atlasCacheDir);
+        fontLoader.setAtlasCacheDirectory(atlasCacheDir);
+    }
+
+    // The default font and its startup atlas are compiled in when the build
+    // could bake them: the first frame then needs no file I/O at all
+    if (const phantom::EmbeddedFont* embedded = phantom::embeddedDefaultFont()) {
+        fontLoaded = fontLoader.loadEmbedded(*embedded);
+    } else {
+        // Distance field glyphs stay sharp at every scale the text is drawn at
+        fontLoader.setFormat(phantom::GlyphFormat::SDF);
+
+        // The font file is mapped, not read: only the pages stb_truetype touches get loaded
+        fontLoaded = fontLoader.loadFromFile("assets/fonts/default_mono.ttf", 48.0f);
+    }
 
-    if (!fontLoader.loadFromFile("assets/fonts/default_mono.ttf", 48.0f)) {
+    if (!fontLoaded) {
         LOG_FATAL(phantom::LogCategory::INIT, "Failed to load font");
         showWindowsError("Failed to load font: assets/fonts/default_mono.ttf\n\nMake sure:\n- The 'assets' folder is in the same directory as the executable\n- default_mono.ttf exists in assets/fonts/\n\nCheck phantom_writer.log for details.");
         renderer.cleanup();
@@ -103,13 +143,45 @@ int main() {
         return EXIT_FAILURE;
     }
 
+    // Optional fallback faces for what the primary font lacks, tried in
+    // this order. They load in the background and join the glyph cache
+    // when ready; they rasterize nothing up front.
+    std::vector<std::unique_ptr<phantom::FontLoader>> fallbackFonts;
+    std::future<std::vector<std::unique_ptr<phantom::FontLoader>>> fallbackLoad = std::async(std::launch::async,
+        [fileSystem = platform.fileSystem, format = fontLoader.getFormat(), size = fontLoader.getFontSize()]() {
+            const char* fallbackPaths[] = {
+                "assets/fonts/fallback_symbols.ttf",
+                "assets/fonts/fallback_cjk.ttf",
+            };
+            std::vector<std::unique_ptr<phantom::FontLoader>> loaded;
+            for (const char* path : fallbackPaths) {
+                if (!fileSystem || !fileSystem->fileExists(path)) {
+                    continue;
+                }
+                auto fallback = std::make_unique<phantom::FontLoader>();
+                fallback->setFormat(format);
+                fallback->setCharset({});
+                if (fallback->loadFromFile(path, size)) {
+                    loaded.push_back(std::move(fallback));
+                } else {
+                    LOG_WARN(phantom::LogCategory::INIT, "Skipping fallback font %s", path);
+                }
+            }
+            return loaded;
+        });
+
+    // Glyph cache: the startup ASCII atlas becomes page 0, everything else
+    // is rasterized the first time it is drawn
+    phantom::GlyphCache glyphCache(fontLoader);
+    glyphCache.seed(fontLoader.getAtlas());
+
     // Initialize text renderer
     LOG_INFO(phantom::LogCategory::INIT, "Initializing text renderer");
     phantom::VulkanTextRenderer textRenderer;
 
-    if (!textRenderer.initialize(&renderer, renderer.getRenderPass(), fontLoader.getAtlas())) {
+    if (!textRenderer.initialize(&renderer, renderer.getRenderPass(), glyphCache)) {
         LOG_FATAL(phantom::LogCategory::INIT, "Failed to initialize text renderer");
-        showWindowsError("Failed to initialize text renderer.\n\nMost common causes:\n- Shader files not found (shaders/text_vert.spv, shaders/text_frag.spv)\n- Run copy_assets_windows.bat to copy all required files\n\nCheck phantom_writer.log for details.");
+        showWindowsError("Failed to initialize text renderer.\n\nMost common causes:\n- Shader files not found (shaders/text_vert.spv, shaders/text_sdf_frag.spv)\n- Run copy_assets_windows.bat to copy all required files\n\nCheck phantom_writer.log for details.");
         renderer.cleanup();
         platform.cleanup();
         phantom::Logger::shutdown();
@@ -119,31 +191,84 @@ int main() {
     // Update projection matrix for text rendering
     textRenderer.updateProjection(windowConfig.width, windowConfig.height);
 
+    // A fresh fragmentation pattern every session; within it each position
+    // keeps its half. Stays at the fixed default pattern without a random source.
+    uint32_t fragmentSeed = 0;
+    if (phantom::secureRandom(&fragmentSeed, sizeof(fragmentSeed))) {
+        textRenderer.setFragmentSeed(fragmentSeed);
+    }
+
     // Create editor state (buffer + cursor + persistence)
-    std::string filePath = ""; // TODO: Get from command line args
+    // phantom_writer [file]: without a file the text lives only in the swap file
+    std::string filePath = argc > 1 ? argv[1] : "";
     phantom::EditorState editorState(filePath);
 
-    // Check for crash recovery
-    if (editorState.getSwapFile()->exists()) {
+    // PHANTOM_PASSPHRASE turns on at-rest encryption. It is removed from the
+    // environment right away so child processes never see it.
+    if (const char* passphrase = std::getenv("PHANTOM_PASSPHRASE")) {
+        std::string secret = passphrase;
+#ifdef _WIN32
+        _putenv_s("PHANTOM_PASSPHRASE", "");
+#else
+        unsetenv("PHANTOM_PASSPHRASE");
+#endif
+        if (!secret.empty() && !editorState.enableEncryption(secret)) {
+            // Writing plaintext after the user asked for encryption would be worse than not starting
+            LOG_FATAL(phantom::LogCategory::INIT, "Encryption was requested but could not be enabled");
+            showWindowsError("Encryption was requested but could not be enabled.\n\nCheck phantom_writer.log for details.");
+            textRenderer.cleanup();
+            renderer.cleanup();
+            platform.cleanup();
+            phantom::Logger::shutdown();
+            return EXIT_FAILURE;
+        }
+        std::fill(secret.begin(), secret.end(), '\0');
+    }
+
+    // Check for crash recovery (swap snapshot + edit journal)
+    bool recovered = false;
+    if (editorState.hasRecoveryData()) {
         if (editorState.getSwapFile()->isNewerThanOriginal()) {
             LOG_WARN(phantom::LogCategory::PERSISTENCE, "Swap file detected - possible crash recovery");
             LOG_INFO(phantom::LogCategory::PERSISTENCE, "Attempting to load from swap file");
             if (editorState.loadFromSwapFile()) {
+                recovered = true;
                 LOG_INFO(phantom::LogCategory::PERSISTENCE, "Successfully recovered from swap file");
             } else {
                 LOG_ERROR(phantom::LogCategory::PERSISTENCE, "Failed to recover from swap file");
             }
         } else {
             LOG_INFO(phantom::LogCategory::PERSISTENCE, "Removing old swap file");
-            editorState.getSwapFile()->remove();
+            editorState.removeRecoveryFiles();
+        }
+    }
+
+    if (!recovered && !filePath.empty()) {
+        if (phantom::DocumentFile::exists(filePath)) {
+            if (!editorState.loadDocument()) {
+                LOG_FATAL(phantom::LogCategory::INIT, "Failed to open %s", filePath.c_str());
+                showWindowsError("Failed to open the document.\n\nCheck phantom_writer.log for details.");
+                textRenderer.cleanup();
+                renderer.cleanup();
+                platform.cleanup();
+                phantom::Logger::shutdown();
+                return EXIT_FAILURE;
+            }
+        } else {
+            LOG_INFO(phantom::LogCategory::PERSISTENCE, "New document: %s", filePath.c_str());
         }
     }
 
     // Start autosave thread
     editorState.startAutosave();
 
+    // Document text zoom, in quarter octaves to match the glyph cache's
+    // size ladder: every zoom level has glyphs rasterized for it. Levels
+    // -2 to 8 are 71% to 400%.
+    int zoomLevel = 0;
+
     // Setup input callback to handle keyboard events (cross-platform)
-    platform.window->setInputCallback([&editorState](const phantom::InputEvent& event) {
+    platform.window->setInputCallback([&editorState, &zoomLevel](const phantom::InputEvent& event) {
             if (event.type == phantom::InputEvent::Type::Character) {
                 // If confirmation dialog is active, route input to it
                 if (editorState.getConfirmationDialog()->isActive()) {
@@ -159,8 +284,13 @@ int main() {
                     return;
                 }
 
-                // Insert printable character (only if not in confirmation dialog)
+                // Insert printable character (only if not in confirmation dialog).
+                // Control characters arrive with Ctrl shortcuts, Enter and
+                // Backspace, whose KeyDown already handled them.
                 char ch = static_cast<char>(event.data.character.codepoint);
+                if (static_cast<unsigned char>(ch) < 0x20 && ch != '\t') {
+                    return;
+                }
                 editorState.insertChar(ch);
                 LOG_TRACE(phantom::LogCategory::INPUT, "Character inserted: '%c'", ch);
             }
@@ -183,6 +313,26 @@ int main() {
                     return;
                 }
 
+                // Handle Ctrl+H / Ctrl+Shift+H (step back / forward through version history)
+                if (kbd.ctrl && kbd.key == phantom::KeyCode::H) {
+                    if (kbd.shift) {
+                        editorState.restoreNewerVersion();
+                    } else {
+                        editorState.restoreOlderVersion();
+                    }
+                    return;
+                }
+
+                // Handle Ctrl+Up / Ctrl+Down (zoom)
+                if (kbd.ctrl && (kbd.key == phantom::KeyCode::Up || kbd.key == phantom::KeyCode::Down)) {
+                    int level = zoomLevel + (kbd.key == phantom::KeyCode::Up ? 1 : -1);
+                    if (level >= -2 && level <= 8) {
+                        zoomLevel = level;
+                        LOG_INFO(phantom::LogCategory::UI, "Zoom %.0f%%", std::exp2(zoomLevel / 4.0f) * 100.0f);
+                    }
+                    return;
+                }
+
                 // Handle special keys
                 switch (kbd.key) {
                     case phantom::KeyCode::Escape:
@@ -281,8 +431,18 @@ int main() {
             continue;
         }
 
+        // Fallback fonts finished loading in the background
+        if (fallbackLoad.valid() && fallbackLoad.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            fallbackFonts = fallbackLoad.get();
+            for (const auto& fallback : fallbackFonts) {
+                glyphCache.addFallback(*fallback);
+            }
+        }
+
         // Render frame
         renderer.beginFrame();
+        glyphCache.beginFrame();
+        textRenderer.beginFrame();
 
         // Render buffer content
         std::string bufferText = editorState.getBuffer().getText();
@@ -308,7 +468,8 @@ int main() {
         // Render at top-left with some padding
         float textX = 20.0f;
         float textY = 50.0f;
-        textRenderer.renderText(renderer.getCurrentCommandBuffer(), bufferText, textX, textY, 1.0f, opacity, disableFragmentation);
+        float zoom = std::exp2(zoomLevel / 4.0f);
+        textRenderer.renderText(renderer.getCurrentCommandBuffer(), bufferText, textX, textY, zoom, opacity, disableFragmentation);
 
         // Render UI overlays
         // Confirmation dialog prompt at bottom
@@ -341,12 +502,17 @@ int main() {
     // Cleanup
     LOG_INFO(phantom::LogCategory::INIT, "Cleaning up resources");
 
-    // Stop autosave and remove swap file on clean exit
+    // Stop autosave, save the document, and remove swap file and journal on clean exit
     editorState.stopAutosave();
-    if (editorState.getSwapFile()->exists()) {
-        LOG_INFO(phantom::LogCategory::PERSISTENCE, "Removing swap file on clean exit");
-        editorState.getSwapFile()->remove();
+    if (!editorState.saveDocumentIfModified()) {
+        LOG_ERROR(phantom::LogCategory::PERSISTENCE, "Failed to save %s, keeping recovery files", filePath.c_str());
+    } else {
+        if (editorState.hasRecoveryData()) {
+            LOG_INFO(phantom::LogCategory::PERSISTENCE, "Removing swap file on clean exit");
+        }
+        editorState.removeRecoveryFiles();
     }
+    phantom::IoEngine::get().stop();
 
     textRenderer.cleanup();
     renderer.cleanup();
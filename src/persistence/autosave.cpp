@@ -1,20 +1,40 @@
 #include "autosave.h"
 #include "swap_file.h"
+#include "edit_journal.h"
+#include "version_history.h"
+#include "persistence_metrics.h"
 #include "core/buffer.h"
 #include "core/cursor.h"
 #include "utils/logger.h"
 
 #include <chrono>
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <utility>
 
 namespace phantom {
 
-Autosave::Autosave(SwapFile* swapFile, const TextBuffer& buffer, const Cursor& cursor)
+Autosave::Autosave(SwapFile* swapFile, EditJournal* journal, TextBuffer& buffer, const Cursor& cursor,
+                   std::mutex& bufferMutex)
     : swapFile_(swapFile)
+    , journal_(journal)
     , buffer_(buffer)
     , cursor_(cursor)
+    , bufferMutex_(bufferMutex)
     , running_(false)
     , shouldExit_(false)
     , isDirty_(false)
+    , checkpointRequired_(false)
+    , saveRequested_(false)
+    , documentSaveRequested_(false)
+    , policy_(DurabilityPolicy::Batched)
+    , lastEdit_(0)
+    , saveCost_(Clock::duration::zero())
+    , maxUnsavedAge_(DEFAULT_MAX_UNSAVED_AGE_MS)
+    , journalUnsynced_(false)
+    , lastJournalSync_(0)
+    , historyDirty_(false)
 {
     LOG_DEBUG(LogCategory::PERSISTENCE, "Autosave created");
 }
@@ -30,11 +50,20 @@ void Autosave::start() {
         return;
     }
 
-    LOG_INFO(LogCategory::PERSISTENCE, "Starting autosave thread (interval: %.1fs)", AUTOSAVE_INTERVAL);
+    LOG_INFO(LogCategory::PERSISTENCE, "Starting autosave thread (max unsaved age: %lldms, durability: %s)",
+             static_cast<long long>(maxUnsavedAge_.count()), durabilityPolicyName(policy_.load()));
 
     running_.store(true);
     shouldExit_.store(false);
     isDirty_.store(false);
+    lastVersion_ = Clock::now();
+    retryAt_ = Clock::time_point();
+
+    // Record the session's starting text (a no-op if history already has it)
+    historyDirty_.store(history_ != nullptr);
+
+    // The thread starts by writing the base snapshot this session's journal builds on
+    saveRequested_.store(true);
 
     autosaveThread_ = std::thread(&Autosave::autosaveLoop, this);
 }
@@ -53,50 +82,355 @@ void Autosave::stop() {
         autosaveThread_.join();
     }
 
+    // Don't leave batched journal commits unsynced
+    syncJournalIfDue(true);
+    commitVersionIfDue(true);
+
     running_.store(false);
+    PersistenceMetrics::get().logSummary();
     LOG_DEBUG(LogCategory::PERSISTENCE, "Autosave thread stopped");
 }
 
 void Autosave::saveNow() {
     LOG_DEBUG(LogCategory::PERSISTENCE, "Manual save triggered");
 
-    if (swapFile_->write(buffer_, cursor_)) {
-        isDirty_.store(false);
-        LOG_INFO(LogCategory::PERSISTENCE, "Manual save successful");
+    if (!running_.load()) {
+        // No thread to hand off to; write synchronously
+        if (!checkpoint()) {
+            LOG_ERROR(LogCategory::PERSISTENCE, "Manual save failed");
+        }
+        documentSaveRequested_.store(true);
+        saveDocument();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        documentSaveRequested_.store(true);
+        saveRequested_.store(true);
+    }
+    cv_.notify_one();
+}
+
+void Autosave::saveDocument() {
+    if (!documentSaveRequested_.exchange(false) || !documentSaver_) {
+        return;
+    }
+
+    if (documentSaver_()) {
+        LOG_INFO(LogCategory::PERSISTENCE, "Document saved");
     } else {
-        LOG_ERROR(LogCategory::PERSISTENCE, "Manual save failed");
+        LOG_ERROR(LogCategory::PERSISTENCE, "Document save failed");
+    }
+}
+
+void Autosave::setDurabilityPolicy(DurabilityPolicy policy) {
+    policy_.store(policy);
+    LOG_INFO(LogCategory::PERSISTENCE, "Durability policy: %s", durabilityPolicyName(policy));
+}
+
+bool Autosave::checkpoint() {
+    std::lock_guard<std::mutex> persistLock(persistMutex_);
+
+    // Only a snapshot this session wrote, still on disk, can stand in for a new one
+    bool snapshotOnDisk = snapshotKnown_ && !checkpointRequired_.load() && swapFile_->exists();
+
+    // Snapshot under the buffer lock; the disk I/O happens outside it
+    std::vector<u8> image;
+    u32 generation = 0;
+    u64 digest;
+    bool unchanged;
+    {
+        std::lock_guard<std::mutex> bufferLock(bufferMutex_);
+        fingerprint_.update(buffer_.getSegments(), buffer_.takeEditSpan());
+        digest = fingerprint_.digest();
+        unchanged = snapshotOnDisk && digest == snapshotDigest_;
+
+        if (unchanged) {
+            if (journal_) {
+                generation = journal_->discardPending();
+            }
+        } else {
+            if (journal_) {
+                generation = journal_->beginCheckpoint();
+            }
+            SwapFile::encode(buffer_, cursor_, generation, image);
+        }
+    }
+
+    bool sync = policy_.load() != DurabilityPolicy::None;
+
+    if (unchanged) {
+        // The journal's records add up to nothing; drop them so they aren't replayed
+        if (journal_ && journal_->hasCommittedRecords()) {
+            if (!journal_->reset(generation, sync)) {
+                checkpointRequired_.store(true);
+                return false;
+            }
+            noteJournalSynced(Clock::now());
+        }
+        PersistenceMetrics::get().checkpointsSkipped.fetch_add(1, std::memory_order_relaxed);
+        LOG_DEBUG(LogCategory::PERSISTENCE, "Checkpoint skipped: text unchanged since the last snapshot (%llu bytes rehashed)",
+                  static_cast<unsigned long long>(fingerprint_.lastHashedBytes()));
+        return true;
+    }
+
+    snapshotKnown_ = false;
+
+    if (!swapFile_->writeImage(std::move(image), sync)) {
+        // The journal still belongs to the previous snapshot; retry on the next save
+        checkpointRequired_.store(true);
+        return false;
+    }
+
+    if (journal_) {
+        if (!journal_->reset(generation, sync)) {
+            checkpointRequired_.store(true);
+            return false;
+        }
+        noteJournalSynced(Clock::now());
     }
+
+    checkpointRequired_.store(false);
+    snapshotDigest_ = digest;
+    snapshotKnown_ = true;
+    LOG_DEBUG(LogCategory::PERSISTENCE, "Checkpoint written (generation %u)", generation);
+    return true;
+}
+
+bool Autosave::needsCheckpoint() const {
+    if (!journal_ || checkpointRequired_.load()) {
+        return true;
+    }
+
+    size_t documentLength;
+    {
+        std::lock_guard<std::mutex> lock(bufferMutex_);
+        documentLength = buffer_.length();
+    }
+
+    size_t threshold = std::max(JOURNAL_MIN_CHECKPOINT_BYTES,
+                                static_cast<size_t>(documentLength * JOURNAL_CHECKPOINT_RATIO));
+    return journal_->getSizeOnDisk() > threshold;
+}
+
+bool Autosave::persist() {
+    if (needsCheckpoint()) {
+        return checkpoint();
+    }
+
+    std::lock_guard<std::mutex> persistLock(persistMutex_);
+
+    size_t bytesWritten = 0;
+    if (!journal_->commit(&bytesWritten)) {
+        // Committed records were lost with the failed write; only a snapshot is safe now
+        checkpointRequired_.store(true);
+        return false;
+    }
+
+    if (bytesWritten > 0) {
+        journalUnsynced_.store(true);
+        if (policy_.load() == DurabilityPolicy::EverySave && journal_->sync()) {
+            noteJournalSynced(Clock::now());
+        }
+    }
+    return true;
+}
+
+void Autosave::syncJournalIfDue(bool force) {
+    std::lock_guard<std::mutex> persistLock(persistMutex_);
+
+    if (!journal_ || !journalUnsynced_.load() || policy_.load() == DurabilityPolicy::None) {
+        return;
+    }
+
+    Clock::time_point now = Clock::now();
+    Clock::time_point lastSync{Clock::duration(lastJournalSync_.load())};
+    std::chrono::duration<float> sinceSync = now - lastSync;
+    if (!force && sinceSync.count() < BATCHED_SYNC_INTERVAL) {
+        return;
+    }
+
+    if (journal_->sync()) {
+        noteJournalSynced(now);
+        LOG_TRACE(LogCategory::PERSISTENCE, "Journal synced (%llu us)",
+                  static_cast<unsigned long long>(PersistenceMetrics::get().syncLatency.last()));
+    }
+}
+
+void Autosave::commitVersionIfDue(bool force) {
+    if (!history_ || !historyDirty_.load()) {
+        return;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    std::chrono::duration<float> sinceVersion = now - lastVersion_;
+    if (!force && sinceVersion.count() < HISTORY_INTERVAL) {
+        return;
+    }
+
+    // Copy under the lock; chunking and hashing happen outside it
+    std::string text;
+    {
+        std::lock_guard<std::mutex> lock(bufferMutex_);
+        text = buffer_.getText();
+    }
+    historyDirty_.store(false);
+
+    u64 timestamp = static_cast<u64>(std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+
+    if (history_->commit(text, timestamp)) {
+        lastVersion_ = now;
+    } else {
+        historyDirty_.store(true);
+        LOG_ERROR(LogCategory::PERSISTENCE, "Failed to record history version");
+    }
+}
+
+void Autosave::setMaxUnsavedAge(std::chrono::milliseconds age) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        maxUnsavedAge_ = age;
+    }
+    LOG_INFO(LogCategory::PERSISTENCE, "Max unsaved age: %lldms", static_cast<long long>(age.count()));
 }
 
 void Autosave::markDirty() {
-    isDirty_.store(true);
+    Clock::time_point now = Clock::now();
+    lastEdit_.store(now.time_since_epoch().count(), std::memory_order_relaxed);
+    historyDirty_.store(true);
+
+    if (isDirty_.load()) {
+        return;
+    }
+
+    // First edit since the last save: start the unsaved-age clock and wake the thread
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (isDirty_.exchange(true)) {
+            return;
+        }
+        firstDirty_ = now;
+    }
+    cv_.notify_one();
+}
+
+Autosave::Clock::duration Autosave::idleDelay() const {
+    Clock::duration delay = std::max<Clock::duration>(std::chrono::milliseconds(IDLE_DELAY_MS),
+                                                      saveCost_ * SAVE_COST_FACTOR);
+    return std::min<Clock::duration>(delay, maxUnsavedAge_);
+}
+
+void Autosave::recordSaveCost(Clock::duration cost) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Exponential moving average, weight 1/4
+    saveCost_ = saveCost_ == Clock::duration::zero() ? cost : (saveCost_ * 3 + cost) / 4;
+}
+
+void Autosave::markSaveFailed() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!isDirty_.exchange(true)) {
+        firstDirty_ = Clock::now();
+    }
+    retryAt_ = Clock::now() + std::chrono::milliseconds(RETRY_DELAY_MS);
+}
+
+void Autosave::noteJournalSynced(Clock::time_point when) {
+    lastJournalSync_.store(when.time_since_epoch().count());
+    journalUnsynced_.store(false);
+}
+
+Autosave::Clock::time_point Autosave::saveDeadline() const {
+    Clock::time_point lastEdit{Clock::duration(lastEdit_.load(std::memory_order_relaxed))};
+    Clock::time_point due = std::min(lastEdit + idleDelay(), firstDirty_ + maxUnsavedAge_);
+    return std::max(due, retryAt_);
+}
+
+bool Autosave::nextWakeup(Clock::time_point& when) const {
+    bool pending = false;
+    auto consider = [&](Clock::time_point t) {
+        when = pending ? std::min(when, t) : t;
+        pending = true;
+    };
+
+    if (isDirty_.load()) {
+        consider(saveDeadline());
+    }
+
+    if (journalUnsynced_.load() && policy_.load() == DurabilityPolicy::Batched) {
+        Clock::time_point lastSync{Clock::duration(lastJournalSync_.load())};
+        consider(lastSync + std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<float>(BATCHED_SYNC_INTERVAL)));
+    }
+
+    if (history_ && historyDirty_.load()) {
+        consider(lastVersion_ + std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<float>(HISTORY_INTERVAL)));
+    }
+
+    return pending;
 }
 
 void Autosave::autosaveLoop() {
     LOG_DEBUG(LogCategory::PERSISTENCE, "Autosave thread started");
 
-    while (!shouldExit_.load()) {
+    // Exit is checked after requested saves, so a stop() right after start()
+    // still gets the initial checkpoint
+    for (;;) {
         std::unique_lock<std::mutex> lock(mutex_);
 
-        // Wait for interval or exit signal
-        cv_.wait_for(lock, std::chrono::milliseconds(static_cast<int>(AUTOSAVE_INTERVAL * 1000)),
-                     [this]() { return shouldExit_.load(); });
+        // Sleep until the next deadline, or indefinitely while nothing is
+        // pending. A first edit, a manual save or exit cuts the wait short.
+        bool wasDirty = isDirty_.load();
+        auto woken = [this, wasDirty]() {
+            return shouldExit_.load() || saveRequested_.load() || (!wasDirty && isDirty_.load());
+        };
+
+        Clock::time_point wakeAt;
+        if (nextWakeup(wakeAt)) {
+            cv_.wait_until(lock, wakeAt, woken);
+        } else {
+            cv_.wait(lock, woken);
+        }
+
+        bool saveDue = isDirty_.load() && saveDeadline() <= Clock::now();
+
+        lock.unlock();
+
+        // Requested saves are honoured even when stopping
+        if (saveRequested_.exchange(false)) {
+            isDirty_.store(false);
+            if (checkpoint()) {
+                LOG_INFO(LogCategory::PERSISTENCE, "Checkpoint saved");
+                commitVersionIfDue(true);
+            } else {
+                markSaveFailed();
+                LOG_ERROR(LogCategory::PERSISTENCE, "Checkpoint save failed");
+            }
+            saveDocument();
+            continue;
+        }
 
         if (shouldExit_.load()) {
             break;
         }
 
-        // Check if buffer has been modified
-        if (isDirty_.load()) {
+        if (saveDue && isDirty_.exchange(false)) {
             LOG_TRACE(LogCategory::PERSISTENCE, "Autosaving...");
 
-            if (swapFile_->write(buffer_, cursor_)) {
-                isDirty_.store(false);
+            Clock::time_point start = Clock::now();
+            if (persist()) {
+                recordSaveCost(Clock::now() - start);
                 LOG_DEBUG(LogCategory::PERSISTENCE, "Autosave successful");
             } else {
+                markSaveFailed();
                 LOG_ERROR(LogCategory::PERSISTENCE, "Autosave failed");
             }
         }
+
+        syncJournalIfDue(false);
+        commitVersionIfDue(false);
     }
 
     LOG_DEBUG(LogCategory::PERSISTENCE, "Autosave thread exiting");
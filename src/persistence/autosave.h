@@ -5,17 +5,42 @@
 #include <mutex>
 #include <atomic>
 #include <condition_variable>
+#include <chrono>
 #include <memory>
+#include <functional>
+
+#include "durable_file.h"
+#include "content_fingerprint.h"
 
 namespace phantom {
 
 class SwapFile;
+class EditJournal;
+class VersionHistory;
 class TextBuffer;
 class Cursor;
 
+// Persists the buffer in the background. Normally only the edit journal is
+// committed; a full swap snapshot (checkpoint) is written when the journal
+// has grown relative to the document, which keeps write volume proportional
+// to what was typed rather than to the document size.
+//
+// Saves are event driven: the thread sleeps until an edit arrives, then
+// saves once typing pauses for the idle delay, or when the oldest unsaved
+// edit reaches the maximum unsaved age, whichever comes first. The idle
+// delay grows with the measured save cost, so huge documents are saved less
+// eagerly during bursts, but never later than the maximum unsaved age.
+//
+// A checkpoint first brings a content fingerprint up to date from the
+// buffer's edit span. If the text is the same as in the last snapshot this
+// session wrote (typed and deleted again, Ctrl+S with nothing new), the swap
+// file is left alone and at most the journal is emptied.
 class Autosave {
 public:
-    Autosave(SwapFile* swapFile, const TextBuffer& buffer, const Cursor& cursor);
+    // bufferMutex must be held by whoever modifies buffer/cursor. Autosave
+    // only reads the text, but takes the buffer's edit span under that lock.
+    Autosave(SwapFile* swapFile, EditJournal* journal, TextBuffer& buffer, const Cursor& cursor,
+             std::mutex& bufferMutex);
     ~Autosave();
 
     // Start autosave thread
@@ -24,10 +49,30 @@ public:
     // Stop autosave thread
     void stop();
 
-    // Trigger immediate save (called by Ctrl+S)
+    // Request an immediate checkpoint (called by Ctrl+S), followed by the
+    // document saver if one is set. The writes happen on the autosave
+    // thread, so this never blocks the caller on disk I/O.
     void saveNow();
 
-    // Mark buffer as modified (restart timer)
+    // Writes the user's document on saveNow()
+    void setDocumentSaver(std::function<bool()> saver) { documentSaver_ = std::move(saver); }
+
+    // Write a full snapshot and start a new journal generation (blocking).
+    // Skipped when the text matches the last snapshot.
+    bool checkpoint();
+
+    // Also record a version every HISTORY_INTERVAL and on every manual save
+    void setVersionHistory(VersionHistory* history) { history_ = history; }
+
+    // Trade save latency against safety (default: Batched)
+    void setDurabilityPolicy(DurabilityPolicy policy);
+    DurabilityPolicy getDurabilityPolicy() const { return policy_.load(); }
+
+    // Upper bound on how long an edit may stay unsaved (default: 5 seconds)
+    void setMaxUnsavedAge(std::chrono::milliseconds age);
+
+    // Mark buffer as modified. Wakes the thread only on the first edit
+    // after a save; later edits just push the idle deadline back.
     void markDirty();
 
     // Check if autosave is running
@@ -35,19 +80,81 @@ public:
 
 private:
     void autosaveLoop();
+    bool persist();
+    bool needsCheckpoint() const;
+    void syncJournalIfDue(bool force);
+    void commitVersionIfDue(bool force);
+
+    using Clock = std::chrono::steady_clock;
+
+    // Earliest time the thread has work to do; false if there is none
+    bool nextWakeup(Clock::time_point& when) const;
+    Clock::time_point saveDeadline() const;
+    Clock::duration idleDelay() const;
+    void recordSaveCost(Clock::duration cost);
+    void markSaveFailed();
+    void noteJournalSynced(Clock::time_point when);
+    void saveDocument();
 
     SwapFile* swapFile_;
-    const TextBuffer& buffer_;
+    EditJournal* journal_;
+    VersionHistory* history_ = nullptr;
+    std::function<bool()> documentSaver_;
+    TextBuffer& buffer_;
     const Cursor& cursor_;
+    std::mutex& bufferMutex_;
 
     std::thread autosaveThread_;
     std::mutex mutex_;
+    std::mutex persistMutex_;   // Serializes journal commits and checkpoints
     std::condition_variable cv_;
     std::atomic<bool> running_;
     std::atomic<bool> shouldExit_;
     std::atomic<bool> isDirty_;
+    std::atomic<bool> checkpointRequired_;
+    std::atomic<bool> saveRequested_;
+    std::atomic<bool> documentSaveRequested_;
+    std::atomic<DurabilityPolicy> policy_;
+
+    // Scheduling state, guarded by mutex_ (lastEdit_ is written without it)
+    std::atomic<Clock::rep> lastEdit_;
+    Clock::time_point firstDirty_;
+    Clock::time_point retryAt_;
+    Clock::duration saveCost_;           // Moving average of persist() time
+    std::chrono::milliseconds maxUnsavedAge_;
+
+    // Text of the snapshot on disk, guarded by persistMutex_
+    ContentFingerprint fingerprint_;
+    u64 snapshotDigest_ = 0;
+    bool snapshotKnown_ = false;
+
+    // Batched durability: journal commits not yet fdatasync'ed. Written
+    // under persistMutex_, which checkpoint() may hold on another thread;
+    // atomic so nextWakeup() can read them without it.
+    std::atomic<bool> journalUnsynced_;
+    std::atomic<Clock::rep> lastJournalSync_;
+
+    // Edits not yet captured in the version history
+    std::atomic<bool> historyDirty_;
+    std::chrono::steady_clock::time_point lastVersion_;
+
+    // Save after this much typing idle time, or SAVE_COST_FACTOR times the
+    // average save cost if that is longer
+    static constexpr int IDLE_DELAY_MS = 750;
+    static constexpr int SAVE_COST_FACTOR = 8;
+    static constexpr int DEFAULT_MAX_UNSAVED_AGE_MS = 5000;
+
+    // Wait this long before retrying a failed save
+    static constexpr int RETRY_DELAY_MS = 2000;
+
+    // Checkpoint once the journal exceeds this many bytes or this fraction of the document
+    static constexpr size_t JOURNAL_MIN_CHECKPOINT_BYTES = 1024 * 1024;
+    static constexpr float JOURNAL_CHECKPOINT_RATIO = 0.5f;
+
+    // Batched durability: fdatasync the journal at most this often
+    static constexpr float BATCHED_SYNC_INTERVAL = 10.0f; // seconds
 
-    static constexpr float AUTOSAVE_INTERVAL = 3.0f; // 3 seconds
+    static constexpr float HISTORY_INTERVAL = 300.0f; // 5 minutes
 };
 
 } // namespace phantom
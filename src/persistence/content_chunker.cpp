@@ -0,0 +1,63 @@
+#include "content_chunker.h"
+
+#include <algorithm>
+
+namespace phantom {
+
+namespace {
+
+// Spread-out bit masks from the FastCDC paper: 15 bits before the average
+// size makes cuts rarer, 11 bits after it makes them more likely, which
+// pulls chunk sizes towards CDC_AVG_CHUNK.
+constexpr u64 MASK_SMALL = 0x0003590703530000ull;
+constexpr u64 MASK_LARGE = 0x0000d90003530000ull;
+
+struct GearTable {
+    u64 values[256];
+
+    GearTable() {
+        // Fixed seed: boundaries must be identical across runs and machines
+        u64 state = 0x50484E544D475231ull;
+        for (u64& value : values) {
+            // splitmix64
+            state += 0x9e3779b97f4a7c15ull;
+            u64 z = state;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+            value = z ^ (z >> 31);
+        }
+    }
+};
+
+const GearTable GEAR;
+
+} // namespace
+
+size_t findChunkBoundary(const u8* data, size_t size) {
+    if (size <= CDC_MIN_CHUNK) {
+        return size;
+    }
+
+    const size_t normal = std::min(size, CDC_AVG_CHUNK);
+    const size_t end = std::min(size, CDC_MAX_CHUNK);
+
+    // Cut points below the minimum are never taken, so those bytes aren't hashed
+    u64 fingerprint = 0;
+    size_t i = CDC_MIN_CHUNK;
+
+    for (; i < normal; i++) {
+        fingerprint = (fingerprint << 1) + GEAR.values[data[i]];
+        if ((fingerprint & MASK_SMALL) == 0) {
+            return i + 1;
+        }
+    }
+    for (; i < end; i++) {
+        fingerprint = (fingerprint << 1) + GEAR.values[data[i]];
+        if ((fingerprint & MASK_LARGE) == 0) {
+            return i + 1;
+        }
+    }
+    return end;
+}
+
+} // namespace phantom
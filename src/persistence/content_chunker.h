@@ -0,0 +1,22 @@
+#ifndef PHANTOM_CONTENT_CHUNKER_H
+#define PHANTOM_CONTENT_CHUNKER_H
+
+#include <phantom_writer/types.h>
+#include <cstddef>
+
+namespace phantom {
+
+// Content-defined chunking (FastCDC: gear rolling hash with normalized
+// chunking). Boundaries depend only on nearby bytes, so an edit changes the
+// chunks around it and leaves every other chunk of the document identical.
+
+constexpr size_t CDC_MIN_CHUNK = 2 * 1024;
+constexpr size_t CDC_AVG_CHUNK = 8 * 1024;
+constexpr size_t CDC_MAX_CHUNK = 64 * 1024;
+
+// Length of the chunk starting at data (at most size bytes)
+size_t findChunkBoundary(const u8* data, size_t size);
+
+} // namespace phantom
+
+#endif // PHANTOM_CONTENT_CHUNKER_H
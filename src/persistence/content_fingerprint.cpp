@@ -0,0 +1,90 @@
+#include "content_fingerprint.h"
+#include "content_chunker.h"
+#include "core/buffer.h"
+#include "utils/hash.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace phantom {
+
+void ContentFingerprint::update(const TextSegments& text, const EditSpan& span) {
+    lastHashedBytes_ = 0;
+
+    if (!valid_ || span.replaced) {
+        chunks_.clear();
+        rechunk(text, 0, 0, 0, {});
+        valid_ = true;
+    } else if (span.changed) {
+        // Restart at the chunk holding the first edited byte; the chunks
+        // before it were cut by their own bytes, which didn't change. An
+        // append restarts at the last chunk, which was cut by the old end.
+        auto first = std::upper_bound(chunks_.begin(), chunks_.end(), static_cast<u64>(span.begin),
+                                      [](u64 position, const Chunk& chunk) {
+                                          return position < chunk.offset + chunk.length;
+                                      });
+        if (first == chunks_.end() && first != chunks_.begin()) {
+            --first;
+        }
+
+        u64 restart = first != chunks_.end() ? first->offset : 0;
+        std::vector<Chunk> tail(first, chunks_.end());
+        chunks_.erase(first, chunks_.end());
+        rechunk(text, restart, span.end, span.delta, tail);
+    } else {
+        return;
+    }
+
+    u64 digest = 0;
+    for (const Chunk& chunk : chunks_) {
+        digest = hash64(&chunk.hash, sizeof(chunk.hash), digest);
+    }
+    digest_ = digest;
+}
+
+void ContentFingerprint::rechunk(const TextSegments& text, u64 position, u64 resyncFrom, i64 delta,
+                                 const std::vector<Chunk>& tail) {
+    const u64 length = text.beforeLength + text.afterLength;
+    size_t next = 0;
+
+    while (position < length) {
+        if (position >= resyncFrom && next < tail.size()) {
+            // Unchanged text from here on: an old chunk starting at the same
+            // (shifted) place ends at the same place, and so do all after it
+            u64 oldPosition = static_cast<u64>(static_cast<i64>(position) - delta);
+            while (next < tail.size() && tail[next].offset < oldPosition) {
+                next++;
+            }
+            if (next < tail.size() && tail[next].offset == oldPosition) {
+                for (; next < tail.size(); next++) {
+                    Chunk chunk = tail[next];
+                    chunk.offset = static_cast<u64>(static_cast<i64>(chunk.offset) + delta);
+                    chunks_.push_back(chunk);
+                }
+                return;
+            }
+        }
+
+        size_t window = static_cast<size_t>(std::min<u64>(CDC_MAX_CHUNK, length - position));
+        const u8* data;
+        if (position + window <= text.beforeLength) {
+            data = reinterpret_cast<const u8*>(text.before) + position;
+        } else if (position >= text.beforeLength) {
+            data = reinterpret_cast<const u8*>(text.after) + (position - text.beforeLength);
+        } else {
+            // Straddles the gap
+            size_t head = static_cast<size_t>(text.beforeLength - position);
+            scratch_.resize(window);
+            std::memcpy(scratch_.data(), text.before + position, head);
+            std::memcpy(scratch_.data() + head, text.after, window - head);
+            data = scratch_.data();
+        }
+
+        size_t cut = findChunkBoundary(data, window);
+        chunks_.push_back({position, hash64(data, cut), static_cast<u32>(cut)});
+        lastHashedBytes_ += cut;
+        position += cut;
+    }
+}
+
+} // namespace phantom
@@ -0,0 +1,53 @@
+#ifndef PHANTOM_CONTENT_FINGERPRINT_H
+#define PHANTOM_CONTENT_FINGERPRINT_H
+
+#include <phantom_writer/types.h>
+#include <vector>
+#include <cstddef>
+
+namespace phantom {
+
+struct TextSegments;
+struct EditSpan;
+
+// Hash of the whole document, kept up to date from the buffer's edit span.
+// The text is split into content-defined chunks (see content_chunker.h) and
+// each chunk is hashed. After an edit only the chunks from the edit up to
+// the next boundary that survived it are hashed again, so the cost follows
+// the size of the edit rather than the size of the document.
+class ContentFingerprint {
+public:
+    // Catch up with the edits described by span (from TextBuffer::takeEditSpan).
+    // Call with the buffer lock held.
+    void update(const TextSegments& text, const EditSpan& span);
+
+    // Same text, same digest, whatever the edits that led to it
+    u64 digest() const { return digest_; }
+
+    size_t chunkCount() const { return chunks_.size(); }
+
+    // Bytes hashed by the last update()
+    u64 lastHashedBytes() const { return lastHashedBytes_; }
+
+private:
+    struct Chunk {
+        u64 offset;
+        u64 hash;
+        u32 length;
+    };
+
+    // Chunk the text from position on. Past resyncFrom, stop as soon as a
+    // cut lands where one of the old chunks in tail starts (shifted by
+    // delta) and keep the rest of tail as it is.
+    void rechunk(const TextSegments& text, u64 position, u64 resyncFrom, i64 delta, const std::vector<Chunk>& tail);
+
+    std::vector<Chunk> chunks_;
+    std::vector<u8> scratch_;       // Chunks that straddle the gap are copied here
+    u64 digest_ = 0;
+    u64 lastHashedBytes_ = 0;
+    bool valid_ = false;
+};
+
+} // namespace phantom
+
+#endif // PHANTOM_CONTENT_FINGERPRINT_H
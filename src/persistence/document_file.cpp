@@ -0,0 +1,459 @@
+#include "document_file.h"
+#include "durable_file.h"
+#include "encryption.h"
+#include "io_engine.h"
+#include "core/buffer.h"
+#include "utils/logger.h"
+#include "utils/text_decode.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <memory>
+#include <vector>
+
+namespace phantom {
+
+namespace {
+
+const u8 UTF8_BOM[3] = {0xEF, 0xBB, 0xBF};
+
+// How much of the file detectFormat() looks at
+constexpr size_t SNIFF_SIZE = 64 * 1024;
+
+// Spans handed to the sink per call when splitting lines for CRLF
+constexpr size_t SPAN_BATCH = 4096;
+
+// Where encode() sends its spans: the image, or a sealer in front of it
+using SpanSink = std::function<bool(const WriteSpan* spans, size_t count)>;
+
+bool startsWith(const u8* data, size_t size, const u8* prefix, size_t length) {
+    return size >= length && std::memcmp(data, prefix, length) == 0;
+}
+
+// BOM from the first bytes of a file. skip receives the BOM length; false
+// means an encoding the editor cannot open.
+bool sniffFormat(const u8* data, size_t size, DocumentFormat& format, size_t& skip) {
+    skip = 0;
+    if (startsWith(data, size, UTF8_BOM, sizeof(UTF8_BOM))) {
+        format.utf8Bom = true;
+        skip = sizeof(UTF8_BOM);
+    } else if (size >= 2 && ((data[0] == 0xFF && data[1] == 0xFE) || (data[0] == 0xFE && data[1] == 0xFF))) {
+        return false;
+    }
+    return true;
+}
+
+// The buffer only holds LF, so a file is saved with one style: whichever
+// most of its line breaks use
+void chooseLineBreaks(DocumentFormat& format, u64 crlfCount, u64 lineCount) {
+    format.crlf = crlfCount > lineCount - crlfCount;
+    format.mixedLineEndings = crlfCount > 0 && crlfCount < lineCount;
+}
+
+// Line breaks in a raw sample: all of them, and those preceded by '\r'
+void countLineBreaks(const u8* data, size_t size, u64& crlfCount, u64& lineCount) {
+    crlfCount = 0;
+    lineCount = 0;
+    const u8* end = data + size;
+    for (const u8* p = data; p < end; p++) {
+        p = static_cast<const u8*>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+        if (!p) {
+            break;
+        }
+        lineCount++;
+        crlfCount += (p > data && p[-1] == '\r');
+    }
+}
+
+// Queue a segment, turning each '\n' into "\r\n" without copying the text
+bool appendCrlfSpans(const SpanSink& sink, std::vector<WriteSpan>& spans, const char* data, size_t size) {
+    static const char CRLF[2] = {'\r', '\n'};
+
+    const char* end = data + size;
+    while (data < end) {
+        const char* newline = static_cast<const char*>(std::memchr(data, '\n', static_cast<size_t>(end - data)));
+        const char* lineEnd = newline ? newline : end;
+        if (lineEnd > data) {
+            spans.push_back({data, static_cast<size_t>(lineEnd - data)});
+        }
+        if (!newline) {
+            break;
+        }
+        spans.push_back({CRLF, sizeof(CRLF)});
+        data = newline + 1;
+
+        if (spans.size() >= SPAN_BATCH) {
+            if (!sink(spans.data(), spans.size())) {
+                return false;
+            }
+            spans.clear();
+        }
+    }
+    return true;
+}
+
+bool writeSpans(const SpanSink& sink, const TextSegments& segments, const DocumentFormat& format) {
+    std::vector<WriteSpan> spans;
+    if (format.utf8Bom) {
+        spans.push_back({UTF8_BOM, sizeof(UTF8_BOM)});
+    }
+
+    if (!format.crlf) {
+        spans.push_back({segments.before, segments.beforeLength});
+        spans.push_back({segments.after, segments.afterLength});
+        return sink(spans.data(), spans.size());
+    }
+
+    spans.reserve(SPAN_BATCH + 2);
+    return appendCrlfSpans(sink, spans, segments.before, segments.beforeLength) &&
+           appendCrlfSpans(sink, spans, segments.after, segments.afterLength) &&
+           sink(spans.data(), spans.size());
+}
+
+// Reads a file front to back through the I/O engine, keeping the next block
+// in flight while the caller works on the current one
+class EngineReader {
+public:
+    EngineReader(const std::string& path, size_t blockSize)
+        : path_(path), blockSize_(blockSize) {
+        pending_ = IoEngine::get().readFileRange(path_, 0, blockSize_);
+    }
+
+    // Copy the next size bytes to out; got < size only at the end of the file
+    bool read(u8* out, size_t size, size_t& got) {
+        got = 0;
+        while (got < size) {
+            if (position_ == block_.size()) {
+                if (atEnd_) {
+                    break;
+                }
+                if (!nextBlock()) {
+                    return false;
+                }
+                continue;
+            }
+            size_t length = std::min(size - got, block_.size() - position_);
+            std::memcpy(out + got, block_.data() + position_, length);
+            position_ += length;
+            got += length;
+        }
+        return true;
+    }
+
+    // Up to size bytes at the current position, without consuming them
+    size_t peek(u8* out, size_t size) {
+        if (position_ == block_.size() && !atEnd_ && !nextBlock()) {
+            return 0;
+        }
+        size_t length = std::min(size, block_.size() - position_);
+        std::memcpy(out, block_.data() + position_, length);
+        return length;
+    }
+
+private:
+    bool nextBlock() {
+        IoResult result = pending_.get();
+        if (!result.ok) {
+            return false;
+        }
+        block_ = std::move(result.data);
+        position_ = 0;
+        offset_ += block_.size();
+        atEnd_ = block_.size() < blockSize_;
+        if (!atEnd_) {
+            pending_ = IoEngine::get().readFileRange(path_, offset_, blockSize_);
+        }
+        return true;
+    }
+
+    std::string path_;
+    size_t blockSize_;
+    std::future<IoResult> pending_;
+    std::vector<u8> block_;
+    size_t position_ = 0;
+    u64 offset_ = 0;            // File offset just past block_
+    bool atEnd_ = false;
+};
+
+// Plaintext of an encrypted file, whole chunks at a time
+class DecryptingReader {
+public:
+    DecryptingReader(EngineReader& source, u64 fileSize)
+        : source_(source), remaining_(fileSize) {}
+
+    bool begin(const EncryptionKey& key) {
+        u8 header[sizeof(EncryptionHeader)];
+        size_t got;
+        if (remaining_ < sizeof(header) || !source_.read(header, sizeof(header), got) || got != sizeof(header) ||
+            !opener_.begin(key, header, sizeof(header))) {
+            return false;
+        }
+        remaining_ -= sizeof(header);
+        sealed_.resize(opener_.sealedChunkSize());
+        return true;
+    }
+
+    size_t chunkSize() const { return opener_.chunkSize(); }
+
+    // Fill out with as many whole chunks as fit in capacity (at least one chunk)
+    bool read(u8* out, size_t capacity, size_t& got, bool& final) {
+        got = 0;
+        while (remaining_ > 0 && capacity - got >= opener_.chunkSize()) {
+            size_t sealedSize = static_cast<size_t>(std::min<u64>(remaining_, sealed_.size()));
+            size_t sealedGot;
+            if (!source_.read(sealed_.data(), sealedSize, sealedGot) || sealedGot != sealedSize) {
+                return false;
+            }
+            remaining_ -= sealedSize;
+            if (!opener_.openChunk(index_++, sealed_.data(), sealedSize, remaining_ == 0, out + got)) {
+                LOG_ERROR(LogCategory::PERSISTENCE, "Encrypted chunk %llu failed authentication",
+                          static_cast<unsigned long long>(index_ - 1));
+                return false;
+            }
+            got += sealedSize - ENCRYPTION_TAG_SIZE;
+        }
+        final = remaining_ == 0;
+        return got > 0 || final;
+    }
+
+private:
+    EngineReader& source_;
+    u64 remaining_;
+    StreamOpener opener_;
+    std::vector<u8> sealed_;
+    u64 index_ = 0;
+};
+
+// True if the source starts like an encrypted stream (nothing is consumed)
+bool startsEncrypted(EngineReader& source) {
+    u8 magic[sizeof(ENCRYPTION_MAGIC)];
+    size_t got = source.peek(magic, sizeof(magic));
+    return isEncrypted(magic, got);
+}
+
+} // namespace
+
+bool DocumentFile::exists(const std::string& path) {
+    std::error_code error;
+    return std::filesystem::is_regular_file(path, error);
+}
+
+bool DocumentFile::detectFormat(const std::string& path, DocumentFormat& format, const EncryptionKey* key) {
+    std::error_code error;
+    u64 fileSize = std::filesystem::file_size(path, error);
+    if (error) {
+        return false;
+    }
+
+    EngineReader source(path, SNIFF_SIZE);
+    std::vector<u8> head(SNIFF_SIZE);
+    if (startsEncrypted(source)) {
+        format.encrypted = true;
+        DecryptingReader reader(source, fileSize);
+        size_t got = 0;
+        bool final;
+        bool opened = key && reader.begin(*key);
+        if (opened) {
+            head.resize(reader.chunkSize());
+            opened = reader.read(head.data(), head.size(), got, final);
+        }
+        if (!opened) {
+            // Without the plaintext only the encryption is known
+            return key == nullptr;
+        }
+        head.resize(got);
+    } else {
+        format.encrypted = false;
+        size_t got;
+        if (!source.read(head.data(), head.size(), got)) {
+            return false;
+        }
+        head.resize(got);
+    }
+
+    size_t skip;
+    if (!sniffFormat(head.data(), head.size(), format, skip)) {
+        return false;
+    }
+    u64 crlfCount;
+    u64 lineCount;
+    countLineBreaks(head.data() + skip, head.size() - skip, crlfCount, lineCount);
+    chooseLineBreaks(format, crlfCount, lineCount);
+    return true;
+}
+
+bool DocumentFile::load(const std::string& path, std::string& text, DocumentFormat& format,
+                        DocumentLoadStats* stats, const EncryptionKey* key) {
+    auto start = std::chrono::steady_clock::now();
+
+    std::error_code error;
+    u64 fileSize = std::filesystem::file_size(path, error);
+    if (error) {
+        LOG_ERROR(LogCategory::PERSISTENCE, "Cannot stat %s: %s", path.c_str(), error.message().c_str());
+        return false;
+    }
+
+    // The next block is read while this one decodes
+    EngineReader source(path, LOAD_CHUNK_SIZE);
+
+    format = DocumentFormat();
+    TextDecoder decoder;
+
+    std::unique_ptr<DecryptingReader> reader;
+    if (startsEncrypted(source)) {
+        format.encrypted = true;
+        reader.reset(new DecryptingReader(source, fileSize));
+        if (!key || !reader->begin(*key)) {
+            LOG_ERROR(LogCategory::PERSISTENCE, "%s is encrypted and %s", path.c_str(),
+                      key ? "could not be opened with this passphrase" : "no passphrase was given");
+            return false;
+        }
+    }
+
+    // Decoded text never outgrows the file, so one allocation normally suffices
+    text.clear();
+    text.resize(static_cast<size_t>(fileSize));
+
+    // Room for whole encrypted chunks plus the decoder's carry
+    std::vector<u8> chunk(reader ? std::max(LOAD_CHUNK_SIZE, 2 * reader->chunkSize()) : LOAD_CHUNK_SIZE);
+    size_t written = 0;     // Decoded text at text[0, written)
+    size_t carry = 0;       // Undecoded bytes kept at the front of chunk
+    u64 bytesRead = 0;
+    bool first = true;
+    bool ok = true;
+
+    for (;;) {
+        size_t want = chunk.size() - carry;
+        size_t got;
+        bool final;
+        if (reader) {
+            if (!reader->read(chunk.data() + carry, want, got, final)) {
+                LOG_ERROR(LogCategory::PERSISTENCE, "Cannot decrypt %s", path.c_str());
+                ok = false;
+                break;
+            }
+        } else {
+            if (!source.read(chunk.data() + carry, want, got)) {
+                LOG_ERROR(LogCategory::PERSISTENCE, "Read error in %s", path.c_str());
+                ok = false;
+                break;
+            }
+            final = got < want;
+        }
+        bytesRead += got;
+
+        size_t available = carry + got;
+        size_t skip = 0;
+
+        if (first) {
+            first = false;
+            if (!sniffFormat(chunk.data(), available, format, skip)) {
+                LOG_ERROR(LogCategory::PERSISTENCE, "%s is UTF-16, which is not supported", path.c_str());
+                ok = false;
+                break;
+            }
+        }
+
+        if (text.size() < written + available) {
+            // The file grew since it was measured
+            text.resize(written + available);
+        }
+
+        size_t consumed = 0;
+        written += decoder.decode(chunk.data() + skip, available - skip,
+                                  reinterpret_cast<u8*>(&text[written]), final, consumed);
+        carry = available - skip - consumed;
+        if (carry > 0) {
+            std::memmove(chunk.data(), chunk.data() + skip + consumed, carry);
+        }
+
+        if (final) {
+            break;
+        }
+    }
+
+    if (!ok) {
+        text.clear();
+        return false;
+    }
+
+    text.resize(written);
+    format.validUtf8 = decoder.isValidUtf8();
+
+    // Every CRLF became one '\n', so only CRLF files need the line count
+    u64 crlfCount = decoder.getCrlfCount();
+    u64 lineCount = crlfCount ? static_cast<u64>(countLineFeeds(text.data(), text.size())) : 0;
+    chooseLineBreaks(format, crlfCount, lineCount);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double mbps = seconds > 0.0 ? (bytesRead / (1024.0 * 1024.0)) / seconds : 0.0;
+
+    if (!format.validUtf8) {
+        LOG_WARN(LogCategory::PERSISTENCE, "%s is not valid UTF-8 (first bad byte at offset %llu)",
+                 path.c_str(), static_cast<unsigned long long>(decoder.getFirstInvalidOffset()));
+    }
+    if (format.mixedLineEndings) {
+        LOG_WARN(LogCategory::PERSISTENCE, "%s mixes CRLF (%llu) and LF (%llu) line breaks; it will be saved with %s",
+                 path.c_str(), static_cast<unsigned long long>(crlfCount),
+                 static_cast<unsigned long long>(lineCount - crlfCount), format.crlf ? "CRLF" : "LF");
+    }
+    LOG_INFO(LogCategory::PERSISTENCE, "Loaded %s: %llu bytes in %.2f ms (%.0f MB/s)%s%s%s",
+             path.c_str(), static_cast<unsigned long long>(bytesRead), seconds * 1000.0, mbps,
+             format.utf8Bom ? ", BOM" : "", format.crlf ? ", CRLF" : "", format.encrypted ? ", encrypted" : "");
+
+    if (stats) {
+        stats->fileBytes = bytesRead;
+        stats->textBytes = written;
+        stats->seconds = seconds;
+        stats->megabytesPerSecond = mbps;
+    }
+    return true;
+}
+
+bool DocumentFile::encode(const TextSegments& segments, const DocumentFormat& format, std::vector<u8>& image,
+                          const EncryptionKey* key) {
+    image.clear();
+
+    if (!format.encrypted) {
+        image.reserve(sizeof(UTF8_BOM) + segments.beforeLength + segments.afterLength);
+        return writeSpans(
+            [&image](const WriteSpan* spans, size_t count) {
+                for (size_t i = 0; i < count; i++) {
+                    const u8* data = static_cast<const u8*>(spans[i].data);
+                    image.insert(image.end(), data, data + spans[i].size);
+                }
+                return true;
+            },
+            segments, format);
+    }
+
+    StreamSealer sealer;
+    if (!key || !sealer.begin(*key, image)) {
+        LOG_ERROR(LogCategory::PERSISTENCE, "Cannot save an encrypted document without a usable key");
+        return false;
+    }
+
+    auto sealSpans = [&sealer](const WriteSpan* spans, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            sealer.write(spans[i].data, spans[i].size);
+        }
+        return true;
+    };
+
+    writeSpans(sealSpans, segments, format);
+    sealer.finish();
+    return true;
+}
+
+bool DocumentFile::save(const std::string& path, const TextSegments& segments, const DocumentFormat& format,
+                        bool sync, const EncryptionKey* key) {
+    std::vector<u8> image;
+    return encode(segments, format, image, key) &&
+           IoEngine::get().writeFileAtomically(path, std::move(image), sync).get().ok;
+}
+
+} // namespace phantom
@@ -0,0 +1,72 @@
+#ifndef PHANTOM_DOCUMENT_FILE_H
+#define PHANTOM_DOCUMENT_FILE_H
+
+#include <phantom_writer/types.h>
+#include <string>
+#include <vector>
+
+namespace phantom {
+
+struct TextSegments;
+class EncryptionKey;
+
+// On-disk shape of a document, restored when it is saved
+struct DocumentFormat {
+    bool utf8Bom = false;       // File started with EF BB BF
+    bool crlf = false;          // Line breaks were CRLF (the buffer always holds LF)
+    bool mixedLineEndings = false;  // Both CRLF and bare LF were found; crlf is the majority
+    bool validUtf8 = true;      // Invalid bytes are kept, but the file is flagged
+    bool encrypted = false;     // Stored as an encrypted stream (see encryption.h)
+};
+
+struct DocumentLoadStats {
+    u64 fileBytes = 0;
+    u64 textBytes = 0;
+    double seconds = 0.0;
+    double megabytesPerSecond = 0.0;
+};
+
+// Reads and writes the user's document (as opposed to the swap/journal
+// files, which are the editor's own).
+//
+// All file access goes through the IoEngine. Loading reads the file in
+// chunk-sized blocks, one block ahead of the decoder, and decodes each
+// chunk into the destination string: BOM detection, UTF-8 validation and
+// CRLF -> LF normalization happen in a single pass over the bytes (see
+// TextDecoder). Saving encodes the gap buffer's two segments (and the line
+// breaks, for CRLF files) into one image that the engine writes atomically.
+//
+// Encrypted documents go through the same paths a chunk at a time: loading
+// opens each 64 KiB chunk into the decode buffer, saving seals the spans
+// straight into the image. The key is only needed for encrypted files (or
+// format.encrypted on save).
+class DocumentFile {
+public:
+    static bool exists(const std::string& path);
+
+    // Replace text with the decoded contents of path
+    static bool load(const std::string& path, std::string& text, DocumentFormat& format,
+                     DocumentLoadStats* stats = nullptr, const EncryptionKey* key = nullptr);
+
+    // Sniff the BOM and line breaks from the start of path, without loading it
+    static bool detectFormat(const std::string& path, DocumentFormat& format, const EncryptionKey* key = nullptr);
+
+    // Replace image with the file contents for segments in the given format.
+    // The segments are not touched after this returns, so a caller can drop
+    // the buffer lock before handing the image to IoEngine::writeFileAtomically.
+    static bool encode(const TextSegments& segments, const DocumentFormat& format, std::vector<u8>& image,
+                       const EncryptionKey* key = nullptr);
+
+    // Atomically replace path with the text in segments
+    static bool save(const std::string& path, const TextSegments& segments, const DocumentFormat& format,
+                     bool sync, const EncryptionKey* key = nullptr);
+
+    static constexpr size_t LOAD_CHUNK_SIZE = 1024 * 1024;
+
+private:
+    DocumentFile() = delete;
+};
+
+} // namespace phantom
+
+#endif // PHANTOM_DOCUMENT_FILE_H
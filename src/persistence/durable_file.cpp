@@ -0,0 +1,389 @@
+#include "durable_file.h"
+#include "persistence_metrics.h"
+#include "fault_injection.h"
+#include "utils/logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#endif
+
+namespace phantom {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+u64 elapsedMicros(Clock::time_point start) {
+    return static_cast<u64>(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count());
+}
+
+#ifdef _WIN32
+constexpr size_t STAGING_SIZE = 1024 * 1024;
+#endif
+
+#ifndef _WIN32
+std::string parentDirectory(const std::string& path) {
+    size_t lastSlash = path.find_last_of("/\\");
+    if (lastSlash == std::string::npos) {
+        return ".";
+    }
+    if (lastSlash == 0) {
+        return "/";
+    }
+    return path.substr(0, lastSlash);
+}
+
+bool syncDescriptor(int fd) {
+#if defined(__linux__) || defined(__ANDROID__)
+    return fdatasync(fd) == 0;
+#else
+    return fsync(fd) == 0;
+#endif
+}
+
+// Spans per writev call; POSIX guarantees IOV_MAX >= 16, Linux/BSD allow 1024
+constexpr int WRITEV_BATCH = 1024;
+
+// writev that lets the FaultInjector cut it short or fail it
+ssize_t injectedWritev(int fd, iovec* iov, int count) {
+    size_t total = 0;
+    for (int i = 0; i < count; i++) {
+        total += iov[i].iov_len;
+    }
+
+    size_t allowed = total;
+    if (!FaultInjector::get().admitWrite(allowed)) {
+        return -1;
+    }
+
+    int used = 0;
+    for (size_t left = allowed; used < count && left > 0; used++) {
+        iov[used].iov_len = std::min(iov[used].iov_len, left);
+        left -= iov[used].iov_len;
+    }
+    return ::writev(fd, iov, used);
+}
+#endif
+
+} // namespace
+
+const char* durabilityPolicyName(DurabilityPolicy policy) {
+    switch (policy) {
+        case DurabilityPolicy::None: return "none";
+        case DurabilityPolicy::Batched: return "batched";
+        case DurabilityPolicy::EverySave: return "every-save";
+        default: return "unknown";
+    }
+}
+
+#ifdef _WIN32
+
+bool DurableFile::writeAtomically(const std::string& path, const void* data, size_t size, bool sync) {
+    AtomicFileWriter writer(path);
+    return writer.open() && writer.write(data, size) && writer.commit(sync);
+}
+
+bool DurableFile::syncStream(std::FILE* file) {
+    if (std::fflush(file) != 0) {
+        return false;
+    }
+
+    if (!FaultInjector::get().admitOperation()) {
+        return false;
+    }
+
+    Clock::time_point start = Clock::now();
+    bool ok = _commit(_fileno(file)) == 0;
+    PersistenceMetrics::get().syncLatency.record(elapsedMicros(start));
+    return ok;
+}
+
+bool DurableFile::syncParentDirectory(const std::string& path) {
+    (void)path; // NTFS makes the rename durable with MOVEFILE_WRITE_THROUGH
+    return true;
+}
+
+AtomicFileWriter::AtomicFileWriter(const std::string& path)
+    : path_(path)
+    , tempPath_(path + ".tmp")
+    , handle_(INVALID_HANDLE_VALUE)
+{
+}
+
+AtomicFileWriter::~AtomicFileWriter() {
+    abandon();
+}
+
+bool AtomicFileWriter::open() {
+    handle_ = CreateFileA(tempPath_.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                          FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle_ == INVALID_HANDLE_VALUE) {
+        LOG_ERROR(LogCategory::PERSISTENCE, "Failed to create temp file: %s", tempPath_.c_str());
+        return false;
+    }
+    staging_.reserve(STAGING_SIZE);
+    return true;
+}
+
+bool AtomicFileWriter::flushStaging() {
+    const u8* bytes = staging_.data();
+    size_t remaining = staging_.size();
+    while (!failed_ && remaining > 0) {
+        size_t allowed = remaining > (1u << 30) ? (1u << 30) : remaining;
+        if (!FaultInjector::get().admitWrite(allowed)) {
+            failed_ = true;
+            break;
+        }
+        DWORD chunk = static_cast<DWORD>(allowed);
+        DWORD written = 0;
+        failed_ = !WriteFile(static_cast<HANDLE>(handle_), bytes, chunk, &written, nullptr) || written != chunk;
+        bytes += written;
+        remaining -= written;
+    }
+    staging_.clear();
+    return !failed_;
+}
+
+bool AtomicFileWriter::write(const void* data, size_t size) {
+    WriteSpan span{data, size};
+    return write(&span, 1);
+}
+
+bool AtomicFileWriter::write(const WriteSpan* spans, size_t count) {
+    if (handle_ == INVALID_HANDLE_VALUE || failed_) {
+        return false;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        const u8* bytes = static_cast<const u8*>(spans[i].data);
+        if (spans[i].size >= STAGING_SIZE) {
+            // Large spans go straight to the file
+            if (!flushStaging()) {
+                break;
+            }
+            staging_.assign(bytes, bytes + spans[i].size);
+            flushStaging();
+            staging_.shrink_to_fit();
+            staging_.reserve(STAGING_SIZE);
+            continue;
+        }
+        if (staging_.size() + spans[i].size > STAGING_SIZE && !flushStaging()) {
+            break;
+        }
+        staging_.insert(staging_.end(), bytes, bytes + spans[i].size);
+    }
+
+    if (failed_) {
+        LOG_ERROR(LogCategory::PERSISTENCE, "Failed to write %s", tempPath_.c_str());
+    }
+    return !failed_;
+}
+
+bool AtomicFileWriter::commit(bool sync) {
+    if (handle_ == INVALID_HANDLE_VALUE || !flushStaging()) {
+        abandon();
+        return false;
+    }
+
+    bool ok = FaultInjector::get().admitOperation();
+    if (ok && sync) {
+        Clock::time_point start = Clock::now();
+        ok = FlushFileBuffers(static_cast<HANDLE>(handle_)) != 0;
+        PersistenceMetrics::get().syncLatency.record(elapsedMicros(start));
+    }
+
+    CloseHandle(static_cast<HANDLE>(handle_));
+    handle_ = INVALID_HANDLE_VALUE;
+
+    if (!ok || !FaultInjector::get().admitOperation() || !MoveFileExA(tempPath_.c_str(), path_.c_str(),
+                            MOVEFILE_REPLACE_EXISTING | (sync ? MOVEFILE_WRITE_THROUGH : 0))) {
+        LOG_ERROR(LogCategory::PERSISTENCE, "Atomic write failed: %s", path_.c_str());
+        DeleteFileA(tempPath_.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+void AtomicFileWriter::abandon() {
+    if (handle_ != INVALID_HANDLE_VALUE) {
+        CloseHandle(static_cast<HANDLE>(handle_));
+        handle_ = INVALID_HANDLE_VALUE;
+        DeleteFileA(tempPath_.c_str());
+    }
+}
+
+#else
+
+bool DurableFile::writeAtomically(const std::string& path, const void* data, size_t size, bool sync) {
+    AtomicFileWriter writer(path);
+    return writer.open() && writer.write(data, size) && writer.commit(sync);
+}
+
+AtomicFileWriter::AtomicFileWriter(const std::string& path)
+    : path_(path)
+    , tempPath_(path + ".tmp")
+{
+}
+
+AtomicFileWriter::~AtomicFileWriter() {
+    abandon();
+}
+
+bool AtomicFileWriter::open() {
+    // Owner-only unless replacing an existing file: swap files hold the full document text
+    fd_ = ::open(tempPath_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd_ < 0) {
+        LOG_ERROR(LogCategory::PERSISTENCE, "Failed to create temp file %s: %s", tempPath_.c_str(), strerror(errno));
+        return false;
+    }
+
+    struct stat original;
+    if (::stat(path_.c_str(), &original) == 0) {
+        fchmod(fd_, original.st_mode & 07777);
+    }
+    return true;
+}
+
+bool AtomicFileWriter::write(const void* data, size_t size) {
+    WriteSpan span{data, size};
+    return write(&span, 1);
+}
+
+bool AtomicFileWriter::write(const WriteSpan* spans, size_t count) {
+    if (fd_ < 0 || failed_) {
+        return false;
+    }
+
+    iovec iov[WRITEV_BATCH];
+    size_t next = 0;
+    size_t skip = 0;    // Bytes of spans[next] already written
+
+    while (next < count) {
+        int batch = 0;
+        for (size_t i = next; i < count && batch < WRITEV_BATCH; i++) {
+            size_t offset = i == next ? skip : 0;
+            iov[batch].iov_base = const_cast<u8*>(static_cast<const u8*>(spans[i].data) + offset);
+            iov[batch].iov_len = spans[i].size - offset;
+            batch++;
+        }
+
+        ssize_t written = FaultInjector::get().isArmed() ? injectedWritev(fd_, iov, batch) : ::writev(fd_, iov, batch);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG_ERROR(LogCategory::PERSISTENCE, "Failed to write %s: %s", tempPath_.c_str(), strerror(errno));
+            failed_ = true;
+            return false;
+        }
+
+        // Advance past what was written; a short write resumes mid-span
+        size_t remaining = static_cast<size_t>(written);
+        while (next < count && remaining >= spans[next].size - skip) {
+            remaining -= spans[next].size - skip;
+            skip = 0;
+            next++;
+        }
+        skip += remaining;
+    }
+    return true;
+}
+
+bool AtomicFileWriter::commit(bool sync) {
+    if (fd_ < 0 || failed_) {
+        abandon();
+        return false;
+    }
+
+    bool ok = FaultInjector::get().admitOperation();
+    Clock::time_point start = Clock::now();
+    if (ok && sync && !syncDescriptor(fd_)) {
+        LOG_ERROR(LogCategory::PERSISTENCE, "fdatasync failed for %s: %s", tempPath_.c_str(), strerror(errno));
+        ok = false;
+    }
+
+    if (::close(fd_) != 0) {
+        ok = false;
+    }
+    fd_ = -1;
+
+    if (!ok) {
+        ::unlink(tempPath_.c_str());
+        return false;
+    }
+
+    if (!FaultInjector::get().admitOperation() || ::rename(tempPath_.c_str(), path_.c_str()) != 0) {
+        LOG_ERROR(LogCategory::PERSISTENCE, "rename %s -> %s failed: %s", tempPath_.c_str(), path_.c_str(), strerror(errno));
+        ::unlink(tempPath_.c_str());
+        return false;
+    }
+
+    if (sync) {
+        // The directory entry must reach the disk too, or the rename can be lost
+        ok = DurableFile::syncParentDirectory(path_);
+        PersistenceMetrics::get().syncLatency.record(elapsedMicros(start));
+    }
+
+    return ok;
+}
+
+void AtomicFileWriter::abandon() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+        ::unlink(tempPath_.c_str());
+    }
+}
+
+bool DurableFile::syncStream(std::FILE* file) {
+    if (std::fflush(file) != 0) {
+        return false;
+    }
+
+    if (!FaultInjector::get().admitOperation()) {
+        return false;
+    }
+
+    Clock::time_point start = Clock::now();
+    bool ok = syncDescriptor(fileno(file));
+    PersistenceMetrics::get().syncLatency.record(elapsedMicros(start));
+
+    if (!ok) {
+        LOG_ERROR(LogCategory::PERSISTENCE, "fdatasync failed: %s", strerror(errno));
+    }
+    return ok;
+}
+
+bool DurableFile::syncParentDirectory(const std::string& path) {
+    if (!FaultInjector::get().admitOperation()) {
+        return false;
+    }
+
+    std::string directory = parentDirectory(path);
+
+    int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        LOG_WARN(LogCategory::PERSISTENCE, "Cannot open directory %s for fsync", directory.c_str());
+        return false;
+    }
+
+    bool ok = fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+}
+
+#endif
+
+} // namespace phantom
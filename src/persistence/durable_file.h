@@ -0,0 +1,88 @@
+#ifndef PHANTOM_DURABLE_FILE_H
+#define PHANTOM_DURABLE_FILE_H
+
+#include <phantom_writer/types.h>
+#include <string>
+#include <cstdio>
+#include <cstddef>
+#include <vector>
+
+namespace phantom {
+
+// How hard persistence tries to get data onto stable storage
+enum class DurabilityPolicy {
+    None,       // Never fsync: survives an app crash, not a power loss
+    Batched,    // Snapshots are synced; journal syncs are coalesced (at most one per interval)
+    EverySave   // Every snapshot and every journal commit is synced before returning
+};
+
+const char* durabilityPolicyName(DurabilityPolicy policy);
+
+// One piece of a gathered write
+struct WriteSpan {
+    const void* data;
+    size_t size;
+};
+
+// Crash-safe file primitives. Sync latencies are recorded in PersistenceMetrics.
+class DurableFile {
+public:
+    // Replace path atomically: write path.tmp, fdatasync it, rename over
+    // path, then fsync the directory so the rename itself is durable.
+    // With sync == false the rename is still atomic but nothing is flushed.
+    static bool writeAtomically(const std::string& path, const void* data, size_t size, bool sync);
+
+    // Flush a stdio stream and fdatasync its file
+    static bool syncStream(std::FILE* file);
+
+    // fsync the directory containing path (no-op on Windows)
+    static bool syncParentDirectory(const std::string& path);
+
+private:
+    DurableFile() = delete;
+};
+
+// Incremental form of DurableFile::writeAtomically, for callers that write
+// from several buffers and want to do the slow part (sync + rename) after
+// releasing whatever those buffers were borrowed from:
+//
+//   AtomicFileWriter writer(path);
+//   writer.open() && writer.write(spans, count) && writer.commit(sync);
+//
+// The temp file keeps the permissions of the file it replaces. Destroying
+// the writer before a successful commit() deletes the temp file.
+class AtomicFileWriter {
+public:
+    explicit AtomicFileWriter(const std::string& path);
+    ~AtomicFileWriter();
+
+    bool open();
+    bool write(const void* data, size_t size);
+    bool write(const WriteSpan* spans, size_t count);
+
+    // Flush, optionally sync, and rename over the target
+    bool commit(bool sync);
+
+private:
+    AtomicFileWriter(const AtomicFileWriter&) = delete;
+    AtomicFileWriter& operator=(const AtomicFileWriter&) = delete;
+
+    void abandon();
+
+    std::string path_;
+    std::string tempPath_;
+    bool failed_ = false;
+
+#ifdef _WIN32
+    bool flushStaging();
+
+    void* handle_;
+    std::vector<u8> staging_;    // Coalesces small spans into fewer WriteFile calls
+#else
+    int fd_ = -1;
+#endif
+};
+
+} // namespace phantom
+
+#endif // PHANTOM_DURABLE_FILE_H
@@ -0,0 +1,448 @@
+#include "edit_journal.h"
+#include "recovery_scanner.h"
+#include "io_engine.h"
+#include "persistence_metrics.h"
+#include "core/buffer.h"
+#include "core/cursor.h"
+#include "utils/crc32c.h"
+#include "utils/logger.h"
+#include "utils/mapped_file.h"
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <cstdio>
+#include <fstream>
+#include <utility>
+
+namespace phantom {
+
+namespace {
+
+template <typename T>
+u32 crcOfHeader(const T& header) {
+    return crc32c(&header, sizeof(T) - sizeof(u32));
+}
+
+void appendBytes(std::vector<u8>& out, const void* data, size_t length) {
+    const u8* bytes = static_cast<const u8*>(data);
+    out.insert(out.end(), bytes, bytes + length);
+}
+
+} // namespace
+
+EditJournal::EditJournal(const std::string& journalFilePath)
+    : journalFilePath_(journalFilePath)
+{
+    // Continue numbering after a journal left behind by a previous session so
+    // a new snapshot can never be mistaken for the base of the old journal
+    MappedFile existing;
+    if (existing.open(journalFilePath_) && existing.size() >= sizeof(JournalHeader)) {
+        JournalHeader header;
+        std::memcpy(&header, existing.data(), sizeof(header));
+        if (std::memcmp(header.magic, JOURNAL_MAGIC, sizeof(header.magic)) == 0) {
+            generation_ = header.generation;
+        }
+    }
+
+    LOG_DEBUG(LogCategory::PERSISTENCE, "EditJournal created: %s (generation %u)",
+              journalFilePath_.c_str(), generation_);
+}
+
+EditJournal::~EditJournal() {
+    LOG_TRACE(LogCategory::PERSISTENCE, "EditJournal destroyed");
+}
+
+void EditJournal::recordInsert(size_t position, const char* data, size_t length) {
+    if (length == 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Typing extends the previous insert
+    if (!pending_.empty()) {
+        PendingRecord& last = pending_.back();
+        if (last.type == JournalRecordType::Insert && position == last.position + last.data.size()) {
+            last.data.append(data, length);
+            last.length = last.data.size();
+            return;
+        }
+    }
+
+    pending_.push_back({JournalRecordType::Insert, position, length, std::string(data, length)});
+}
+
+void EditJournal::recordErase(size_t position, size_t length) {
+    if (length == 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (!pending_.empty()) {
+        PendingRecord& last = pending_.back();
+
+        // Backspacing over text that was never committed just shortens the insert
+        if (last.type == JournalRecordType::Insert &&
+            position >= last.position &&
+            position + length == last.position + last.data.size()) {
+            last.data.resize(position - last.position);
+            last.length = last.data.size();
+            if (last.data.empty()) {
+                pending_.pop_back();
+            }
+            return;
+        }
+
+        if (last.type == JournalRecordType::Erase) {
+            if (position + length == last.position) {
+                // Backspace run
+                last.position = position;
+                last.length += length;
+                return;
+            }
+            if (position == last.position) {
+                // Forward delete run
+                last.length += length;
+                return;
+            }
+        }
+    }
+
+    pending_.push_back({JournalRecordType::Erase, position, length, std::string()});
+}
+
+bool EditJournal::commit(size_t* bytesWritten) {
+    if (bytesWritten) {
+        *bytesWritten = 0;
+    }
+
+    bool startFile;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (pending_.empty()) {
+            return true;
+        }
+        // Records can only be sealed into a file this session started
+        startFile = encryption_ && !sealing_;
+    }
+
+    // A missing journal is started fresh for the current generation. This
+    // comes before numbering the batch, because a new file starts at 0.
+    if ((startFile || !exists()) && !reset(getGeneration())) {
+        return false;
+    }
+
+    std::vector<PendingRecord> batch;
+    u64 firstSequence;
+    FileKey key;
+    bool seal;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        batch.swap(pending_);
+        if (batch.empty()) {
+            return true;
+        }
+        firstSequence = nextSequence_;
+        nextSequence_ += batch.size();
+        seal = sealing_;
+        key = fileKey_;
+    }
+
+    // Serialize the whole batch so it reaches the file in one write
+    std::vector<u8> out;
+    size_t estimate = 0;
+    for (const PendingRecord& record : batch) {
+        estimate += sizeof(JournalRecordHeader) + record.data.size() + (seal ? ENCRYPTION_TAG_SIZE : 0);
+    }
+    out.reserve(estimate);
+
+    u64 sequence = firstSequence;
+    for (const PendingRecord& record : batch) {
+        JournalRecordHeader header{};
+        header.magic = JOURNAL_RECORD_MAGIC;
+        header.type = static_cast<u8>(record.type);
+        header.flags = seal ? JOURNAL_RECORD_SEALED : 0;
+        header.sequence = sequence++;
+        header.position = record.position;
+        header.length = static_cast<u32>(record.length);
+
+        size_t payloadSize = record.data.size() + (seal ? ENCRYPTION_TAG_SIZE : 0);
+        size_t headerOffset = out.size();
+        out.resize(headerOffset + sizeof(header) + payloadSize);
+        u8* payload = out.data() + headerOffset + sizeof(header);
+
+        if (seal) {
+            // The header (minus the CRC, which covers the ciphertext) is the associated data
+            key.seal(header.sequence, NONCE_JOURNAL_RECORD, reinterpret_cast<const u8*>(&header),
+                     sizeof(header) - sizeof(header.crc), reinterpret_cast<const u8*>(record.data.data()),
+                     payload, record.data.size(), payload + record.data.size());
+        } else {
+            std::memcpy(payload, record.data.data(), record.data.size());
+        }
+
+        header.crc = crc32c(payload, payloadSize, crcOfHeader(header));
+        std::memcpy(out.data() + headerOffset, &header, sizeof(header));
+    }
+
+    size_t size = out.size();
+    if (!IoEngine::get().appendFile(journalFilePath_, std::move(out), false).get().ok) {
+        LOG_ERROR(LogCategory::PERSISTENCE, "Failed to append to journal: %s", journalFilePath_.c_str());
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sizeOnDisk_ += size;
+    }
+    PersistenceMetrics::get().journalBytesWritten.fetch_add(size, std::memory_order_relaxed);
+
+    if (bytesWritten) {
+        *bytesWritten = size;
+    }
+
+    LOG_TRACE(LogCategory::PERSISTENCE, "Journal commit: %zu records, %zu bytes", batch.size(), size);
+    return true;
+}
+
+void EditJournal::continueFrom(u32 generation) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (generation > generation_) {
+        generation_ = generation;
+    }
+}
+
+u32 EditJournal::beginCheckpoint() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.clear();
+    generation_++;
+    return generation_;
+}
+
+u32 EditJournal::discardPending() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.clear();
+    return generation_;
+}
+
+bool EditJournal::hasCommittedRecords() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return sizeOnDisk_ > headerSizeOnDisk_;
+}
+
+bool EditJournal::sync() {
+    if (!exists()) {
+        return true;
+    }
+    return IoEngine::get().syncFile(journalFilePath_).get().ok;
+}
+
+bool EditJournal::reset(u32 generation, bool sync) {
+    std::shared_ptr<const EncryptionKey> encryption;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        generation_ = generation;
+        encryption = encryption_;
+    }
+
+    JournalHeader header{};
+    std::memcpy(header.magic, JOURNAL_MAGIC, sizeof(header.magic));
+    header.version = JOURNAL_VERSION;
+    header.generation = generation;
+    header.createdAt = static_cast<u64>(time(nullptr));
+    header.flags = encryption ? JOURNAL_ENCRYPTED : 0;
+    header.headerCrc = crcOfHeader(header);
+
+    // Every reset starts a new file key, so record nonces never repeat under one key
+    EncryptionHeader encryptionHeader{};
+    FileKey key;
+    if (encryption && !encryption->newFile(encryptionHeader, key)) {
+        LOG_ERROR(LogCategory::PERSISTENCE, "Failed to create journal key: %s", journalFilePath_.c_str());
+        return false;
+    }
+
+    std::vector<u8> image;
+    appendBytes(image, &header, sizeof(header));
+    if (encryption) {
+        appendBytes(image, &encryptionHeader, sizeof(encryptionHeader));
+    }
+    size_t size = image.size();
+
+    if (!IoEngine::get().writeFileAtomically(journalFilePath_, std::move(image), sync).get().ok) {
+        LOG_ERROR(LogCategory::PERSISTENCE, "Failed to reset journal: %s", journalFilePath_.c_str());
+        return false;
+    }
+
+    PersistenceMetrics::get().journalBytesWritten.fetch_add(size, std::memory_order_relaxed);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sizeOnDisk_ = size;
+        headerSizeOnDisk_ = size;
+        nextSequence_ = 0;
+        sealing_ = encryption != nullptr;
+        encryptionHeader_ = encryptionHeader;
+        fileKey_ = key;
+    }
+
+    LOG_DEBUG(LogCategory::PERSISTENCE, "Journal reset to generation %u", generation);
+    return true;
+}
+
+bool EditJournal::replay(TextBuffer& buffer, Cursor& cursor, u32 generation) const {
+    MappedFile file;
+    if (!file.open(journalFilePath_)) {
+        LOG_DEBUG(LogCategory::PERSISTENCE, "No journal to replay: %s", journalFilePath_.c_str());
+        return true;
+    }
+
+    const u8* data = file.data();
+    const size_t size = file.size();
+
+    JournalHeader header;
+    if (size < sizeof(header)) {
+        LOG_WARN(LogCategory::PERSISTENCE, "Journal too small, ignoring: %s", journalFilePath_.c_str());
+        return true;
+    }
+    std::memcpy(&header, data, sizeof(header));
+
+    if (std::memcmp(header.magic, JOURNAL_MAGIC, sizeof(header.magic)) != 0 ||
+        header.headerCrc != crcOfHeader(header) || header.version != JOURNAL_VERSION) {
+        LOG_WARN(LogCategory::PERSISTENCE, "Invalid journal header, ignoring: %s", journalFilePath_.c_str());
+        return true;
+    }
+
+    if (header.generation != generation) {
+        // The snapshot was taken after this journal was written; it already has these edits
+        LOG_INFO(LogCategory::PERSISTENCE, "Journal generation %u does not match snapshot %u, ignoring",
+                 header.generation, generation);
+        return true;
+    }
+
+    size_t firstRecord = sizeof(header);
+    const bool encrypted = (header.flags & JOURNAL_ENCRYPTED) != 0;
+    FileKey key;
+
+    if (encrypted) {
+        std::shared_ptr<const EncryptionKey> encryption;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            encryption = encryption_;
+        }
+        EncryptionHeader encryptionHeader;
+        bool opened = encryption && size - firstRecord >= sizeof(encryptionHeader);
+        if (opened) {
+            std::memcpy(&encryptionHeader, data + firstRecord, sizeof(encryptionHeader));
+            opened = encryption->openFile(encryptionHeader, key);
+        }
+        if (!opened) {
+            LOG_ERROR(LogCategory::PERSISTENCE, "Encrypted journal cannot be opened (%s), edits not replayed",
+                      encryption ? "wrong passphrase or damaged header" : "no passphrase");
+            return true;
+        }
+        firstRecord += sizeof(EncryptionHeader);
+    }
+
+    // Each record's position assumes every earlier edit was applied, so replay
+    // stops at the first damaged record or sequence gap, including a first
+    // record other than 0. Everything from there on is reported as lost
+    // instead of being applied at the wrong place.
+    RecoveryReport report;
+    report.headerIntact = true;
+    size_t applied = 0;
+    size_t cursorPos = cursor.getPosition();
+    u64 expectedSequence = 0;
+    std::string text;
+
+    auto stopAt = [&](const u8* payload, const char* reason, u64 sequence) {
+        size_t offset = static_cast<size_t>(payload - data) - sizeof(JournalRecordHeader);
+        report.lostRanges.push_back({offset, size});
+        LOG_ERROR(LogCategory::PERSISTENCE, "Journal replay stopped at record %llu (%s); %zu bytes not applied",
+                  static_cast<unsigned long long>(sequence), reason, size - offset);
+        return false;
+    };
+
+    scanJournalRecords(data, size, firstRecord, report,
+                       [&](const JournalRecordHeader& record, const u8* payload) {
+        const bool isInsert = record.type == static_cast<u8>(JournalRecordType::Insert);
+        const bool sealed = (record.flags & JOURNAL_RECORD_SEALED) != 0;
+
+        // The scanner has already recorded the damaged stretch before this record
+        if (report.damagedRegions > 0) {
+            return stopAt(payload, "follows a damaged stretch", record.sequence);
+        }
+        if (record.sequence != expectedSequence) {
+            report.damagedRegions++;
+            return stopAt(payload, "sequence gap", record.sequence);
+        }
+        expectedSequence = record.sequence + 1;
+
+        if (encrypted) {
+            // Unsealed records in an encrypted journal were not written by the editor
+            JournalRecordHeader aad = record;
+            size_t textSize = isInsert ? record.length : 0;
+            text.resize(textSize);
+            if (!sealed || !key.open(record.sequence, NONCE_JOURNAL_RECORD, reinterpret_cast<const u8*>(&aad),
+                                     sizeof(aad) - sizeof(aad.crc), payload,
+                                     reinterpret_cast<u8*>(&text[0]), textSize, payload + textSize)) {
+                report.damagedRegions++;
+                return stopAt(payload, "failed authentication", record.sequence);
+            }
+        } else if (isInsert) {
+            text.assign(reinterpret_cast<const char*>(payload), record.length);
+        }
+
+        size_t position = static_cast<size_t>(record.position);
+        if (position > buffer.length()) {
+            report.damagedRegions++;
+            return stopAt(payload, "outside the document", record.sequence);
+        }
+
+        if (isInsert) {
+            buffer.insert(position, text);
+            cursorPos = position + record.length;
+        } else {
+            buffer.erase(position, record.length);
+            cursorPos = position;
+        }
+        applied++;
+        return true;
+    });
+    // The record replay stopped at verified, but was not applied
+    report.intactBlocks = static_cast<u32>(applied);
+
+    cursor.setPosition(std::min(cursorPos, buffer.length()));
+    LOG_INFO(LogCategory::PERSISTENCE, "Journal replayed: %zu records", applied);
+    if (!report.isComplete()) {
+        logRecoveryReport("Journal", report);
+    }
+    return true;
+}
+
+void EditJournal::setEncryption(std::shared_ptr<const EncryptionKey> key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    encryption_ = std::move(key);
+    sealing_ = false;
+}
+
+bool EditJournal::exists() const {
+    std::ifstream file(journalFilePath_);
+    return file.good();
+}
+
+bool EditJournal::remove() {
+    return std::remove(journalFilePath_.c_str()) == 0;
+}
+
+u32 EditJournal::getGeneration() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return generation_;
+}
+
+u64 EditJournal::getSizeOnDisk() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return sizeOnDisk_;
+}
+
+} // namespace phantom
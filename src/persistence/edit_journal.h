@@ -0,0 +1,152 @@
+#ifndef PHANTOM_EDIT_JOURNAL_H
+#define PHANTOM_EDIT_JOURNAL_H
+
+#include <phantom_writer/types.h>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <memory>
+
+#include "encryption.h"
+
+namespace phantom {
+
+class TextBuffer;
+class Cursor;
+
+// Journal file layout (.filename.jnl)
+//
+//   JournalHeader                               32 bytes
+//   { JournalRecordHeader, payload } * N        appended by commit()
+//
+// The journal holds the edits made since the last swap snapshot. Both carry
+// a generation number; a journal only applies on top of the snapshot with
+// the same generation, so a crash between writing a snapshot and resetting
+// the journal never replays edits twice. Records are numbered from 0 in
+// each file, so replay can tell when leading records are missing.
+//
+// An encrypted journal (JOURNAL_ENCRYPTED) has an EncryptionHeader after the
+// JournalHeader, and every record is sealed on its own: the payload is
+// encrypted, a 16-byte tag follows it, and the record header is the
+// associated data. Positions and lengths stay readable so a damaged journal
+// can still be scanned; the text does not.
+
+constexpr char JOURNAL_MAGIC[8] = {'P', 'H', 'J', 'R', 'N', 'L', '0', '1'};
+constexpr u32 JOURNAL_VERSION = 1;
+constexpr u32 JOURNAL_RECORD_MAGIC = 0x43455250; // "PREC"
+
+// JournalHeader::flags
+constexpr u32 JOURNAL_ENCRYPTED = 1u << 0;
+
+// JournalRecordHeader::flags
+constexpr u8 JOURNAL_RECORD_SEALED = 1u << 0;
+
+enum class JournalRecordType : u8 {
+    Insert = 1,  // payload = inserted bytes
+    Erase = 2    // no payload, length = erased byte count
+};
+
+struct JournalHeader {
+    char magic[8];
+    u32 version;
+    u32 generation;
+    u64 createdAt;
+    u32 flags;
+    u32 headerCrc;       // CRC32C of all preceding header bytes
+};
+
+struct JournalRecordHeader {
+    u32 magic;
+    u8 type;
+    u8 flags;
+    u8 reserved[2];
+    u64 sequence;
+    u64 position;
+    u32 length;
+    u32 crc;             // CRC32C of preceding header bytes + payload
+};
+
+static_assert(sizeof(JournalHeader) == 32, "JournalHeader layout changed");
+static_assert(sizeof(JournalRecordHeader) == 32, "JournalRecordHeader layout changed");
+
+class EditJournal {
+public:
+    EditJournal(const std::string& journalFilePath);
+    ~EditJournal();
+
+    // Record edits from the change stream. Cheap: only appends to an
+    // in-memory batch, coalescing runs of typing and backspacing.
+    void recordInsert(size_t position, const char* data, size_t length);
+    void recordErase(size_t position, size_t length);
+
+    // Group commit: append every pending record with a single IoEngine write.
+    // bytesWritten receives the number of bytes appended (0 if nothing was pending).
+    bool commit(size_t* bytesWritten = nullptr);
+
+    // Make sure the next generation is newer than `generation` (the
+    // generation of a recovered snapshot)
+    void continueFrom(u32 generation);
+
+    // Start a new generation. Pending records are dropped because the
+    // snapshot taken under the same lock already contains them.
+    u32 beginCheckpoint();
+
+    // Drop pending records but keep the generation: for a checkpoint that
+    // finds the text back at the snapshot's, where pending and committed
+    // records cancel out. The caller then empties the file with reset().
+    u32 discardPending();
+
+    // Whether the file holds records on top of its header
+    bool hasCommittedRecords() const;
+
+    // Make committed records durable (fdatasync)
+    bool sync();
+
+    // Atomically replace the file with an empty journal for `generation`
+    // (after the snapshot for that generation has been written)
+    bool reset(u32 generation, bool sync = true);
+
+    // Apply the journal on top of a snapshot of `generation`.
+    // Replay stops at the first damaged record or sequence gap, because
+    // later positions assume the lost edits were applied; the rest of the
+    // file is reported as lost. An unreadable header means nothing was
+    // committed after the snapshot.
+    bool replay(TextBuffer& buffer, Cursor& cursor, u32 generation) const;
+
+    // Seal records from the next reset() on, and open sealed journals on replay.
+    // Set before the autosave thread starts.
+    void setEncryption(std::shared_ptr<const EncryptionKey> key);
+
+    bool exists() const;
+    bool remove();
+
+    u32 getGeneration() const;
+    u64 getSizeOnDisk() const;
+    const std::string& getJournalFilePath() const { return journalFilePath_; }
+
+private:
+    struct PendingRecord {
+        JournalRecordType type;
+        size_t position;
+        size_t length;
+        std::string data;
+    };
+
+    std::string journalFilePath_;
+
+    mutable std::mutex mutex_;
+    std::vector<PendingRecord> pending_;
+    u32 generation_ = 0;
+    u64 nextSequence_ = 0;
+    u64 sizeOnDisk_ = 0;
+    u64 headerSizeOnDisk_ = 0;
+
+    std::shared_ptr<const EncryptionKey> encryption_;
+    EncryptionHeader encryptionHeader_{};
+    FileKey fileKey_;
+    bool sealing_ = false;      // The file on disk was started with fileKey_
+};
+
+} // namespace phantom
+
+#endif // PHANTOM_EDIT_JOURNAL_H
@@ -0,0 +1,398 @@
+#include "encryption.h"
+#include "recovery_scanner.h"
+#include "utils/chacha20_poly1305.h"
+#include "utils/sha256.h"
+#include "utils/secure_memory.h"
+#include "utils/logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+namespace phantom {
+
+namespace {
+
+constexpr u32 MIN_CHUNK_SIZE = 4 * 1024;
+constexpr u32 MAX_CHUNK_SIZE = 16 * 1024 * 1024;
+constexpr u32 MAX_KDF_ITERATIONS = 100000000;
+
+// Bytes per sealing/opening thread, below which threads are not worth starting
+constexpr size_t PARALLEL_BYTES = 8 * 1024 * 1024;
+
+const char FILE_KEY_LABEL[] = "phantom-writer file key";
+const char KEY_CHECK_LABEL[] = "phantom-writer key check";
+
+void makeNonce(u64 index, u32 flags, u8 nonce[CHACHA20_NONCE_SIZE]) {
+    std::memcpy(nonce, &index, sizeof(index));
+    std::memcpy(nonce + sizeof(index), &flags, sizeof(flags));
+}
+
+// Run work(first, last) over [0, count) on up to one thread per PARALLEL_BYTES of data
+template <typename Work>
+void forChunks(size_t count, size_t bytes, const Work& work) {
+    size_t threadCount = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()),
+                                          bytes / PARALLEL_BYTES + 1);
+    threadCount = std::min(threadCount, count);
+    if (threadCount <= 1) {
+        work(0, count);
+        return;
+    }
+
+    size_t perThread = (count + threadCount - 1) / threadCount;
+    std::vector<std::thread> threads;
+    for (size_t first = perThread; first < count; first += perThread) {
+        threads.emplace_back(work, first, std::min(first + perThread, count));
+    }
+    work(0, perThread);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+bool headerUsable(const EncryptionHeader& header) {
+    return std::memcmp(header.magic, ENCRYPTION_MAGIC, sizeof(header.magic)) == 0 &&
+           header.version == ENCRYPTION_VERSION &&
+           header.chunkSize >= MIN_CHUNK_SIZE && header.chunkSize <= MAX_CHUNK_SIZE &&
+           header.kdfIterations > 0 && header.kdfIterations <= MAX_KDF_ITERATIONS;
+}
+
+} // namespace
+
+bool isEncrypted(const u8* data, size_t size) {
+    return size >= sizeof(ENCRYPTION_MAGIC) && std::memcmp(data, ENCRYPTION_MAGIC, sizeof(ENCRYPTION_MAGIC)) == 0;
+}
+
+// ---------------------------------------------------------------------------
+// FileKey
+// ---------------------------------------------------------------------------
+
+FileKey::FileKey(const FileKey& other) {
+    std::memcpy(bytes, other.bytes, sizeof(bytes));
+}
+
+FileKey& FileKey::operator=(const FileKey& other) {
+    std::memcpy(bytes, other.bytes, sizeof(bytes));
+    return *this;
+}
+
+FileKey::~FileKey() {
+    secureWipe(bytes, sizeof(bytes));
+}
+
+void FileKey::seal(u64 index, u32 flags, const u8* aad, size_t aadSize, const u8* in, u8* out, size_t size,
+                   u8 tag[ENCRYPTION_TAG_SIZE]) const {
+    u8 nonce[CHACHA20_NONCE_SIZE];
+    makeNonce(index, flags, nonce);
+    aeadSeal(bytes, nonce, aad, aadSize, in, out, size, tag);
+}
+
+bool FileKey::open(u64 index, u32 flags, const u8* aad, size_t aadSize, const u8* in, u8* out, size_t size,
+                   const u8 tag[ENCRYPTION_TAG_SIZE]) const {
+    u8 nonce[CHACHA20_NONCE_SIZE];
+    makeNonce(index, flags, nonce);
+    return aeadOpen(bytes, nonce, aad, aadSize, in, out, size, tag);
+}
+
+// ---------------------------------------------------------------------------
+// EncryptionKey
+// ---------------------------------------------------------------------------
+
+EncryptionKey::EncryptionKey(const std::string& passphrase, u32 iterations)
+    : passphrase_(passphrase)
+{
+    PassphraseKey session;
+    session.iterations = iterations;
+    if (!secureRandom(session.salt, sizeof(session.salt))) {
+        LOG_ERROR(LogCategory::PERSISTENCE, "No secure random source; encryption is unavailable");
+        return;
+    }
+
+    pbkdf2Sha256(passphrase_.data(), passphrase_.size(), session.salt, sizeof(session.salt), iterations,
+                 session.key, sizeof(session.key));
+    keys_.push_back(session);
+    secureWipe(&session, sizeof(session));
+    valid_ = true;
+
+    LOG_INFO(LogCategory::PERSISTENCE, "Encryption key derived (PBKDF2-SHA256, %u iterations, ChaCha20 %s)",
+             iterations, chacha20Implementation());
+}
+
+EncryptionKey::~EncryptionKey() {
+    secureWipe(&passphrase_[0], passphrase_.size());
+    for (PassphraseKey& key : keys_) {
+        secureWipe(&key, sizeof(key));
+    }
+}
+
+void EncryptionKey::deriveFileKey(const u8 passphraseKey[ENCRYPTION_KEY_SIZE], const u8 fileNonce[16],
+                                  FileKey& key, u8 keyCheck[8]) const {
+    HmacSha256 hmac(passphraseKey, ENCRYPTION_KEY_SIZE);
+    u8 message[64];
+    u8 digest[SHA256_DIGEST_SIZE];
+
+    size_t labelSize = sizeof(FILE_KEY_LABEL) - 1;
+    std::memcpy(message, FILE_KEY_LABEL, labelSize);
+    std::memcpy(message + labelSize, fileNonce, 16);
+    hmac.mac(message, labelSize + 16, key.bytes);
+
+    labelSize = sizeof(KEY_CHECK_LABEL) - 1;
+    std::memcpy(message, KEY_CHECK_LABEL, labelSize);
+    std::memcpy(message + labelSize, fileNonce, 16);
+    hmac.mac(message, labelSize + 16, digest);
+    std::memcpy(keyCheck, digest, 8);
+
+    secureWipe(digest, sizeof(digest));
+}
+
+bool EncryptionKey::newFile(EncryptionHeader& header, FileKey& key) const {
+    if (!valid_) {
+        return false;
+    }
+
+    header = EncryptionHeader();
+    std::memcpy(header.magic, ENCRYPTION_MAGIC, sizeof(header.magic));
+    header.version = ENCRYPTION_VERSION;
+    header.chunkSize = ENCRYPTION_CHUNK_SIZE;
+    if (!secureRandom(header.fileNonce, sizeof(header.fileNonce))) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    const PassphraseKey& session = keys_.front();
+    header.kdfIterations = session.iterations;
+    std::memcpy(header.salt, session.salt, sizeof(header.salt));
+    deriveFileKey(session.key, header.fileNonce, key, header.keyCheck);
+    return true;
+}
+
+bool EncryptionKey::openFile(const EncryptionHeader& header, FileKey& key) const {
+    if (!valid_ || !headerUsable(header)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto cached = std::find_if(keys_.begin(), keys_.end(), [&header](const PassphraseKey& k) {
+        return k.iterations == header.kdfIterations && std::memcmp(k.salt, header.salt, sizeof(k.salt)) == 0;
+    });
+    if (cached == keys_.end()) {
+        // Written in another session
+        PassphraseKey derived;
+        derived.iterations = header.kdfIterations;
+        std::memcpy(derived.salt, header.salt, sizeof(derived.salt));
+        pbkdf2Sha256(passphrase_.data(), passphrase_.size(), derived.salt, sizeof(derived.salt),
+                     derived.iterations, derived.key, sizeof(derived.key));
+        keys_.push_back(derived);
+        secureWipe(&derived, sizeof(derived));
+        cached = keys_.end() - 1;
+    }
+
+    u8 keyCheck[8];
+    deriveFileKey(cached->key, header.fileNonce, key, keyCheck);
+    if (!secureEqual(keyCheck, header.keyCheck, sizeof(keyCheck))) {
+        secureWipe(key.bytes, sizeof(key.bytes));
+        return false;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// StreamSealer
+// ---------------------------------------------------------------------------
+
+bool StreamSealer::begin(const EncryptionKey& key, std::vector<u8>& out) {
+    if (!key.newFile(header_, key_)) {
+        return false;
+    }
+    out_ = &out;
+    index_ = 0;
+
+    const u8* headerBytes = reinterpret_cast<const u8*>(&header_);
+    out.insert(out.end(), headerBytes, headerBytes + sizeof(header_));
+    chunkStart_ = out.size();
+    return true;
+}
+
+void StreamSealer::write(const void* data, size_t size) {
+    const u8* p = static_cast<const u8*>(data);
+    while (size > 0) {
+        // A full chunk is sealed only once more data arrives: the last
+        // chunk of the stream has to carry the last-chunk flag
+        size_t pending = out_->size() - chunkStart_;
+        if (pending == header_.chunkSize) {
+            sealChunk(false);
+            pending = 0;
+        }
+        size_t take = std::min(size, header_.chunkSize - pending);
+        out_->insert(out_->end(), p, p + take);
+        p += take;
+        size -= take;
+    }
+}
+
+void StreamSealer::finish() {
+    sealChunk(true);
+}
+
+void StreamSealer::sealChunk(bool last) {
+    size_t size = out_->size() - chunkStart_;
+    u8 tag[ENCRYPTION_TAG_SIZE];
+    u8* chunk = out_->data() + chunkStart_;
+    key_.seal(index_++, last ? NONCE_LAST_CHUNK : 0, reinterpret_cast<const u8*>(&header_), sizeof(header_),
+              chunk, chunk, size, tag);
+    out_->insert(out_->end(), tag, tag + sizeof(tag));
+    chunkStart_ = out_->size();
+}
+
+void StreamSealer::discardSealed() {
+    out_->erase(out_->begin(), out_->begin() + static_cast<std::ptrdiff_t>(chunkStart_));
+    chunkStart_ = 0;
+}
+
+// ---------------------------------------------------------------------------
+// StreamOpener
+// ---------------------------------------------------------------------------
+
+bool StreamOpener::begin(const EncryptionKey& key, const u8* data, size_t size) {
+    if (size < sizeof(header_) || !isEncrypted(data, size)) {
+        LOG_ERROR(LogCategory::PERSISTENCE, "Encrypted file header is missing");
+        return false;
+    }
+    std::memcpy(&header_, data, sizeof(header_));
+
+    if (!headerUsable(header_)) {
+        LOG_ERROR(LogCategory::PERSISTENCE, "Encrypted file header is damaged or from a newer version");
+        return false;
+    }
+    if (!key.openFile(header_, key_)) {
+        LOG_ERROR(LogCategory::PERSISTENCE, "Wrong passphrase for encrypted file");
+        return false;
+    }
+    return true;
+}
+
+bool StreamOpener::openChunk(u64 index, const u8* sealed, size_t sealedSize, bool last, u8* out) const {
+    if (sealedSize < ENCRYPTION_TAG_SIZE || sealedSize > sealedChunkSize()) {
+        return false;
+    }
+    size_t size = sealedSize - ENCRYPTION_TAG_SIZE;
+    return key_.open(index, last ? NONCE_LAST_CHUNK : 0, reinterpret_cast<const u8*>(&header_), sizeof(header_),
+                     sealed, out, size, sealed + size);
+}
+
+// ---------------------------------------------------------------------------
+// Whole buffers
+// ---------------------------------------------------------------------------
+
+bool sealBuffer(const EncryptionKey& key, const u8* data, size_t size, std::vector<u8>& out) {
+    EncryptionHeader header;
+    FileKey fileKey;
+    if (!key.newFile(header, fileKey)) {
+        return false;
+    }
+
+    const size_t chunkSize = header.chunkSize;
+    const size_t chunkCount = std::max<size_t>(1, (size + chunkSize - 1) / chunkSize);
+
+    out.resize(sizeof(header) + size + chunkCount * ENCRYPTION_TAG_SIZE);
+    std::memcpy(out.data(), &header, sizeof(header));
+
+    const u8* aad = out.data();
+    forChunks(chunkCount, size, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; i++) {
+            size_t offset = i * chunkSize;
+            size_t length = std::min(chunkSize, size - offset);
+            u8* sealed = out.data() + sizeof(header) + i * (chunkSize + ENCRYPTION_TAG_SIZE);
+            fileKey.seal(i, i + 1 == chunkCount ? NONCE_LAST_CHUNK : 0, aad, sizeof(header),
+                         data + offset, sealed, length, sealed + length);
+        }
+    });
+    return true;
+}
+
+bool openBuffer(const EncryptionKey& key, const u8* data, size_t size, std::vector<u8>& out,
+                RecoveryReport* report) {
+    auto start = std::chrono::steady_clock::now();
+    StreamOpener opener;
+    if (!opener.begin(key, data, size)) {
+        return false;
+    }
+    if (report) {
+        report->headerIntact = true;
+        report->scannedBytes = size;
+    }
+
+    const u8* body = data + sizeof(EncryptionHeader);
+    size_t bodySize = size - sizeof(EncryptionHeader);
+    const size_t sealedChunk = opener.sealedChunkSize();
+    const size_t chunkSize = opener.chunkSize();
+
+    size_t chunkCount = (bodySize + sealedChunk - 1) / sealedChunk;
+    bool truncated = false;
+    if (chunkCount == 0 || bodySize - (chunkCount - 1) * sealedChunk < ENCRYPTION_TAG_SIZE) {
+        // A piece too short to be a chunk: the file was cut off
+        truncated = true;
+        if (chunkCount > 0) {
+            chunkCount--;
+        }
+        bodySize = chunkCount * sealedChunk;
+    }
+    if (truncated && !report) {
+        LOG_ERROR(LogCategory::PERSISTENCE, "Encrypted file is truncated");
+        return false;
+    }
+
+    out.resize(bodySize - chunkCount * ENCRYPTION_TAG_SIZE);
+    std::vector<u8> opened(chunkCount, 0);
+
+    forChunks(chunkCount, out.size(), [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; i++) {
+            size_t sealedSize = std::min(sealedChunk, bodySize - i * sealedChunk);
+            const u8* sealed = body + i * sealedChunk;
+            u8* plain = out.data() + i * chunkSize;
+            bool isLast = i + 1 == chunkCount;
+
+            opened[i] = opener.openChunk(i, sealed, sealedSize, isLast && !truncated, plain);
+            if (!opened[i] && isLast && report && !truncated &&
+                opener.openChunk(i, sealed, sealedSize, false, plain)) {
+                // Intact, but not the end of the stream: cut off at a chunk boundary
+                opened[i] = 2;
+            }
+        }
+    });
+
+    for (size_t i = 0; i < chunkCount; i++) {
+        if (opened[i] == 2) {
+            truncated = true;
+        }
+        if (opened[i]) {
+            if (report) {
+                report->intactBlocks++;
+            }
+            continue;
+        }
+        if (!report) {
+            LOG_ERROR(LogCategory::PERSISTENCE, "Encrypted chunk %zu failed authentication", i);
+            return false;
+        }
+
+        u64 begin = static_cast<u64>(i) * chunkSize;
+        u64 end = std::min<u64>(begin + chunkSize, out.size());
+        std::memset(out.data() + begin, 0, static_cast<size_t>(end - begin));
+        report->lostRanges.push_back({begin, end});
+        report->damagedRegions++;
+    }
+
+    if (truncated) {
+        report->damagedRegions++;
+        LOG_WARN(LogCategory::PERSISTENCE, "Encrypted file is truncated after %zu bytes", out.size());
+    }
+    if (report) {
+        report->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    return true;
+}
+
+} // namespace phantom
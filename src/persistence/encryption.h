@@ -0,0 +1,168 @@
+#ifndef PHANTOM_ENCRYPTION_H
+#define PHANTOM_ENCRYPTION_H
+
+#include <phantom_writer/types.h>
+#include <string>
+#include <vector>
+#include <mutex>
+
+namespace phantom {
+
+struct RecoveryReport;
+
+// Encrypted file layout (swap files, saved documents):
+//
+//   EncryptionHeader                          64 bytes
+//   { ciphertext, tag } * N                   chunkSize + 16 bytes, the last one shorter
+//
+// Chunks are sealed with ChaCha20-Poly1305 following the STREAM construction:
+// the nonce of chunk i is (i, last-chunk flag) and the header is the
+// associated data of every chunk, so chunks cannot be reordered, dropped,
+// or cut off at a chunk boundary without a tag failing. Each file gets its
+// own key, derived from the passphrase key and a random per-file nonce, so
+// chunk nonces never repeat under one key even though every file counts
+// from zero. A damaged chunk only costs its own 64 KiB.
+//
+// The passphrase key comes from PBKDF2-HMAC-SHA256. It is derived once per
+// session; files written in an earlier session (another salt) cost one more
+// derivation the first time they are opened.
+
+constexpr char ENCRYPTION_MAGIC[8] = {'P', 'H', 'C', 'R', 'Y', 'P', 'T', '1'};
+constexpr u32 ENCRYPTION_VERSION = 1;
+constexpr u32 ENCRYPTION_CHUNK_SIZE = 64 * 1024;
+constexpr size_t ENCRYPTION_TAG_SIZE = 16;
+constexpr size_t ENCRYPTION_KEY_SIZE = 32;
+
+// Nonce domains: whole-file streams and single journal records
+constexpr u32 NONCE_LAST_CHUNK = 1u << 0;
+constexpr u32 NONCE_JOURNAL_RECORD = 1u << 1;
+
+struct EncryptionHeader {
+    char magic[8];
+    u32 version;
+    u32 chunkSize;       // Plaintext bytes per chunk
+    u32 kdfIterations;
+    u32 reserved;
+    u8 salt[16];         // PBKDF2 salt of the passphrase key
+    u8 fileNonce[16];    // Random per file; the file key is derived from it
+    u8 keyCheck[8];      // Derived from the file key: a wrong passphrase is reported as such
+};
+
+static_assert(sizeof(EncryptionHeader) == 64, "EncryptionHeader layout changed");
+
+bool isEncrypted(const u8* data, size_t size);
+
+// Key for one file. Wiped on destruction.
+struct FileKey {
+    u8 bytes[ENCRYPTION_KEY_SIZE] = {};
+
+    FileKey() = default;
+    FileKey(const FileKey& other);
+    FileKey& operator=(const FileKey& other);
+    ~FileKey();
+
+    // Seal or open one message under this key with the nonce (index, flags)
+    void seal(u64 index, u32 flags, const u8* aad, size_t aadSize, const u8* in, u8* out, size_t size,
+              u8 tag[ENCRYPTION_TAG_SIZE]) const;
+    bool open(u64 index, u32 flags, const u8* aad, size_t aadSize, const u8* in, u8* out, size_t size,
+              const u8 tag[ENCRYPTION_TAG_SIZE]) const;
+};
+
+// The passphrase, and the keys derived from it
+class EncryptionKey {
+public:
+    // OWASP's 2023 recommendation for PBKDF2-HMAC-SHA256; ~0.2 s on a desktop CPU
+    static constexpr u32 DEFAULT_KDF_ITERATIONS = 600000;
+
+    // Derives this session's key, so this takes a moment
+    explicit EncryptionKey(const std::string& passphrase, u32 iterations = DEFAULT_KDF_ITERATIONS);
+    ~EncryptionKey();
+
+    EncryptionKey(const EncryptionKey&) = delete;
+    EncryptionKey& operator=(const EncryptionKey&) = delete;
+
+    // False if the system has no usable random source
+    bool isValid() const { return valid_; }
+
+    // Header and key for a new file
+    bool newFile(EncryptionHeader& header, FileKey& key) const;
+
+    // Key for an existing file. False for a malformed header or the wrong passphrase.
+    bool openFile(const EncryptionHeader& header, FileKey& key) const;
+
+private:
+    struct PassphraseKey {
+        u8 salt[16];
+        u32 iterations;
+        u8 key[ENCRYPTION_KEY_SIZE];
+    };
+
+    void deriveFileKey(const u8 passphraseKey[ENCRYPTION_KEY_SIZE], const u8 fileNonce[16], FileKey& key,
+                       u8 keyCheck[8]) const;
+
+    std::string passphrase_;
+    bool valid_ = false;
+
+    mutable std::mutex mutex_;
+    mutable std::vector<PassphraseKey> keys_;   // keys_[0] is this session's
+};
+
+// Writes an encrypted stream into a byte vector, a chunk at a time
+class StreamSealer {
+public:
+    StreamSealer() = default;
+
+    // Start a stream at the end of out (the header is appended right away)
+    bool begin(const EncryptionKey& key, std::vector<u8>& out);
+
+    void write(const void* data, size_t size);
+
+    // Seal the last chunk. Must be called exactly once, even for an empty stream.
+    void finish();
+
+    // Bytes at the front of out that are final and can be written out
+    size_t sealedSize() const { return chunkStart_; }
+
+    // Drop the sealed bytes from out (after writing them)
+    void discardSealed();
+
+private:
+    void sealChunk(bool last);
+
+    std::vector<u8>* out_ = nullptr;
+    FileKey key_;
+    EncryptionHeader header_{};
+    u64 index_ = 0;
+    size_t chunkStart_ = 0;     // Start of the chunk being filled in *out_
+};
+
+// Reads an encrypted stream chunk by chunk
+class StreamOpener {
+public:
+    // Check the header at the front of data and derive the file key
+    bool begin(const EncryptionKey& key, const u8* data, size_t size);
+
+    size_t chunkSize() const { return header_.chunkSize; }
+    size_t sealedChunkSize() const { return header_.chunkSize + ENCRYPTION_TAG_SIZE; }
+
+    // Open chunk `index`; sealedSize includes the tag. out receives
+    // sealedSize - ENCRYPTION_TAG_SIZE bytes.
+    bool openChunk(u64 index, const u8* sealed, size_t sealedSize, bool last, u8* out) const;
+
+private:
+    FileKey key_;
+    EncryptionHeader header_{};
+};
+
+// Encrypt a whole buffer. Large buffers are sealed on several threads.
+bool sealBuffer(const EncryptionKey& key, const u8* data, size_t size, std::vector<u8>& out);
+
+// Decrypt a whole stream. Without a report any damage fails the call; with
+// one, chunks that fail to authenticate are zero-filled and listed in
+// report->lostRanges (plaintext offsets) so the caller can salvage the rest.
+bool openBuffer(const EncryptionKey& key, const u8* data, size_t size, std::vector<u8>& out,
+                RecoveryReport* report = nullptr);
+
+} // namespace phantom
+
+#endif // PHANTOM_ENCRYPTION_H
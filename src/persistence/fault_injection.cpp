@@ -0,0 +1,94 @@
+#include "fault_injection.h"
+
+#include <algorithm>
+#include <cerrno>
+
+namespace phantom {
+
+FaultInjector& FaultInjector::get() {
+    static FaultInjector instance;
+    return instance;
+}
+
+void FaultInjector::arm(FaultKind kind, u64 budget, u32 seed) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    kind_ = kind;
+    budget_ = budget;
+    written_ = 0;
+    random_ = seed ? seed : 1;
+    crashed_ = false;
+    armed_.store(true);
+}
+
+void FaultInjector::disarm() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    armed_.store(false);
+    crashed_ = false;
+}
+
+bool FaultInjector::hasCrashed() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return crashed_;
+}
+
+u64 FaultInjector::bytesWritten() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return written_;
+}
+
+bool FaultInjector::admitWrite(size_t& size) {
+    if (!isArmed()) {
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    switch (kind_) {
+        case FaultKind::ShortWrites:
+            if (size > 1) {
+                // xorshift32; half of the writes come back short
+                random_ ^= random_ << 13;
+                random_ ^= random_ >> 17;
+                random_ ^= random_ << 5;
+                if (random_ & 1) {
+                    size = 1 + (random_ >> 1) % (size - 1);
+                }
+            }
+            break;
+
+        case FaultKind::NoSpace:
+            if (written_ >= budget_) {
+                errno = ENOSPC;
+                return false;
+            }
+            size = static_cast<size_t>(std::min<u64>(size, budget_ - written_));
+            break;
+
+        case FaultKind::Crash:
+            if (crashed_ || written_ >= budget_) {
+                crashed_ = true;
+                errno = EIO;
+                return false;
+            }
+            size = static_cast<size_t>(std::min<u64>(size, budget_ - written_));
+            crashed_ = written_ + size >= budget_;
+            break;
+    }
+
+    written_ += size;
+    return true;
+}
+
+bool FaultInjector::admitOperation() {
+    if (!isArmed()) {
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (kind_ == FaultKind::Crash && crashed_) {
+        errno = EIO;
+        return false;
+    }
+    return true;
+}
+
+} // namespace phantom
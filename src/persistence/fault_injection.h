@@ -0,0 +1,63 @@
+#ifndef PHANTOM_FAULT_INJECTION_H
+#define PHANTOM_FAULT_INJECTION_H
+
+#include <phantom_writer/types.h>
+#include <atomic>
+#include <mutex>
+#include <cstddef>
+
+namespace phantom {
+
+// Simulated storage failures for the persistence write paths, so recovery
+// can be checked against them (see benchmarks/persistence_bench.cpp).
+//
+// AtomicFileWriter, DurableFile and the IoEngine's blocking backend ask the
+// injector before every write, sync and rename; while nothing is armed that
+// costs one relaxed atomic load. While armed, the IoEngine runs requests on
+// the calling thread, so they fail in submission order and io_uring
+// submissions go through the hooked blocking path too.
+
+enum class FaultKind {
+    ShortWrites,    // Writes transfer a random part of what was asked; callers must loop
+    NoSpace,        // Once the byte budget is used up, writes fail with ENOSPC
+    Crash           // The process "dies" once the budget is used up: the write that
+                    // crosses it is torn, and every later write, sync or rename fails
+};
+
+class FaultInjector {
+public:
+    static FaultInjector& get();
+
+    // Fail after `budget` more bytes have been written (NoSpace, Crash).
+    // seed drives the ShortWrites sizes.
+    void arm(FaultKind kind, u64 budget = 0, u32 seed = 1);
+    void disarm();
+
+    bool isArmed() const { return armed_.load(std::memory_order_relaxed); }
+    bool hasCrashed() const;
+
+    // Bytes let through since arm()
+    u64 bytesWritten() const;
+
+    // Before a write of size bytes: false (errno set) fails the call,
+    // otherwise size may come back smaller, as from a short write
+    bool admitWrite(size_t& size);
+
+    // Before fsync, rename and the like: false (errno set) after a crash
+    bool admitOperation();
+
+private:
+    FaultInjector() = default;
+
+    std::atomic<bool> armed_{false};
+    mutable std::mutex mutex_;
+    FaultKind kind_ = FaultKind::ShortWrites;
+    u64 budget_ = 0;
+    u64 written_ = 0;
+    u32 random_ = 1;
+    bool crashed_ = false;
+};
+
+} // namespace phantom
+
+#endif // PHANTOM_FAULT_INJECTION_H
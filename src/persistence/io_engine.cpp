@@ -0,0 +1,854 @@
+#include "io_engine.h"
+#include "durable_file.h"
+#include "persistence_metrics.h"
+#include "fault_injection.h"
+#include "utils/logger.h"
+
+#include <chrono>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+#ifdef PHANTOM_IO_URING
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace phantom {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+enum class IoOpType {
+    ReadFile,
+    ReadRange,
+    WriteAtomic,
+    Append,
+    Sync
+};
+
+#ifdef PHANTOM_IO_URING
+enum class RingPhase {
+    Transfer,        // Reads/writes in flight
+    SyncFile,        // fdatasync of the file
+    SyncDirectory    // fsync of the parent directory after a rename
+};
+
+constexpr size_t RING_CHUNK_SIZE = 1024 * 1024;
+constexpr int RING_SLOTS = 4;           // Operations in flight per request
+constexpr u64 WAKE_TAG = ~u64(0);       // user_data of the eventfd poll
+
+std::string parentDirectory(const std::string& path) {
+    size_t lastSlash = path.find_last_of('/');
+    if (lastSlash == std::string::npos) {
+        return ".";
+    }
+    return lastSlash == 0 ? "/" : path.substr(0, lastSlash);
+}
+#endif
+
+bool isReadOp(IoOpType type) {
+    return type == IoOpType::ReadFile || type == IoOpType::ReadRange;
+}
+
+} // namespace
+
+struct IoEngine::Request {
+    IoOpType type;
+    std::string path;
+    std::vector<u8> data;
+    u64 offset = 0;             // ReadRange: first byte and most bytes to read
+    size_t length = 0;
+    bool sync = false;
+    std::promise<IoResult> promise;
+    Clock::time_point submitted;
+
+#ifdef PHANTOM_IO_URING
+    // One outstanding ring operation; its address is the SQE user_data
+    struct Slot {
+        Request* owner = nullptr;
+        iovec iov{};
+        u64 offset = 0;
+        bool busy = false;
+    };
+
+    Slot slots[RING_SLOTS];
+    RingPhase phase = RingPhase::Transfer;
+    int fd = -1;
+    int dirFd = -1;
+    std::string tempPath;
+    size_t queuedBytes = 0;     // Handed to the ring
+    size_t doneBytes = 0;       // Confirmed by completions
+    int inFlight = 0;
+    int error = 0;
+    Clock::time_point syncStarted;
+#endif
+};
+
+// ============================================================================
+// Raw io_uring (no liburing): only the 5.1 feature set is used so any kernel
+// that can create a ring can run every request type.
+// ============================================================================
+
+#ifdef PHANTOM_IO_URING
+
+class IoEngine::Ring {
+public:
+    ~Ring() {
+        if (sqes_ != MAP_FAILED) munmap(sqes_, sqesSize_);
+        if (cqRing_ != MAP_FAILED && cqRing_ != sqRing_) munmap(cqRing_, cqRingSize_);
+        if (sqRing_ != MAP_FAILED) munmap(sqRing_, sqRingSize_);
+        if (fd_ >= 0) ::close(fd_);
+    }
+
+    bool init(unsigned entries) {
+#ifdef __NR_io_uring_setup
+        io_uring_params params{};
+        fd_ = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (fd_ < 0) {
+            LOG_INFO(LogCategory::PERSISTENCE, "io_uring unavailable: %s", strerror(errno));
+            return false;
+        }
+
+        sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(u32);
+        cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (singleMmap) {
+            sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+        }
+
+        sqRing_ = mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+        if (sqRing_ == MAP_FAILED) {
+            return false;
+        }
+        cqRing_ = singleMmap ? sqRing_
+                             : mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+        if (cqRing_ == MAP_FAILED) {
+            return false;
+        }
+        sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) {
+            return false;
+        }
+        sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+        u8* sq = static_cast<u8*>(sqRing_);
+        sqHead_ = reinterpret_cast<u32*>(sq + params.sq_off.head);
+        sqTail_ = reinterpret_cast<u32*>(sq + params.sq_off.tail);
+        sqMask_ = *reinterpret_cast<u32*>(sq + params.sq_off.ring_mask);
+        sqArray_ = reinterpret_cast<u32*>(sq + params.sq_off.array);
+        sqEntries_ = params.sq_entries;
+        sqLocalTail_ = *sqTail_;
+
+        u8* cq = static_cast<u8*>(cqRing_);
+        cqHead_ = reinterpret_cast<u32*>(cq + params.cq_off.head);
+        cqTail_ = reinterpret_cast<u32*>(cq + params.cq_off.tail);
+        cqMask_ = *reinterpret_cast<u32*>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return true;
+#else
+        (void)entries;
+        return false;
+#endif
+    }
+
+    // Next free submission entry, zeroed; nullptr when the queue is full
+    io_uring_sqe* getSqe() {
+        u32 head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+        if (sqLocalTail_ - head >= sqEntries_) {
+            return nullptr;
+        }
+        u32 index = sqLocalTail_ & sqMask_;
+        sqArray_[index] = index;
+        sqLocalTail_++;
+        toSubmit_++;
+
+        io_uring_sqe* sqe = &sqes_[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        return sqe;
+    }
+
+    // Publish queued entries and block until at least waitCount completions exist
+    bool submitAndWait(unsigned waitCount) {
+        __atomic_store_n(sqTail_, sqLocalTail_, __ATOMIC_RELEASE);
+
+        for (;;) {
+            long ret = syscall(__NR_io_uring_enter, fd_, toSubmit_, waitCount,
+                               waitCount ? IORING_ENTER_GETEVENTS : 0u, nullptr, 0);
+            if (ret >= 0) {
+                toSubmit_ -= std::min<u32>(toSubmit_, static_cast<u32>(ret));
+                return true;
+            }
+            if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                LOG_ERROR(LogCategory::PERSISTENCE, "io_uring_enter failed: %s", strerror(errno));
+                return false;
+            }
+            if (errno != EINTR) {
+                // Completion queue is full: reap before submitting more
+                return true;
+            }
+        }
+    }
+
+    bool popCompletion(u64& userData, int& result) {
+        u32 head = *cqHead_;
+        if (head == __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE)) {
+            return false;
+        }
+        const io_uring_cqe& cqe = cqes_[head & cqMask_];
+        userData = cqe.user_data;
+        result = cqe.res;
+        __atomic_store_n(cqHead_, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+private:
+    int fd_ = -1;
+    void* sqRing_ = MAP_FAILED;
+    void* cqRing_ = MAP_FAILED;
+    size_t sqRingSize_ = 0;
+    size_t cqRingSize_ = 0;
+    size_t sqesSize_ = 0;
+    io_uring_sqe* sqes_ = static_cast<io_uring_sqe*>(MAP_FAILED);
+
+    u32* sqHead_ = nullptr;
+    u32* sqTail_ = nullptr;
+    u32* sqArray_ = nullptr;
+    u32 sqMask_ = 0;
+    u32 sqEntries_ = 0;
+    u32 sqLocalTail_ = 0;
+    u32 toSubmit_ = 0;
+
+    u32* cqHead_ = nullptr;
+    u32* cqTail_ = nullptr;
+    u32 cqMask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+};
+
+#endif // PHANTOM_IO_URING
+
+// ============================================================================
+// Engine
+// ============================================================================
+
+const char* ioBackendName(IoBackend backend) {
+    switch (backend) {
+        case IoBackend::Inline: return "inline";
+        case IoBackend::ThreadPool: return "thread-pool";
+        case IoBackend::IoUring: return "io_uring";
+        default: return "unknown";
+    }
+}
+
+IoEngine& IoEngine::get() {
+    static IoEngine instance;
+    return instance;
+}
+
+IoEngine::IoEngine()
+    : running_(false)
+    , stopping_(false)
+{
+}
+
+IoEngine::~IoEngine() {
+    stop();
+}
+
+bool IoEngine::start(bool allowIoUring) {
+    if (running_.load()) {
+        return true;
+    }
+
+    stopping_.store(false);
+
+#ifdef PHANTOM_IO_URING
+    if (allowIoUring) {
+        auto ring = std::make_unique<Ring>();
+        wakeFd_ = eventfd(0, EFD_CLOEXEC);
+        if (wakeFd_ >= 0 && ring->init(RING_ENTRIES)) {
+            ring_ = std::move(ring);
+            backend_ = IoBackend::IoUring;
+            running_.store(true);
+            threads_.emplace_back(&IoEngine::ringLoop, this);
+            LOG_INFO(LogCategory::PERSISTENCE, "I/O engine started (io_uring, %u entries)", RING_ENTRIES);
+            return true;
+        }
+        if (wakeFd_ >= 0) {
+            ::close(wakeFd_);
+            wakeFd_ = -1;
+        }
+    }
+#else
+    (void)allowIoUring;
+#endif
+
+    backend_ = IoBackend::ThreadPool;
+    running_.store(true);
+    for (size_t i = 0; i < WORKER_COUNT; i++) {
+        threads_.emplace_back(&IoEngine::workerLoop, this);
+    }
+    LOG_INFO(LogCategory::PERSISTENCE, "I/O engine started (thread pool, %zu workers)", WORKER_COUNT);
+    return true;
+}
+
+void IoEngine::stop() {
+    if (!running_.load()) {
+        return;
+    }
+
+    LOG_DEBUG(LogCategory::PERSISTENCE, "Stopping I/O engine (%u requests pending)", getQueueDepth());
+
+    {
+        std::lock_guard<std::mutex> lock(queueMutex_);
+        stopping_.store(true);
+    }
+    queueCv_.notify_all();
+
+#ifdef PHANTOM_IO_URING
+    if (wakeFd_ >= 0) {
+        u64 one = 1;
+        ssize_t ignored = ::write(wakeFd_, &one, sizeof(one));
+        (void)ignored;
+    }
+#endif
+
+    for (std::thread& thread : threads_) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    threads_.clear();
+
+#ifdef PHANTOM_IO_URING
+    ring_.reset();
+    if (wakeFd_ >= 0) {
+        ::close(wakeFd_);
+        wakeFd_ = -1;
+    }
+#endif
+
+    running_.store(false);
+    backend_ = IoBackend::Inline;
+    LOG_DEBUG(LogCategory::PERSISTENCE, "I/O engine stopped");
+}
+
+std::future<IoResult> IoEngine::readFile(const std::string& path) {
+    auto request = std::make_unique<Request>();
+    request->type = IoOpType::ReadFile;
+    request->path = path;
+    return submit(std::move(request));
+}
+
+std::future<IoResult> IoEngine::readFileRange(const std::string& path, u64 offset, size_t size) {
+    auto request = std::make_unique<Request>();
+    request->type = IoOpType::ReadRange;
+    request->path = path;
+    request->offset = offset;
+    request->length = size;
+    return submit(std::move(request));
+}
+
+std::future<IoResult> IoEngine::writeFileAtomically(const std::string& path, std::vector<u8> data, bool sync) {
+    auto request = std::make_unique<Request>();
+    request->type = IoOpType::WriteAtomic;
+    request->path = path;
+    request->data = std::move(data);
+    request->sync = sync;
+    return submit(std::move(request));
+}
+
+std::future<IoResult> IoEngine::appendFile(const std::string& path, std::vector<u8> data, bool sync) {
+    auto request = std::make_unique<Request>();
+    request->type = IoOpType::Append;
+    request->path = path;
+    request->data = std::move(data);
+    request->sync = sync;
+    return submit(std::move(request));
+}
+
+std::future<IoResult> IoEngine::syncFile(const std::string& path) {
+    auto request = std::make_unique<Request>();
+    request->type = IoOpType::Sync;
+    request->path = path;
+    request->sync = true;
+    return submit(std::move(request));
+}
+
+u32 IoEngine::getQueueDepth() const {
+    return PersistenceMetrics::get().ioQueueDepth.load(std::memory_order_relaxed);
+}
+
+std::future<IoResult> IoEngine::submit(std::unique_ptr<Request> request) {
+    std::future<IoResult> future = request->promise.get_future();
+    request->submitted = Clock::now();
+
+    PersistenceMetrics& metrics = PersistenceMetrics::get();
+    u32 depth = metrics.ioQueueDepth.fetch_add(1, std::memory_order_relaxed) + 1;
+    u32 maxDepth = metrics.ioMaxQueueDepth.load(std::memory_order_relaxed);
+    while (depth > maxDepth && !metrics.ioMaxQueueDepth.compare_exchange_weak(maxDepth, depth)) {
+    }
+
+    {
+        // Injected faults must hit requests in order, on the hooked blocking path
+        std::unique_lock<std::mutex> lock(queueMutex_);
+        if (running_.load() && !stopping_.load() && !FaultInjector::get().isArmed()) {
+            queue_.push_back(std::move(request));
+        }
+    }
+
+    if (!request) {
+        queueCv_.notify_one();
+#ifdef PHANTOM_IO_URING
+        if (backend_ == IoBackend::IoUring) {
+            u64 one = 1;
+            ssize_t ignored = ::write(wakeFd_, &one, sizeof(one));
+            (void)ignored;
+        }
+#endif
+        return future;
+    }
+
+    // Engine not running (or faults armed): do the work on the caller's thread
+    runBlocking(*request);
+    return future;
+}
+
+void IoEngine::complete(Request& request, bool ok, int error) {
+    IoResult result;
+    result.ok = ok;
+    result.error = ok ? 0 : (error ? error : EIO);
+    result.latencyMicros = static_cast<u64>(
+        std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - request.submitted).count());
+    if (ok && isReadOp(request.type)) {
+        result.data = std::move(request.data);
+    }
+
+    PersistenceMetrics& metrics = PersistenceMetrics::get();
+    if (isReadOp(request.type)) {
+        metrics.ioReadLatency.record(result.latencyMicros);
+    } else {
+        metrics.ioWriteLatency.record(result.latencyMicros);
+    }
+    metrics.ioQueueDepth.fetch_sub(1, std::memory_order_relaxed);
+
+    if (!ok) {
+        LOG_ERROR(LogCategory::PERSISTENCE, "I/O request failed for %s: %s",
+                  request.path.c_str(), strerror(result.error));
+    }
+
+    request.promise.set_value(std::move(result));
+}
+
+// ============================================================================
+// Blocking backend
+// ============================================================================
+
+void IoEngine::workerLoop() {
+    for (;;) {
+        std::unique_ptr<Request> request;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex_);
+            queueCv_.wait(lock, [this]() { return !queue_.empty() || stopping_.load(); });
+            if (queue_.empty()) {
+                return; // Stopping and drained
+            }
+            request = std::move(queue_.front());
+            queue_.pop_front();
+        }
+        runBlocking(*request);
+    }
+}
+
+void IoEngine::runBlocking(Request& request) {
+    errno = 0;
+    bool ok = false;
+
+    switch (request.type) {
+        case IoOpType::ReadFile: {
+            std::FILE* file = std::fopen(request.path.c_str(), "rb");
+            if (!file) {
+                break;
+            }
+            if (std::fseek(file, 0, SEEK_END) == 0) {
+                long size = std::ftell(file);
+                if (size >= 0 && std::fseek(file, 0, SEEK_SET) == 0) {
+                    request.data.resize(static_cast<size_t>(size));
+                    ok = std::fread(request.data.data(), 1, request.data.size(), file) == request.data.size();
+                }
+            }
+            std::fclose(file);
+            break;
+        }
+
+        case IoOpType::ReadRange: {
+            std::FILE* file = std::fopen(request.path.c_str(), "rb");
+            if (!file) {
+                break;
+            }
+#ifdef _WIN32
+            bool positioned = _fseeki64(file, static_cast<long long>(request.offset), SEEK_SET) == 0;
+#else
+            bool positioned = fseeko(file, static_cast<off_t>(request.offset), SEEK_SET) == 0;
+#endif
+            if (positioned) {
+                request.data.resize(request.length);
+                request.data.resize(std::fread(request.data.data(), 1, request.length, file));
+                ok = !std::ferror(file);
+            }
+            std::fclose(file);
+            break;
+        }
+
+        case IoOpType::WriteAtomic:
+            ok = DurableFile::writeAtomically(request.path, request.data.data(), request.data.size(), request.sync);
+            break;
+
+        case IoOpType::Append:
+        case IoOpType::Sync: {
+            // Sync must not create the file; "r+b" still allows flushing on Windows
+            const char* mode = (request.type == IoOpType::Sync) ? "r+b" : "ab";
+            std::FILE* file = std::fopen(request.path.c_str(), mode);
+            if (!file) {
+                break;
+            }
+            ok = true;
+            for (size_t done = 0; ok && done < request.data.size();) {
+                size_t chunk = request.data.size() - done;
+                ok = FaultInjector::get().admitWrite(chunk) &&
+                     std::fwrite(request.data.data() + done, 1, chunk, file) == chunk;
+                done += chunk;
+            }
+            if (ok && request.sync) {
+                ok = DurableFile::syncStream(file);
+            }
+            ok = (std::fclose(file) == 0) && ok;
+            break;
+        }
+    }
+
+    complete(request, ok, errno);
+}
+
+// ============================================================================
+// io_uring backend
+// ============================================================================
+
+#ifdef PHANTOM_IO_URING
+
+void IoEngine::armWakeup() {
+    io_uring_sqe* sqe = ring_->getSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = wakeFd_;
+    sqe->poll_events = POLLIN;
+    sqe->user_data = WAKE_TAG;
+}
+
+void IoEngine::ringLoop() {
+    LOG_DEBUG(LogCategory::PERSISTENCE, "I/O thread started");
+
+    armWakeup();
+
+    for (;;) {
+        // Admit queued requests; the cap keeps the submission queue from overflowing
+        {
+            std::lock_guard<std::mutex> lock(queueMutex_);
+            while (!queue_.empty() && active_.size() < MAX_ACTIVE_RING_REQUESTS) {
+                active_.push_back(std::move(queue_.front()));
+                queue_.pop_front();
+                startRingRequest(*active_.back());
+            }
+            if (stopping_.load() && queue_.empty() && active_.empty()) {
+                break;
+            }
+        }
+
+        if (!ring_->submitAndWait(1)) {
+            // The ring is unusable; fail what is in flight rather than hang
+            for (auto& request : active_) {
+                complete(*request, false, EIO);
+            }
+            active_.clear();
+            std::lock_guard<std::mutex> lock(queueMutex_);
+            for (auto& request : queue_) {
+                runBlocking(*request);
+            }
+            queue_.clear();
+            if (stopping_.load()) {
+                break;
+            }
+            continue;
+        }
+
+        u64 userData;
+        int result;
+        while (ring_->popCompletion(userData, result)) {
+            if (userData == WAKE_TAG) {
+                u64 count;
+                ssize_t ignored = ::read(wakeFd_, &count, sizeof(count));
+                (void)ignored;
+                armWakeup();
+            } else {
+                onRingCompletion(userData, result);
+            }
+        }
+    }
+
+    LOG_DEBUG(LogCategory::PERSISTENCE, "I/O thread exiting");
+}
+
+void IoEngine::startRingRequest(Request& request) {
+    for (Request::Slot& slot : request.slots) {
+        slot.owner = &request;
+    }
+
+    int flags = O_CLOEXEC;
+    switch (request.type) {
+        case IoOpType::ReadFile:
+            request.fd = ::open(request.path.c_str(), O_RDONLY | flags);
+            if (request.fd >= 0) {
+                struct stat st;
+                if (fstat(request.fd, &st) == 0) {
+                    request.data.resize(static_cast<size_t>(st.st_size));
+                } else {
+                    request.error = errno;
+                }
+            }
+            break;
+
+        case IoOpType::ReadRange:
+            request.fd = ::open(request.path.c_str(), O_RDONLY | flags);
+            if (request.fd >= 0) {
+                struct stat st;
+                if (fstat(request.fd, &st) == 0) {
+                    u64 size = static_cast<u64>(st.st_size);
+                    u64 available = request.offset < size ? size - request.offset : 0;
+                    request.data.resize(static_cast<size_t>(std::min<u64>(request.length, available)));
+                } else {
+                    request.error = errno;
+                }
+            }
+            break;
+
+        case IoOpType::WriteAtomic:
+            // Same temp + rename protocol as DurableFile::writeAtomically
+            request.tempPath = request.path + ".tmp";
+            request.fd = ::open(request.tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | flags, 0600);
+            break;
+
+        case IoOpType::Append:
+            request.fd = ::open(request.path.c_str(), O_WRONLY | O_CREAT | O_APPEND | flags, 0600);
+            break;
+
+        case IoOpType::Sync:
+            request.fd = ::open(request.path.c_str(), O_RDONLY | flags);
+            if (request.fd >= 0) {
+                queueRingSync(request, request.fd, true);
+                request.phase = RingPhase::SyncFile;
+                return;
+            }
+            break;
+    }
+
+    if (request.fd < 0 && !request.error) {
+        request.error = errno;
+    }
+
+    advanceRingRequest(request);
+}
+
+void IoEngine::queueRingSync(Request& request, int fd, bool dataOnly) {
+    Request::Slot& slot = request.slots[0];
+    slot.busy = true;
+
+    io_uring_sqe* sqe = ring_->getSqe();
+    sqe->opcode = IORING_OP_FSYNC;
+    sqe->fd = fd;
+    sqe->fsync_flags = dataOnly ? IORING_FSYNC_DATASYNC : 0;
+    sqe->user_data = reinterpret_cast<u64>(&slot);
+    request.inFlight++;
+    request.syncStarted = Clock::now();
+}
+
+void IoEngine::advanceRingRequest(Request& request) {
+    if (request.error) {
+        if (request.inFlight == 0) {
+            finishRingRequest(request);
+        }
+        return;
+    }
+
+    switch (request.phase) {
+        case RingPhase::Transfer: {
+            const size_t total = request.data.size();
+            const bool isRead = isReadOp(request.type);
+
+            // Appends must land in order, so they go one chunk at a time
+            const int maxInFlight = (request.type == IoOpType::Append) ? 1 : RING_SLOTS;
+
+            for (Request::Slot& slot : request.slots) {
+                if (request.queuedBytes >= total || request.inFlight >= maxInFlight) {
+                    break;
+                }
+                if (slot.busy) {
+                    continue;
+                }
+
+                size_t length = std::min(RING_CHUNK_SIZE, total - request.queuedBytes);
+                slot.offset = request.offset + request.queuedBytes;
+                slot.iov.iov_base = request.data.data() + request.queuedBytes;
+                slot.iov.iov_len = length;
+                slot.busy = true;
+
+                io_uring_sqe* sqe = ring_->getSqe();
+                sqe->opcode = isRead ? IORING_OP_READV : IORING_OP_WRITEV;
+                sqe->fd = request.fd;
+                sqe->addr = reinterpret_cast<u64>(&slot.iov);
+                sqe->len = 1;
+                sqe->off = slot.offset;
+                sqe->user_data = reinterpret_cast<u64>(&slot);
+
+                request.queuedBytes += length;
+                request.inFlight++;
+            }
+
+            if (request.inFlight > 0) {
+                return;
+            }
+
+            if (isRead || !request.sync) {
+                finishRingRequest(request);
+                return;
+            }
+
+            queueRingSync(request, request.fd, true);
+            request.phase = RingPhase::SyncFile;
+            return;
+        }
+
+        case RingPhase::SyncFile:
+            // fdatasync done
+            if (request.type != IoOpType::WriteAtomic) {
+                finishRingRequest(request);
+                return;
+            }
+
+            // The data is durable; publish it under its real name, then make the rename durable
+            if (::close(request.fd) != 0) {
+                request.error = errno;
+            }
+            request.fd = -1;
+            if (!request.error && ::rename(request.tempPath.c_str(), request.path.c_str()) != 0) {
+                request.error = errno;
+            }
+            if (!request.error) {
+                request.tempPath.clear();
+                request.dirFd = ::open(parentDirectory(request.path).c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+                if (request.dirFd < 0) {
+                    request.error = errno;
+                }
+            }
+            if (request.error) {
+                finishRingRequest(request);
+                return;
+            }
+
+            queueRingSync(request, request.dirFd, false);
+            request.phase = RingPhase::SyncDirectory;
+            return;
+
+        case RingPhase::SyncDirectory:
+            finishRingRequest(request);
+            return;
+    }
+}
+
+void IoEngine::onRingCompletion(u64 userData, int result) {
+    Request::Slot* slot = reinterpret_cast<Request::Slot*>(userData);
+    Request& request = *slot->owner;
+    request.inFlight--;
+
+    if (request.phase == RingPhase::Transfer && !request.error) {
+        if (result < 0) {
+            request.error = -result;
+        } else if (result == 0) {
+            // The file shrank (or the disk is full) while we were working on it
+            request.error = EIO;
+        } else if (static_cast<size_t>(result) < slot->iov.iov_len) {
+            // Short transfer: resubmit the remainder from the same slot
+            size_t done = static_cast<size_t>(result);
+            request.doneBytes += done;
+            slot->offset += done;
+            slot->iov.iov_base = static_cast<u8*>(slot->iov.iov_base) + done;
+            slot->iov.iov_len -= done;
+
+            io_uring_sqe* sqe = ring_->getSqe();
+            sqe->opcode = isReadOp(request.type) ? IORING_OP_READV : IORING_OP_WRITEV;
+            sqe->fd = request.fd;
+            sqe->addr = reinterpret_cast<u64>(&slot->iov);
+            sqe->len = 1;
+            sqe->off = slot->offset;
+            sqe->user_data = userData;
+            request.inFlight++;
+            return;
+        } else {
+            request.doneBytes += static_cast<size_t>(result);
+        }
+    } else if (request.phase != RingPhase::Transfer) {
+        PersistenceMetrics::get().syncLatency.record(static_cast<u64>(
+            std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - request.syncStarted).count()));
+        if (result < 0 && !request.error) {
+            request.error = -result;
+        }
+    }
+
+    slot->busy = false;
+    advanceRingRequest(request);
+}
+
+void IoEngine::finishRingRequest(Request& request) {
+    if (request.fd >= 0) {
+        if (::close(request.fd) != 0 && !request.error) {
+            request.error = errno;
+        }
+        request.fd = -1;
+    }
+    if (request.dirFd >= 0) {
+        ::close(request.dirFd);
+        request.dirFd = -1;
+    }
+
+    // Unsynced atomic writes still need their rename
+    if (!request.error && request.type == IoOpType::WriteAtomic && !request.tempPath.empty()) {
+        if (::rename(request.tempPath.c_str(), request.path.c_str()) == 0) {
+            request.tempPath.clear();
+        } else {
+            request.error = errno;
+        }
+    }
+    if (request.error && !request.tempPath.empty()) {
+        ::unlink(request.tempPath.c_str());
+    }
+
+    complete(request, request.error == 0, request.error);
+
+    auto it = std::find_if(active_.begin(), active_.end(),
+                           [&request](const std::unique_ptr<Request>& r) { return r.get() == &request; });
+    if (it != active_.end()) {
+        active_.erase(it);
+    }
+}
+
+#endif // PHANTOM_IO_URING
+
+} // namespace phantom
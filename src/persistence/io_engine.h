@@ -0,0 +1,123 @@
+#ifndef PHANTOM_IO_ENGINE_H
+#define PHANTOM_IO_ENGINE_H
+
+#include <phantom_writer/types.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <future>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+// Android blocks io_uring for apps; every other Linux gets the ring backend
+#if defined(__linux__) && !defined(__ANDROID__)
+#define PHANTOM_IO_URING 1
+#endif
+
+namespace phantom {
+
+struct IoResult {
+    bool ok = false;
+    int error = 0;              // errno of the first failure
+    std::vector<u8> data;       // File contents (reads only)
+    u64 latencyMicros = 0;      // Submission to completion
+};
+
+enum class IoBackend {
+    Inline,       // Not started: requests run on the calling thread
+    ThreadPool,   // Blocking syscalls on worker threads
+    IoUring       // One I/O thread driving a Linux io_uring
+};
+
+const char* ioBackendName(IoBackend backend);
+
+// Asynchronous file I/O for persistence and asset loading.
+//
+// Requests go into a submission queue and complete through a std::future.
+// On Linux the engine drives an io_uring from a single I/O thread; when
+// io_uring is unavailable (old kernel, seccomp, other platforms) a small
+// pool of worker threads runs the same operations with blocking syscalls.
+// Queue depth and per-operation latency are recorded in PersistenceMetrics.
+class IoEngine {
+public:
+    static IoEngine& get();
+
+    // Start the I/O thread(s). Prefers io_uring unless allowIoUring is false.
+    bool start(bool allowIoUring = true);
+
+    // Finish every submitted request, then stop
+    void stop();
+
+    bool isRunning() const { return running_.load(); }
+    IoBackend getBackend() const { return backend_; }
+
+    // Read a whole file
+    std::future<IoResult> readFile(const std::string& path);
+
+    // Read up to size bytes starting at offset; data comes back short at the end of the file
+    std::future<IoResult> readFileRange(const std::string& path, u64 offset, size_t size);
+
+    // Replace a file atomically (temp file + rename, see DurableFile)
+    std::future<IoResult> writeFileAtomically(const std::string& path, std::vector<u8> data, bool sync);
+
+    // Append to a file, creating it if needed
+    std::future<IoResult> appendFile(const std::string& path, std::vector<u8> data, bool sync);
+
+    // fdatasync a file that was written earlier
+    std::future<IoResult> syncFile(const std::string& path);
+
+    // Requests submitted but not yet completed
+    u32 getQueueDepth() const;
+
+private:
+    struct Request;
+
+    IoEngine();
+    ~IoEngine();
+
+    IoEngine(const IoEngine&) = delete;
+    IoEngine& operator=(const IoEngine&) = delete;
+
+    std::future<IoResult> submit(std::unique_ptr<Request> request);
+    void complete(Request& request, bool ok, int error);
+
+    // Thread pool backend (also used inline before start())
+    void workerLoop();
+    void runBlocking(Request& request);
+
+#ifdef PHANTOM_IO_URING
+    // io_uring backend
+    class Ring;
+    void ringLoop();
+    void startRingRequest(Request& request);
+    void advanceRingRequest(Request& request);
+    void queueRingSync(Request& request, int fd, bool dataOnly);
+    void onRingCompletion(u64 userData, int result);
+    void finishRingRequest(Request& request);
+    void armWakeup();
+
+    std::unique_ptr<Ring> ring_;
+    int wakeFd_ = -1;
+    std::vector<std::unique_ptr<Request>> active_;
+#endif
+
+    IoBackend backend_ = IoBackend::Inline;
+    std::atomic<bool> running_;
+    std::atomic<bool> stopping_;
+
+    std::mutex queueMutex_;
+    std::condition_variable queueCv_;
+    std::deque<std::unique_ptr<Request>> queue_;
+    std::vector<std::thread> threads_;
+
+    static constexpr size_t WORKER_COUNT = 2;
+    static constexpr unsigned RING_ENTRIES = 64;
+    static constexpr size_t MAX_ACTIVE_RING_REQUESTS = 8;
+};
+
+} // namespace phantom
+
+#endif // PHANTOM_IO_ENGINE_H
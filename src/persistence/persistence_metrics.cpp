@@ -0,0 +1,105 @@
+#include "persistence_metrics.h"
+#include "utils/logger.h"
+
+#include <algorithm>
+
+namespace phantom {
+
+LatencyHistogram::LatencyHistogram() {
+    reset();
+}
+
+void LatencyHistogram::record(u64 micros) {
+    int index = 0;
+    while (index < BUCKET_COUNT - 1 && (micros >> (index + 1)) != 0) {
+        index++;
+    }
+
+    buckets_[index].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(micros, std::memory_order_relaxed);
+    last_.store(micros, std::memory_order_relaxed);
+
+    u64 currentMax = max_.load(std::memory_order_relaxed);
+    while (micros > currentMax) {
+        if (max_.compare_exchange_weak(currentMax, micros, std::memory_order_relaxed)) {
+            break;
+        }
+    }
+}
+
+void LatencyHistogram::reset() {
+    for (auto& bucket : buckets_) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    count_.store(0, std::memory_order_relaxed);
+    sum_.store(0, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+    last_.store(0, std::memory_order_relaxed);
+}
+
+double LatencyHistogram::mean() const {
+    u64 n = count();
+    return n ? static_cast<double>(sum_.load(std::memory_order_relaxed)) / n : 0.0;
+}
+
+u64 LatencyHistogram::percentile(double p) const {
+    u64 n = count();
+    if (n == 0) {
+        return 0;
+    }
+
+    u64 target = static_cast<u64>(n * (p / 100.0));
+    if (target >= n) {
+        target = n - 1;
+    }
+
+    u64 seen = 0;
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+        seen += bucket(i);
+        if (seen > target) {
+            return (u64(2) << i) - 1;
+        }
+    }
+    return max();
+}
+
+PersistenceMetrics& PersistenceMetrics::get() {
+    static PersistenceMetrics instance;
+    return instance;
+}
+
+namespace {
+
+void logHistogram(const char* name, const LatencyHistogram& histogram) {
+    LOG_INFO(LogCategory::PERSISTENCE, "%s latency: n=%llu mean=%.0fus p50<=%lluus p99<=%lluus max=%lluus",
+             name, static_cast<unsigned long long>(histogram.count()), histogram.mean(),
+             static_cast<unsigned long long>(histogram.percentile(50.0)),
+             static_cast<unsigned long long>(histogram.percentile(99.0)),
+             static_cast<unsigned long long>(histogram.max()));
+}
+
+} // namespace
+
+double PersistenceMetrics::bytesWrittenPerHour() const {
+    std::chrono::duration<double> uptime = std::chrono::steady_clock::now() - start_;
+    double hours = std::max(uptime.count(), 1.0) / 3600.0;
+    u64 bytes = swapBytesWritten.load(std::memory_order_relaxed) + journalBytesWritten.load(std::memory_order_relaxed);
+    return static_cast<double>(bytes) / hours;
+}
+
+void PersistenceMetrics::logSummary() const {
+    logHistogram("fsync", syncLatency);
+    logHistogram("I/O read", ioReadLatency);
+    logHistogram("I/O write", ioWriteLatency);
+    LOG_INFO(LogCategory::PERSISTENCE, "I/O queue depth: current=%u max=%u",
+             ioQueueDepth.load(std::memory_order_relaxed), ioMaxQueueDepth.load(std::memory_order_relaxed));
+
+    constexpr double MB = 1024.0 * 1024.0;
+    LOG_INFO(LogCategory::PERSISTENCE, "Autosave writes: %.1f MB/hour (swap %.1f MB, journal %.1f MB, %llu unchanged checkpoints skipped)",
+             bytesWrittenPerHour() / MB, swapBytesWritten.load(std::memory_order_relaxed) / MB,
+             journalBytesWritten.load(std::memory_order_relaxed) / MB,
+             static_cast<unsigned long long>(checkpointsSkipped.load(std::memory_order_relaxed)));
+}
+
+} // namespace phantom
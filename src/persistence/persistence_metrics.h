@@ -0,0 +1,76 @@
+#ifndef PHANTOM_PERSISTENCE_METRICS_H
+#define PHANTOM_PERSISTENCE_METRICS_H
+
+#include <phantom_writer/types.h>
+#include <atomic>
+#include <chrono>
+
+namespace phantom {
+
+// Lock-free latency histogram with power-of-two microsecond buckets.
+// Bucket i counts samples in [2^i, 2^(i+1)) us; bucket 0 also holds 0 us.
+class LatencyHistogram {
+public:
+    static constexpr int BUCKET_COUNT = 32;
+
+    LatencyHistogram();
+
+    void record(u64 micros);
+    void reset();
+
+    u64 count() const { return count_.load(std::memory_order_relaxed); }
+    u64 max() const { return max_.load(std::memory_order_relaxed); }
+    u64 last() const { return last_.load(std::memory_order_relaxed); }
+    double mean() const;
+
+    // Upper bound of the bucket containing the given percentile (0-100)
+    u64 percentile(double p) const;
+
+    u64 bucket(int index) const { return buckets_[index].load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<u64> buckets_[BUCKET_COUNT];
+    std::atomic<u64> count_;
+    std::atomic<u64> sum_;
+    std::atomic<u64> max_;
+    std::atomic<u64> last_;
+};
+
+// Process-wide persistence counters, readable from any thread
+class PersistenceMetrics {
+public:
+    static PersistenceMetrics& get();
+
+    // fdatasync/fsync time spent per save (file + directory)
+    LatencyHistogram syncLatency;
+
+    // IoEngine: submission to completion, per request
+    LatencyHistogram ioReadLatency;
+    LatencyHistogram ioWriteLatency;
+
+    // IoEngine requests submitted but not yet completed
+    std::atomic<u32> ioQueueDepth{0};
+    std::atomic<u32> ioMaxQueueDepth{0};
+
+    // Bytes autosave put on disk: swap snapshots and journal appends
+    std::atomic<u64> swapBytesWritten{0};
+    std::atomic<u64> journalBytesWritten{0};
+
+    // Checkpoints that found the text unchanged since the last snapshot
+    std::atomic<u64> checkpointsSkipped{0};
+
+    // Swap and journal bytes per hour, averaged since startup
+    double bytesWrittenPerHour() const;
+
+    // Write the current numbers to the log
+    void logSummary() const;
+
+private:
+    PersistenceMetrics() = default;
+
+    std::chrono::steady_clock::time_point start_ = std::chrono::steady_clock::now();
+};
+
+} // namespace phantom
+
+#endif // PHANTOM_PERSISTENCE_METRICS_H
@@ -0,0 +1,296 @@
+#include "recovery_scanner.h"
+#include "swap_format.h"
+#include "edit_journal.h"
+#include "encryption.h"
+#include "utils/crc32c.h"
+#include "utils/lz_codec.h"
+#include "utils/logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+namespace phantom {
+
+namespace {
+
+// Salvaged text per decoding thread, below which threads are not worth starting
+constexpr u64 PARALLEL_DECODE_BYTES = 16 * 1024 * 1024;
+
+template <typename T>
+u32 crcOfHeader(const T& header) {
+    return crc32c(&header, sizeof(T) - sizeof(u32));
+}
+
+// Next offset in [from, end) where the 4-byte little-endian magic starts, or end
+size_t findMagic(const u8* data, size_t from, size_t end, u32 magic) {
+    const u8 first = static_cast<u8>(magic);
+    while (from + sizeof(u32) <= end) {
+        const u8* hit = static_cast<const u8*>(std::memchr(data + from, first, end - from - sizeof(u32) + 1));
+        if (!hit) {
+            break;
+        }
+        u32 candidate;
+        std::memcpy(&candidate, hit, sizeof(candidate));
+        if (candidate == magic) {
+            return static_cast<size_t>(hit - data);
+        }
+        from = static_cast<size_t>(hit - data) + 1;
+    }
+    return end;
+}
+
+// Same byte length as the lost text, visible in the editor, valid UTF-8
+void fillLost(char* out, size_t length) {
+    static const char REPLACEMENT[3] = {'\xEF', '\xBF', '\xBD'};
+    size_t i = 0;
+    for (; i + 3 <= length; i += 3) {
+        std::memcpy(out + i, REPLACEMENT, 3);
+    }
+    for (; i < length; i++) {
+        out[i] = '?';
+    }
+}
+
+struct FoundBlock {
+    u64 rawOffset;
+    u32 rawSize;
+    u32 storedSize;
+    bool compressed;
+    const u8* payload;
+};
+
+bool readSwapHeader(const u8* data, size_t size, SwapHeaderV2& header) {
+    if (size < sizeof(header) || !isSwapV2(data, size)) {
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    return header.headerCrc == crcOfHeader(header) && header.version == SWAP_V2_VERSION &&
+           header.blockSize > 0 && header.blockSize <= SWAP_V2_BLOCK_SIZE;
+}
+
+bool readSwapTrailer(const u8* data, size_t size, SwapTrailerV2& trailer) {
+    if (size < sizeof(trailer)) {
+        return false;
+    }
+    std::memcpy(&trailer, data + size - sizeof(trailer), sizeof(trailer));
+    return std::memcmp(trailer.magic, SWAP_V2_TRAILER_MAGIC, sizeof(trailer.magic)) == 0 &&
+           trailer.trailerCrc == crcOfHeader(trailer);
+}
+
+} // namespace
+
+u64 RecoveryReport::lostBytes() const {
+    u64 total = 0;
+    for (const RecoveryRange& range : lostRanges) {
+        total += range.end - range.begin;
+    }
+    return total;
+}
+
+bool salvageSwapV2(const u8* data, size_t size, SwapMetadata& meta, std::string& content,
+                   RecoveryReport& report) {
+    auto start = std::chrono::steady_clock::now();
+    report = RecoveryReport();
+    report.scannedBytes = size;
+
+    SwapHeaderV2 header;
+    SwapTrailerV2 trailer;
+    report.headerIntact = readSwapHeader(data, size, header);
+    bool trailerIntact = readSwapTrailer(data, size, trailer);
+
+    const u32 blockSize = report.headerIntact ? header.blockSize : SWAP_V2_BLOCK_SIZE;
+    const bool lengthKnown = report.headerIntact || trailerIntact;
+    const u64 expectedLength = report.headerIntact ? header.contentLength
+                             : trailerIntact ? trailer.contentLength : 0;
+
+    size_t pos = report.headerIntact ? sizeof(SwapHeaderV2) : 0;
+    const size_t end = trailerIntact ? size - sizeof(SwapTrailerV2) : size;
+
+    std::vector<FoundBlock> found;
+
+    while (pos + sizeof(SwapBlockHeader) <= end) {
+        SwapBlockHeader block;
+        std::memcpy(&block, data + pos, sizeof(block));
+
+        const size_t available = end - pos - sizeof(block);
+        const bool compressed = (block.flags & SWAP_BLOCK_COMPRESSED) != 0;
+        bool valid = block.magic == SWAP_V2_BLOCK_MAGIC && (block.flags & ~SWAP_BLOCK_COMPRESSED) == 0 &&
+                     block.rawSize > 0 && block.rawSize <= blockSize &&
+                     (compressed ? block.storedSize < block.rawSize : block.storedSize == block.rawSize) &&
+                     block.storedSize <= available &&
+                     (!report.headerIntact || block.rawOffset % blockSize == 0) &&
+                     (!lengthKnown || (block.rawOffset <= expectedLength &&
+                                       block.rawSize <= expectedLength - block.rawOffset));
+
+        const u8* payload = data + pos + sizeof(block);
+        if (valid && crc32c(payload, block.storedSize, crcOfHeader(block)) == block.crc) {
+            found.push_back({block.rawOffset, block.rawSize, block.storedSize, compressed, payload});
+            pos += sizeof(block) + block.storedSize;
+            continue;
+        }
+
+        // Damaged: skip to the next thing that looks like a block
+        size_t next = findMagic(data, pos + 1, end, SWAP_V2_BLOCK_MAGIC);
+        LOG_WARN(LogCategory::PERSISTENCE, "Swap file damaged at bytes %zu-%zu, resynchronizing", pos, next);
+        report.damagedRegions++;
+        pos = next;
+    }
+    if (pos < end && pos + sizeof(SwapBlockHeader) > end) {
+        report.damagedRegions++;
+    }
+
+    // Blocks are written in order, so this is normally already sorted
+    std::stable_sort(found.begin(), found.end(),
+                     [](const FoundBlock& a, const FoundBlock& b) { return a.rawOffset < b.rawOffset; });
+
+    // Keep the first block at each offset; the rest overlap it. A known length
+    // bounds every block; without one, the furthest block end sets it.
+    std::vector<FoundBlock> placed;
+    placed.reserve(found.size());
+    u64 length = expectedLength;
+    u64 next = 0;
+    for (const FoundBlock& block : found) {
+        const u64 blockEnd = block.rawOffset + block.rawSize;
+        if (block.rawOffset < next || (lengthKnown && blockEnd > length)) {
+            continue;
+        }
+        placed.push_back(block);
+        next = blockEnd;
+        if (!lengthKnown) {
+            length = std::max(length, blockEnd);
+        }
+    }
+
+    content.assign(static_cast<size_t>(length), '\0');
+    std::vector<u8> decoded(placed.size(), 0);
+
+    // Blocks land in disjoint parts of content, so decoding splits across
+    // threads; LZ decoding is the slow part of a large salvage
+    auto decodeRange = [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; i++) {
+            const FoundBlock& block = placed[i];
+            char* dest = &content[static_cast<size_t>(block.rawOffset)];
+            if (block.compressed) {
+                decoded[i] = lzDecompress(block.payload, block.storedSize, reinterpret_cast<u8*>(dest), block.rawSize);
+            } else {
+                std::memcpy(dest, block.payload, block.rawSize);
+                decoded[i] = 1;
+            }
+        }
+    };
+
+    size_t threadCount = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()),
+                                          static_cast<size_t>(length / PARALLEL_DECODE_BYTES) + 1);
+    threadCount = std::min(threadCount, placed.size());
+    if (threadCount > 1) {
+        std::vector<std::thread> threads;
+        size_t perThread = (placed.size() + threadCount - 1) / threadCount;
+        for (size_t first = perThread; first < placed.size(); first += perThread) {
+            threads.emplace_back(decodeRange, first, std::min(first + perThread, placed.size()));
+        }
+        decodeRange(0, perThread);
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    } else {
+        decodeRange(0, placed.size());
+    }
+
+    u64 covered = 0;    // Document bytes before this offset are restored or reported lost
+    for (size_t i = 0; i < placed.size(); i++) {
+        if (!decoded[i]) {
+            report.damagedRegions++;
+            continue;
+        }
+        if (placed[i].rawOffset > covered) {
+            report.lostRanges.push_back({covered, placed[i].rawOffset});
+        }
+        covered = placed[i].rawOffset + placed[i].rawSize;
+        report.intactBlocks++;
+    }
+    if (covered < length) {
+        report.lostRanges.push_back({covered, length});
+    }
+
+    for (const RecoveryRange& range : report.lostRanges) {
+        fillLost(&content[static_cast<size_t>(range.begin)], static_cast<size_t>(range.end - range.begin));
+    }
+
+    if (report.headerIntact) {
+        meta.timestamp = header.timestamp;
+        meta.cursorPosition = std::min<u64>(header.cursorPosition, length);
+        meta.cursorColumn = header.cursorColumn;
+        meta.generation = header.generation;
+    }
+
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return report.intactBlocks > 0 || (lengthKnown && length == 0);
+}
+
+void scanJournalRecords(const u8* data, size_t size, size_t firstRecord, RecoveryReport& report,
+                        const JournalRecordVisitor& visit) {
+    auto start = std::chrono::steady_clock::now();
+    report.scannedBytes += size;
+
+    size_t pos = firstRecord;
+    while (pos < size) {
+        JournalRecordHeader record;
+        bool valid = size - pos >= sizeof(record);
+        size_t payloadSize = 0;
+
+        if (valid) {
+            std::memcpy(&record, data + pos, sizeof(record));
+            bool isInsert = record.type == static_cast<u8>(JournalRecordType::Insert);
+            bool isErase = record.type == static_cast<u8>(JournalRecordType::Erase);
+            payloadSize = (isInsert ? record.length : 0) +
+                          ((record.flags & JOURNAL_RECORD_SEALED) ? ENCRYPTION_TAG_SIZE : 0);
+            valid = record.magic == JOURNAL_RECORD_MAGIC && (isInsert || isErase) &&
+                    payloadSize <= size - pos - sizeof(record) &&
+                    crc32c(data + pos + sizeof(record), payloadSize, crcOfHeader(record)) == record.crc;
+        }
+
+        if (valid) {
+            report.intactBlocks++;
+            if (!visit(record, data + pos + sizeof(record))) {
+                break;
+            }
+            pos += sizeof(record) + payloadSize;
+            continue;
+        }
+
+        size_t next = findMagic(data, pos + 1, size, JOURNAL_RECORD_MAGIC);
+        report.damagedRegions++;
+        report.lostRanges.push_back({pos, next});
+        pos = next;
+    }
+
+    report.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void logRecoveryReport(const char* what, const RecoveryReport& report) {
+    constexpr size_t MAX_LOGGED_RANGES = 8;
+
+    if (report.isComplete()) {
+        LOG_INFO(LogCategory::PERSISTENCE, "%s: %u blocks intact, nothing lost", what, report.intactBlocks);
+        return;
+    }
+
+    double mbps = report.seconds > 0.0 ? (report.scannedBytes / (1024.0 * 1024.0)) / report.seconds : 0.0;
+    LOG_WARN(LogCategory::PERSISTENCE, "%s: salvaged %u blocks, %u damaged regions, %llu bytes lost%s (scanned at %.0f MB/s)",
+             what, report.intactBlocks, report.damagedRegions,
+             static_cast<unsigned long long>(report.lostBytes()),
+             report.headerIntact ? "" : ", header unreadable", mbps);
+
+    for (size_t i = 0; i < report.lostRanges.size() && i < MAX_LOGGED_RANGES; i++) {
+        LOG_WARN(LogCategory::PERSISTENCE, "  lost bytes %llu-%llu",
+                 static_cast<unsigned long long>(report.lostRanges[i].begin),
+                 static_cast<unsigned long long>(report.lostRanges[i].end));
+    }
+    if (report.lostRanges.size() > MAX_LOGGED_RANGES) {
+        LOG_WARN(LogCategory::PERSISTENCE, "  ... and %zu more ranges", report.lostRanges.size() - MAX_LOGGED_RANGES);
+    }
+}
+
+} // namespace phantom
@@ -0,0 +1,64 @@
+#ifndef PHANTOM_RECOVERY_SCANNER_H
+#define PHANTOM_RECOVERY_SCANNER_H
+
+#include <phantom_writer/types.h>
+#include <string>
+#include <vector>
+#include <functional>
+
+namespace phantom {
+
+struct SwapMetadata;
+struct JournalRecordHeader;
+
+// Half-open byte range [begin, end)
+struct RecoveryRange {
+    u64 begin;
+    u64 end;
+};
+
+struct RecoveryReport {
+    u64 scannedBytes = 0;
+    u32 intactBlocks = 0;       // Swap blocks or journal records that verified
+    u32 damagedRegions = 0;     // Stretches of the file that had to be skipped
+    bool headerIntact = false;
+
+    // Swap: document offsets whose text is gone (filled with U+FFFD).
+    // Journal: file offsets of records that could not be read.
+    std::vector<RecoveryRange> lostRanges;
+
+    double seconds = 0.0;
+
+    bool isComplete() const { return headerIntact && lostRanges.empty() && damagedRegions == 0; }
+    u64 lostBytes() const;
+};
+
+// Salvage scanning for damaged swap and journal files.
+//
+// Both formats frame their data in self-describing units (swap blocks,
+// journal records) that start with a magic number and end with a CRC32C
+// over the unit. The scanners walk the units in order; when one fails to
+// verify they search forward for the next magic and carry on, so damage
+// costs only the units it touches. Verification is CRC32C (hardware on
+// x86/ARMv8) plus LZ decoding, which together run well above disk speed.
+
+// Rebuild a v2 swap image from every block that verifies. Blocks are
+// placed by their recorded document offset, so holes keep their size: lost
+// text is replaced by U+FFFD characters of the same byte length and journal
+// positions recorded against the snapshot stay valid. meta is only filled
+// when the header is intact. Returns false if nothing could be salvaged.
+bool salvageSwapV2(const u8* data, size_t size, SwapMetadata& meta, std::string& content,
+                   RecoveryReport& report);
+
+// Visit every journal record that verifies, in file order. Returning false
+// from the visitor stops the scan.
+using JournalRecordVisitor = std::function<bool(const JournalRecordHeader& record, const u8* payload)>;
+void scanJournalRecords(const u8* data, size_t size, size_t firstRecord, RecoveryReport& report,
+                        const JournalRecordVisitor& visit);
+
+// Log a report's lost ranges (at most a handful, then a count)
+void logRecoveryReport(const char* what, const RecoveryReport& report);
+
+} // namespace phantom
+
+#endif // PHANTOM_RECOVERY_SCANNER_H
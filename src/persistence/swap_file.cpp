@@ -1,11 +1,20 @@
 #include "swap_file.h"
+#include "swap_format.h"
+#include "recovery_scanner.h"
+#include "encryption.h"
+#include "io_engine.h"
+#include "persistence_metrics.h"
 #include "core/buffer.h"
 #include "core/cursor.h"
 #include "utils/logger.h"
+#include "utils/mapped_file.h"
 
 #include <fstream>
-#include <sstream>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
 #include <ctime>
+#include <utility>
 #include <sys/stat.h>
 
 namespace phantom {
@@ -30,45 +39,46 @@ SwapFile::~SwapFile() {
     LOG_TRACE(LogCategory::PERSISTENCE, "SwapFile destroyed");
 }
 
-bool SwapFile::write(const TextBuffer& buffer, const Cursor& cursor) {
-    LOG_TRACE(LogCategory::PERSISTENCE, "Writing swap file: %s", swapFilePath_.c_str());
-
-    std::ofstream file(swapFilePath_, std::ios::binary | std::ios::trunc);
-    if (!file.is_open()) {
-        LOG_ERROR(LogCategory::PERSISTENCE, "Failed to open swap file for writing: %s", swapFilePath_.c_str());
-        return false;
-    }
-
-    // Get current timestamp
-    time_t now = time(nullptr);
+bool SwapFile::write(const TextBuffer& buffer, const Cursor& cursor, u32 generation, bool sync) {
+    // Build the whole image in memory so it goes out in a single write
+    std::vector<u8> image;
+    encode(buffer, cursor, generation, image);
+    return writeImage(std::move(image), sync);
+}
 
-    // Get cursor position (line and column)
-    size_t cursorPos = cursor.getPosition();
-    size_t cursorLine = buffer.positionToLine(cursorPos);
-    size_t cursorCol = cursor.getPreferredColumn();
+void SwapFile::encode(const TextBuffer& buffer, const Cursor& cursor, u32 generation, std::vector<u8>& image) {
+    SwapMetadata meta;
+    meta.timestamp = static_cast<u64>(time(nullptr));
+    meta.cursorPosition = cursor.getPosition();
+    meta.cursorColumn = cursor.getPreferredColumn();
+    meta.generation = generation;
 
-    // Get buffer content
-    std::string content = buffer.getText();
+    encodeSwapV2(buffer.getSegments(), meta, image);
+}
 
-    // Write header
-    file << SWAP_HEADER << "\n";
-    file << "timestamp: " << now << "\n";
-    file << "cursor_line: " << cursorLine << "\n";
-    file << "cursor_column: " << cursorCol << "\n";
-    file << "cursor_position: " << cursorPos << "\n";
-    file << "buffer_length: " << content.length() << "\n";
-    file << "---BEGIN_CONTENT---\n";
-    file << content;
-    file << "\n---END_CONTENT---\n";
+bool SwapFile::writeImage(std::vector<u8> image, bool sync) {
+    LOG_TRACE(LogCategory::PERSISTENCE, "Writing swap file: %s", swapFilePath_.c_str());
 
-    file.close();
+    if (encryption_) {
+        std::vector<u8> sealed;
+        if (!sealBuffer(*encryption_, image.data(), image.size(), sealed)) {
+            LOG_ERROR(LogCategory::PERSISTENCE, "Failed to encrypt swap file: %s", swapFilePath_.c_str());
+            return false;
+        }
+        image.swap(sealed);
+    }
 
-    if (file.fail()) {
+    // Never truncate the live swap file: a crash mid-write would leave nothing to recover
+    size_t size = image.size();
+    IoResult result = IoEngine::get().writeFileAtomically(swapFilePath_, std::move(image), sync).get();
+    if (!result.ok) {
         LOG_ERROR(LogCategory::PERSISTENCE, "Error writing swap file: %s", swapFilePath_.c_str());
         return false;
     }
+    PersistenceMetrics::get().swapBytesWritten.fetch_add(size, std::memory_order_relaxed);
 
-    LOG_INFO(LogCategory::PERSISTENCE, "Swap file written: %zu bytes", content.length());
+    LOG_INFO(LogCategory::PERSISTENCE, "Swap file written: %zu bytes%s in %llu us", size, sync ? " (synced)" : "",
+             static_cast<unsigned long long>(result.latencyMicros));
     return true;
 }
 
@@ -77,80 +87,157 @@ bool SwapFile::exists() const {
     return file.good();
 }
 
-bool SwapFile::read(TextBuffer& buffer, Cursor& cursor) {
+bool SwapFile::read(TextBuffer& buffer, Cursor& cursor, u32* generation, RecoveryReport* report) {
     LOG_INFO(LogCategory::PERSISTENCE, "Reading swap file: %s", swapFilePath_.c_str());
 
-    std::ifstream file(swapFilePath_, std::ios::binary);
-    if (!file.is_open()) {
+    MappedFile file;
+    if (!file.open(swapFilePath_)) {
         LOG_ERROR(LogCategory::PERSISTENCE, "Failed to open swap file for reading: %s", swapFilePath_.c_str());
         return false;
     }
 
+    const u8* data = file.data();
+    size_t size = file.size();
+
+    std::vector<u8> decrypted;
+    if (isEncrypted(data, size)) {
+        if (!encryption_) {
+            LOG_ERROR(LogCategory::PERSISTENCE, "Swap file is encrypted and no passphrase was given: %s",
+                      swapFilePath_.c_str());
+            return false;
+        }
+        // Damaged chunks come back zeroed; the block checksums below find them
+        RecoveryReport chunks;
+        if (!openBuffer(*encryption_, data, size, decrypted, &chunks)) {
+            return false;
+        }
+        if (!chunks.isComplete()) {
+            logRecoveryReport("Encrypted swap file", chunks);
+        }
+        data = decrypted.data();
+        size = decrypted.size();
+    }
+
+    size_t legacyHeaderLength = std::strlen(LEGACY_SWAP_HEADER);
+    if (!isSwapV2(data, size) && size >= legacyHeaderLength &&
+        std::memcmp(data, LEGACY_SWAP_HEADER, legacyHeaderLength) == 0) {
+        if (generation) {
+            *generation = 0;
+        }
+        if (report) {
+            *report = RecoveryReport();
+            report->headerIntact = true;
+        }
+        return readLegacyV1(data, size, buffer, cursor);
+    }
+
+    SwapMetadata meta;
+    std::string content;
+    RecoveryReport salvage;
+
+    if (decodeSwapV2(data, size, meta, content)) {
+        salvage.headerIntact = true;
+    } else {
+        // Fall back to whatever blocks still verify
+        LOG_WARN(LogCategory::PERSISTENCE, "Swap file is damaged, salvaging: %s", swapFilePath_.c_str());
+        if (!salvageSwapV2(data, size, meta, content, salvage)) {
+            LOG_ERROR(LogCategory::PERSISTENCE, "Nothing could be salvaged from %s", swapFilePath_.c_str());
+            return false;
+        }
+        logRecoveryReport("Swap file", salvage);
+    }
+
+    LOG_INFO(LogCategory::PERSISTENCE, "Swap file read: timestamp=%llu, length=%zu",
+             static_cast<unsigned long long>(meta.timestamp), content.length());
+
+    buffer.assign(std::move(content));
+    cursor.setPosition(static_cast<size_t>(meta.cursorPosition));
+    cursor.setPreferredColumn(static_cast<size_t>(meta.cursorColumn));
+
+    if (generation) {
+        *generation = meta.generation;
+    }
+    if (report) {
+        *report = std::move(salvage);
+    }
+
+    return true;
+}
+
+bool SwapFile::readLegacyV1(const u8* data, size_t size, TextBuffer& buffer, Cursor& cursor) {
+    const char* p = reinterpret_cast<const char*>(data);
+    const char* end = p + size;
+
+    auto nextLine = [&p, end](std::string& line) {
+        if (p >= end) {
+            return false;
+        }
+        const char* newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        const char* lineEnd = newline ? newline : end;
+        line.assign(p, lineEnd);
+        p = newline ? newline + 1 : end;
+        return true;
+    };
+
     std::string line;
 
     // Read and validate header
-    std::getline(file, line);
-    if (line != SWAP_HEADER) {
+    if (!nextLine(line) || line != LEGACY_SWAP_HEADER) {
         LOG_ERROR(LogCategory::PERSISTENCE, "Invalid swap file header: %s", line.c_str());
         return false;
     }
 
     // Parse metadata
     long timestamp = 0;
-    size_t cursorLine = 0;
     size_t cursorCol = 0;
     size_t cursorPos = 0;
     size_t bufferLength = 0;
+    bool hasLength = false;
 
-    while (std::getline(file, line)) {
+    while (nextLine(line)) {
         if (line == "---BEGIN_CONTENT---") {
             break;
         }
 
-        size_t colonPos = line.find(':');
+        size_t colonPos = line.find(": ");
         if (colonPos != std::string::npos) {
             std::string key = line.substr(0, colonPos);
-            std::string value = line.substr(colonPos + 2); // Skip ": "
+            const char* value = line.c_str() + colonPos + 2;
 
             if (key == "timestamp") {
-                timestamp = std::stol(value);
-            } else if (key == "cursor_line") {
-                cursorLine = std::stoull(value);
+                timestamp = std::strtol(value, nullptr, 10);
             } else if (key == "cursor_column") {
-                cursorCol = std::stoull(value);
+                cursorCol = std::strtoull(value, nullptr, 10);
             } else if (key == "cursor_position") {
-                cursorPos = std::stoull(value);
+                cursorPos = std::strtoull(value, nullptr, 10);
             } else if (key == "buffer_length") {
-                bufferLength = std::stoull(value);
+                bufferLength = std::strtoull(value, nullptr, 10);
+                hasLength = true;
             }
         }
     }
 
-    // Read content
-    std::stringstream contentStream;
-    std::string contentLine;
-    while (std::getline(file, contentLine)) {
-        if (contentLine == "---END_CONTENT---") {
-            break;
-        }
-        if (contentStream.tellp() > 0) {
-            contentStream << "\n";
+    // V1 wrote the raw content followed by "\n---END_CONTENT---\n". Prefer the
+    // recorded length so trailing newlines and CRs survive; fall back to the marker.
+    static const char END_MARKER[] = "\n---END_CONTENT---";
+    size_t available = static_cast<size_t>(end - p);
+    size_t contentLength = available;
+
+    if (hasLength && bufferLength <= available) {
+        contentLength = bufferLength;
+    } else {
+        std::string remaining(p, available);
+        size_t markerPos = remaining.find(END_MARKER);
+        if (markerPos != std::string::npos) {
+            contentLength = markerPos;
         }
-        contentStream << contentLine;
     }
 
-    std::string content = contentStream.str();
-    file.close();
+    std::string content(p, contentLength);
 
-    LOG_INFO(LogCategory::PERSISTENCE, "Swap file read: timestamp=%ld, length=%zu", timestamp, content.length());
+    LOG_INFO(LogCategory::PERSISTENCE, "Legacy swap file read: timestamp=%ld, length=%zu", timestamp, content.length());
 
-    // Restore buffer
-    buffer.clear();
-    if (!content.empty()) {
-        buffer.insert(0, content);
-    }
-
-    // Restore cursor
+    buffer.assign(std::move(content));
     cursor.setPosition(cursorPos);
     cursor.setPreferredColumn(cursorCol);
 
@@ -169,6 +256,16 @@ bool SwapFile::remove() {
     }
 }
 
+std::string SwapFile::getJournalFilePath() const {
+    // ".name.swp" -> ".name.jnl"
+    return swapFilePath_.substr(0, swapFilePath_.size() - 4) + ".jnl";
+}
+
+std::string SwapFile::getHistoryBasePath() const {
+    // ".name.swp" -> ".name"
+    return swapFilePath_.substr(0, swapFilePath_.size() - 4);
+}
+
 bool SwapFile::isNewerThanOriginal() const {
     if (!exists()) {
         return false;
@@ -1,27 +1,50 @@
 #ifndef PHANTOM_SWAP_FILE_H
 #define PHANTOM_SWAP_FILE_H
 
+#include <phantom_writer/types.h>
 #include <string>
+#include <vector>
+#include <memory>
+#include <utility>
 #include <cstddef>
 
 namespace phantom {
 
 class TextBuffer;
 class Cursor;
+struct RecoveryReport;
+class EncryptionKey;
 
 class SwapFile {
 public:
     SwapFile(const std::string& originalFilePath);
     ~SwapFile();
 
-    // Write current state to swap file
-    bool write(const TextBuffer& buffer, const Cursor& cursor);
+    // Write current state to swap file (binary PHANTOM_SWAP_V2 format).
+    // The file is replaced atomically; sync makes it durable (fdatasync + directory fsync).
+    bool write(const TextBuffer& buffer, const Cursor& cursor, u32 generation = 0, bool sync = true);
+
+    // Encode current state into a swap image without touching the disk.
+    // Lets callers snapshot under a lock and do the I/O outside it.
+    static void encode(const TextBuffer& buffer, const Cursor& cursor, u32 generation, std::vector<u8>& image);
+
+    // Write a previously encoded image to the swap file through the IoEngine
+    // (encrypting it first if a key is set)
+    bool writeImage(std::vector<u8> image, bool sync = true);
+
+    // Encrypt swap files from now on, and decrypt encrypted ones on read.
+    // Set before the autosave thread starts.
+    void setEncryption(std::shared_ptr<const EncryptionKey> key) { encryption_ = std::move(key); }
 
     // Check if swap file exists
     bool exists() const;
 
-    // Read swap file and restore state
-    bool read(TextBuffer& buffer, Cursor& cursor);
+    // Read swap file and restore state (accepts V2 and legacy V1 files).
+    // generation receives the journal generation the snapshot belongs to.
+    // A damaged V2 file is salvaged block by block; report (if given) says
+    // what was lost. Without an intact header the generation is unknown and
+    // report->headerIntact is false.
+    bool read(TextBuffer& buffer, Cursor& cursor, u32* generation = nullptr, RecoveryReport* report = nullptr);
 
     // Delete swap file (after successful save)
     bool remove();
@@ -29,14 +52,23 @@ public:
     // Get swap file path
     std::string getSwapFilePath() const { return swapFilePath_; }
 
+    // Path of the edit journal that accompanies this swap file (.filename.jnl)
+    std::string getJournalFilePath() const;
+
+    // Base path of the version history files (.filename.hpk / .filename.hix)
+    std::string getHistoryBasePath() const;
+
     // Check if swap file is newer than original file
     bool isNewerThanOriginal() const;
 
 private:
+    bool readLegacyV1(const u8* data, size_t size, TextBuffer& buffer, Cursor& cursor);
+
     std::string originalFilePath_;
     std::string swapFilePath_;
+    std::shared_ptr<const EncryptionKey> encryption_;
 
-    static constexpr const char* SWAP_HEADER = "PHANTOM_SWAP_V1";
+    static constexpr const char* LEGACY_SWAP_HEADER = "PHANTOM_SWAP_V1";
 };
 
 } // namespace phantom
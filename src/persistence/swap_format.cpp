@@ -0,0 +1,177 @@
+#include "swap_format.h"
+#include "core/buffer.h"
+#include "utils/crc32c.h"
+#include "utils/lz_codec.h"
+#include "utils/logger.h"
+
+#include <cstring>
+
+namespace phantom {
+
+namespace {
+
+template <typename T>
+u32 crcOfHeader(const T& header) {
+    // Every header ends with its own CRC field
+    return crc32c(&header, sizeof(T) - sizeof(u32));
+}
+
+void appendBytes(std::vector<u8>& out, const void* data, size_t length) {
+    const u8* bytes = static_cast<const u8*>(data);
+    out.insert(out.end(), bytes, bytes + length);
+}
+
+} // namespace
+
+bool isSwapV2(const u8* data, size_t size) {
+    return size >= sizeof(SWAP_V2_MAGIC) && std::memcmp(data, SWAP_V2_MAGIC, sizeof(SWAP_V2_MAGIC)) == 0;
+}
+
+void encodeSwapV2(const TextSegments& text, const SwapMetadata& meta, std::vector<u8>& out) {
+    const size_t contentLength = text.beforeLength + text.afterLength;
+    const u32 blockCount = static_cast<u32>((contentLength + SWAP_V2_BLOCK_SIZE - 1) / SWAP_V2_BLOCK_SIZE);
+
+    // Upper bound: blocks that don't shrink are stored raw
+    out.clear();
+    out.reserve(sizeof(SwapHeaderV2) + blockCount * sizeof(SwapBlockHeader) + contentLength + sizeof(SwapTrailerV2));
+
+    SwapHeaderV2 header{};
+    std::memcpy(header.magic, SWAP_V2_MAGIC, sizeof(header.magic));
+    header.version = SWAP_V2_VERSION;
+    header.timestamp = meta.timestamp;
+    header.cursorPosition = meta.cursorPosition;
+    header.cursorColumn = meta.cursorColumn;
+    header.contentLength = contentLength;
+    header.blockSize = SWAP_V2_BLOCK_SIZE;
+    header.blockCount = blockCount;
+    header.generation = meta.generation;
+    header.headerCrc = crcOfHeader(header);
+    appendBytes(out, &header, sizeof(header));
+
+    u32 blocksCrc = 0;
+    u64 rawOffset = 0;
+
+    // Blocks straddling the gap are the only ones that get copied before compressing
+    LzStreamCompressor stream(SWAP_V2_BLOCK_SIZE, [&](const LzBlock& stored) {
+        SwapBlockHeader block{};
+        block.magic = SWAP_V2_BLOCK_MAGIC;
+        block.flags = stored.compressed ? SWAP_BLOCK_COMPRESSED : 0;
+        block.rawOffset = rawOffset;
+        block.rawSize = static_cast<u32>(stored.rawSize);
+        block.storedSize = static_cast<u32>(stored.storedSize);
+        block.crc = crc32c(stored.data, stored.storedSize, crcOfHeader(block));
+
+        appendBytes(out, &block, sizeof(block));
+        appendBytes(out, stored.data, stored.storedSize);
+
+        blocksCrc = crc32c(&block.crc, sizeof(block.crc), blocksCrc);
+        rawOffset += stored.rawSize;
+        return true;
+    });
+    stream.write(text.before, text.beforeLength);
+    stream.write(text.after, text.afterLength);
+    stream.finish();
+
+    SwapTrailerV2 trailer{};
+    std::memcpy(trailer.magic, SWAP_V2_TRAILER_MAGIC, sizeof(trailer.magic));
+    trailer.contentLength = contentLength;
+    trailer.blockCount = blockCount;
+    trailer.blocksCrc = blocksCrc;
+    trailer.trailerCrc = crcOfHeader(trailer);
+    appendBytes(out, &trailer, sizeof(trailer));
+}
+
+bool decodeSwapV2(const u8* data, size_t size, SwapMetadata& meta, std::string& content) {
+    if (size < sizeof(SwapHeaderV2) + sizeof(SwapTrailerV2) || !isSwapV2(data, size)) {
+        LOG_ERROR(LogCategory::PERSISTENCE, "Swap file too small or bad magic");
+        return false;
+    }
+
+    SwapHeaderV2 header;
+    std::memcpy(&header, data, sizeof(header));
+    if (header.headerCrc != crcOfHeader(header)) {
+        LOG_ERROR(LogCategory::PERSISTENCE, "Swap header checksum mismatch");
+        return false;
+    }
+    if (header.version != SWAP_V2_VERSION) {
+        LOG_ERROR(LogCategory::PERSISTENCE, "Unsupported swap version: %u", header.version);
+        return false;
+    }
+    if (header.blockSize == 0 || header.blockSize > SWAP_V2_BLOCK_SIZE ||
+        header.blockCount > size / sizeof(SwapBlockHeader) ||
+        header.contentLength > static_cast<u64>(header.blockCount) * header.blockSize) {
+        LOG_ERROR(LogCategory::PERSISTENCE, "Swap header describes an impossible layout");
+        return false;
+    }
+
+    content.clear();
+    content.reserve(static_cast<size_t>(header.contentLength));
+
+    size_t pos = sizeof(SwapHeaderV2);
+    u32 blocksCrc = 0;
+
+    for (u32 i = 0; i < header.blockCount; i++) {
+        if (size - pos < sizeof(SwapBlockHeader)) {
+            LOG_ERROR(LogCategory::PERSISTENCE, "Swap block %u truncated", i);
+            return false;
+        }
+
+        SwapBlockHeader block;
+        std::memcpy(&block, data + pos, sizeof(block));
+        pos += sizeof(block);
+
+        bool compressed = (block.flags & SWAP_BLOCK_COMPRESSED) != 0;
+        if (block.magic != SWAP_V2_BLOCK_MAGIC || (block.flags & ~SWAP_BLOCK_COMPRESSED) != 0 ||
+            block.rawOffset != content.size() || block.rawSize > header.blockSize ||
+            (compressed ? block.storedSize >= block.rawSize : block.storedSize != block.rawSize) ||
+            block.storedSize > size - pos) {
+            LOG_ERROR(LogCategory::PERSISTENCE, "Swap block %u has an invalid header", i);
+            return false;
+        }
+
+        const u8* payload = data + pos;
+        if (crc32c(payload, block.storedSize, crcOfHeader(block)) != block.crc) {
+            LOG_ERROR(LogCategory::PERSISTENCE, "Swap block %u checksum mismatch (offset %llu)",
+                      i, static_cast<unsigned long long>(block.rawOffset));
+            return false;
+        }
+
+        if (compressed) {
+            size_t offset = content.size();
+            content.resize(offset + block.rawSize);
+            if (!lzDecompress(payload, block.storedSize, reinterpret_cast<u8*>(&content[offset]), block.rawSize)) {
+                LOG_ERROR(LogCategory::PERSISTENCE, "Swap block %u failed to decompress", i);
+                return false;
+            }
+        } else {
+            content.append(reinterpret_cast<const char*>(payload), block.storedSize);
+        }
+        blocksCrc = crc32c(&block.crc, sizeof(block.crc), blocksCrc);
+        pos += block.storedSize;
+    }
+
+    if (size - pos < sizeof(SwapTrailerV2)) {
+        LOG_ERROR(LogCategory::PERSISTENCE, "Swap trailer missing");
+        return false;
+    }
+
+    SwapTrailerV2 trailer;
+    std::memcpy(&trailer, data + pos, sizeof(trailer));
+    if (std::memcmp(trailer.magic, SWAP_V2_TRAILER_MAGIC, sizeof(trailer.magic)) != 0 ||
+        trailer.trailerCrc != crcOfHeader(trailer) ||
+        trailer.contentLength != header.contentLength ||
+        trailer.blockCount != header.blockCount ||
+        trailer.blocksCrc != blocksCrc ||
+        content.size() != header.contentLength) {
+        LOG_ERROR(LogCategory::PERSISTENCE, "Swap trailer does not match content");
+        return false;
+    }
+
+    meta.timestamp = header.timestamp;
+    meta.cursorPosition = header.cursorPosition;
+    meta.cursorColumn = header.cursorColumn;
+    meta.generation = header.generation;
+    return true;
+}
+
+} // namespace phantom
@@ -0,0 +1,89 @@
+#ifndef PHANTOM_SWAP_FORMAT_H
+#define PHANTOM_SWAP_FORMAT_H
+
+#include <phantom_writer/types.h>
+#include <string>
+#include <vector>
+
+namespace phantom {
+
+struct TextSegments;
+
+// Binary swap file format (PHANTOM_SWAP_V2)
+//
+//   SwapHeaderV2                       64 bytes
+//   { SwapBlockHeader, payload } * N   32 bytes + storedSize each
+//   SwapTrailerV2                      32 bytes
+//
+// The content is split into blocks of at most SWAP_V2_BLOCK_SIZE bytes.
+// Each block is LZ-compressed on its own (SWAP_BLOCK_COMPRESSED) or stored
+// raw when compression doesn't pay off. Every block carries its offset in
+// the document and a CRC32C over its header and stored payload, so a
+// damaged file can be verified (and salvaged) block by block. All integers are little-endian, which is the native
+// byte order on every platform we ship.
+
+constexpr char SWAP_V2_MAGIC[8] = {'P', 'H', 'S', 'W', 'A', 'P', '0', '2'};
+constexpr char SWAP_V2_TRAILER_MAGIC[8] = {'P', 'H', 'S', 'W', 'E', 'N', 'D', '2'};
+constexpr u32 SWAP_V2_VERSION = 2;
+constexpr u32 SWAP_V2_BLOCK_MAGIC = 0x4B4C4250; // "PBLK"
+constexpr u32 SWAP_V2_BLOCK_SIZE = 256 * 1024;
+
+// SwapBlockHeader::flags
+constexpr u32 SWAP_BLOCK_COMPRESSED = 1u << 0;
+
+struct SwapHeaderV2 {
+    char magic[8];
+    u32 version;
+    u32 flags;
+    u64 timestamp;
+    u64 cursorPosition;
+    u64 cursorColumn;
+    u64 contentLength;
+    u32 blockSize;
+    u32 blockCount;
+    u32 generation;      // Edit journal generation this snapshot is the base of
+    u32 headerCrc;       // CRC32C of all preceding header bytes
+};
+
+struct SwapBlockHeader {
+    u32 magic;
+    u32 flags;
+    u64 rawOffset;       // Offset of this block in the document
+    u32 rawSize;         // Decoded payload size
+    u32 storedSize;      // Bytes following this header
+    u32 reserved;
+    u32 crc;             // CRC32C of preceding header bytes + stored payload
+};
+
+struct SwapTrailerV2 {
+    char magic[8];
+    u64 contentLength;
+    u32 blockCount;
+    u32 blocksCrc;       // CRC32C over the sequence of block CRCs
+    u32 reserved;
+    u32 trailerCrc;      // CRC32C of all preceding trailer bytes
+};
+
+static_assert(sizeof(SwapHeaderV2) == 64, "SwapHeaderV2 layout changed");
+static_assert(sizeof(SwapBlockHeader) == 32, "SwapBlockHeader layout changed");
+static_assert(sizeof(SwapTrailerV2) == 32, "SwapTrailerV2 layout changed");
+
+struct SwapMetadata {
+    u64 timestamp = 0;
+    u64 cursorPosition = 0;
+    u64 cursorColumn = 0;
+    u32 generation = 0;
+};
+
+// Check whether a file image starts with the v2 magic
+bool isSwapV2(const u8* data, size_t size);
+
+// Serialize the document into a complete v2 file image
+void encodeSwapV2(const TextSegments& text, const SwapMetadata& meta, std::vector<u8>& out);
+
+// Parse and verify a v2 file image. Fails on any structural or checksum error.
+bool decodeSwapV2(const u8* data, size_t size, SwapMetadata& meta, std::string& content);
+
+} // namespace phantom
+
+#endif // PHANTOM_SWAP_FORMAT_H
@@ -0,0 +1,499 @@
+#include "version_history.h"
+#include "content_chunker.h"
+#include "io_engine.h"
+#include "utils/crc32c.h"
+#include "utils/hash.h"
+#include "utils/logger.h"
+#include "utils/lz_codec.h"
+#include "utils/mapped_file.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <utility>
+
+namespace phantom {
+
+namespace {
+
+template <typename T>
+u32 crcOfHeader(const T& header) {
+    return crc32c(&header, sizeof(T) - sizeof(u32));
+}
+
+void appendBytes(std::vector<u8>& out, const void* data, size_t length) {
+    const u8* bytes = static_cast<const u8*>(data);
+    out.insert(out.end(), bytes, bytes + length);
+}
+
+void appendVarint(std::vector<u8>& out, u64 value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<u8>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<u8>(value));
+}
+
+bool readVarint(const u8*& p, const u8* end, u64& value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        u8 b = *p++;
+        value |= static_cast<u64>(b & 0x7F) << shift;
+        if ((b & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Ref lists are stored as zigzag(id - previous - 1): a run of consecutive
+// chunk ids becomes a run of zero bytes, which LZ reduces to almost nothing
+void encodeRefs(const std::vector<u32>& refs, std::vector<u8>& out) {
+    i64 previous = -1;
+    for (u32 id : refs) {
+        i64 delta = static_cast<i64>(id) - previous - 1;
+        appendVarint(out, (static_cast<u64>(delta) << 1) ^ static_cast<u64>(delta >> 63));
+        previous = id;
+    }
+}
+
+bool fileHeaderValid(const u8* data, size_t size, const char* magic) {
+    if (size < sizeof(HistoryFileHeader)) {
+        return false;
+    }
+    HistoryFileHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    return std::memcmp(header.magic, magic, sizeof(header.magic)) == 0 &&
+           header.version == HISTORY_FORMAT_VERSION &&
+           header.headerCrc == crcOfHeader(header);
+}
+
+bool fileExists(const std::string& path) {
+    std::ifstream file(path);
+    return file.good();
+}
+
+} // namespace
+
+VersionHistory::VersionHistory(const std::string& basePath)
+    : packPath_(basePath + ".hpk")
+    , indexPath_(basePath + ".hix")
+{
+    LOG_DEBUG(LogCategory::PERSISTENCE, "VersionHistory created: %s", basePath.c_str());
+}
+
+VersionHistory::~VersionHistory() {
+    LOG_TRACE(LogCategory::PERSISTENCE, "VersionHistory destroyed");
+}
+
+bool VersionHistory::open() {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    chunks_.clear();
+    chunkIds_.clear();
+    versions_.clear();
+    latestRefs_.clear();
+    open_ = false;
+
+    if (!loadPack() || !loadIndex()) {
+        return false;
+    }
+
+    open_ = true;
+    LOG_INFO(LogCategory::PERSISTENCE, "Version history: %zu versions, %zu chunks, %llu KB",
+             versions_.size(), chunks_.size(),
+             static_cast<unsigned long long>((packSize_ + indexSize_) / 1024));
+    return true;
+}
+
+bool VersionHistory::createFile(const std::string& path, const char* magic) {
+    HistoryFileHeader header{};
+    std::memcpy(header.magic, magic, sizeof(header.magic));
+    header.version = HISTORY_FORMAT_VERSION;
+    header.headerCrc = crcOfHeader(header);
+
+    std::vector<u8> image;
+    appendBytes(image, &header, sizeof(header));
+    if (!IoEngine::get().writeFileAtomically(path, std::move(image), true).get().ok) {
+        LOG_ERROR(LogCategory::PERSISTENCE, "Failed to create %s", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+void VersionHistory::truncateFile(const std::string& path, u64 size) {
+    std::error_code error;
+    std::filesystem::resize_file(path, size, error);
+    if (error) {
+        LOG_ERROR(LogCategory::PERSISTENCE, "Failed to truncate %s: %s", path.c_str(), error.message().c_str());
+    }
+}
+
+bool VersionHistory::loadPack() {
+    if (!fileExists(packPath_)) {
+        packSize_ = sizeof(HistoryFileHeader);
+        return createFile(packPath_, HISTORY_PACK_MAGIC);
+    }
+
+    MappedFile file;
+    if (!file.open(packPath_) || !fileHeaderValid(file.data(), file.size(), HISTORY_PACK_MAGIC)) {
+        LOG_ERROR(LogCategory::PERSISTENCE, "History pack is unreadable: %s", packPath_.c_str());
+        return false;
+    }
+
+    const u8* data = file.data();
+    const size_t size = file.size();
+    size_t pos = sizeof(HistoryFileHeader);
+
+    while (pos < size) {
+        HistoryChunkHeader header;
+        if (size - pos < sizeof(header)) {
+            break;
+        }
+        std::memcpy(&header, data + pos, sizeof(header));
+        if (header.magic != HISTORY_CHUNK_MAGIC || header.storedSize > size - pos - sizeof(header) ||
+            crc32c(data + pos + sizeof(header), header.storedSize, crcOfHeader(header)) != header.crc) {
+            break;
+        }
+
+        u32 id = static_cast<u32>(chunks_.size());
+        chunks_.push_back({pos + sizeof(header), header.rawSize, header.storedSize, header.flags, header.rawCrc});
+        chunkIds_.emplace(header.hash, id);
+        pos += sizeof(header) + header.storedSize;
+    }
+
+    packSize_ = pos;
+    if (pos < size) {
+        LOG_WARN(LogCategory::PERSISTENCE, "History pack has a torn tail at offset %zu, truncating", pos);
+        file.close();
+        truncateFile(packPath_, pos);
+    }
+    return true;
+}
+
+bool VersionHistory::loadIndex() {
+    if (!fileExists(indexPath_)) {
+        indexSize_ = sizeof(HistoryFileHeader);
+        return createFile(indexPath_, HISTORY_INDEX_MAGIC);
+    }
+
+    MappedFile file;
+    if (!file.open(indexPath_) || !fileHeaderValid(file.data(), file.size(), HISTORY_INDEX_MAGIC)) {
+        LOG_ERROR(LogCategory::PERSISTENCE, "History index is unreadable: %s", indexPath_.c_str());
+        return false;
+    }
+
+    const u8* data = file.data();
+    const size_t size = file.size();
+    size_t pos = sizeof(HistoryFileHeader);
+    std::vector<u32> refs;
+
+    while (pos < size) {
+        if (!decodeRefs(data + pos, size - pos, refs)) {
+            break;
+        }
+
+        HistoryVersionHeader header;
+        std::memcpy(&header, data + pos, sizeof(header));
+        versions_.push_back({{header.timestamp, header.contentLength, header.chunkCount}, pos});
+        latestRefs_.swap(refs);
+        pos += sizeof(header) + header.refsStoredSize;
+    }
+
+    indexSize_ = pos;
+    if (pos < size) {
+        LOG_WARN(LogCategory::PERSISTENCE, "History index has a torn tail at offset %zu, truncating", pos);
+        file.close();
+        truncateFile(indexPath_, pos);
+    }
+    return true;
+}
+
+bool VersionHistory::decodeRefs(const u8* record, size_t available, std::vector<u32>& refs) const {
+    HistoryVersionHeader header;
+    if (available < sizeof(header)) {
+        return false;
+    }
+    std::memcpy(&header, record, sizeof(header));
+
+    const u8* stored = record + sizeof(header);
+    if (header.magic != HISTORY_VERSION_MAGIC || header.refsStoredSize > available - sizeof(header) ||
+        crc32c(stored, header.refsStoredSize, crcOfHeader(header)) != header.crc) {
+        return false;
+    }
+
+    std::vector<u8> encoded;
+    const u8* p = stored;
+    const u8* end = stored + header.refsStoredSize;
+    if (header.flags & HISTORY_COMPRESSED) {
+        // Each ref encodes to at most 5 bytes
+        if (header.refsRawSize > static_cast<u64>(header.chunkCount) * 5) {
+            return false;
+        }
+        encoded.resize(header.refsRawSize);
+        if (!lzDecompress(stored, header.refsStoredSize, encoded.data(), encoded.size())) {
+            return false;
+        }
+        p = encoded.data();
+        end = p + encoded.size();
+    }
+
+    refs.clear();
+    refs.reserve(header.chunkCount);
+    i64 previous = -1;
+    u64 length = 0;
+    for (u32 i = 0; i < header.chunkCount; i++) {
+        u64 zigzag;
+        if (!readVarint(p, end, zigzag)) {
+            return false;
+        }
+        i64 delta = static_cast<i64>(zigzag >> 1) ^ -static_cast<i64>(zigzag & 1);
+        i64 id = previous + 1 + delta;
+        if (id < 0 || static_cast<u64>(id) >= chunks_.size()) {
+            return false;
+        }
+        refs.push_back(static_cast<u32>(id));
+        length += chunks_[static_cast<size_t>(id)].rawSize;
+        previous = id;
+    }
+
+    return p == end && length == header.contentLength;
+}
+
+bool VersionHistory::findChunk(u64 hash, u32 rawSize, u32 rawCrc, u32& id) const {
+    auto range = chunkIds_.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        const ChunkLocation& chunk = chunks_[it->second];
+        if (chunk.rawSize == rawSize && chunk.rawCrc == rawCrc) {
+            id = it->second;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool VersionHistory::commit(const std::string& text, u64 timestamp) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (!open_) {
+        return false;
+    }
+
+    const u8* data = reinterpret_cast<const u8*>(text.data());
+    const size_t size = text.size();
+
+    std::vector<u32> refs;
+    std::vector<u8> packAppend;
+    std::vector<ChunkLocation> newChunks;
+    std::vector<std::pair<u64, u32>> newIds;
+
+    LzCompressor compressor;
+    std::vector<u8> compressed(CDC_MAX_CHUNK);
+
+    size_t pos = 0;
+    while (pos < size) {
+        size_t length = findChunkBoundary(data + pos, size - pos);
+        const u8* chunk = data + pos;
+        pos += length;
+
+        u64 hash = hash64(chunk, length);
+        u32 rawCrc = crc32c(chunk, length);
+
+        u32 id;
+        if (findChunk(hash, static_cast<u32>(length), rawCrc, id)) {
+            refs.push_back(id);
+            continue;
+        }
+
+        // Also dedup against chunks created earlier in this same commit
+        bool repeated = false;
+        for (const auto& entry : newIds) {
+            const ChunkLocation& pending = newChunks[entry.second - chunks_.size()];
+            if (entry.first == hash && pending.rawSize == length && pending.rawCrc == rawCrc) {
+                refs.push_back(entry.second);
+                repeated = true;
+                break;
+            }
+        }
+        if (repeated) {
+            continue;
+        }
+
+        size_t storedSize = compressor.compress(chunk, length, compressed.data(), length - 1);
+        bool isCompressed = storedSize > 0;
+        const u8* payload = isCompressed ? compressed.data() : chunk;
+        if (!isCompressed) {
+            storedSize = length;
+        }
+
+        HistoryChunkHeader header{};
+        header.magic = HISTORY_CHUNK_MAGIC;
+        header.flags = isCompressed ? HISTORY_COMPRESSED : 0;
+        header.rawSize = static_cast<u32>(length);
+        header.storedSize = static_cast<u32>(storedSize);
+        header.hash = hash;
+        header.rawCrc = rawCrc;
+        header.crc = crc32c(payload, storedSize, crcOfHeader(header));
+
+        u64 payloadOffset = packSize_ + packAppend.size() + sizeof(header);
+        appendBytes(packAppend, &header, sizeof(header));
+        appendBytes(packAppend, payload, storedSize);
+
+        id = static_cast<u32>(chunks_.size() + newChunks.size());
+        newChunks.push_back({payloadOffset, header.rawSize, header.storedSize, header.flags, rawCrc});
+        newIds.emplace_back(hash, id);
+        refs.push_back(id);
+    }
+
+    if (!versions_.empty() && refs == latestRefs_) {
+        LOG_TRACE(LogCategory::PERSISTENCE, "History: content unchanged, no new version");
+        return true;
+    }
+
+    // The chunks must be durable before a version can point at them
+    if (!packAppend.empty()) {
+        size_t appendSize = packAppend.size();
+        if (!IoEngine::get().appendFile(packPath_, std::move(packAppend), true).get().ok) {
+            LOG_ERROR(LogCategory::PERSISTENCE, "Failed to append to history pack");
+            truncateFile(packPath_, packSize_);
+            return false;
+        }
+        packSize_ += appendSize;
+        for (const ChunkLocation& chunk : newChunks) {
+            chunks_.push_back(chunk);
+        }
+        for (const auto& entry : newIds) {
+            chunkIds_.emplace(entry.first, entry.second);
+        }
+    }
+
+    std::vector<u8> encoded;
+    encodeRefs(refs, encoded);
+
+    std::vector<u8> packedRefs(encoded.size());
+    size_t packedSize = encoded.size() > 1
+        ? compressor.compress(encoded.data(), encoded.size(), packedRefs.data(), encoded.size() - 1)
+        : 0;
+
+    HistoryVersionHeader header{};
+    header.magic = HISTORY_VERSION_MAGIC;
+    header.flags = packedSize > 0 ? HISTORY_COMPRESSED : 0;
+    header.timestamp = timestamp;
+    header.contentLength = size;
+    header.chunkCount = static_cast<u32>(refs.size());
+    header.refsRawSize = static_cast<u32>(encoded.size());
+    header.refsStoredSize = static_cast<u32>(packedSize > 0 ? packedSize : encoded.size());
+    const u8* stored = packedSize > 0 ? packedRefs.data() : encoded.data();
+    header.crc = crc32c(stored, header.refsStoredSize, crcOfHeader(header));
+
+    std::vector<u8> record;
+    appendBytes(record, &header, sizeof(header));
+    appendBytes(record, stored, header.refsStoredSize);
+
+    size_t recordSize = record.size();
+    if (!IoEngine::get().appendFile(indexPath_, std::move(record), true).get().ok) {
+        LOG_ERROR(LogCategory::PERSISTENCE, "Failed to append to history index");
+        truncateFile(indexPath_, indexSize_);
+        return false;
+    }
+
+    versions_.push_back({{timestamp, size, header.chunkCount}, indexSize_});
+    indexSize_ += recordSize;
+    latestRefs_.swap(refs);
+
+    LOG_DEBUG(LogCategory::PERSISTENCE, "History version %zu: %zu bytes, %u chunks (%zu new)",
+              versions_.size(), size, header.chunkCount, newChunks.size());
+    return true;
+}
+
+size_t VersionHistory::getVersionCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return versions_.size();
+}
+
+HistoryVersion VersionHistory::getVersion(size_t index) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return index < versions_.size() ? versions_[index].info : HistoryVersion{};
+}
+
+bool VersionHistory::restore(size_t index, std::string& text) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (index >= versions_.size()) {
+        return false;
+    }
+
+    std::vector<u32> refs;
+    {
+        MappedFile indexFile;
+        if (!indexFile.open(indexPath_) || versions_[index].recordOffset >= indexFile.size()) {
+            return false;
+        }
+        u64 offset = versions_[index].recordOffset;
+        if (!decodeRefs(indexFile.data() + offset, indexFile.size() - offset, refs)) {
+            LOG_ERROR(LogCategory::PERSISTENCE, "History version %zu is damaged", index);
+            return false;
+        }
+    }
+
+    // Where each ref lands in the document
+    std::vector<u64> documentOffsets(refs.size());
+    u64 length = 0;
+    for (size_t i = 0; i < refs.size(); i++) {
+        documentOffsets[i] = length;
+        length += chunks_[refs[i]].rawSize;
+    }
+
+    // Visit refs in pack order so the pack is read front to back
+    std::vector<size_t> order(refs.size());
+    std::iota(order.begin(), order.end(), size_t(0));
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return refs[a] < refs[b]; });
+
+    MappedFile pack;
+    if (!pack.open(packPath_)) {
+        return false;
+    }
+
+    text.assign(static_cast<size_t>(length), '\0');
+    u8* out = reinterpret_cast<u8*>(&text[0]);
+
+    for (size_t i : order) {
+        const ChunkLocation& chunk = chunks_[refs[i]];
+        if (chunk.payloadOffset + chunk.storedSize > pack.size()) {
+            return false;
+        }
+
+        const u8* payload = pack.data() + chunk.payloadOffset;
+        u8* dest = out + documentOffsets[i];
+        if (chunk.flags & HISTORY_COMPRESSED) {
+            if (!lzDecompress(payload, chunk.storedSize, dest, chunk.rawSize)) {
+                LOG_ERROR(LogCategory::PERSISTENCE, "History chunk %u failed to decompress", refs[i]);
+                return false;
+            }
+        } else {
+            std::memcpy(dest, payload, chunk.rawSize);
+        }
+
+        if (crc32c(dest, chunk.rawSize) != chunk.rawCrc) {
+            LOG_ERROR(LogCategory::PERSISTENCE, "History chunk %u checksum mismatch", refs[i]);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+HistoryStats VersionHistory::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    HistoryStats stats;
+    stats.packBytes = packSize_;
+    stats.indexBytes = indexSize_;
+    stats.uniqueChunks = chunks_.size();
+    stats.versions = versions_.size();
+    return stats;
+}
+
+} // namespace phantom
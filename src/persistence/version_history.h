@@ -0,0 +1,147 @@
+#ifndef PHANTOM_VERSION_HISTORY_H
+#define PHANTOM_VERSION_HISTORY_H
+
+#include <phantom_writer/types.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+
+namespace phantom {
+
+// Local version history: content-defined chunks stored once, versions as
+// lists of chunk references.
+//
+// Pack file (.filename.hpk), append-only:
+//   HistoryFileHeader                         16 bytes
+//   { HistoryChunkHeader, payload } * N       payload LZ-compressed when it helps
+//
+// Index file (.filename.hix), append-only:
+//   HistoryFileHeader                         16 bytes
+//   { HistoryVersionHeader, refs } * M
+//
+// refs is the version's chunk id list, delta + varint encoded and then
+// LZ-compressed. Consecutive versions mostly reference runs of consecutive
+// chunk ids, so a version of a 5 MB document costs about 1 KB of index plus
+// the chunks its edits created. Each edit rewrites the whole (8 KB average)
+// chunk around it: in persistence_bench, 1000 versions of a 5 MB document
+// with three scattered edits each take about 19 MB, 3.8 times the document.
+//
+// A crash can only leave a torn record at the end of either file; open()
+// cuts it off. A version is appended only after its chunks are durable.
+
+constexpr char HISTORY_PACK_MAGIC[8] = {'P', 'H', 'H', 'P', 'A', 'C', 'K', '1'};
+constexpr char HISTORY_INDEX_MAGIC[8] = {'P', 'H', 'H', 'I', 'D', 'X', '0', '1'};
+constexpr u32 HISTORY_CHUNK_MAGIC = 0x4B484350;   // "PCHK"
+constexpr u32 HISTORY_VERSION_MAGIC = 0x52455650; // "PVER"
+constexpr u32 HISTORY_FORMAT_VERSION = 1;
+
+// HistoryChunkHeader::flags / HistoryVersionHeader::flags
+constexpr u32 HISTORY_COMPRESSED = 1u << 0;
+
+struct HistoryFileHeader {
+    char magic[8];
+    u32 version;
+    u32 headerCrc;
+};
+
+struct HistoryChunkHeader {
+    u32 magic;
+    u32 flags;
+    u32 rawSize;
+    u32 storedSize;
+    u64 hash;            // hash64 of the raw chunk
+    u32 rawCrc;          // CRC32C of the raw chunk (second half of the dedup key)
+    u32 crc;             // CRC32C of preceding header bytes + stored payload
+};
+
+struct HistoryVersionHeader {
+    u32 magic;
+    u32 flags;
+    u64 timestamp;
+    u64 contentLength;
+    u32 chunkCount;
+    u32 refsRawSize;     // Encoded ref list size before compression
+    u32 refsStoredSize;  // Bytes following this header
+    u32 crc;             // CRC32C of preceding header bytes + refs
+};
+
+static_assert(sizeof(HistoryFileHeader) == 16, "HistoryFileHeader layout changed");
+static_assert(sizeof(HistoryChunkHeader) == 32, "HistoryChunkHeader layout changed");
+static_assert(sizeof(HistoryVersionHeader) == 40, "HistoryVersionHeader layout changed");
+
+struct HistoryVersion {
+    u64 timestamp;
+    u64 contentLength;
+    u32 chunkCount;
+};
+
+struct HistoryStats {
+    u64 packBytes = 0;
+    u64 indexBytes = 0;
+    size_t uniqueChunks = 0;
+    size_t versions = 0;
+};
+
+class VersionHistory {
+public:
+    // basePath without extension, e.g. ".novel.txt"
+    explicit VersionHistory(const std::string& basePath);
+    ~VersionHistory();
+
+    // Load (or create) the pack and index, truncating torn tails
+    bool open();
+
+    // Store text as a new version. Returns true without writing anything
+    // when text is identical to the latest version.
+    bool commit(const std::string& text, u64 timestamp);
+
+    size_t getVersionCount() const;
+    HistoryVersion getVersion(size_t index) const;
+
+    // Rebuild a version. Chunks are read in pack order, so this is one
+    // forward pass over the pack file.
+    bool restore(size_t index, std::string& text) const;
+
+    HistoryStats getStats() const;
+
+    const std::string& getPackFilePath() const { return packPath_; }
+    const std::string& getIndexFilePath() const { return indexPath_; }
+
+private:
+    struct ChunkLocation {
+        u64 payloadOffset;
+        u32 rawSize;
+        u32 storedSize;
+        u32 flags;
+        u32 rawCrc;
+    };
+
+    struct VersionEntry {
+        HistoryVersion info;
+        u64 recordOffset;    // Offset of the HistoryVersionHeader in the index
+    };
+
+    bool loadPack();
+    bool loadIndex();
+    bool createFile(const std::string& path, const char* magic);
+    void truncateFile(const std::string& path, u64 size);
+    bool decodeRefs(const u8* record, size_t available, std::vector<u32>& refs) const;
+    bool findChunk(u64 hash, u32 rawSize, u32 rawCrc, u32& id) const;
+
+    std::string packPath_;
+    std::string indexPath_;
+
+    mutable std::mutex mutex_;
+    std::vector<ChunkLocation> chunks_;
+    std::unordered_multimap<u64, u32> chunkIds_;   // hash64 -> chunk id
+    std::vector<VersionEntry> versions_;
+    std::vector<u32> latestRefs_;
+    u64 packSize_ = 0;
+    u64 indexSize_ = 0;
+    bool open_ = false;
+};
+
+} // namespace phantom
+
+#endif // PHANTOM_VERSION_HISTORY_H
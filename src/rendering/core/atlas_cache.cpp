@@ -0,0 +1,173 @@
+#include "atlas_cache.h"
+#include "utils/crc32c.h"
+#include "utils/hash.h"
+#include "utils/logger.h"
+#include "utils/mapped_file.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+#include <vector>
+
+namespace phantom {
+
+namespace {
+
+static_assert(std::is_trivially_copyable<Glyph>::value, "Glyph records are stored as raw bytes");
+static_assert(sizeof(KerningPair) == 12, "KerningPair records are stored as raw bytes");
+
+u32 crcOfHeader(const AtlasCacheHeader& header) {
+    return crc32c(&header, sizeof(header) - sizeof(u32));
+}
+
+bool matchesKey(const AtlasCacheHeader& header, const AtlasCacheKey& key) {
+    return header.fontHash == key.fontHash && header.charsetHash == key.charsetHash &&
+           header.fontSize == key.fontSize && header.format == key.format &&
+           header.sdfSpread == key.sdfSpread && header.padding == key.padding;
+}
+
+} // namespace
+
+std::string atlasCachePath(const std::string& directory, const AtlasCacheKey& key) {
+    u64 name = hash64(&key.fontHash, sizeof(key.fontHash), ATLAS_RASTERIZER_VERSION);
+    name = hash64(&key.charsetHash, sizeof(key.charsetHash), name);
+    name = hash64(&key.fontSize, sizeof(key.fontSize), name);
+    name = hash64(&key.format, sizeof(key.format), name);
+    name = hash64(&key.sdfSpread, sizeof(key.sdfSpread), name);
+    name = hash64(&key.padding, sizeof(key.padding), name);
+
+    char file[40];
+    std::snprintf(file, sizeof(file), "atlas-%016llx.bin", static_cast<unsigned long long>(name));
+    return directory + "/" + file;
+}
+
+bool loadAtlasCache(const std::string& path, const AtlasCacheKey& key, FontAtlas& atlas) {
+    MappedFile file;
+    if (!file.open(path)) {
+        return false;
+    }
+    if (file.size() < sizeof(AtlasCacheHeader) || std::memcmp(file.data(), ATLAS_CACHE_MAGIC, sizeof(ATLAS_CACHE_MAGIC)) != 0) {
+        LOG_WARN(LogCategory::RENDER, "Atlas cache %s is not an atlas cache", path.c_str());
+        return false;
+    }
+
+    AtlasCacheHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (crcOfHeader(header) != header.headerCrc) {
+        LOG_WARN(LogCategory::RENDER, "Atlas cache %s header checksum mismatch", path.c_str());
+        return false;
+    }
+    if (header.version != ATLAS_CACHE_VERSION || header.rasterizerVersion != ATLAS_RASTERIZER_VERSION || !matchesKey(header, key)) {
+        LOG_DEBUG(LogCategory::RENDER, "Atlas cache %s is stale", path.c_str());
+        return false;
+    }
+
+    if (header.width <= 0 || header.height <= 0) {
+        LOG_WARN(LogCategory::RENDER, "Atlas cache %s describes an impossible layout", path.c_str());
+        return false;
+    }
+    size_t glyphBytes = static_cast<size_t>(header.glyphCount) * sizeof(Glyph);
+    size_t bitmapBytes = static_cast<size_t>(header.width) * header.height;
+    size_t kernBytes = static_cast<size_t>(header.kernPairCount) * sizeof(KerningPair);
+    if (file.size() - sizeof(header) != glyphBytes + bitmapBytes + kernBytes) {
+        LOG_WARN(LogCategory::RENDER, "Atlas cache %s has the wrong size", path.c_str());
+        return false;
+    }
+
+    const u8* payload = file.data() + sizeof(header);
+    if (crc32c(payload, glyphBytes + bitmapBytes + kernBytes) != header.payloadCrc) {
+        LOG_WARN(LogCategory::RENDER, "Atlas cache %s payload checksum mismatch", path.c_str());
+        return false;
+    }
+
+    // A matching checksum only proves the file is what was written; every
+    // rectangle must still lie inside the bitmap before anything copies from it
+    std::vector<Glyph> glyphs(header.glyphCount);
+    if (glyphBytes > 0) {
+        std::memcpy(glyphs.data(), payload, glyphBytes);
+    }
+    for (const Glyph& glyph : glyphs) {
+        if (glyph.width < 0 || glyph.height < 0 || glyph.atlasX < 0 || glyph.atlasY < 0 ||
+            static_cast<i64>(glyph.atlasX) + glyph.width > header.width ||
+            static_cast<i64>(glyph.atlasY) + glyph.height > header.height) {
+            LOG_WARN(LogCategory::RENDER, "Atlas cache %s has glyph U+%04X outside the atlas", path.c_str(), glyph.codepoint);
+            return false;
+        }
+    }
+
+    atlas.width = header.width;
+    atlas.height = header.height;
+    atlas.fontSize = header.fontSize;
+    atlas.lineHeight = header.lineHeight;
+    atlas.glyphs.clear();
+    atlas.index.clear();
+    atlas.glyphs.reserve(header.glyphCount);
+    for (const Glyph& glyph : glyphs) {
+        atlas.addGlyph(glyph);
+    }
+    atlas.bitmap.assign(payload + glyphBytes, payload + glyphBytes + bitmapBytes);
+
+    atlas.kerning.clear();
+    const u8* kern = payload + glyphBytes + bitmapBytes;
+    for (u32 i = 0; i < header.kernPairCount; i++) {
+        KerningPair pair;
+        std::memcpy(&pair, kern + static_cast<size_t>(i) * sizeof(KerningPair), sizeof(KerningPair));
+        atlas.kerning.set(pair.left, pair.right, pair.adjust);
+    }
+
+    LOG_DEBUG(LogCategory::RENDER, "Atlas cache hit: %s (%u glyphs)", path.c_str(), header.glyphCount);
+    return true;
+}
+
+bool storeAtlasCache(const std::string& path, const AtlasCacheKey& key, const FontAtlas& atlas) {
+    AtlasCacheHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, ATLAS_CACHE_MAGIC, sizeof(header.magic));
+    header.version = ATLAS_CACHE_VERSION;
+    header.rasterizerVersion = ATLAS_RASTERIZER_VERSION;
+    header.fontHash = key.fontHash;
+    header.charsetHash = key.charsetHash;
+    header.fontSize = key.fontSize;
+    header.lineHeight = atlas.lineHeight;
+    header.format = key.format;
+    header.sdfSpread = key.sdfSpread;
+    header.padding = key.padding;
+    header.width = atlas.width;
+    header.height = atlas.height;
+    std::vector<KerningPair> kerning = atlas.kerning.pairs();
+    header.glyphCount = static_cast<u32>(atlas.glyphs.size());
+    header.kernPairCount = static_cast<u32>(kerning.size());
+    header.payloadCrc = crc32c(atlas.glyphs.data(), atlas.glyphs.size() * sizeof(Glyph));
+    header.payloadCrc = crc32c(atlas.bitmap.data(), atlas.bitmap.size(), header.payloadCrc);
+    header.payloadCrc = crc32c(kerning.data(), kerning.size() * sizeof(KerningPair), header.payloadCrc);
+    header.headerCrc = crcOfHeader(header);
+
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(atlas.glyphs.data()), atlas.glyphs.size() * sizeof(Glyph));
+        out.write(reinterpret_cast<const char*>(atlas.bitmap.data()), atlas.bitmap.size());
+        out.write(reinterpret_cast<const char*>(kerning.data()), kerning.size() * sizeof(KerningPair));
+        if (!out) {
+            LOG_WARN(LogCategory::RENDER, "Failed to write atlas cache %s", tempPath.c_str());
+            out.close();
+            std::remove(tempPath.c_str());
+            return false;
+        }
+    }
+
+    // Windows rename does not replace an existing file
+    if (std::rename(tempPath.c_str(), path.c_str()) != 0 &&
+        (std::remove(path.c_str()) != 0 || std::rename(tempPath.c_str(), path.c_str()) != 0)) {
+        LOG_WARN(LogCategory::RENDER, "Failed to replace atlas cache %s", path.c_str());
+        std::remove(tempPath.c_str());
+        return false;
+    }
+
+    LOG_DEBUG(LogCategory::RENDER, "Atlas cache written: %s (%zu glyphs)", path.c_str(), atlas.glyphs.size());
+    return true;
+}
+
+} // namespace phantom
@@ -0,0 +1,74 @@
+#ifndef PHANTOM_ATLAS_CACHE_H
+#define PHANTOM_ATLAS_CACHE_H
+
+#include <phantom_writer/types.h>
+#include "font_loader.h"
+#include <string>
+
+namespace phantom {
+
+// On-disk copy of a finished FontAtlas, so a launch with an unchanged font
+// maps one file instead of rasterizing the charset again.
+//
+//   AtlasCacheHeader        80 bytes
+//   Glyph * glyphCount      sizeof(Glyph) each, in FontAtlas::glyphs order
+//   bitmap                  width * height bytes
+//   KerningPair * kernPairCount
+//
+// The header repeats the whole key, so a file whose name collides or
+// that was written by another build is simply treated as a miss. A CRC32C
+// over everything after the header catches torn or damaged files. The
+// file is only ever a cache: any problem means "rasterize again".
+
+constexpr char ATLAS_CACHE_MAGIC[8] = {'P', 'H', 'A', 'T', 'L', 'A', 'S', '1'};
+constexpr u32 ATLAS_CACHE_VERSION = 3;
+
+// Bump whenever FontLoader produces different pixels or metrics for the
+// same inputs (stb_truetype update, SDF parameters, packing changes)
+constexpr u32 ATLAS_RASTERIZER_VERSION = 1;
+
+// Everything the atlas pixels depend on
+struct AtlasCacheKey {
+    u64 fontHash = 0;       // hash64 of the font file
+    u64 charsetHash = 0;    // hash64 of the codepoint list
+    float fontSize = 0.0f;
+    u32 format = 0;         // GlyphFormat
+    i32 sdfSpread = 0;
+    i32 padding = 0;
+};
+
+struct AtlasCacheHeader {
+    char magic[8];
+    u32 version;
+    u32 rasterizerVersion;
+    u64 fontHash;
+    u64 charsetHash;
+    float fontSize;
+    float lineHeight;
+    u32 format;
+    i32 sdfSpread;
+    i32 padding;
+    i32 width;
+    i32 height;
+    u32 glyphCount;
+    u32 kernPairCount;
+    u32 reserved;
+    u32 payloadCrc;      // CRC32C of the glyph records, bitmap and kerning pairs
+    u32 headerCrc;       // CRC32C of all preceding header bytes
+};
+
+static_assert(sizeof(AtlasCacheHeader) == 80, "AtlasCacheHeader layout changed");
+
+// File for key inside directory (one file per font, size and settings)
+std::string atlasCachePath(const std::string& directory, const AtlasCacheKey& key);
+
+// Read the atlas stored at path with a single mapping. False if the file
+// is missing, damaged or was built from a different key.
+bool loadAtlasCache(const std::string& path, const AtlasCacheKey& key, FontAtlas& atlas);
+
+// Write atlas to path (temp file + rename, so readers never see half a file)
+bool storeAtlasCache(const std::string& path, const AtlasCacheKey& key, const FontAtlas& atlas);
+
+} // namespace phantom
+
+#endif // PHANTOM_ATLAS_CACHE_H
@@ -0,0 +1,172 @@
+#include "atlas_packer.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace phantom {
+
+SkylinePacker::SkylinePacker(int width, int height, int padding) {
+    reset(width, height, padding);
+}
+
+void SkylinePacker::reset(int width, int height, int padding) {
+    width_ = width;
+    height_ = height;
+    padding_ = padding;
+    usedArea_ = 0;
+
+    // The top and left margins are never handed out
+    skyline_.clear();
+    if (width > padding) {
+        skyline_.push_back({padding, padding, width - padding});
+    }
+}
+
+void SkylinePacker::grow(int width, int height) {
+    if (width > width_) {
+        if (!skyline_.empty() && skyline_.back().y == padding_) {
+            skyline_.back().width += width - width_;
+        } else {
+            skyline_.push_back({std::max(width_, padding_), padding_, width - std::max(width_, padding_)});
+        }
+        width_ = width;
+    }
+    height_ = std::max(height_, height);
+}
+
+int SkylinePacker::fitAt(size_t index, int w, int h) const {
+    int x = skyline_[index].x;
+    if (x + w + padding_ > width_) {
+        return -1;
+    }
+
+    // The rectangle rests on the highest node it spans
+    int y = 0;
+    int remaining = w + padding_;
+    for (size_t i = index; remaining > 0 && i < skyline_.size(); i++) {
+        y = std::max(y, skyline_[i].y);
+        remaining -= skyline_[i].width;
+    }
+
+    if (y + h + padding_ > height_) {
+        return -1;
+    }
+    return y;
+}
+
+bool SkylinePacker::insert(int width, int height, int& x, int& y) {
+    if (width < 0 || height < 0) {
+        return false;
+    }
+
+    size_t bestIndex = skyline_.size();
+    int bestTop = 0;
+    int bestY = 0;
+
+    for (size_t i = 0; i < skyline_.size(); i++) {
+        int fitY = fitAt(i, width, height);
+        if (fitY < 0) {
+            continue;
+        }
+        // Bottom-left: lowest top edge wins, then the leftmost spot
+        int top = fitY + height;
+        if (bestIndex == skyline_.size() || top < bestTop) {
+            bestIndex = i;
+            bestTop = top;
+            bestY = fitY;
+        }
+    }
+
+    if (bestIndex == skyline_.size()) {
+        return false;
+    }
+
+    x = skyline_[bestIndex].x;
+    y = bestY;
+    place(bestIndex, x, y, width, height);
+    usedArea_ += static_cast<u64>(width) * height;
+    return true;
+}
+
+void SkylinePacker::place(size_t index, int x, int y, int w, int h) {
+    Node node{x, y + h + padding_, w + padding_};
+    skyline_.insert(skyline_.begin() + index, node);
+
+    // Trim the nodes the new one now covers
+    int right = node.x + node.width;
+    for (size_t i = index + 1; i < skyline_.size();) {
+        Node& next = skyline_[i];
+        if (next.x >= right) {
+            break;
+        }
+        int overlap = right - next.x;
+        next.x += overlap;
+        next.width -= overlap;
+        if (next.width > 0) {
+            break;
+        }
+        skyline_.erase(skyline_.begin() + i);
+    }
+
+    // Merge neighbours at the same height
+    for (size_t i = 0; i + 1 < skyline_.size();) {
+        if (skyline_[i].y == skyline_[i + 1].y) {
+            skyline_[i].width += skyline_[i + 1].width;
+            skyline_.erase(skyline_.begin() + i + 1);
+        } else {
+            i++;
+        }
+    }
+}
+
+int SkylinePacker::getUsedHeight() const {
+    int used = padding_;
+    for (const Node& node : skyline_) {
+        used = std::max(used, node.y);
+    }
+    return used;
+}
+
+float SkylinePacker::getOccupancy() const {
+    u64 area = static_cast<u64>(width_) * height_;
+    return area ? static_cast<float>(usedArea_) / area : 0.0f;
+}
+
+int packSquare(SkylinePacker& packer, std::vector<PackRect>& rects, int padding, int alignment, int maxSide) {
+    // Tallest first: each skyline row then fills with rectangles of similar height
+    std::vector<size_t> order(rects.size());
+    u64 paddedArea = 0;
+    int widest = 0;
+    for (size_t i = 0; i < rects.size(); i++) {
+        order[i] = i;
+        paddedArea += static_cast<u64>(rects[i].width + padding) * (rects[i].height + padding);
+        widest = std::max(widest, rects[i].width);
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        if (rects[a].height != rects[b].height) {
+            return rects[a].height > rects[b].height;
+        }
+        return rects[a].width > rects[b].width;
+    });
+
+    // Start a little above the area bound; skyline packing rarely gets past 95%
+    int side = std::max(static_cast<int>(std::ceil(std::sqrt(paddedArea * 1.05))), widest + 2 * padding);
+    side = (side + alignment - 1) / alignment * alignment;
+
+    for (; side <= maxSide; side += alignment) {
+        packer.reset(side, side, padding);
+        bool packed = true;
+        for (size_t i : order) {
+            if (!packer.insert(rects[i].width, rects[i].height, rects[i].x, rects[i].y)) {
+                packed = false;
+                break;
+            }
+        }
+        if (packed) {
+            return side;
+        }
+    }
+    return 0;
+}
+
+} // namespace phantom
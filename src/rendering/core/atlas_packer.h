@@ -0,0 +1,80 @@
+#ifndef PHANTOM_ATLAS_PACKER_H
+#define PHANTOM_ATLAS_PACKER_H
+
+#include <phantom_writer/types.h>
+#include <vector>
+
+namespace phantom {
+
+// Skyline bin packer for glyph atlases (bottom-left heuristic).
+// The skyline is the upper outline of everything placed so far; a new
+// rectangle goes where its top edge ends lowest, which keeps rows of
+// similar glyphs tight without a separate shelf per height. Rectangles
+// can be added one at a time at any point, so an atlas can keep filling
+// up as new glyphs show up.
+//
+// Every rectangle keeps padding pixels of empty space to its left and
+// above it, and the last ones in a row or column keep the same margin to
+// the right and bottom edge, so bilinear sampling never bleeds between
+// neighbours.
+class SkylinePacker {
+public:
+    SkylinePacker() = default;
+    SkylinePacker(int width, int height, int padding);
+
+    // Start over with an empty area
+    void reset(int width, int height, int padding);
+
+    // Make the area larger without moving what is already placed
+    void grow(int width, int height);
+
+    // Place a width x height rectangle. Returns false if it does not fit.
+    bool insert(int width, int height, int& x, int& y);
+
+    int getWidth() const { return width_; }
+    int getHeight() const { return height_; }
+    int getPadding() const { return padding_; }
+
+    // Lowest row below which everything placed so far lies (includes the
+    // bottom margin)
+    int getUsedHeight() const;
+
+    // Pixels of placed rectangles, without padding
+    u64 getUsedArea() const { return usedArea_; }
+
+    // Share of the area covered by rectangles (0-1)
+    float getOccupancy() const;
+
+private:
+    struct Node {
+        int x;
+        int y;          // Height of the skyline over [x, x + width)
+        int width;
+    };
+
+    // y at which a w-wide rectangle would rest on node index, or -1 if it
+    // runs past the right or bottom edge
+    int fitAt(size_t index, int w, int h) const;
+    void place(size_t index, int x, int y, int w, int h);
+
+    std::vector<Node> skyline_;
+    int width_ = 0;
+    int height_ = 0;
+    int padding_ = 0;
+    u64 usedArea_ = 0;
+};
+
+struct PackRect {
+    int width, height;      // In
+    int x, y;               // Out
+};
+
+// Pack every rectangle (tallest first) into the smallest square whose side
+// is a multiple of alignment, trying sides up to maxSide. The packer keeps
+// the result, so more rectangles can be inserted later. Returns the side,
+// or 0 if even maxSide is too small.
+int packSquare(SkylinePacker& packer, std::vector<PackRect>& rects, int padding, int alignment, int maxSide);
+
+} // namespace phantom
+
+#endif // PHANTOM_ATLAS_PACKER_H
@@ -0,0 +1,42 @@
+#ifndef PHANTOM_EMBEDDED_FONT_H
+#define PHANTOM_EMBEDDED_FONT_H
+
+#include <phantom_writer/types.h>
+#include "font_loader.h"
+#include "kerning_table.h"
+
+namespace phantom {
+
+// A font compiled into the executable together with its finished atlas.
+//
+// phantom_font_baker (tools/) runs FontLoader on the host at build time and
+// writes the font file, atlas bitmap, glyph records and kerning pairs out
+// as constant arrays, so loading the embedded font needs no file I/O and
+// no rasterization. The font file itself is included as well, for glyphs
+// outside the baked charset.
+struct EmbeddedFont {
+    const char* name;               // Source file name
+    const u8* fontFile;
+    size_t fontFileSize;
+    float fontSize;                 // Pixel size the atlas was baked at
+    GlyphFormat format;
+    int sdfSpread;
+    int padding;
+    float lineHeight;
+    int atlasWidth;
+    int atlasHeight;
+    const u8* atlasBitmap;          // atlasWidth * atlasHeight bytes
+    const Glyph* glyphs;
+    size_t glyphCount;
+    const KerningPair* kerning;
+    size_t kerningCount;
+};
+
+// The default font baked into this build, or nullptr when the build has
+// none (PHANTOM_EMBED_DEFAULT_FONT off, or a cross build that cannot run
+// the baker). Defined by the phantom_embedded_font library.
+const EmbeddedFont* embeddedDefaultFont();
+
+} // namespace phantom
+
+#endif // PHANTOM_EMBEDDED_FONT_H
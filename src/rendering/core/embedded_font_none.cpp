@@ -0,0 +1,11 @@
+// phantom_embedded_font for builds without a baked default font
+
+#include "embedded_font.h"
+
+namespace phantom {
+
+const EmbeddedFont* embeddedDefaultFont() {
+    return nullptr;
+}
+
+} // namespace phantom
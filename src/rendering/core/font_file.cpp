@@ -0,0 +1,74 @@
+#include "font_file.h"
+#include "utils/hash.h"
+#include "utils/logger.h"
+
+#include <unordered_map>
+#include <utility>
+
+namespace phantom {
+
+namespace {
+
+// Open mappings by path. Entries expire with the last FontFile using them.
+std::mutex registryMutex;
+std::unordered_map<std::string, std::weak_ptr<const FontFile>> registry;
+
+} // namespace
+
+std::shared_ptr<const FontFile> FontFile::open(const std::string& path) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+
+    auto found = registry.find(path);
+    if (found != registry.end()) {
+        if (std::shared_ptr<const FontFile> shared = found->second.lock()) {
+            LOG_DEBUG(LogCategory::RENDER, "Font file shared: %s", path.c_str());
+            return shared;
+        }
+        registry.erase(found);
+    }
+
+    std::shared_ptr<FontFile> file(new FontFile());
+    if (!file->mapping_.open(path)) {
+        LOG_ERROR(LogCategory::RENDER, "Failed to map font file: %s", path.c_str());
+        return nullptr;
+    }
+    if (file->mapping_.size() == 0) {
+        LOG_ERROR(LogCategory::RENDER, "Font file is empty: %s", path.c_str());
+        return nullptr;
+    }
+    file->data_ = file->mapping_.data();
+    file->size_ = file->mapping_.size();
+    file->path_ = path;
+
+    registry[path] = file;
+    LOG_DEBUG(LogCategory::RENDER, "Font file mapped: %s (%zu bytes)", path.c_str(), file->size_);
+    return file;
+}
+
+std::shared_ptr<const FontFile> FontFile::fromMemory(std::vector<u8> data) {
+    if (data.empty()) {
+        return nullptr;
+    }
+    std::shared_ptr<FontFile> file(new FontFile());
+    file->owned_ = std::move(data);
+    file->data_ = file->owned_.data();
+    file->size_ = file->owned_.size();
+    return file;
+}
+
+std::shared_ptr<const FontFile> FontFile::fromStatic(const u8* data, size_t size) {
+    if (!data || size == 0) {
+        return nullptr;
+    }
+    std::shared_ptr<FontFile> file(new FontFile());
+    file->data_ = data;
+    file->size_ = size;
+    return file;
+}
+
+u64 FontFile::contentHash() const {
+    std::call_once(hashOnce_, [this]() { hash_ = hash64(data_, size_); });
+    return hash_;
+}
+
+} // namespace phantom
@@ -0,0 +1,59 @@
+#ifndef PHANTOM_FONT_FILE_H
+#define PHANTOM_FONT_FILE_H
+
+#include <phantom_writer/types.h>
+#include "utils/mapped_file.h"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace phantom {
+
+// Read-only contents of a font file, shared by every FontLoader that uses
+// the same face.
+//
+// Files are memory-mapped rather than read, so only the tables and glyph
+// outlines actually touched become resident, and opening the same path
+// again while a FontFile for it is alive returns that same mapping. A
+// 20 MB CJK fallback face loaded at three sizes therefore costs one
+// mapping, not three 20 MB copies.
+class FontFile {
+public:
+    // Map path, or share the mapping already open for it. nullptr if the
+    // file cannot be mapped or is empty.
+    static std::shared_ptr<const FontFile> open(const std::string& path);
+
+    // Wrap font contents already in memory (e.g. read by the IoEngine)
+    static std::shared_ptr<const FontFile> fromMemory(std::vector<u8> data);
+
+    // Refer to font contents that live as long as the process (a font
+    // compiled into the executable) without copying them
+    static std::shared_ptr<const FontFile> fromStatic(const u8* data, size_t size);
+
+    const u8* data() const { return data_; }
+    size_t size() const { return size_; }
+    const std::string& getPath() const { return path_; }
+
+    // hash64 of the contents, computed on first use
+    u64 contentHash() const;
+
+    FontFile(const FontFile&) = delete;
+    FontFile& operator=(const FontFile&) = delete;
+
+private:
+    FontFile() = default;
+
+    MappedFile mapping_;
+    std::vector<u8> owned_;
+    const u8* data_ = nullptr;
+    size_t size_ = 0;
+    std::string path_;          // Empty unless opened from a file
+
+    mutable std::once_flag hashOnce_;
+    mutable u64 hash_ = 0;
+};
+
+} // namespace phantom
+
+#endif // PHANTOM_FONT_FILE_H
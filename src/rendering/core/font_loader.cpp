@@ -1,16 +1,29 @@
 #include "font_loader.h"
+#include "atlas_cache.h"
+#include "embedded_font.h"
+#include "utils/hash.h"
 #include "utils/logger.h"
 
 #define STB_TRUETYPE_IMPLEMENTATION
 #include <stb_truetype.h>
 
-#include <fstream>
+#include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <cstring>
+#include <thread>
+#include <unordered_map>
+#include <utility>
 
 namespace phantom {
 
 FontLoader::FontLoader() {
     LOG_TRACE(LogCategory::RENDER, "FontLoader constructor");
+
+    // Printable ASCII
+    for (u32 codepoint = 32; codepoint <= 126; codepoint++) {
+        charset_.push_back(codepoint);
+    }
 }
 
 FontLoader::~FontLoader() {
@@ -20,182 +33,457 @@ FontLoader::~FontLoader() {
 bool FontLoader::loadFromFile(const std::string& fontPath, float fontSize) {
     LOG_INFO(LogCategory::RENDER, "Loading font: %s (size: %.1f)", fontPath.c_str(), fontSize);
 
-    // Read font file
-    std::ifstream file(fontPath, std::ios::binary | std::ios::ate);
-    if (!file.is_open()) {
+    std::shared_ptr<const FontFile> file = FontFile::open(fontPath);
+    if (!file) {
         LOG_ERROR(LogCategory::RENDER, "Failed to open font file: %s", fontPath.c_str());
         return false;
     }
+    return load(std::move(file), fontSize);
+}
+
+bool FontLoader::loadFromMemory(std::vector<u8> fontData, float fontSize) {
+    std::shared_ptr<const FontFile> file = FontFile::fromMemory(std::move(fontData));
+    if (!file) {
+        LOG_ERROR(LogCategory::RENDER, "Font data is empty");
+        return false;
+    }
+    return load(std::move(file), fontSize);
+}
 
-    std::streamsize fileSize = file.tellg();
-    file.seekg(0, std::ios::beg);
+bool FontLoader::load(std::shared_ptr<const FontFile> file, float fontSize) {
+    if (!file) {
+        return false;
+    }
+    fontFile_ = std::move(file);
+    LOG_DEBUG(LogCategory::RENDER, "Font file: %zu bytes", fontFile_->size());
 
-    fontFileData_.resize(fileSize);
-    if (!file.read(reinterpret_cast<char*>(fontFileData_.data()), fileSize)) {
-        LOG_ERROR(LogCategory::RENDER, "Failed to read font file: %s", fontPath.c_str());
+    if (!initFont(fontSize)) {
         return false;
     }
 
-    file.close();
-    LOG_DEBUG(LogCategory::RENDER, "Font file loaded: %zu bytes", fontFileData_.size());
+    // A cached atlas for this exact font and settings skips rasterization;
+    // the font stays loaded for glyphs added later
+    std::string cachePath;
+    AtlasCacheKey cacheKey;
+    if (!cacheDirectory_.empty()) {
+        cacheKey = atlasCacheKey(fontSize);
+        cachePath = atlasCachePath(cacheDirectory_, cacheKey);
+        if (loadCachedAtlas(cachePath, cacheKey)) {
+            LOG_INFO(LogCategory::RENDER, "Font loaded from atlas cache: %zu glyphs, atlas %dx%d",
+                atlas_.glyphs.size(), atlas_.width, atlas_.height);
+            return true;
+        }
+    }
 
     // Generate atlas
-    if (!generateAtlas(fontSize)) {
+    if (!generateAtlas()) {
         LOG_ERROR(LogCategory::RENDER, "Failed to generate font atlas");
         return false;
     }
 
+    if (!cachePath.empty()) {
+        storeAtlasCache(cachePath, cacheKey, atlas_);
+    }
+
     LOG_INFO(LogCategory::RENDER, "Font loaded successfully: %zu glyphs, atlas %dx%d",
         atlas_.glyphs.size(), atlas_.width, atlas_.height);
 
     return true;
 }
 
-bool FontLoader::generateAtlas(float fontSize) {
-    LOG_DEBUG(LogCategory::RENDER, "Generating font atlas (size: %.1f)", fontSize);
+bool FontLoader::loadEmbedded(const EmbeddedFont& font) {
+    LOG_INFO(LogCategory::RENDER, "Loading embedded font: %s (size: %.1f)", font.name, font.fontSize);
 
-    stbtt_fontinfo font;
-    if (!stbtt_InitFont(&font, fontFileData_.data(), 0)) {
-        LOG_ERROR(LogCategory::RENDER, "Failed to initialize font");
+    fontFile_ = FontFile::fromStatic(font.fontFile, font.fontFileSize);
+    if (!fontFile_) {
+        return false;
+    }
+    format_ = font.format;
+    sdfSpread_ = font.sdfSpread;
+    padding_ = font.padding;
+    if (!initFont(font.fontSize)) {
         return false;
     }
 
-    // Calculate scale for desired font size
-    float scale = stbtt_ScaleForPixelHeight(&font, fontSize);
+    atlas_.lineHeight = font.lineHeight;
+    atlas_.width = font.atlasWidth;
+    atlas_.height = font.atlasHeight;
+    atlas_.bitmap.assign(font.atlasBitmap, font.atlasBitmap + static_cast<size_t>(font.atlasWidth) * font.atlasHeight);
+    atlas_.glyphs.clear();
+    atlas_.index.clear();
+    charset_.clear();
+    for (size_t i = 0; i < font.glyphCount; i++) {
+        atlas_.addGlyph(font.glyphs[i]);
+        charset_.push_back(font.glyphs[i].codepoint);
+    }
+    atlas_.kerning.clear();
+    for (size_t i = 0; i < font.kerningCount; i++) {
+        atlas_.kerning.set(font.kerning[i].left, font.kerning[i].right, font.kerning[i].adjust);
+    }
+    reservePackedArea();
 
-    // Get font metrics
-    int ascent, descent, lineGap;
-    stbtt_GetFontVMetrics(&font, &ascent, &descent, &lineGap);
+    LOG_INFO(LogCategory::RENDER, "Embedded font loaded: %zu glyphs, atlas %dx%d",
+        atlas_.glyphs.size(), atlas_.width, atlas_.height);
+    return true;
+}
 
-    atlas_.fontSize = fontSize;
-    atlas_.lineHeight = (ascent - descent + lineGap) * scale;
+void FontAtlas::addGlyph(const Glyph& glyph) {
+    u32 slot = index.find(glyph.codepoint);
+    if (slot != GlyphIndex::NONE) {
+        glyphs[slot] = glyph;
+        return;
+    }
+    index.insert(glyph.codepoint, static_cast<u32>(glyphs.size()));
+    glyphs.push_back(glyph);
+}
 
-    LOG_DEBUG(LogCategory::RENDER, "Font scale: %.4f, line height: %.2f", scale, atlas_.lineHeight);
+namespace {
 
-    // We'll pack ASCII printable characters (32-126) = 95 characters
-    const int firstChar = 32;
-    const int lastChar = 126;
-    const int numChars = lastChar - firstChar + 1;
+constexpr int ATLAS_ALIGNMENT = 16;     // Atlas side steps
+constexpr int MAX_ATLAS_SIZE = 8192;
+constexpr u8 SDF_EDGE = 128;            // Distance field value on the outline
 
-    // First pass: calculate atlas size
-    int totalWidth = 0;
-    int maxHeight = 0;
+// Glyph pixels per rasterizing thread, below which threads are not worth
+// starting. Distance fields cost far more per pixel than coverage.
+constexpr u64 PARALLEL_COVERAGE_PIXELS = 256 * 1024;
+constexpr u64 PARALLEL_SDF_PIXELS = 16 * 1024;
+constexpr size_t RASTER_BATCH = 4;      // Glyphs a worker claims at a time
 
-    std::vector<int> widths(numChars);
-    std::vector<int> heights(numChars);
+// GPOS kerning can only be queried pair by pair; past this many glyphs the
+// charset (e.g. CJK, which has no kerning anyway) is not worth squaring
+constexpr size_t MAX_PAIRWISE_KERNING_GLYPHS = 512;
 
-    for (int i = 0; i < numChars; i++) {
-        int codepoint = firstChar + i;
-        int width, height, xOffset, yOffset;
+int roundUp(int value, int multiple) {
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+} // namespace
 
-        stbtt_GetCodepointBitmapBox(&font, codepoint, scale, scale,
-            &xOffset, &yOffset, &width, &height);
+int FontLoader::findGlyphIndex(u32 codepoint) const {
+    return font_ ? stbtt_FindGlyphIndex(font_.get(), static_cast<int>(codepoint)) : 0;
+}
 
-        width = width - xOffset;
-        height = height - yOffset;
+bool FontLoader::getGlyphMetrics(u32 codepoint, GlyphMetrics& metrics) const {
+    int glyphIndex = findGlyphIndex(codepoint);
+    if (glyphIndex == 0) {
+        return false;
+    }
+    measureGlyph(glyphIndex, metrics);
+    return true;
+}
 
-        widths[i] = width;
-        heights[i] = height;
+void FontLoader::measureGlyph(int glyphIndex, GlyphMetrics& metrics) const {
+    metrics.glyphIndex = glyphIndex;
+
+    int x0, y0, x1, y1;
+    stbtt_GetGlyphBitmapBox(font_.get(), metrics.glyphIndex, scale_, scale_, &x0, &y0, &x1, &y1);
+    if (x1 <= x0 || y1 <= y0) {
+        x0 = y0 = x1 = y1 = 0;  // Blank glyph such as the space
+    } else if (format_ == GlyphFormat::SDF) {
+        // Same box stbtt_GetGlyphSDF produces
+        x0 -= sdfSpread_;
+        y0 -= sdfSpread_;
+        x1 += sdfSpread_;
+        y1 += sdfSpread_;
+    }
+
+    int advance, leftSideBearing;
+    stbtt_GetGlyphHMetrics(font_.get(), metrics.glyphIndex, &advance, &leftSideBearing);
+
+    metrics.width = x1 - x0;
+    metrics.height = y1 - y0;
+    metrics.xOffset = static_cast<float>(x0);
+    metrics.yOffset = static_cast<float>(y0);
+    metrics.advance = advance * scale_;
+}
+
+void FontLoader::rasterizeGlyph(const GlyphMetrics& metrics, u8* dst, int stride) const {
+    if (metrics.width <= 0) {
+        return;
+    }
+    if (format_ == GlyphFormat::Coverage) {
+        stbtt_MakeGlyphBitmap(font_.get(), dst, metrics.width, metrics.height, stride, scale_, scale_, metrics.glyphIndex);
+        return;
+    }
 
-        totalWidth += width + 2; // 2 pixels padding
-        maxHeight = std::max(maxHeight, height);
+    // SDF_EDGE on the outline, one step per SDF_EDGE / spread of a pixel,
+    // so the field saturates spread pixels away from it
+    int width, height, xOffset, yOffset;
+    u8* sdf = stbtt_GetGlyphSDF(font_.get(), scale_, metrics.glyphIndex, sdfSpread_, SDF_EDGE,
+                                static_cast<float>(SDF_EDGE) / sdfSpread_, &width, &height, &xOffset, &yOffset);
+    if (!sdf) {
+        return;
+    }
+    int rows = std::min(height, metrics.height);
+    int cols = std::min(width, metrics.width);
+    for (int y = 0; y < rows; y++) {
+        std::memcpy(dst + static_cast<size_t>(y) * stride, sdf + static_cast<size_t>(y) * width, cols);
     }
+    stbtt_FreeSDF(sdf, nullptr);
+}
 
-    // Simple atlas layout: single row
-    // For better packing, we could use multiple rows, but for FASE 1B we keep it simple
-    atlas_.width = totalWidth;
-    atlas_.height = maxHeight + 4; // Extra padding
+void FontLoader::rasterizeGlyphs(const std::vector<GlyphRaster>& glyphs) const {
+    u64 pixels = 0;
+    for (const GlyphRaster& glyph : glyphs) {
+        pixels += static_cast<u64>(glyph.metrics.width) * glyph.metrics.height;
+    }
 
-    // Round up to power of 2 for better GPU compatibility
-    auto nextPowerOf2 = [](int n) {
-        n--;
-        n |= n >> 1;
-        n |= n >> 2;
-        n |= n >> 4;
-        n |= n >> 8;
-        n |= n >> 16;
-        n++;
-        return n;
+    u64 perThread = format_ == GlyphFormat::SDF ? PARALLEL_SDF_PIXELS : PARALLEL_COVERAGE_PIXELS;
+    size_t threadCount = rasterThreads_ ? rasterThreads_ : std::max(1u, std::thread::hardware_concurrency());
+    threadCount = std::min<size_t>(threadCount, pixels / perThread + 1);
+    threadCount = std::min(threadCount, glyphs.size());
+
+    // Glyph cost varies a lot (a period against an ideograph), so workers
+    // claim small batches instead of fixed ranges
+    std::atomic<size_t> next{0};
+    auto work = [&]() {
+        for (;;) {
+            size_t first = next.fetch_add(RASTER_BATCH, std::memory_order_relaxed);
+            if (first >= glyphs.size()) {
+                return;
+            }
+            size_t last = std::min(first + RASTER_BATCH, glyphs.size());
+            for (size_t i = first; i < last; i++) {
+                rasterizeGlyph(glyphs[i].metrics, glyphs[i].dst, glyphs[i].stride);
+            }
+        }
     };
 
-    atlas_.width = nextPowerOf2(atlas_.width);
-    atlas_.height = nextPowerOf2(atlas_.height);
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < threadCount; i++) {
+        threads.emplace_back(work);
+    }
+    work();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
 
-    LOG_DEBUG(LogCategory::RENDER, "Atlas dimensions: %dx%d", atlas_.width, atlas_.height);
+void FontLoader::setTexCoords(Glyph& glyph) const {
+    glyph.x0 = static_cast<float>(glyph.atlasX) / atlas_.width;
+    glyph.y0 = static_cast<float>(glyph.atlasY) / atlas_.height;
+    glyph.x1 = static_cast<float>(glyph.atlasX + glyph.width) / atlas_.width;
+    glyph.y1 = static_cast<float>(glyph.atlasY + glyph.height) / atlas_.height;
+}
 
-    // Allocate atlas bitmap (initialized to 0)
-    atlas_.bitmap.resize(atlas_.width * atlas_.height, 0);
+bool FontLoader::initFont(float fontSize) {
+    font_ = std::make_unique<stbtt_fontinfo>();
+    if (!stbtt_InitFont(font_.get(), fontFile_->data(), 0)) {
+        LOG_ERROR(LogCategory::RENDER, "Failed to initialize font");
+        font_.reset();
+        return false;
+    }
+
+    // Calculate scale for desired font size
+    scale_ = stbtt_ScaleForPixelHeight(font_.get(), fontSize);
+
+    // Get font metrics
+    int ascent, descent, lineGap;
+    stbtt_GetFontVMetrics(font_.get(), &ascent, &descent, &lineGap);
 
-    // Second pass: rasterize glyphs into atlas
-    int xOffset = 2; // Start with padding
+    atlas_.fontSize = fontSize;
+    atlas_.lineHeight = (ascent - descent + lineGap) * scale_;
 
-    for (int i = 0; i < numChars; i++) {
-        int codepoint = firstChar + i;
+    LOG_DEBUG(LogCategory::RENDER, "Font scale: %.4f, line height: %.2f", scale_, atlas_.lineHeight);
+    return true;
+}
 
-        int width, height, xoff, yoff;
-        u8* glyphBitmap = stbtt_GetCodepointBitmap(&font, 0, scale,
-            codepoint, &width, &height, &xoff, &yoff);
+AtlasCacheKey FontLoader::atlasCacheKey(float fontSize) const {
+    AtlasCacheKey key;
+    key.fontHash = fontFile_->contentHash();
+    key.charsetHash = hash64(charset_.data(), charset_.size() * sizeof(u32));
+    key.fontSize = fontSize;
+    key.format = static_cast<u32>(format_);
+    key.sdfSpread = format_ == GlyphFormat::SDF ? sdfSpread_ : 0;
+    key.padding = padding_;
+    return key;
+}
 
-        if (!glyphBitmap) {
-            LOG_WARN(LogCategory::RENDER, "Failed to rasterize glyph: %c (%d)", (char)codepoint, codepoint);
+bool FontLoader::loadCachedAtlas(const std::string& path, const AtlasCacheKey& key) {
+    FontAtlas cached;
+    if (!loadAtlasCache(path, key, cached)) {
+        return false;
+    }
+    atlas_ = std::move(cached);
+    reservePackedArea();
+    return true;
+}
+
+void FontLoader::reservePackedArea() {
+    // An atlas that was not packed here fills one block at the top left;
+    // later addGlyph calls pack below and beside it, as seeding the glyph
+    // cache does
+    packer_.reset(atlas_.width, atlas_.width, padding_);
+    int x, y;
+    packer_.insert(std::max(atlas_.width - padding_, 0), std::max(atlas_.height - padding_, 0), x, y);
+}
+
+bool FontLoader::generateAtlas() {
+    LOG_DEBUG(LogCategory::RENDER, "Generating font atlas (size: %.1f, %s)", atlas_.fontSize,
+        format_ == GlyphFormat::SDF ? "distance field" : "coverage");
+
+    // First pass: measure every glyph the font has
+    std::vector<u32> codepoints;
+    std::vector<GlyphMetrics> metrics;
+    std::vector<PackRect> rects;
+    codepoints.reserve(charset_.size());
+    metrics.reserve(charset_.size());
+    rects.reserve(charset_.size());
+    size_t missing = 0;
+
+    for (u32 codepoint : charset_) {
+        GlyphMetrics glyphMetrics;
+        if (!getGlyphMetrics(codepoint, glyphMetrics)) {
+            LOG_TRACE(LogCategory::RENDER, "Font has no glyph for U+%04X", codepoint);
+            missing++;
             continue;
         }
+        codepoints.push_back(codepoint);
+        metrics.push_back(glyphMetrics);
+        rects.push_back({glyphMetrics.width, glyphMetrics.height, 0, 0});
+    }
 
-        // Copy glyph to atlas
-        int yStart = 2; // Vertical padding
-        for (int y = 0; y < height; y++) {
-            for (int x = 0; x < width; x++) {
-                int atlasX = xOffset + x;
-                int atlasY = yStart + y;
+    if (missing > 0) {
+        LOG_WARN(LogCategory::RENDER, "Font has no glyph for %zu of %zu codepoints", missing, charset_.size());
+    }
+
+    // Second pass: pack into the smallest square that holds everything,
+    // then trim the unused rows at the bottom
+    int side = packSquare(packer_, rects, padding_, ATLAS_ALIGNMENT, MAX_ATLAS_SIZE);
+    if (side == 0) {
+        LOG_ERROR(LogCategory::RENDER, "%zu glyphs do not fit in a %dx%d atlas",
+            rects.size(), MAX_ATLAS_SIZE, MAX_ATLAS_SIZE);
+        return false;
+    }
+
+    atlas_.width = side;
+    atlas_.height = std::max(roundUp(packer_.getUsedHeight(), 4), 4);
+
+    LOG_DEBUG(LogCategory::RENDER, "Atlas dimensions: %dx%d", atlas_.width, atlas_.height);
 
-                if (atlasX < atlas_.width && atlasY < atlas_.height) {
-                    atlas_.bitmap[atlasY * atlas_.width + atlasX] = glyphBitmap[y * width + x];
+    // Allocate atlas bitmap (initialized to 0)
+    atlas_.bitmap.assign(static_cast<size_t>(atlas_.width) * atlas_.height, 0);
+    atlas_.glyphs.clear();
+    atlas_.index.clear();
+
+    // Third pass: rasterize straight into the atlas. The packed rectangles
+    // never overlap, so every worker writes its own part of the bitmap.
+    std::vector<GlyphRaster> rasters;
+    rasters.reserve(rects.size());
+    for (size_t i = 0; i < rects.size(); i++) {
+        Glyph glyph = placeGlyph(codepoints[i], metrics[i], rects[i].x, rects[i].y);
+        rasters.push_back({metrics[i], &atlas_.bitmap[static_cast<size_t>(glyph.atlasY) * atlas_.width + glyph.atlasX], atlas_.width});
+        atlas_.addGlyph(glyph);
+
+        LOG_TRACE(LogCategory::RENDER, "Glyph U+%04X: pos(%d,%d), size(%dx%d), advance(%.2f)",
+            glyph.codepoint, glyph.atlasX, glyph.atlasY, glyph.width, glyph.height, glyph.advance);
+    }
+    rasterizeGlyphs(rasters);
+    buildKerning(codepoints, metrics);
+
+    LOG_INFO(LogCategory::RENDER, "Atlas generated: %zu glyphs, %dx%d, %.0f%% covered",
+        atlas_.glyphs.size(), atlas_.width, atlas_.height,
+        100.0 * packer_.getUsedArea() / (static_cast<double>(atlas_.width) * atlas_.height));
+
+    return true;
+}
+
+void FontLoader::buildKerning(const std::vector<u32>& codepoints, const std::vector<GlyphMetrics>& metrics) {
+    atlas_.kerning.clear();
+    const stbtt_fontinfo* font = font_.get();
+
+    if (font->gpos) {
+        // Same source stbtt_GetGlyphKernAdvance prefers
+        if (codepoints.size() > MAX_PAIRWISE_KERNING_GLYPHS) {
+            LOG_DEBUG(LogCategory::RENDER, "Kerning skipped for %zu glyphs", codepoints.size());
+            return;
+        }
+        for (size_t i = 0; i < codepoints.size(); i++) {
+            for (size_t j = 0; j < codepoints.size(); j++) {
+                int kern = stbtt_GetGlyphKernAdvance(font, metrics[i].glyphIndex, metrics[j].glyphIndex);
+                if (kern != 0) {
+                    atlas_.kerning.set(codepoints[i], codepoints[j], kern * scale_);
                 }
             }
         }
+    } else if (font->kern) {
+        // The legacy kern table lists its pairs; keep those within the charset
+        std::unordered_multimap<int, u32> codepointsOf;
+        for (size_t i = 0; i < codepoints.size(); i++) {
+            codepointsOf.emplace(metrics[i].glyphIndex, codepoints[i]);
+        }
 
-        // Get advance width
-        int advance, leftSideBearing;
-        stbtt_GetCodepointHMetrics(&font, codepoint, &advance, &leftSideBearing);
-
-        // Create glyph metadata
-        Glyph glyph;
-        glyph.codepoint = codepoint;
-
-        // Normalized texture coordinates
-        glyph.x0 = static_cast<float>(xOffset) / atlas_.width;
-        glyph.y0 = static_cast<float>(yStart) / atlas_.height;
-        glyph.x1 = static_cast<float>(xOffset + width) / atlas_.width;
-        glyph.y1 = static_cast<float>(yStart + height) / atlas_.height;
+        std::vector<stbtt_kerningentry> entries(stbtt_GetKerningTableLength(font));
+        entries.resize(stbtt_GetKerningTable(font, entries.data(), static_cast<int>(entries.size())));
+        for (const stbtt_kerningentry& entry : entries) {
+            auto lefts = codepointsOf.equal_range(entry.glyph1);
+            for (auto left = lefts.first; left != lefts.second; ++left) {
+                auto rights = codepointsOf.equal_range(entry.glyph2);
+                for (auto right = rights.first; right != rights.second; ++right) {
+                    atlas_.kerning.set(left->second, right->second, entry.advance * scale_);
+                }
+            }
+        }
+    }
 
-        glyph.xOffset = xoff;
-        glyph.yOffset = yoff;
-        glyph.advance = advance * scale;
-        glyph.width = width;
-        glyph.height = height;
+    LOG_DEBUG(LogCategory::RENDER, "Kerning: %zu pairs", atlas_.kerning.size());
+}
 
-        atlas_.glyphs.push_back(glyph);
+Glyph FontLoader::placeGlyph(u32 codepoint, const GlyphMetrics& metrics, int x, int y) const {
+    Glyph glyph;
+    glyph.codepoint = codepoint;
+    glyph.atlasX = x;
+    glyph.atlasY = y;
+    glyph.width = metrics.width;
+    glyph.height = metrics.height;
+    glyph.xOffset = metrics.xOffset;
+    glyph.yOffset = metrics.yOffset;
+    glyph.advance = metrics.advance;
+    glyph.page = 0;
+    glyph.face = 0;
+    setTexCoords(glyph);
+    return glyph;
+}
 
-        LOG_TRACE(LogCategory::RENDER, "Glyph '%c': pos(%d,%d), size(%dx%d), advance(%.2f)",
-            (char)codepoint, xOffset, yStart, width, height, glyph.advance);
+bool FontLoader::addGlyph(u32 codepoint) {
+    if (atlas_.findGlyph(codepoint)) {
+        return true;
+    }
 
-        stbtt_FreeBitmap(glyphBitmap, nullptr);
+    GlyphMetrics metrics;
+    if (!getGlyphMetrics(codepoint, metrics)) {
+        return false;
+    }
 
-        xOffset += width + 2; // Move to next position with padding
+    int x, y;
+    if (!packer_.insert(metrics.width, metrics.height, x, y)) {
+        // Out of room: extend downwards, which keeps existing pixels in place
+        packer_.grow(packer_.getWidth(), std::min(packer_.getHeight() + packer_.getWidth(), MAX_ATLAS_SIZE));
+        if (!packer_.insert(metrics.width, metrics.height, x, y)) {
+            LOG_WARN(LogCategory::RENDER, "Font atlas is full, cannot add U+%04X", codepoint);
+            return false;
+        }
     }
 
-    LOG_INFO(LogCategory::RENDER, "Atlas generated: %zu glyphs", atlas_.glyphs.size());
+    // Rows only ever get appended, so the pixels already there stay put;
+    // only the normalized v coordinates change
+    int neededHeight = roundUp(packer_.getUsedHeight(), 4);
+    if (neededHeight > atlas_.height) {
+        atlas_.height = neededHeight;
+        atlas_.bitmap.resize(static_cast<size_t>(atlas_.width) * atlas_.height, 0);
+        for (Glyph& existing : atlas_.glyphs) {
+            setTexCoords(existing);
+        }
+    }
 
+    Glyph glyph = placeGlyph(codepoint, metrics, x, y);
+    rasterizeGlyph(metrics, &atlas_.bitmap[static_cast<size_t>(y) * atlas_.width + x], atlas_.width);
+    atlas_.addGlyph(glyph);
     return true;
 }
 
 const Glyph* FontLoader::getGlyph(u32 codepoint) const {
-    for (const auto& glyph : atlas_.glyphs) {
-        if (glyph.codepoint == codepoint) {
-            return &glyph;
-        }
-    }
-    return nullptr;
+    return atlas_.findGlyph(codepoint);
 }
 
 } // namespace phantom
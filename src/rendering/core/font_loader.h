@@ -2,11 +2,22 @@
 #define PHANTOM_FONT_LOADER_H
 
 #include <phantom_writer/types.h>
+#include "glyph_index.h"
+#include "atlas_packer.h"
+#include "font_file.h"
+#include "kerning_table.h"
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
+struct stbtt_fontinfo;
+
 namespace phantom {
 
+struct AtlasCacheKey;
+struct EmbeddedFont;
+
 struct Glyph {
     u32 codepoint;       // Character code
     float x0, y0;        // Top-left position in atlas (normalized 0-1)
@@ -16,6 +27,9 @@ struct Glyph {
     float advance;       // Horizontal advance
     int width;           // Glyph width in pixels
     int height;          // Glyph height in pixels
+    int atlasX, atlasY;  // Top-left position in atlas pixels
+    u32 page;            // Atlas page (GlyphCache); always 0 in a FontAtlas
+    u32 face;            // Font in the fallback chain (GlyphCache); always 0 in a FontAtlas
 };
 
 struct FontAtlas {
@@ -23,8 +37,42 @@ struct FontAtlas {
     int width;                    // Atlas width
     int height;                   // Atlas height
     std::vector<Glyph> glyphs;   // Glyph metadata
+    GlyphIndex index;             // Codepoint -> position in glyphs
     float fontSize;               // Font size in pixels
     float lineHeight;             // Recommended line spacing
+    KerningTable kerning;         // Pen adjustments between glyphs of the charset
+
+    // Glyph for codepoint, or nullptr if the atlas has none
+    const Glyph* findGlyph(u32 codepoint) const {
+        u32 slot = index.find(codepoint);
+        return slot == GlyphIndex::NONE ? nullptr : &glyphs[slot];
+    }
+
+    // Append a glyph and index it (replaces an earlier glyph for the same codepoint)
+    void addGlyph(const Glyph& glyph);
+};
+
+// What atlas pixels hold
+enum class GlyphFormat {
+    Coverage,   // Antialiased coverage, sharp at the loaded size only
+    SDF         // Signed distance to the outline, scales in the shader
+};
+
+// Size and placement of one glyph at the loaded font size
+struct GlyphMetrics {
+    int glyphIndex;      // Glyph number inside the font
+    int width;           // Bitmap size in pixels (0 for blank glyphs)
+    int height;
+    float xOffset;       // Bitmap position relative to the pen
+    float yOffset;
+    float advance;       // Horizontal advance
+};
+
+// One glyph for FontLoader::rasterizeGlyphs
+struct GlyphRaster {
+    GlyphMetrics metrics;
+    u8* dst;             // Top-left destination pixel
+    int stride;          // Destination bytes per row
 };
 
 class FontLoader {
@@ -32,20 +80,108 @@ public:
     FontLoader();
     ~FontLoader();
 
-    // Load a TrueType font from file and generate atlas
+    // Load a TrueType font from file and generate atlas. The file is
+    // mapped, and shared with every other loader that opened the same path.
     bool loadFromFile(const std::string& fontPath, float fontSize);
 
+    // Same, from font file contents already read (e.g. by the IoEngine)
+    bool loadFromMemory(std::vector<u8> fontData, float fontSize);
+
+    // Same, from a font file another loader may be using as well (e.g.
+    // one face at several sizes)
+    bool load(std::shared_ptr<const FontFile> file, float fontSize);
+
+    // Load a font compiled into the executable. Its prebaked atlas, size
+    // and settings are used as they are: no file I/O, no rasterization.
+    bool loadEmbedded(const EmbeddedFont& font);
+
+    // Font file in use, for loading the same face at another size
+    const std::shared_ptr<const FontFile>& getFontFile() const { return fontFile_; }
+
+    // Directory for cached atlases (default none: always rasterize). When
+    // set, loading reuses an atlas stored there for the same font file,
+    // size, charset and settings, and stores a freshly generated one.
+    // Set before loading.
+    void setAtlasCacheDirectory(std::string directory) { cacheDirectory_ = std::move(directory); }
+    const std::string& getAtlasCacheDirectory() const { return cacheDirectory_; }
+
     // Get the generated atlas
     const FontAtlas& getAtlas() const { return atlas_; }
 
     // Get glyph for a specific character
     const Glyph* getGlyph(u32 codepoint) const;
 
+    // Empty pixels kept around each glyph (default 2). Set before loading.
+    void setPadding(int padding) { padding_ = padding; }
+    int getPadding() const { return padding_; }
+
+    // Codepoints rasterized when the atlas is generated (default: printable
+    // ASCII). Set before loading.
+    void setCharset(std::vector<u32> codepoints) { charset_ = std::move(codepoints); }
+    const std::vector<u32>& getCharset() const { return charset_; }
+
+    // Glyph bitmap format (default Coverage). In SDF mode every glyph gets
+    // spread pixels of distance field around its outline, and 128 marks the
+    // edge. Set before loading.
+    void setFormat(GlyphFormat format, int spread = DEFAULT_SDF_SPREAD) { format_ = format; sdfSpread_ = spread; }
+    GlyphFormat getFormat() const { return format_; }
+    int getSdfSpread() const { return sdfSpread_; }
+
+    static constexpr int DEFAULT_SDF_SPREAD = 6;
+
+    // Metrics of codepoint's glyph. False if the font has none.
+    bool getGlyphMetrics(u32 codepoint, GlyphMetrics& metrics) const;
+
+    // Glyph number of codepoint inside the font, 0 if it has none
+    int findGlyphIndex(u32 codepoint) const;
+
+    // Metrics of a glyph found by findGlyphIndex
+    void measureGlyph(int glyphIndex, GlyphMetrics& metrics) const;
+
+    // Render a glyph measured by getGlyphMetrics into dst (8-bit coverage
+    // or distance, stride bytes per row, metrics.width x metrics.height pixels)
+    void rasterizeGlyph(const GlyphMetrics& metrics, u8* dst, int stride) const;
+
+    // Rasterize glyphs into disjoint destinations. Large batches are spread
+    // over worker threads, which all read the same font.
+    void rasterizeGlyphs(const std::vector<GlyphRaster>& glyphs) const;
+
+    // Threads rasterizeGlyphs may use (default 0: one per core)
+    void setRasterThreads(u32 threads) { rasterThreads_ = threads; }
+
+    float getFontSize() const { return atlas_.fontSize; }
+    float getLineHeight() const { return atlas_.lineHeight; }
+
+    // Pixels to add to the pen between left and right. Precomputed for
+    // the charset when the atlas is built; other pairs read as 0.
+    float getKerning(u32 left, u32 right) const { return atlas_.kerning.get(left, right); }
+
+    // Rasterize one more glyph into the free space of the current atlas.
+    // The atlas keeps its width but may gain rows, so the caller must
+    // upload it again. False if the font has no such glyph or the atlas is full.
+    bool addGlyph(u32 codepoint);
+
 private:
     FontAtlas atlas_;
-    std::vector<u8> fontFileData_;
+    std::shared_ptr<const FontFile> fontFile_;
+    std::unique_ptr<stbtt_fontinfo> font_;
+    float scale_ = 0.0f;
+    int padding_ = 2;
+    GlyphFormat format_ = GlyphFormat::Coverage;
+    int sdfSpread_ = DEFAULT_SDF_SPREAD;
+    u32 rasterThreads_ = 0;
+    std::vector<u32> charset_;
+    SkylinePacker packer_;
+    std::string cacheDirectory_;
 
-    bool generateAtlas(float fontSize);
+    bool initFont(float fontSize);
+    AtlasCacheKey atlasCacheKey(float fontSize) const;
+    bool loadCachedAtlas(const std::string& path, const AtlasCacheKey& key);
+    void reservePackedArea();
+    bool generateAtlas();
+    void buildKerning(const std::vector<u32>& codepoints, const std::vector<GlyphMetrics>& metrics);
+    Glyph placeGlyph(u32 codepoint, const GlyphMetrics& metrics, int x, int y) const;
+    void setTexCoords(Glyph& glyph) const;
 };
 
 } // namespace phantom
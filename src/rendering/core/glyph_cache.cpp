@@ -0,0 +1,456 @@
+#include "glyph_cache.h"
+#include "utils/logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+namespace phantom {
+
+GlyphCache::GlyphCache(const FontLoader& font, int pageSize, u32 maxPages, int padding)
+    : faces_{&font}
+    , pageSize_(pageSize)
+    , maxPages_(std::max(maxPages, 1u))
+    , padding_(padding)
+{
+    sizes_.emplace_back();
+    SizeBucket& primary = sizes_.back();
+    primary.pixelSize = font.getFontSize();
+    primary.state = SizeState::Ready;
+    primary.faces.push_back(&font);
+}
+
+bool GlyphCache::addFallback(const FontLoader& font) {
+    if (faces_.size() >= MAX_FACES) {
+        LOG_WARN(LogCategory::RENDER, "Glyph cache fallback chain is full");
+        return false;
+    }
+    const FontLoader& primary = *faces_[0];
+    if (font.getFormat() != primary.getFormat() || font.getFontSize() != primary.getFontSize()) {
+        LOG_WARN(LogCategory::RENDER, "Fallback font does not match the primary font's size and format");
+        return false;
+    }
+    faces_.push_back(&font);
+    for (SizeBucket& bucket : sizes_) {
+        bucket.faces.push_back(bucket.step == 0 ? &font : nullptr);
+        bucket.missing.clear();
+    }
+    LOG_DEBUG(LogCategory::RENDER, "Glyph cache fallback face %zu added", faces_.size() - 1);
+    return true;
+}
+
+bool GlyphCache::seed(const FontAtlas& atlas) {
+    SizeBucket& primary = sizes_[0];
+    if (!pages_.empty() || primary.index.size() > 0) {
+        return false;
+    }
+    if (atlas.width > pageSize_ || atlas.height > pageSize_) {
+        LOG_WARN(LogCategory::RENDER, "Atlas %dx%d does not fit a %d px cache page, glyphs will be rasterized on use",
+                 atlas.width, atlas.height, pageSize_);
+        return false;
+    }
+
+    pages_.emplace_back();
+    Page& page = pages_.back();
+    page.bitmap.assign(static_cast<size_t>(pageSize_) * pageSize_, 0);
+    for (int y = 0; y < atlas.height; y++) {
+        std::memcpy(&page.bitmap[static_cast<size_t>(y) * pageSize_], &atlas.bitmap[static_cast<size_t>(y) * atlas.width], atlas.width);
+    }
+
+    // Claim the atlas area as one block; the first rectangle in an empty
+    // skyline lands at (padding, padding), so the block ends at the atlas edge
+    page.packer.reset(pageSize_, pageSize_, padding_);
+    int x, y;
+    page.packer.insert(std::max(atlas.width - padding_, 0), std::max(atlas.height - padding_, 0), x, y);
+    page.lastUsed = frame_;
+    markDirty(page, {0, 0, pageSize_, pageSize_});
+
+    for (const Glyph& seeded : atlas.glyphs) {
+        Glyph glyph = seeded;
+        glyph.page = 0;
+        glyph.face = 0;
+        glyph.x0 = static_cast<float>(glyph.atlasX) / pageSize_;
+        glyph.y0 = static_cast<float>(glyph.atlasY) / pageSize_;
+        glyph.x1 = static_cast<float>(glyph.atlasX + glyph.width) / pageSize_;
+        glyph.y1 = static_cast<float>(glyph.atlasY + glyph.height) / pageSize_;
+        primary.index.insert(glyph.codepoint, newEntry(glyph, 0));
+    }
+
+    LOG_DEBUG(LogCategory::RENDER, "Glyph cache seeded with %zu glyphs", atlas.glyphs.size());
+    return true;
+}
+
+u32 GlyphCache::selectSize(float pixelSize) {
+    const float primarySize = sizes_[0].pixelSize;
+    if (!(pixelSize > 0.0f) || pixelSize == primarySize) {
+        return 0;
+    }
+    int step = static_cast<int>(std::lround(std::log2(pixelSize / primarySize) * SIZE_STEPS_PER_OCTAVE));
+    step = std::max(-MAX_SIZE_STEP, std::min(step, MAX_SIZE_STEP));
+
+    u32 wanted = MAX_SIZES;
+    for (u32 size = 0; size < sizes_.size(); size++) {
+        if (sizes_[size].step == step) {
+            wanted = size;
+            break;
+        }
+    }
+    if (wanted == MAX_SIZES && sizes_.size() < MAX_SIZES) {
+        wanted = startSize(step);
+    }
+    if (wanted != MAX_SIZES && sizes_[wanted].state == SizeState::Ready) {
+        return wanted;
+    }
+
+    // Nearest size on the ladder that can draw right now
+    u32 nearest = 0;
+    for (u32 size = 1; size < sizes_.size(); size++) {
+        if (sizes_[size].state == SizeState::Ready &&
+            std::abs(sizes_[size].step - step) < std::abs(sizes_[nearest].step - step)) {
+            nearest = size;
+        }
+    }
+    return nearest;
+}
+
+u32 GlyphCache::startSize(int step) {
+    const FontLoader& primary = *faces_[0];
+
+    sizes_.emplace_back();
+    SizeBucket& bucket = sizes_.back();
+    bucket.step = step;
+    bucket.pixelSize = primary.getFontSize() * std::exp2(static_cast<float>(step) / SIZE_STEPS_PER_OCTAVE);
+    bucket.faces.assign(faces_.size(), nullptr);
+
+    // Same face, charset and settings as the primary font, so the atlas
+    // cache can serve this size on later launches too. One raster thread:
+    // the job must not compete with the frames drawn meanwhile.
+    bucket.loading = std::async(std::launch::async,
+        [file = primary.getFontFile(), charset = primary.getCharset(), cacheDirectory = primary.getAtlasCacheDirectory(),
+         format = primary.getFormat(), spread = primary.getSdfSpread(), padding = primary.getPadding(),
+         pixelSize = bucket.pixelSize]() {
+            auto loader = std::make_unique<FontLoader>();
+            loader->setFormat(format, spread);
+            loader->setPadding(padding);
+            loader->setCharset(charset);
+            loader->setAtlasCacheDirectory(cacheDirectory);
+            loader->setRasterThreads(1);
+            if (!loader->load(file, pixelSize)) {
+                loader.reset();
+            }
+            return loader;
+        });
+
+    LOG_DEBUG(LogCategory::RENDER, "Glyph cache size %.1f px requested", bucket.pixelSize);
+    return static_cast<u32>(sizes_.size() - 1);
+}
+
+void GlyphCache::beginFrame() {
+    frame_++;
+    for (u32 size = 1; size < sizes_.size(); size++) {
+        SizeBucket& bucket = sizes_[size];
+        if (bucket.state == SizeState::Loading &&
+            bucket.loading.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            finishSize(size);
+        }
+    }
+}
+
+void GlyphCache::finishSize(u32 size) {
+    SizeBucket& bucket = sizes_[size];
+    std::unique_ptr<FontLoader> loader = bucket.loading.get();
+    if (!loader) {
+        bucket.state = SizeState::Failed;
+        LOG_WARN(LogCategory::RENDER, "Glyph cache size %.1f px failed to load, scaling another size instead",
+                 bucket.pixelSize);
+        return;
+    }
+
+    // Copy the finished atlas glyph by glyph into whatever page has room;
+    // glyphs that find none are rasterized on first use instead
+    const FontAtlas& atlas = loader->getAtlas();
+    size_t copied = 0;
+    for (const Glyph& loaded : atlas.glyphs) {
+        Glyph glyph = loaded;
+        glyph.page = 0;
+        glyph.face = 0;
+        if (glyph.width > 0) {
+            if (!allocate(glyph.width, glyph.height, glyph.page, glyph.atlasX, glyph.atlasY)) {
+                break;
+            }
+            Page& page = pages_[glyph.page];
+            for (int y = 0; y < glyph.height; y++) {
+                std::memcpy(&page.bitmap[static_cast<size_t>(glyph.atlasY + y) * pageSize_ + glyph.atlasX],
+                            &atlas.bitmap[static_cast<size_t>(loaded.atlasY + y) * atlas.width + loaded.atlasX],
+                            glyph.width);
+            }
+            markDirty(page, {glyph.atlasX, glyph.atlasY, glyph.width, glyph.height});
+            page.lastUsed = frame_;
+
+            glyph.x0 = static_cast<float>(glyph.atlasX) / pageSize_;
+            glyph.y0 = static_cast<float>(glyph.atlasY) / pageSize_;
+            glyph.x1 = static_cast<float>(glyph.atlasX + glyph.width) / pageSize_;
+            glyph.y1 = static_cast<float>(glyph.atlasY + glyph.height) / pageSize_;
+        }
+        bucket.index.insert(glyph.codepoint, newEntry(glyph, size));
+        copied++;
+    }
+
+    bucket.faces[0] = loader.get();
+    bucket.owned.push_back(std::move(loader));
+    bucket.state = SizeState::Ready;
+    stats_.sizesLoaded++;
+    LOG_DEBUG(LogCategory::RENDER, "Glyph cache size %.1f px ready (%zu glyphs)", bucket.pixelSize, copied);
+}
+
+const FontLoader& GlyphCache::faceAt(u32 size, u32 face) {
+    SizeBucket& bucket = sizes_[size];
+    if (!bucket.faces[face]) {
+        // Fallbacks at other sizes rasterize nothing up front, so loading
+        // one from the already open font file is cheap enough to do here
+        const FontLoader& base = *faces_[face];
+        auto loader = std::make_unique<FontLoader>();
+        loader->setFormat(base.getFormat(), base.getSdfSpread());
+        loader->setPadding(base.getPadding());
+        loader->setCharset({});
+        if (!loader->load(base.getFontFile(), bucket.pixelSize)) {
+            LOG_WARN(LogCategory::RENDER, "Fallback face %u failed to load at %.1f px, using %.1f px",
+                     face, bucket.pixelSize, base.getFontSize());
+            return base;
+        }
+        bucket.faces[face] = loader.get();
+        bucket.owned.push_back(std::move(loader));
+    }
+    return *bucket.faces[face];
+}
+
+const Glyph* GlyphCache::get(u32 codepoint, u32 size) {
+    SizeBucket& bucket = sizes_[size];
+    u32 slot = bucket.index.find(codepoint);
+    if (slot != GlyphIndex::NONE) {
+        Entry& entry = entries_[slot];
+        if (entry.glyph.width > 0) {
+            pages_[entry.glyph.page].lastUsed = frame_;
+        }
+        stats_.hits++;
+        return &entry.glyph;
+    }
+
+    if (bucket.missing.find(codepoint) != GlyphIndex::NONE) {
+        return nullptr;
+    }
+
+    stats_.misses++;
+    GlyphRaster raster{};
+    const Glyph* glyph = insert(codepoint, size, raster);
+    if (glyph && raster.dst) {
+        faceAt(size, glyph->face).rasterizeGlyph(raster.metrics, raster.dst, raster.stride);
+    }
+    return glyph;
+}
+
+size_t GlyphCache::prefetch(const std::vector<u32>& codepoints, u32 size) {
+    // Place everything first, then rasterize the batch. Glyphs placed here
+    // mark their page as used this frame, so a later allocation in the same
+    // batch cannot evict the page under them.
+    std::vector<std::vector<GlyphRaster>> rasters(faces_.size());
+    size_t added = 0;
+    for (u32 codepoint : codepoints) {
+        if (isResolved(codepoint, size)) {
+            continue;
+        }
+        stats_.misses++;
+        GlyphRaster raster{};
+        if (const Glyph* glyph = insert(codepoint, size, raster)) {
+            added++;
+            if (raster.dst) {
+                rasters[glyph->face].push_back(raster);
+            }
+        }
+    }
+
+    for (u32 face = 0; face < faces_.size(); face++) {
+        if (!rasters[face].empty()) {
+            faceAt(size, face).rasterizeGlyphs(rasters[face]);
+        }
+    }
+    return added;
+}
+
+bool GlyphCache::resolve(u32 codepoint, u32 size, u32& face, GlyphMetrics& metrics) {
+    u32 resolved = resolved_.find(codepoint);
+    if (resolved == GlyphIndex::NONE) {
+        int glyphIndex = 0;
+        for (face = 0; face < faces_.size(); face++) {
+            glyphIndex = faces_[face]->findGlyphIndex(codepoint);
+            if (glyphIndex != 0) {
+                break;
+            }
+        }
+        if (glyphIndex == 0) {
+            return false;
+        }
+        if (face > 0) {
+            stats_.fallbacks++;
+            LOG_TRACE(LogCategory::RENDER, "Glyph U+%04X resolved to fallback face %u", codepoint, face);
+        }
+        resolved = face << FACE_SHIFT | static_cast<u32>(glyphIndex);
+        resolved_.insert(codepoint, resolved);
+    }
+
+    face = resolved >> FACE_SHIFT;
+    faceAt(size, face).measureGlyph(static_cast<int>(resolved & GLYPH_MASK), metrics);
+    return true;
+}
+
+const Glyph* GlyphCache::insert(u32 codepoint, u32 size, GlyphRaster& raster) {
+    SizeBucket& bucket = sizes_[size];
+    u32 face;
+    GlyphMetrics metrics;
+    if (!resolve(codepoint, size, face, metrics)) {
+        bucket.missing.insert(codepoint, 0);
+        return nullptr;
+    }
+    if (metrics.width + 2 * padding_ > pageSize_ || metrics.height + 2 * padding_ > pageSize_) {
+        LOG_WARN(LogCategory::RENDER, "Glyph U+%04X (%dx%d) is larger than a cache page",
+                 codepoint, metrics.width, metrics.height);
+        bucket.missing.insert(codepoint, 0);
+        return nullptr;
+    }
+
+    Glyph glyph;
+    glyph.codepoint = codepoint;
+    glyph.width = metrics.width;
+    glyph.height = metrics.height;
+    glyph.xOffset = metrics.xOffset;
+    glyph.yOffset = metrics.yOffset;
+    glyph.advance = metrics.advance;
+    glyph.page = 0;
+    glyph.face = face;
+    glyph.atlasX = 0;
+    glyph.atlasY = 0;
+    glyph.x0 = glyph.y0 = glyph.x1 = glyph.y1 = 0.0f;
+
+    // Blank glyphs only carry metrics and take no page space
+    if (glyph.width > 0) {
+        if (!allocate(glyph.width, glyph.height, glyph.page, glyph.atlasX, glyph.atlasY)) {
+            stats_.overflows++;
+            LOG_WARN(LogCategory::RENDER, "Glyph cache full, U+%04X skipped this frame", codepoint);
+            return nullptr;
+        }
+
+        Page& page = pages_[glyph.page];
+        raster = {metrics, &page.bitmap[static_cast<size_t>(glyph.atlasY) * pageSize_ + glyph.atlasX], pageSize_};
+        markDirty(page, {glyph.atlasX, glyph.atlasY, glyph.width, glyph.height});
+        page.lastUsed = frame_;
+
+        glyph.x0 = static_cast<float>(glyph.atlasX) / pageSize_;
+        glyph.y0 = static_cast<float>(glyph.atlasY) / pageSize_;
+        glyph.x1 = static_cast<float>(glyph.atlasX + glyph.width) / pageSize_;
+        glyph.y1 = static_cast<float>(glyph.atlasY + glyph.height) / pageSize_;
+    }
+
+    u32 slot = newEntry(glyph, size);
+    bucket.index.insert(codepoint, slot);
+
+    LOG_TRACE(LogCategory::RENDER, "Glyph U+%04X at %.1f px cached on page %u at (%d,%d)",
+              codepoint, bucket.pixelSize, glyph.page, glyph.atlasX, glyph.atlasY);
+    return &entries_[slot].glyph;
+}
+
+bool GlyphCache::allocate(int width, int height, u32& page, int& x, int& y) {
+    for (u32 i = 0; i < pages_.size(); i++) {
+        if (pages_[i].packer.insert(width, height, x, y)) {
+            page = i;
+            return true;
+        }
+    }
+
+    if (pages_.size() < maxPages_) {
+        pages_.emplace_back();
+        Page& added = pages_.back();
+        added.bitmap.assign(static_cast<size_t>(pageSize_) * pageSize_, 0);
+        added.packer.reset(pageSize_, pageSize_, padding_);
+        markDirty(added, {0, 0, pageSize_, pageSize_});
+        page = static_cast<u32>(pages_.size() - 1);
+        LOG_DEBUG(LogCategory::RENDER, "Glyph cache page %u added", page);
+        return added.packer.insert(width, height, x, y);
+    }
+
+    // Least recently used page not needed by the frame being built
+    u32 victim = maxPages_;
+    for (u32 i = 0; i < pages_.size(); i++) {
+        if (pages_[i].lastUsed < frame_ && (victim == maxPages_ || pages_[i].lastUsed < pages_[victim].lastUsed)) {
+            victim = i;
+        }
+    }
+    if (victim == maxPages_) {
+        return false;
+    }
+
+    evictPage(victim);
+    page = victim;
+    return pages_[victim].packer.insert(width, height, x, y);
+}
+
+void GlyphCache::evictPage(u32 page) {
+    u64 dropped = 0;
+    for (u32 slot = 0; slot < entries_.size(); slot++) {
+        Entry& entry = entries_[slot];
+        if (entry.live && entry.glyph.width > 0 && entry.glyph.page == page) {
+            sizes_[entry.size].index.erase(entry.glyph.codepoint);
+            entry.live = false;
+            freeEntries_.push_back(slot);
+            dropped++;
+        }
+    }
+
+    Page& victim = pages_[page];
+    std::fill(victim.bitmap.begin(), victim.bitmap.end(), 0);
+    victim.packer.reset(pageSize_, pageSize_, padding_);
+    markDirty(victim, {0, 0, pageSize_, pageSize_});
+
+    stats_.evictedPages++;
+    stats_.evictedGlyphs += dropped;
+    LOG_DEBUG(LogCategory::RENDER, "Glyph cache page %u evicted (%llu glyphs)",
+              page, static_cast<unsigned long long>(dropped));
+}
+
+void GlyphCache::markDirty(Page& page, const AtlasRect& rect) {
+    if (!page.dirty) {
+        page.dirtyRect = rect;
+        page.dirty = true;
+        return;
+    }
+
+    int x0 = std::min(page.dirtyRect.x, rect.x);
+    int y0 = std::min(page.dirtyRect.y, rect.y);
+    int x1 = std::max(page.dirtyRect.x + page.dirtyRect.width, rect.x + rect.width);
+    int y1 = std::max(page.dirtyRect.y + page.dirtyRect.height, rect.y + rect.height);
+    page.dirtyRect = {x0, y0, x1 - x0, y1 - y0};
+}
+
+bool GlyphCache::takeDirtyRect(u32 page, AtlasRect& rect) {
+    Page& target = pages_[page];
+    if (!target.dirty) {
+        return false;
+    }
+    rect = target.dirtyRect;
+    target.dirty = false;
+    return true;
+}
+
+u32 GlyphCache::newEntry(const Glyph& glyph, u32 size) {
+    if (!freeEntries_.empty()) {
+        u32 slot = freeEntries_.back();
+        freeEntries_.pop_back();
+        entries_[slot] = {glyph, size, true};
+        return slot;
+    }
+    entries_.push_back({glyph, size, true});
+    return static_cast<u32>(entries_.size() - 1);
+}
+
+} // namespace phantom
@@ -0,0 +1,188 @@
+#ifndef PHANTOM_GLYPH_CACHE_H
+#define PHANTOM_GLYPH_CACHE_H
+
+#include <phantom_writer/types.h>
+#include "font_loader.h"
+#include "glyph_index.h"
+#include "atlas_packer.h"
+#include <deque>
+#include <future>
+#include <memory>
+#include <vector>
+
+namespace phantom {
+
+// Region of an atlas page, in pixels
+struct AtlasRect {
+    int x, y;
+    int width, height;
+};
+
+// Glyphs rasterized on first use into fixed-size atlas pages.
+//
+// Each page is a square 8-bit bitmap with its own skyline packer. A glyph
+// that is not cached yet is rasterized once into the first page with
+// room, and the page records the rectangle that changed so only that part
+// has to reach the GPU. When every page is full and no more may be
+// added, the least recently used page is cleared and its glyphs are
+// dropped; they come back one rasterization each if they are needed
+// again. Eviction works on whole pages because a skyline cannot free
+// single rectangles. A page used in the current frame is never evicted.
+//
+// Glyphs come from a chain of faces: the primary font first, then any
+// fallbacks (symbols, CJK) in the order they were added. The first face
+// that has a codepoint supplies it, and the choice is remembered with the
+// glyph number, so after the first lookup a codepoint never searches the
+// chain again, not even when its page has been evicted.
+//
+// The same faces can be cached at several pixel sizes, so zoomed text and
+// smaller overlays are drawn from glyphs rasterized for their size instead
+// of stretching the primary size in the vertex math. Sizes sit on a ladder
+// of quarter octaves around the primary size (48 px: 40.4, 57.1, 67.9...)
+// and share the pages with everything else. A size is started with
+// selectSize(): its startup atlas is rasterized on a background thread and
+// copied into the pages by the beginFrame() after it finishes, and until
+// then the nearest size already available is returned, so switching sizes
+// never stalls a frame.
+class GlyphCache {
+public:
+    static constexpr int DEFAULT_PAGE_SIZE = 1024;
+    static constexpr u32 DEFAULT_MAX_PAGES = 4;
+    static constexpr u32 MAX_FACES = 255;
+    static constexpr u32 MAX_SIZES = 8;             // Including the primary size
+    static constexpr int SIZE_STEPS_PER_OCTAVE = 4;
+    static constexpr int MAX_SIZE_STEP = 8;         // Quarter to four times the primary size
+
+    struct Stats {
+        u64 hits = 0;
+        u64 misses = 0;             // Lookups that had to rasterize
+        u64 evictedPages = 0;
+        u64 evictedGlyphs = 0;
+        u64 overflows = 0;          // Glyphs dropped: every page in use this frame
+        u64 fallbacks = 0;          // Codepoints resolved to a fallback face
+        u64 sizesLoaded = 0;        // Sizes rasterized in the background
+    };
+
+    explicit GlyphCache(const FontLoader& font, int pageSize = DEFAULT_PAGE_SIZE,
+                        u32 maxPages = DEFAULT_MAX_PAGES, int padding = 2);
+
+    // Append a face to the fallback chain. It must be loaded at the same
+    // size and glyph format as the primary font, and outlive the cache.
+    // May be called at any time (e.g. once a font loaded in the background
+    // is ready): codepoints no face had so far are looked up again. Other
+    // sizes load the face from the same font file on first use. False if
+    // the chain is full or the face does not match.
+    bool addFallback(const FontLoader& font);
+    u32 getFaceCount() const { return static_cast<u32>(faces_.size()); }
+
+    // Copy a prebuilt atlas (e.g. the startup ASCII set) into page 0 so its
+    // glyphs need no rasterization. Call before any get().
+    bool seed(const FontAtlas& atlas);
+
+    // Size to draw text of pixelSize with: the ladder size nearest to it
+    // if that is loaded, otherwise the nearest loaded one while the ladder
+    // size is rasterized in the background. Size 0 is the primary size.
+    u32 selectSize(float pixelSize);
+
+    // Pixel size glyphs of size are rasterized at
+    float getPixelSize(u32 size = 0) const { return sizes_[size].pixelSize; }
+    u32 getSizeCount() const { return static_cast<u32>(sizes_.size()); }
+
+    // Glyph for codepoint at size, rasterizing it on first use. nullptr if
+    // the font has no such glyph. The pointer stays valid until its page is
+    // evicted, which never happens within the frame that looked it up.
+    const Glyph* get(u32 codepoint, u32 size = 0);
+
+    // Rasterize every codepoint that is not cached yet in one batch, spread
+    // over the font's worker threads. Lets a frame with many new glyphs
+    // (pasted CJK text, a fresh page after eviction) avoid one serial miss
+    // per character. Returns the number of glyphs added.
+    size_t prefetch(const std::vector<u32>& codepoints, u32 size = 0);
+
+    // Whether get(codepoint, size) would return without rasterizing
+    bool isResolved(u32 codepoint, u32 size = 0) const {
+        const SizeBucket& bucket = sizes_[size];
+        return bucket.index.find(codepoint) != GlyphIndex::NONE || bucket.missing.find(codepoint) != GlyphIndex::NONE;
+    }
+
+    // Start a new frame for LRU bookkeeping, and take in sizes that
+    // finished rasterizing in the background
+    void beginFrame();
+
+    int getPageSize() const { return pageSize_; }
+    u32 getMaxPages() const { return maxPages_; }
+    u32 getPageCount() const { return static_cast<u32>(pages_.size()); }
+    const std::vector<u8>& getPageBitmap(u32 page) const { return pages_[page].bitmap; }
+
+    // Region of page changed since the last call, if any (and forget it)
+    bool takeDirtyRect(u32 page, AtlasRect& rect);
+
+    float getLineHeight(u32 size = 0) const { return sizes_[size].faces[0]->getLineHeight(); }
+    float getKerning(u32 left, u32 right, u32 size = 0) const { return sizes_[size].faces[0]->getKerning(left, right); }
+    GlyphFormat getFormat() const { return faces_[0]->getFormat(); }
+    const Stats& getStats() const { return stats_; }
+
+private:
+    struct Page {
+        std::vector<u8> bitmap;
+        SkylinePacker packer;
+        u64 lastUsed = 0;
+        bool dirty = false;
+        AtlasRect dirtyRect{0, 0, 0, 0};
+    };
+
+    struct Entry {
+        Glyph glyph;
+        u32 size;
+        bool live;
+    };
+
+    enum class SizeState {
+        Loading,
+        Ready,
+        Failed
+    };
+
+    struct SizeBucket {
+        int step = 0;                   // Position on the size ladder
+        float pixelSize = 0.0f;
+        SizeState state = SizeState::Loading;
+        std::vector<const FontLoader*> faces;       // Parallel to faces_, nullptr until needed
+        std::vector<std::unique_ptr<FontLoader>> owned;
+        std::future<std::unique_ptr<FontLoader>> loading;
+        GlyphIndex index;               // Codepoint -> entries_ slot
+        GlyphIndex missing;             // Codepoints with no glyph at this size
+    };
+
+    // resolved_ values: face << FACE_SHIFT | glyph number
+    static constexpr u32 FACE_SHIFT = 24;
+    static constexpr u32 GLYPH_MASK = (1u << FACE_SHIFT) - 1;
+
+    bool resolve(u32 codepoint, u32 size, u32& face, GlyphMetrics& metrics);
+    const Glyph* insert(u32 codepoint, u32 size, GlyphRaster& raster);
+    const FontLoader& faceAt(u32 size, u32 face);
+    u32 startSize(int step);
+    void finishSize(u32 size);
+    bool allocate(int width, int height, u32& page, int& x, int& y);
+    void evictPage(u32 page);
+    void markDirty(Page& page, const AtlasRect& rect);
+    u32 newEntry(const Glyph& glyph, u32 size);
+
+    std::vector<const FontLoader*> faces_;  // Primary font first, at the primary size
+    std::deque<SizeBucket> sizes_;  // Primary size first; deque: loading jobs never move
+    int pageSize_;
+    u32 maxPages_;
+    int padding_;
+
+    std::vector<Page> pages_;
+    std::deque<Entry> entries_;     // Deque: pointers survive growth
+    std::vector<u32> freeEntries_;
+    GlyphIndex resolved_;           // Codepoint -> face and glyph number, the same at every size
+
+    u64 frame_ = 1;
+    Stats stats_;
+};
+
+} // namespace phantom
+
+#endif // PHANTOM_GLYPH_CACHE_H
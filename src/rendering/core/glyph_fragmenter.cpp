@@ -1,9 +1,87 @@
 #include "glyph_fragmenter.h"
 #include "utils/logger.h"
 
+#if defined(__SSE2__) || defined(_M_X64)
+    #define PHANTOM_FRAGMENT_SSE2 1
+    #include <emmintrin.h>
+#elif defined(__aarch64__)
+    #define PHANTOM_FRAGMENT_NEON 1
+    #include <arm_neon.h>
+#endif
+
 namespace phantom {
 
-GlyphFragmenter::GlyphFragmenter() {
+namespace {
+
+constexpr uint32_t FNV_OFFSET_BASIS = 2166136261u;
+constexpr uint32_t FNV_PRIME = 16777619u;
+
+// MurmurHash3 finalizer
+inline uint32_t fmix32(uint32_t hash) {
+    hash ^= hash >> 16;
+    hash *= 0x85EBCA6Bu;
+    hash ^= hash >> 13;
+    hash *= 0xC2B2AE35u;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+// The mode is the top bit of the hash after the MurmurHash3 finalizer.
+// FNV-1a alone mixes poorly at either end: its lowest bit is only the
+// parity of the input (the prime is odd), which turns every seed into the
+// same checkerboard, and its top bit barely changes from one column to
+// the next.
+inline uint32_t modeBit(uint32_t hash) {
+    return fmix32(hash) >> 31;
+}
+
+#if defined(PHANTOM_FRAGMENT_SSE2)
+// Low 32 bits of a * b in each lane (SSE2 has no 32-bit mullo)
+inline __m128i mulLo32(__m128i a, __m128i b) {
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+#endif
+
+// Mode bits of 4 consecutive columns starting at column, bit i for column + i
+inline uint32_t modeBits4(uint32_t lineHash, uint32_t column) {
+#if defined(PHANTOM_FRAGMENT_SSE2)
+    __m128i columns = _mm_add_epi32(_mm_set1_epi32(static_cast<int>(column)), _mm_setr_epi32(0, 1, 2, 3));
+    __m128i hash = mulLo32(_mm_xor_si128(_mm_set1_epi32(static_cast<int>(lineHash)), columns),
+                           _mm_set1_epi32(static_cast<int>(FNV_PRIME)));
+    hash = _mm_xor_si128(hash, _mm_srli_epi32(hash, 16));
+    hash = mulLo32(hash, _mm_set1_epi32(static_cast<int>(0x85EBCA6Bu)));
+    hash = _mm_xor_si128(hash, _mm_srli_epi32(hash, 13));
+    hash = mulLo32(hash, _mm_set1_epi32(static_cast<int>(0xC2B2AE35u)));
+    hash = _mm_xor_si128(hash, _mm_srli_epi32(hash, 16));
+    return static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(hash)));
+#elif defined(PHANTOM_FRAGMENT_NEON)
+    static const uint32_t offsets[4] = {0, 1, 2, 3};
+    static const uint32_t weights[4] = {1, 2, 4, 8};
+    uint32x4_t columns = vaddq_u32(vdupq_n_u32(column), vld1q_u32(offsets));
+    uint32x4_t hash = vmulq_u32(veorq_u32(vdupq_n_u32(lineHash), columns), vdupq_n_u32(FNV_PRIME));
+    hash = veorq_u32(hash, vshrq_n_u32(hash, 16));
+    hash = vmulq_u32(hash, vdupq_n_u32(0x85EBCA6Bu));
+    hash = veorq_u32(hash, vshrq_n_u32(hash, 13));
+    hash = vmulq_u32(hash, vdupq_n_u32(0xC2B2AE35u));
+    hash = veorq_u32(hash, vshrq_n_u32(hash, 16));
+    return vaddvq_u32(vmulq_u32(vshrq_n_u32(hash, 31), vld1q_u32(weights)));
+#else
+    uint32_t bits = 0;
+    for (uint32_t i = 0; i < 4; i++) {
+        bits |= modeBit((lineHash ^ (column + i)) * FNV_PRIME) << i;
+    }
+    return bits;
+#endif
+}
+
+} // namespace
+
+GlyphFragmenter::GlyphFragmenter(uint32_t seed)
+    : seed_(seed)
+{
     LOG_TRACE(LogCategory::RENDER, "GlyphFragmenter created");
 }
 
@@ -14,9 +92,8 @@ GlyphFragmenter::~GlyphFragmenter() {
 FragmentMode GlyphFragmenter::getFragmentMode(size_t line, size_t column) const {
     uint32_t hash = hashPosition(line, column);
 
-    // Use least significant bit to determine top or bottom
-    // This gives a ~50/50 distribution
-    FragmentMode mode = (hash & 1) ? FragmentMode::Bottom : FragmentMode::Top;
+    // One well-mixed bit decides top or bottom, ~50/50 over a line
+    FragmentMode mode = modeBit(hash) ? FragmentMode::Bottom : FragmentMode::Top;
 
     LOG_TRACE(LogCategory::RENDER, "Glyph at (%zu, %zu): mode=%s",
         line, column, mode == FragmentMode::Top ? "TOP" : "BOTTOM");
@@ -24,24 +101,53 @@ FragmentMode GlyphFragmenter::getFragmentMode(size_t line, size_t column) const
     return mode;
 }
 
+void GlyphFragmenter::getFragmentModes(size_t line, size_t firstColumn, size_t count,
+                                       std::vector<uint64_t>& bits) const {
+    bits.assign((count + 63) / 64, 0);
+
+    // hashPosition truncates the column to 32 bits; so does the lane math
+    const uint32_t lineHash = hashLine(line);
+    const uint32_t first = static_cast<uint32_t>(firstColumn);
+    for (size_t word = 0; word < bits.size(); word++) {
+        uint64_t packed = 0;
+        for (uint32_t i = 0; i < 64; i += 4) {
+            packed |= static_cast<uint64_t>(modeBits4(lineHash, first + static_cast<uint32_t>(word * 64) + i)) << i;
+        }
+        bits[word] = packed;
+    }
+
+    // Columns past count stay clear
+    if (count % 64 != 0) {
+        bits.back() &= (uint64_t(1) << (count % 64)) - 1;
+    }
+}
+
 FragmentMode GlyphFragmenter::getFragmentModeByIndex(size_t index) const {
     // Simple hash: multiply by large prime and use LSB
     uint32_t hash = static_cast<uint32_t>(index * 2654435761u);
     return (hash & 1) ? FragmentMode::Bottom : FragmentMode::Top;
 }
 
+uint32_t GlyphFragmenter::hashLine(size_t line) const {
+    // FNV-1a over the finalized seed, then the line. The seed needs its
+    // own round: XORed into the same word as the line, seed s was the
+    // unseeded pattern of line ^ s, so nearby seeds only reordered rows.
+    uint32_t hash = FNV_OFFSET_BASIS;
+    hash ^= fmix32(seed_);
+    hash *= FNV_PRIME;
+    hash ^= static_cast<uint32_t>(line);
+    hash *= FNV_PRIME;
+    return hash;
+}
+
 uint32_t GlyphFragmenter::hashPosition(size_t line, size_t column) const {
     // FNV-1a hash variant for position
     // This ensures consistent results for same position
-    uint32_t hash = 2166136261u; // FNV offset basis
-
-    // Hash line
-    hash ^= static_cast<uint32_t>(line);
-    hash *= 16777619u; // FNV prime
+    uint32_t hash = hashLine(line);
 
     // Hash column
     hash ^= static_cast<uint32_t>(column);
-    hash *= 16777619u;
+    hash *= FNV_PRIME;
 
     return hash;
 }
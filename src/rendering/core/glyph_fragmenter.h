@@ -3,6 +3,7 @@
 
 #include <cstdint>
 #include <cstddef>
+#include <vector>
 
 namespace phantom {
 
@@ -14,19 +15,41 @@ enum class FragmentMode : uint32_t {
 
 class GlyphFragmenter {
 public:
-    GlyphFragmenter();
+    // The seed selects one of 2^32 patterns. Equal seeds always give equal
+    // modes for the same position, so a session can pick a fresh seed at
+    // startup and keep a stable pattern while it runs.
+    explicit GlyphFragmenter(uint32_t seed = 0);
     ~GlyphFragmenter();
 
+    void setSeed(uint32_t seed) { seed_ = seed; }
+    uint32_t getSeed() const { return seed_; }
+
     // Determine fragment mode based on position
     // Uses a consistent hash to ensure same position always gets same mode
     FragmentMode getFragmentMode(size_t line, size_t column) const;
 
+    // Modes of columns [firstColumn, firstColumn + count) of line, packed
+    // into bits: bit i (word i / 64, bit i % 64) set means Bottom for
+    // column firstColumn + i. Same modes as getFragmentMode, computed
+    // several columns per instruction.
+    void getFragmentModes(size_t line, size_t firstColumn, size_t count, std::vector<uint64_t>& bits) const;
+
+    // Mode of the i-th column of a span filled by getFragmentModes
+    static FragmentMode modeAt(const std::vector<uint64_t>& bits, size_t i) {
+        return (bits[i >> 6] >> (i & 63)) & 1 ? FragmentMode::Bottom : FragmentMode::Top;
+    }
+
     // Alternative: get fragment mode by character index
     FragmentMode getFragmentModeByIndex(size_t index) const;
 
 private:
     // Simple hash function for consistent fragmentation
     uint32_t hashPosition(size_t line, size_t column) const;
+
+    // First half of hashPosition, shared by every column of a line
+    uint32_t hashLine(size_t line) const;
+
+    uint32_t seed_;
 };
 
 } // namespace phantom
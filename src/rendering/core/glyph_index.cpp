@@ -0,0 +1,42 @@
+#include "glyph_index.h"
+
+namespace phantom {
+
+GlyphIndex::GlyphIndex()
+    : dense_(DENSE_LIMIT, NONE)
+{
+}
+
+void GlyphIndex::insert(u32 codepoint, u32 slot) {
+    if (codepoint < DENSE_LIMIT) {
+        if (dense_[codepoint] == NONE) {
+            size_++;
+        }
+        dense_[codepoint] = slot;
+        return;
+    }
+    if (sparse_.insert(codepoint, slot)) {
+        size_++;
+    }
+}
+
+void GlyphIndex::erase(u32 codepoint) {
+    if (codepoint < DENSE_LIMIT) {
+        if (dense_[codepoint] != NONE) {
+            dense_[codepoint] = NONE;
+            size_--;
+        }
+        return;
+    }
+    if (sparse_.erase(codepoint)) {
+        size_--;
+    }
+}
+
+void GlyphIndex::clear() {
+    dense_.assign(DENSE_LIMIT, NONE);
+    sparse_.clear();
+    size_ = 0;
+}
+
+} // namespace phantom
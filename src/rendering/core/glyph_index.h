@@ -0,0 +1,52 @@
+#ifndef PHANTOM_GLYPH_INDEX_H
+#define PHANTOM_GLYPH_INDEX_H
+
+#include <phantom_writer/types.h>
+#include "utils/open_hash_map.h"
+#include <vector>
+
+namespace phantom {
+
+// Maps a codepoint to its slot in a glyph array in O(1).
+// Codepoints below DENSE_LIMIT (Latin, Greek, Cyrillic, most punctuation
+// and symbols) use a direct-indexed table; the rest of Unicode goes into
+// an OpenHashMap. Slots are whatever the
+// owner stores them as, so missing glyphs simply have no entry.
+class GlyphIndex {
+public:
+    static constexpr u32 NONE = ~0u;
+    static constexpr u32 DENSE_LIMIT = 0x3000;
+
+    GlyphIndex();
+
+    // Slot for codepoint, or NONE
+    u32 find(u32 codepoint) const {
+        if (codepoint < DENSE_LIMIT) {
+            return dense_[codepoint];
+        }
+        return findSparse(codepoint);
+    }
+
+    // Add or replace the entry for codepoint
+    void insert(u32 codepoint, u32 slot);
+
+    // Remove codepoint's entry, if any
+    void erase(u32 codepoint);
+
+    void clear();
+    size_t size() const { return size_; }
+
+private:
+    u32 findSparse(u32 codepoint) const {
+        const u32* slot = sparse_.find(codepoint);
+        return slot ? *slot : NONE;
+    }
+
+    std::vector<u32> dense_;
+    OpenHashMap<u32, u32, NONE> sparse_;
+    size_t size_ = 0;
+};
+
+} // namespace phantom
+
+#endif // PHANTOM_GLYPH_INDEX_H
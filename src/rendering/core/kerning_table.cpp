@@ -0,0 +1,48 @@
+#include "kerning_table.h"
+
+namespace phantom {
+
+void KerningTable::set(u32 left, u32 right, float adjust) {
+    if (adjust == 0.0f) {
+        return;
+    }
+
+    u32 l = left - DENSE_FIRST;
+    u32 r = right - DENSE_FIRST;
+    if (l < DENSE_SIZE && r < DENSE_SIZE) {
+        if (dense_.empty()) {
+            dense_.assign(DENSE_SIZE * DENSE_SIZE, 0.0f);
+        }
+        float& slot = dense_[l * DENSE_SIZE + r];
+        if (slot == 0.0f) {
+            size_++;
+        }
+        slot = adjust;
+        return;
+    }
+    if (sparse_.insert(keyFor(left, right), adjust)) {
+        size_++;
+    }
+}
+
+void KerningTable::clear() {
+    dense_.clear();
+    sparse_.clear();
+    size_ = 0;
+}
+
+std::vector<KerningPair> KerningTable::pairs() const {
+    std::vector<KerningPair> result;
+    result.reserve(size_);
+    for (u32 i = 0; i < dense_.size(); i++) {
+        if (dense_[i] != 0.0f) {
+            result.push_back({DENSE_FIRST + i / DENSE_SIZE, DENSE_FIRST + i % DENSE_SIZE, dense_[i]});
+        }
+    }
+    sparse_.forEach([&result](u64 key, float adjust) {
+        result.push_back({static_cast<u32>(key >> 32), static_cast<u32>(key), adjust});
+    });
+    return result;
+}
+
+} // namespace phantom
@@ -0,0 +1,66 @@
+#ifndef PHANTOM_KERNING_TABLE_H
+#define PHANTOM_KERNING_TABLE_H
+
+#include <phantom_writer/types.h>
+#include "utils/open_hash_map.h"
+#include <vector>
+
+namespace phantom {
+
+// One kerning adjustment: pen offset in pixels between left and right
+struct KerningPair {
+    u32 left;
+    u32 right;
+    float adjust;
+};
+
+// Kerning adjustments precomputed for a glyph set, looked up in O(1).
+// Pairs of printable ASCII characters, where nearly all kerning in prose
+// happens, live in a dense DENSE_SIZE x DENSE_SIZE table; every other
+// pair goes into an OpenHashMap keyed by both codepoints. Pairs
+// without kerning are not stored and read back as 0.
+class KerningTable {
+public:
+    static constexpr u32 DENSE_FIRST = 0x20;
+    static constexpr u32 DENSE_SIZE = 0x60;      // U+0020 - U+007F
+
+    // Adjustment to add to the pen between left and right
+    float get(u32 left, u32 right) const {
+        u32 l = left - DENSE_FIRST;
+        u32 r = right - DENSE_FIRST;
+        if (l < DENSE_SIZE && r < DENSE_SIZE) {
+            return dense_.empty() ? 0.0f : dense_[l * DENSE_SIZE + r];
+        }
+        return sparse_.empty() ? 0.0f : findSparse(left, right);
+    }
+
+    // Add or replace a pair (adjust 0 is ignored)
+    void set(u32 left, u32 right, float adjust);
+
+    void clear();
+    bool empty() const { return size_ == 0; }
+    size_t size() const { return size_; }
+
+    // Every stored pair, for serialization
+    std::vector<KerningPair> pairs() const;
+
+private:
+    static constexpr u64 EMPTY = ~0ull;
+
+    static u64 keyFor(u32 left, u32 right) {
+        return static_cast<u64>(left) << 32 | right;
+    }
+
+    float findSparse(u32 left, u32 right) const {
+        const float* adjust = sparse_.find(keyFor(left, right));
+        return adjust ? *adjust : 0.0f;
+    }
+
+    std::vector<float> dense_;      // Allocated with the first dense pair
+    OpenHashMap<u64, float, EMPTY> sparse_;
+    size_t size_ = 0;
+};
+
+} // namespace phantom
+
+#endif // PHANTOM_KERNING_TABLE_H
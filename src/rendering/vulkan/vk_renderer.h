@@ -37,6 +37,11 @@ public:
     VkExtent2D getSwapChainExtent() const { return swapChainExtent_; }
     VkCommandBuffer getCurrentCommandBuffer() const { return commandBuffers_[currentFrame_]; }
 
+    // Frame being recorded, 0 to MAX_FRAMES_IN_FLIGHT - 1. beginFrame waits
+    // for this frame's previous submission, so its per-frame resources are free.
+    uint32_t getCurrentFrame() const { return currentFrame_; }
+    static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
+
 private:
     // Initialization steps
     bool createInstance();
@@ -85,7 +90,6 @@ private:
     std::vector<VkSemaphore> renderFinishedSemaphores_;
     std::vector<VkFence> inFlightFences_;
 
-    static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
     uint32_t currentFrame_ = 0;
     uint32_t imageIndex_ = 0;
 
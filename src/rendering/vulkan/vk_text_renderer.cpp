@@ -1,23 +1,26 @@
 #include "vk_text_renderer.h"
 #include "vk_renderer.h"
-#include "rendering/core/font_loader.h"
+#include "rendering/core/glyph_cache.h"
 #include "rendering/core/glyph_fragmenter.h"
 #include "utils/logger.h"
+#include "utils/text_decode.h"
 #include <fstream>
 #include <cstring>
 #include <cmath>
+#include <algorithm>
 
 namespace phantom {
 
-// Helper function to create orthographic projection matrix
-static void createOrthographicMatrix(float* matrix, float left, float right, float bottom, float top) {
+// Helper function to create orthographic projection matrix. Vulkan clip
+// space has Y pointing down, so top maps to -1 and bottom to +1.
+static void createOrthographicMatrix(float* matrix, float left, float right, float top, float bottom) {
     memset(matrix, 0, 16 * sizeof(float));
 
     matrix[0] = 2.0f / (right - left);
-    matrix[5] = 2.0f / (top - bottom);
+    matrix[5] = 2.0f / (bottom - top);
     matrix[10] = -1.0f;
     matrix[12] = -(right + left) / (right - left);
-    matrix[13] = -(top + bottom) / (top - bottom);
+    matrix[13] = -(bottom + top) / (bottom - top);
     matrix[15] = 1.0f;
 }
 
@@ -30,16 +33,16 @@ VulkanTextRenderer::~VulkanTextRenderer() {
     cleanup();
 }
 
-bool VulkanTextRenderer::initialize(VulkanRenderer* renderer, VkRenderPass renderPass, const FontAtlas& atlas) {
+bool VulkanTextRenderer::initialize(VulkanRenderer* renderer, VkRenderPass renderPass, GlyphCache& glyphs) {
     LOG_INFO(LogCategory::RENDER, "Initializing Vulkan text renderer");
 
     renderer_ = renderer;
     renderPass_ = renderPass;
-    atlas_ = &atlas;
+    glyphs_ = &glyphs;
     device_ = renderer->getDevice();
 
     // Create glyph fragmenter
-    fragmenter_ = new GlyphFragmenter();
+    fragmenter_ = new GlyphFragmenter(fragmentSeed_);
     LOG_DEBUG(LogCategory::RENDER, "GlyphFragmenter created");
 
     if (!createDescriptorSet()) {
@@ -57,9 +60,8 @@ bool VulkanTextRenderer::initialize(VulkanRenderer* renderer, VkRenderPass rende
         return false;
     }
 
-    // Create vertex buffer (start with space for 100 characters = 600 vertices)
-    vertexBufferSize_ = 100 * 6 * sizeof(TextVertex);
-    // Buffer creation will be done when needed
+    // Vertex buffers are created by the first frame that draws text
+    frameVertices_.resize(VulkanRenderer::MAX_FRAMES_IN_FLIGHT);
 
     initialized_ = true;
     LOG_INFO(LogCategory::RENDER, "Vulkan text renderer initialized successfully");
@@ -77,13 +79,20 @@ void VulkanTextRenderer::cleanup() {
     if (device_ != VK_NULL_HANDLE) {
         vkDeviceWaitIdle(device_);
 
-        // Cleanup vertex buffer
-        if (vertexBuffer_ != VK_NULL_HANDLE) {
-            vkDestroyBuffer(device_, vertexBuffer_, nullptr);
-        }
-        if (vertexBufferMemory_ != VK_NULL_HANDLE) {
-            vkFreeMemory(device_, vertexBufferMemory_, nullptr);
+        // Cleanup vertex buffers
+        for (FrameVertices& frame : frameVertices_) {
+            freeRetiredVertexBuffers(frame);
+            if (frame.mapped != nullptr) {
+                vkUnmapMemory(device_, frame.memory);
+            }
+            if (frame.buffer != VK_NULL_HANDLE) {
+                vkDestroyBuffer(device_, frame.buffer, nullptr);
+            }
+            if (frame.memory != VK_NULL_HANDLE) {
+                vkFreeMemory(device_, frame.memory, nullptr);
+            }
         }
+        frameVertices_.clear();
 
         // Cleanup descriptor set
         if (descriptorPool_ != VK_NULL_HANDLE) {
@@ -93,6 +102,26 @@ void VulkanTextRenderer::cleanup() {
             vkDestroyDescriptorSetLayout(device_, descriptorSetLayout_, nullptr);
         }
 
+        // Cleanup staging slots
+        for (UploadSlot& slot : uploadSlots_) {
+            if (slot.mapped != nullptr) {
+                vkUnmapMemory(device_, slot.memory);
+            }
+            if (slot.buffer != VK_NULL_HANDLE) {
+                vkDestroyBuffer(device_, slot.buffer, nullptr);
+            }
+            if (slot.memory != VK_NULL_HANDLE) {
+                vkFreeMemory(device_, slot.memory, nullptr);
+            }
+            if (slot.commandBuffer != VK_NULL_HANDLE) {
+                vkFreeCommandBuffers(device_, renderer_->getCommandPool(), 1, &slot.commandBuffer);
+            }
+            if (slot.fence != VK_NULL_HANDLE) {
+                vkDestroyFence(device_, slot.fence, nullptr);
+            }
+        }
+        uploadSlots_.clear();
+
         // Cleanup font texture
         if (fontSampler_ != VK_NULL_HANDLE) {
             vkDestroySampler(device_, fontSampler_, nullptr);
@@ -171,7 +200,10 @@ bool VulkanTextRenderer::createPipeline() {
     if (!loadShader("shaders/text_vert.spv", vertShaderModule_)) {
         return false;
     }
-    if (!loadShader("shaders/text_frag.spv", fragShaderModule_)) {
+    // Distance field atlases need the shader that thresholds the field
+    const char* fragShader = glyphs_->getFormat() == GlyphFormat::SDF
+        ? "shaders/text_sdf_frag.spv" : "shaders/text_frag.spv";
+    if (!loadShader(fragShader, fragShaderModule_)) {
         return false;
     }
 
@@ -210,11 +242,11 @@ bool VulkanTextRenderer::createPipeline() {
     attributeDescriptions[1].format = VK_FORMAT_R32G32_SFLOAT;
     attributeDescriptions[1].offset = offsetof(TextVertex, texCoord);
 
-    // Fragment Mode
+    // Atlas page
     attributeDescriptions[2].binding = 0;
     attributeDescriptions[2].location = 2;
     attributeDescriptions[2].format = VK_FORMAT_R32_UINT;
-    attributeDescriptions[2].offset = offsetof(TextVertex, fragmentMode);
+    attributeDescriptions[2].offset = offsetof(TextVertex, page);
 
     VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
     vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
@@ -242,7 +274,8 @@ bool VulkanTextRenderer::createPipeline() {
     rasterizer.rasterizerDiscardEnable = VK_FALSE;
     rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
     rasterizer.lineWidth = 1.0f;
-    rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+    // Quads are flat on the screen; none face away
+    rasterizer.cullMode = VK_CULL_MODE_NONE;
     rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
     rasterizer.depthBiasEnable = VK_FALSE;
 
@@ -325,14 +358,391 @@ bool VulkanTextRenderer::createPipeline() {
     return true;
 }
 
+bool VulkanTextRenderer::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties, uint32_t& typeIndex) {
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(renderer_->getPhysicalDevice(), &memProperties);
+
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+        if ((typeFilter & (1u << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            typeIndex = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool VulkanTextRenderer::createUploadSlots(VkDeviceSize size) {
+    VkCommandBufferAllocateInfo commandInfo{};
+    commandInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    commandInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    commandInfo.commandPool = renderer_->getCommandPool();
+    commandInfo.commandBufferCount = 1;
+
+    // Signaled, so the first use of a slot does not wait
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+    uploadSlots_.resize(UPLOAD_SLOTS);
+    for (UploadSlot& slot : uploadSlots_) {
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = size;
+        bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        if (vkCreateBuffer(device_, &bufferInfo, nullptr, &slot.buffer) != VK_SUCCESS) {
+            LOG_ERROR(LogCategory::RENDER, "Failed to create font staging buffer");
+            return false;
+        }
+
+        VkMemoryRequirements requirements;
+        vkGetBufferMemoryRequirements(device_, slot.buffer, &requirements);
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = requirements.size;
+        if (!findMemoryType(requirements.memoryTypeBits,
+                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                            allocInfo.memoryTypeIndex) ||
+            vkAllocateMemory(device_, &allocInfo, nullptr, &slot.memory) != VK_SUCCESS) {
+            LOG_ERROR(LogCategory::RENDER, "Failed to allocate font staging memory");
+            return false;
+        }
+        vkBindBufferMemory(device_, slot.buffer, slot.memory, 0);
+        vkMapMemory(device_, slot.memory, 0, size, 0, &slot.mapped);
+
+        if (vkAllocateCommandBuffers(device_, &commandInfo, &slot.commandBuffer) != VK_SUCCESS ||
+            vkCreateFence(device_, &fenceInfo, nullptr, &slot.fence) != VK_SUCCESS) {
+            LOG_ERROR(LogCategory::RENDER, "Failed to create font upload commands");
+            return false;
+        }
+    }
+    return true;
+}
+
+VulkanTextRenderer::UploadSlot* VulkanTextRenderer::beginUpload() {
+    UploadSlot& slot = uploadSlots_[nextUploadSlot_];
+    nextUploadSlot_ = (nextUploadSlot_ + 1) % uploadSlots_.size();
+
+    // Normally signaled long ago; the rest of the queue is never waited for
+    if (vkWaitForFences(device_, 1, &slot.fence, VK_TRUE, UINT64_MAX) != VK_SUCCESS) {
+        return nullptr;
+    }
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (vkBeginCommandBuffer(slot.commandBuffer, &beginInfo) != VK_SUCCESS) {
+        return nullptr;
+    }
+    return &slot;
+}
+
+bool VulkanTextRenderer::submitUpload(UploadSlot& slot) {
+    vkEndCommandBuffer(slot.commandBuffer);
+
+    // Barriers in this submission order it after the frames already queued
+    // and before the frame being recorded, which is submitted later
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &slot.commandBuffer;
+
+    vkResetFences(device_, 1, &slot.fence);
+    if (vkQueueSubmit(renderer_->getGraphicsQueue(), 1, &submitInfo, slot.fence) != VK_SUCCESS) {
+        // Nothing will signal the fence now; leave the slot usable
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+        vkDestroyFence(device_, slot.fence, nullptr);
+        vkCreateFence(device_, &fenceInfo, nullptr, &slot.fence);
+        return false;
+    }
+    return true;
+}
+
+bool VulkanTextRenderer::createVertexBuffer(FrameVertices& frame, VkDeviceSize capacity) {
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = capacity;
+    bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(device_, &bufferInfo, nullptr, &frame.buffer) != VK_SUCCESS) {
+        LOG_ERROR(LogCategory::RENDER, "Failed to create text vertex buffer");
+        frame.buffer = VK_NULL_HANDLE;
+        return false;
+    }
+
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(device_, frame.buffer, &requirements);
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = requirements.size;
+    if (!findMemoryType(requirements.memoryTypeBits,
+                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                        allocInfo.memoryTypeIndex) ||
+        vkAllocateMemory(device_, &allocInfo, nullptr, &frame.memory) != VK_SUCCESS) {
+        LOG_ERROR(LogCategory::RENDER, "Failed to allocate text vertex memory");
+        vkDestroyBuffer(device_, frame.buffer, nullptr);
+        frame.buffer = VK_NULL_HANDLE;
+        frame.memory = VK_NULL_HANDLE;
+        return false;
+    }
+    vkBindBufferMemory(device_, frame.buffer, frame.memory, 0);
+    if (vkMapMemory(device_, frame.memory, 0, capacity, 0, &frame.mapped) != VK_SUCCESS) {
+        LOG_ERROR(LogCategory::RENDER, "Failed to map text vertex memory");
+        vkDestroyBuffer(device_, frame.buffer, nullptr);
+        vkFreeMemory(device_, frame.memory, nullptr);
+        frame.buffer = VK_NULL_HANDLE;
+        frame.memory = VK_NULL_HANDLE;
+        frame.mapped = nullptr;
+        return false;
+    }
+
+    frame.capacity = capacity;
+    frame.used = 0;
+    return true;
+}
+
+void VulkanTextRenderer::freeRetiredVertexBuffers(FrameVertices& frame) {
+    for (VkBuffer buffer : frame.retiredBuffers) {
+        vkDestroyBuffer(device_, buffer, nullptr);
+    }
+    for (VkDeviceMemory memory : frame.retiredMemory) {
+        vkUnmapMemory(device_, memory);
+        vkFreeMemory(device_, memory, nullptr);
+    }
+    frame.retiredBuffers.clear();
+    frame.retiredMemory.clear();
+}
+
+VulkanTextRenderer::FrameVertices* VulkanTextRenderer::reserveVertices(VkDeviceSize size, VkDeviceSize& offset) {
+    FrameVertices& frame = frameVertices_[renderer_->getCurrentFrame()];
+
+    if (frame.used + size > frame.capacity) {
+        // Draws already recorded this frame read the old buffer, so it is
+        // kept until the frame's fence has been waited on again
+        if (frame.buffer != VK_NULL_HANDLE) {
+            frame.retiredBuffers.push_back(frame.buffer);
+            frame.retiredMemory.push_back(frame.memory);
+            frame.buffer = VK_NULL_HANDLE;
+            frame.memory = VK_NULL_HANDLE;
+            frame.mapped = nullptr;
+        }
+
+        VkDeviceSize capacity = std::max(frame.capacity * 2, INITIAL_VERTEX_BYTES);
+        while (capacity < size) {
+            capacity *= 2;
+        }
+        if (!createVertexBuffer(frame, capacity)) {
+            frame.capacity = 0;
+            frame.used = 0;
+            return nullptr;
+        }
+    }
+
+    offset = frame.used;
+    frame.used += size;
+    return &frame;
+}
+
+void VulkanTextRenderer::beginFrame() {
+    if (!initialized_) {
+        return;
+    }
+
+    // VulkanRenderer::beginFrame waited for this frame's last submission,
+    // so nothing reads its vertices any more
+    FrameVertices& frame = frameVertices_[renderer_->getCurrentFrame()];
+    freeRetiredVertexBuffers(frame);
+    frame.used = 0;
+}
+
 bool VulkanTextRenderer::createFontTexture() {
     LOG_DEBUG(LogCategory::RENDER, "Creating font texture");
 
-    // TODO: Implement texture creation from atlas bitmap
-    // This will require access to VulkanRenderer's physical device and queues
-    // For FASE 1B, we'll create a stub that will be implemented
+    const uint32_t pageSize = static_cast<uint32_t>(glyphs_->getPageSize());
+    const uint32_t layers = glyphs_->getMaxPages();
+
+    // Glyph cache pages as layers of one 8-bit array texture
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = VK_FORMAT_R8_UNORM;
+    imageInfo.extent = {pageSize, pageSize, 1};
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = layers;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    if (vkCreateImage(device_, &imageInfo, nullptr, &fontImage_) != VK_SUCCESS) {
+        LOG_ERROR(LogCategory::RENDER, "Failed to create font image");
+        return false;
+    }
+
+    VkMemoryRequirements imageRequirements;
+    vkGetImageMemoryRequirements(device_, fontImage_, &imageRequirements);
 
-    LOG_INFO(LogCategory::RENDER, "Font texture created successfully (stub)");
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = imageRequirements.size;
+    if (!findMemoryType(imageRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, allocInfo.memoryTypeIndex) ||
+        vkAllocateMemory(device_, &allocInfo, nullptr, &fontImageMemory_) != VK_SUCCESS) {
+        LOG_ERROR(LogCategory::RENDER, "Failed to allocate font image memory");
+        return false;
+    }
+    vkBindImageMemory(device_, fontImage_, fontImageMemory_, 0);
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = fontImage_;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+    viewInfo.format = VK_FORMAT_R8_UNORM;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = layers;
+
+    if (vkCreateImageView(device_, &viewInfo, nullptr, &fontImageView_) != VK_SUCCESS) {
+        LOG_ERROR(LogCategory::RENDER, "Failed to create font image view");
+        return false;
+    }
+
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.maxLod = 0.0f;
+
+    if (vkCreateSampler(device_, &samplerInfo, nullptr, &fontSampler_) != VK_SUCCESS) {
+        LOG_ERROR(LogCategory::RENDER, "Failed to create font sampler");
+        return false;
+    }
+
+    // Staging slots large enough for one whole page each
+    if (!createUploadSlots(static_cast<VkDeviceSize>(pageSize) * pageSize)) {
+        return false;
+    }
+
+    // Every layer starts out readable; a page is uploaded in full before
+    // any glyph on it is drawn, because new pages start fully dirty
+    UploadSlot* slot = beginUpload();
+    if (!slot) {
+        return false;
+    }
+
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = fontImage_;
+    barrier.subresourceRange = viewInfo.subresourceRange;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    vkCmdPipelineBarrier(slot->commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &barrier);
+    if (!submitUpload(*slot)) {
+        return false;
+    }
+
+    // Point the descriptor set at the texture
+    VkDescriptorImageInfo descriptorImage{};
+    descriptorImage.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    descriptorImage.imageView = fontImageView_;
+    descriptorImage.sampler = fontSampler_;
+
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = descriptorSet_;
+    write.dstBinding = 0;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.descriptorCount = 1;
+    write.pImageInfo = &descriptorImage;
+    vkUpdateDescriptorSets(device_, 1, &write, 0, nullptr);
+
+    LOG_INFO(LogCategory::RENDER, "Font texture created: %u pages of %ux%u", layers, pageSize, pageSize);
+    return uploadGlyphPages();
+}
+
+bool VulkanTextRenderer::uploadGlyphPages() {
+    const int pageSize = glyphs_->getPageSize();
+
+    for (uint32_t page = 0; page < glyphs_->getPageCount(); page++) {
+        AtlasRect rect;
+        if (!glyphs_->takeDirtyRect(page, rect)) {
+            continue;
+        }
+
+        UploadSlot* slot = beginUpload();
+        if (!slot) {
+            return false;
+        }
+        VkCommandBuffer commandBuffer = slot->commandBuffer;
+
+        // Only the changed rectangle, tightly packed
+        const std::vector<u8>& bitmap = glyphs_->getPageBitmap(page);
+        u8* staging = static_cast<u8*>(slot->mapped);
+        for (int y = 0; y < rect.height; y++) {
+            memcpy(staging + static_cast<size_t>(y) * rect.width,
+                   &bitmap[static_cast<size_t>(rect.y + y) * pageSize + rect.x], rect.width);
+        }
+
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = fontImage_;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.baseArrayLayer = page;
+        barrier.subresourceRange.layerCount = 1;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        VkBufferImageCopy region{};
+        region.bufferOffset = 0;
+        region.bufferRowLength = 0;     // Tightly packed
+        region.bufferImageHeight = 0;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = 0;
+        region.imageSubresource.baseArrayLayer = page;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = {rect.x, rect.y, 0};
+        region.imageExtent = {static_cast<uint32_t>(rect.width), static_cast<uint32_t>(rect.height), 1};
+        vkCmdCopyBufferToImage(commandBuffer, slot->buffer, fontImage_, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                             0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        if (!submitUpload(*slot)) {
+            LOG_ERROR(LogCategory::RENDER, "Failed to upload glyph cache page %u", page);
+            return false;
+        }
+
+        LOG_TRACE(LogCategory::RENDER, "Uploaded page %u region (%d,%d) %dx%d",
+                  page, rect.x, rect.y, rect.width, rect.height);
+    }
     return true;
 }
 
@@ -356,7 +766,34 @@ bool VulkanTextRenderer::createDescriptorSet() {
         return false;
     }
 
-    LOG_INFO(LogCategory::RENDER, "Descriptor set created successfully (stub)");
+    // One set for the font texture; it is written once the texture exists
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSize.descriptorCount = 1;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = 1;
+
+    if (vkCreateDescriptorPool(device_, &poolInfo, nullptr, &descriptorPool_) != VK_SUCCESS) {
+        LOG_ERROR(LogCategory::RENDER, "Failed to create descriptor pool");
+        return false;
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = descriptorPool_;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &descriptorSetLayout_;
+
+    if (vkAllocateDescriptorSets(device_, &allocInfo, &descriptorSet_) != VK_SUCCESS) {
+        LOG_ERROR(LogCategory::RENDER, "Failed to allocate descriptor set");
+        return false;
+    }
+
+    LOG_INFO(LogCategory::RENDER, "Descriptor set created successfully");
     return true;
 }
 
@@ -366,7 +803,14 @@ void VulkanTextRenderer::updateProjection(int width, int height) {
     // Create orthographic projection matrix
     // Origin at top-left, Y-axis points down (standard for text rendering)
     createOrthographicMatrix(projectionMatrix_, 0.0f, static_cast<float>(width),
-                            static_cast<float>(height), 0.0f);
+                            0.0f, static_cast<float>(height));
+}
+
+void VulkanTextRenderer::setFragmentSeed(uint32_t seed) {
+    fragmentSeed_ = seed;
+    if (fragmenter_ != nullptr) {
+        fragmenter_->setSeed(seed);
+    }
 }
 
 void VulkanTextRenderer::renderText(VkCommandBuffer commandBuffer, const std::string& text,
@@ -382,40 +826,91 @@ void VulkanTextRenderer::renderText(VkCommandBuffer commandBuffer, const std::st
     std::vector<TextVertex> vertices;
     vertices.reserve(text.length() * 6); // 6 vertices per character (2 triangles)
 
+    // Draw from glyphs rasterized near the requested size; scale only
+    // covers what is left between that size and the one requested
+    const float targetSize = glyphs_->getPixelSize() * scale;
+    const u32 size = glyphs_->selectSize(targetSize);
+    scale = targetSize / glyphs_->getPixelSize(size);
+
+    // Rasterize this frame's new glyphs as one parallel batch rather than
+    // one at a time inside the loop below
+    std::vector<u32> uncached;
+    for (const char* scan = text.data(), *scanEnd = scan + text.size(); scan < scanEnd;) {
+        u32 codepoint = nextCodepoint(scan, scanEnd);
+        if (codepoint != '\n' && !glyphs_->isResolved(codepoint, size)) {
+            uncached.push_back(codepoint);
+        }
+    }
+    if (!uncached.empty()) {
+        glyphs_->prefetch(uncached, size);
+    }
+
     float cursorX = x;
     float cursorY = y;
     size_t charIndex = 0;
     size_t currentLine = 0;
     size_t currentColumn = 0;
+    u32 previous = 0;   // Left side of the kerning pair; 0 at line starts
+
+    const char* it = text.data();
+    const char* end = it + text.size();
+
+    // Fragment modes of the current line, computed for the whole line at
+    // once. Sized by its bytes, which are never fewer than its columns.
+    std::vector<uint64_t> lineModes;
+    auto fillLineModes = [&]() {
+        if (!disableFragmentation) {
+            const void* newline = std::memchr(it, '\n', static_cast<size_t>(end - it));
+            const char* lineEnd = newline ? static_cast<const char*>(newline) : end;
+            fragmenter_->getFragmentModes(currentLine, 0, static_cast<size_t>(lineEnd - it), lineModes);
+        }
+    };
+    fillLineModes();
+
+    while (it < end) {
+        u32 codepoint = nextCodepoint(it, end);
 
-    for (char ch : text) {
         // Handle newlines
-        if (ch == '\n') {
+        if (codepoint == '\n') {
             cursorX = x;
-            cursorY += atlas_->lineHeight * scale;
+            cursorY += glyphs_->getLineHeight(size) * scale;
             currentLine++;
             currentColumn = 0;
             charIndex++;
+            previous = 0;
+            fillLineModes();
             continue;
         }
 
-        // Get glyph from atlas
-        if (ch < 32 || ch > 126) {
+        // Rasterized on first use; characters the font lacks take no space
+        const Glyph* found = glyphs_->get(codepoint, size);
+        if (!found) {
             charIndex++;
             currentColumn++;
-            continue; // Skip non-printable characters
+            previous = 0;
+            continue;
         }
+        const Glyph& glyph = *found;
+
+        // Precomputed pair adjustment, one table lookup
+        cursorX += glyphs_->getKerning(previous, codepoint, size) * scale;
+        previous = codepoint;
 
-        const Glyph& glyph = atlas_->glyphs[ch - 32];
+        // Blank glyphs (space) only advance
+        if (glyph.width == 0 || glyph.height == 0) {
+            cursorX += glyph.advance * scale;
+            charIndex++;
+            currentColumn++;
+            continue;
+        }
 
-        // Determine fragment mode using the fragmenter
+        // Determine fragment mode from the line's precomputed modes
         FragmentMode mode;
         if (disableFragmentation) {
             mode = FragmentMode::None;
         } else {
-            mode = fragmenter_->getFragmentMode(currentLine, currentColumn);
+            mode = GlyphFragmenter::modeAt(lineModes, currentColumn);
         }
-        uint32_t fragmentMode = static_cast<uint32_t>(mode);
 
         // Calculate quad positions
         float x0 = cursorX + glyph.xOffset * scale;
@@ -429,16 +924,25 @@ void VulkanTextRenderer::renderText(VkCommandBuffer commandBuffer, const std::st
         float u1 = glyph.x1;
         float v1 = glyph.y1;
 
+        // Fragmentation stretches one half of the glyph over the whole quad.
+        // The half is cut from the glyph's own rectangle, not the page.
+        if (mode == FragmentMode::Top) {
+            v1 = 0.5f * (v0 + v1);
+        } else if (mode == FragmentMode::Bottom) {
+            v0 = 0.5f * (v0 + v1);
+        }
+
         // Create 6 vertices for two triangles (quad)
         // Triangle 1: top-left, bottom-left, top-right
-        vertices.push_back({{x0, y0}, {u0, v0}, fragmentMode});
-        vertices.push_back({{x0, y1}, {u0, v1}, fragmentMode});
-        vertices.push_back({{x1, y0}, {u1, v0}, fragmentMode});
+        uint32_t page = glyph.page;
+        vertices.push_back({{x0, y0}, {u0, v0}, page});
+        vertices.push_back({{x0, y1}, {u0, v1}, page});
+        vertices.push_back({{x1, y0}, {u1, v0}, page});
 
         // Triangle 2: top-right, bottom-left, bottom-right
-        vertices.push_back({{x1, y0}, {u1, v0}, fragmentMode});
-        vertices.push_back({{x0, y1}, {u0, v1}, fragmentMode});
-        vertices.push_back({{x1, y1}, {u1, v1}, fragmentMode});
+        vertices.push_back({{x1, y0}, {u1, v0}, page});
+        vertices.push_back({{x0, y1}, {u0, v1}, page});
+        vertices.push_back({{x1, y1}, {u1, v1}, page});
 
         // Advance cursor
         cursorX += glyph.advance * scale;
@@ -453,8 +957,49 @@ void VulkanTextRenderer::renderText(VkCommandBuffer commandBuffer, const std::st
     LOG_TRACE(LogCategory::RENDER, "Rendering %zu characters (%zu vertices)",
               text.length(), vertices.size());
 
-    // TODO: Upload vertices to GPU and draw
-    // For now, this is a stub that will be implemented when we integrate with VulkanRenderer
+    // Glyphs first seen while building the quads go up before the draw
+    if (!uploadGlyphPages()) {
+        return;
+    }
+
+    // Append the quads to this frame's vertex buffer
+    const VkDeviceSize bytes = vertices.size() * sizeof(TextVertex);
+    VkDeviceSize offset = 0;
+    FrameVertices* frame = reserveVertices(bytes, offset);
+    if (!frame) {
+        return;
+    }
+    memcpy(static_cast<u8*>(frame->mapped) + offset, vertices.data(), bytes);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout_,
+                            0, 1, &descriptorSet_, 0, nullptr);
+
+    // Viewport and scissor are dynamic and cover the whole swap chain image
+    const VkExtent2D extent = renderer_->getSwapChainExtent();
+    VkViewport viewport{};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = static_cast<float>(extent.width);
+    viewport.height = static_cast<float>(extent.height);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+    VkRect2D scissor{};
+    scissor.offset = {0, 0};
+    scissor.extent = extent;
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    // Projection followed by opacity, as the PushConstants block in text.vert
+    float pushConstants[17];
+    memcpy(pushConstants, projectionMatrix_, sizeof(projectionMatrix_));
+    pushConstants[16] = opacity;
+    vkCmdPushConstants(commandBuffer, pipelineLayout_, VK_SHADER_STAGE_VERTEX_BIT,
+                       0, sizeof(pushConstants), pushConstants);
+
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &frame->buffer, &offset);
+    vkCmdDraw(commandBuffer, static_cast<uint32_t>(vertices.size()), 1, 0, 0);
 }
 
 } // namespace phantom
@@ -10,34 +10,84 @@ namespace phantom {
 
 class VulkanRenderer;
 class GlyphFragmenter;
-struct FontAtlas;
+class GlyphCache;
 
 struct TextVertex {
     float position[2];    // x, y
     float texCoord[2];    // u, v
-    uint32_t fragmentMode; // 0=top, 1=bottom
+    uint32_t page;        // Glyph cache page (texture array layer)
 };
+// Matches the vertex input of text.vert: locations 0, 1 and 2 at these offsets
+static_assert(sizeof(TextVertex) == 20, "TextVertex layout changed");
 
 class VulkanTextRenderer {
 public:
     VulkanTextRenderer();
     ~VulkanTextRenderer();
 
-    bool initialize(VulkanRenderer* renderer, VkRenderPass renderPass, const FontAtlas& atlas);
+    bool initialize(VulkanRenderer* renderer, VkRenderPass renderPass, GlyphCache& glyphs);
     void cleanup();
 
-    // Render text at specified position with opacity
+    // Start a frame's text. Call after VulkanRenderer::beginFrame and before
+    // the frame's first renderText.
+    void beginFrame();
+
+    // Render text at specified position with opacity. scale is relative to
+    // the primary font size; glyphs come from the cached size nearest to it.
     void renderText(VkCommandBuffer commandBuffer, const std::string& text, float x, float y, float scale = 1.0f, float opacity = 1.0f, bool disableFragmentation = false);
 
     // Update projection matrix (call when window resizes)
     void updateProjection(int width, int height);
 
+    // Seed of the fragmentation pattern (default 0). Positions keep their
+    // fragment mode for as long as the seed stays the same.
+    void setFragmentSeed(uint32_t seed);
+
 private:
     bool createPipeline();
     bool createFontTexture();
     bool createDescriptorSet();
     bool loadShader(const std::string& filename, VkShaderModule& shaderModule);
 
+    // Host-visible buffer a page region is copied through, with the command
+    // buffer that copies it and a fence that signals when the copy is done
+    struct UploadSlot {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        void* mapped = nullptr;
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
+    };
+
+    // Copy the regions of glyph cache pages changed since the last upload
+    bool uploadGlyphPages();
+    bool createUploadSlots(VkDeviceSize size);
+    // Next slot in the ring, waiting only for its own previous copy; its
+    // command buffer is begun
+    UploadSlot* beginUpload();
+    bool submitUpload(UploadSlot& slot);
+    bool findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties, uint32_t& typeIndex);
+
+    // Host-visible buffer the quads of one frame in flight are written to.
+    // Each renderText call appends its quads and draws them from there.
+    struct FrameVertices {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        void* mapped = nullptr;
+        VkDeviceSize capacity = 0;
+        VkDeviceSize used = 0;
+        // Outgrown buffers that earlier draws of the frame still read; freed
+        // once the frame comes round again
+        std::vector<VkBuffer> retiredBuffers;
+        std::vector<VkDeviceMemory> retiredMemory;
+    };
+
+    // Room for size bytes of vertices in the current frame's buffer, growing
+    // it if needed
+    FrameVertices* reserveVertices(VkDeviceSize size, VkDeviceSize& offset);
+    bool createVertexBuffer(FrameVertices& frame, VkDeviceSize capacity);
+    void freeRetiredVertexBuffers(FrameVertices& frame);
+
     VulkanRenderer* renderer_ = nullptr;
     VkDevice device_ = VK_NULL_HANDLE;
     VkRenderPass renderPass_ = VK_NULL_HANDLE;
@@ -50,30 +100,37 @@ private:
     VkShaderModule vertShaderModule_ = VK_NULL_HANDLE;
     VkShaderModule fragShaderModule_ = VK_NULL_HANDLE;
 
-    // Font texture
+    // Font texture: one array layer per glyph cache page
     VkImage fontImage_ = VK_NULL_HANDLE;
     VkDeviceMemory fontImageMemory_ = VK_NULL_HANDLE;
     VkImageView fontImageView_ = VK_NULL_HANDLE;
     VkSampler fontSampler_ = VK_NULL_HANDLE;
 
+    // Ring of staging slots. Uploads go to the queue ahead of the frame that
+    // draws with them and are never waited on, unless a burst of dirty pages
+    // laps the ring.
+    std::vector<UploadSlot> uploadSlots_;
+    size_t nextUploadSlot_ = 0;
+    static constexpr size_t UPLOAD_SLOTS = 4;
+
     // Descriptor set
     VkDescriptorSetLayout descriptorSetLayout_ = VK_NULL_HANDLE;
     VkDescriptorPool descriptorPool_ = VK_NULL_HANDLE;
     VkDescriptorSet descriptorSet_ = VK_NULL_HANDLE;
 
-    // Vertex buffer for text quads
-    VkBuffer vertexBuffer_ = VK_NULL_HANDLE;
-    VkDeviceMemory vertexBufferMemory_ = VK_NULL_HANDLE;
-    size_t vertexBufferSize_ = 0;
+    // Vertex buffers for text quads, one per frame in flight
+    std::vector<FrameVertices> frameVertices_;
+    static constexpr VkDeviceSize INITIAL_VERTEX_BYTES = 1024 * 6 * sizeof(TextVertex);
 
     // Projection matrix
-    float projectionMatrix_[16];
+    float projectionMatrix_[16] = {};
 
-    // Font atlas reference
-    const FontAtlas* atlas_ = nullptr;
+    // Glyphs rasterized on demand
+    GlyphCache* glyphs_ = nullptr;
 
     // Glyph fragmenter
     GlyphFragmenter* fragmenter_ = nullptr;
+    uint32_t fragmentSeed_ = 0;
 
     bool initialized_ = false;
 };
@@ -0,0 +1,605 @@
+#include "chacha20_poly1305.h"
+#include "secure_memory.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+    #define PHANTOM_CHACHA_X86 1
+    #include <immintrin.h>
+    #ifdef _MSC_VER
+        #include <intrin.h>
+    #endif
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+    #define PHANTOM_CHACHA_NEON 1
+    #include <arm_neon.h>
+#endif
+
+#if defined(_MSC_VER) && !defined(PHANTOM_CHACHA_X86)
+    #include <intrin.h>
+#endif
+
+#if defined(PHANTOM_CHACHA_X86) && (defined(__GNUC__) || defined(__clang__))
+    #define PHANTOM_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+    #define PHANTOM_TARGET_AVX2
+#endif
+
+namespace phantom {
+
+namespace {
+
+inline u32 load32(const u8* p) {
+    u32 v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline u64 load64(const u8* p) {
+    u64 v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline void store64(u8* p, u64 v) {
+    std::memcpy(p, &v, sizeof(v));
+}
+
+// ---------------------------------------------------------------------------
+// ChaCha20
+// ---------------------------------------------------------------------------
+
+constexpr size_t CHACHA_BLOCK = 64;
+
+inline u32 rotl32(u32 x, int n) {
+    return (x << n) | (x >> (32 - n));
+}
+
+inline void quarterRound(u32& a, u32& b, u32& c, u32& d) {
+    a += b; d = rotl32(d ^ a, 16);
+    c += d; b = rotl32(b ^ c, 12);
+    a += b; d = rotl32(d ^ a, 8);
+    c += d; b = rotl32(b ^ c, 7);
+}
+
+void chachaBlock(const u32 input[16], u8 out[CHACHA_BLOCK]) {
+    u32 x[16];
+    std::memcpy(x, input, sizeof(x));
+
+    for (int round = 0; round < 10; round++) {
+        quarterRound(x[0], x[4], x[8], x[12]);
+        quarterRound(x[1], x[5], x[9], x[13]);
+        quarterRound(x[2], x[6], x[10], x[14]);
+        quarterRound(x[3], x[7], x[11], x[15]);
+        quarterRound(x[0], x[5], x[10], x[15]);
+        quarterRound(x[1], x[6], x[11], x[12]);
+        quarterRound(x[2], x[7], x[8], x[13]);
+        quarterRound(x[3], x[4], x[9], x[14]);
+    }
+
+    for (int i = 0; i < 16; i++) {
+        x[i] += input[i];
+    }
+    std::memcpy(out, x, CHACHA_BLOCK);
+    secureWipe(x, sizeof(x));
+}
+
+// Remaining bytes, one block at a time
+void chachaScalar(u32 state[16], const u8* in, u8* out, size_t size) {
+    u8 keystream[CHACHA_BLOCK];
+    while (size > 0) {
+        chachaBlock(state, keystream);
+        size_t take = size < CHACHA_BLOCK ? size : CHACHA_BLOCK;
+        for (size_t i = 0; i < take; i++) {
+            out[i] = in[i] ^ keystream[i];
+        }
+        state[12]++;
+        in += take;
+        out += take;
+        size -= take;
+    }
+    secureWipe(keystream, sizeof(keystream));
+}
+
+#if defined(PHANTOM_CHACHA_X86)
+
+// SSE2, 4 blocks: vector x[i] holds state word i of each block
+
+inline __m128i rotl16Sse2(__m128i x) {
+    return _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, 0xB1), 0xB1);
+}
+
+template <int N>
+inline __m128i rotlSse2(__m128i x) {
+    return _mm_or_si128(_mm_slli_epi32(x, N), _mm_srli_epi32(x, 32 - N));
+}
+
+inline void quarterRoundSse2(__m128i& a, __m128i& b, __m128i& c, __m128i& d) {
+    a = _mm_add_epi32(a, b); d = rotl16Sse2(_mm_xor_si128(d, a));
+    c = _mm_add_epi32(c, d); b = rotlSse2<12>(_mm_xor_si128(b, c));
+    a = _mm_add_epi32(a, b); d = rotlSse2<8>(_mm_xor_si128(d, a));
+    c = _mm_add_epi32(c, d); b = rotlSse2<7>(_mm_xor_si128(b, c));
+}
+
+size_t chachaSse2(u32 state[16], const u8* in, u8* out, size_t size) {
+    constexpr size_t STRIDE = 4 * CHACHA_BLOCK;
+    size_t done = 0;
+
+    for (; done + STRIDE <= size; done += STRIDE) {
+        __m128i x[16];
+        __m128i input[16];
+        for (int i = 0; i < 16; i++) {
+            input[i] = _mm_set1_epi32(static_cast<int>(state[i]));
+        }
+        input[12] = _mm_add_epi32(input[12], _mm_set_epi32(3, 2, 1, 0));
+        for (int i = 0; i < 16; i++) {
+            x[i] = input[i];
+        }
+
+        for (int round = 0; round < 10; round++) {
+            quarterRoundSse2(x[0], x[4], x[8], x[12]);
+            quarterRoundSse2(x[1], x[5], x[9], x[13]);
+            quarterRoundSse2(x[2], x[6], x[10], x[14]);
+            quarterRoundSse2(x[3], x[7], x[11], x[15]);
+            quarterRoundSse2(x[0], x[5], x[10], x[15]);
+            quarterRoundSse2(x[1], x[6], x[11], x[12]);
+            quarterRoundSse2(x[2], x[7], x[8], x[13]);
+            quarterRoundSse2(x[3], x[4], x[9], x[14]);
+        }
+
+        // Transpose each group of four words into four blocks' 16-byte rows
+        for (int g = 0; g < 16; g += 4) {
+            __m128i a0 = _mm_add_epi32(x[g], input[g]);
+            __m128i a1 = _mm_add_epi32(x[g + 1], input[g + 1]);
+            __m128i a2 = _mm_add_epi32(x[g + 2], input[g + 2]);
+            __m128i a3 = _mm_add_epi32(x[g + 3], input[g + 3]);
+
+            __m128i t0 = _mm_unpacklo_epi32(a0, a1);
+            __m128i t1 = _mm_unpackhi_epi32(a0, a1);
+            __m128i t2 = _mm_unpacklo_epi32(a2, a3);
+            __m128i t3 = _mm_unpackhi_epi32(a2, a3);
+
+            __m128i rows[4] = {
+                _mm_unpacklo_epi64(t0, t2), _mm_unpackhi_epi64(t0, t2),
+                _mm_unpacklo_epi64(t1, t3), _mm_unpackhi_epi64(t1, t3),
+            };
+            for (int j = 0; j < 4; j++) {
+                size_t offset = done + j * CHACHA_BLOCK + g * 4;
+                __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + offset));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + offset), _mm_xor_si128(data, rows[j]));
+            }
+        }
+
+        state[12] += 4;
+    }
+    return done;
+}
+
+// AVX2, 8 blocks: the same layout in 256-bit vectors
+
+PHANTOM_TARGET_AVX2
+inline __m256i rotl16Avx2(__m256i x) {
+    const __m256i shuffle = _mm256_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13,
+                                             2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13);
+    return _mm256_shuffle_epi8(x, shuffle);
+}
+
+PHANTOM_TARGET_AVX2
+inline __m256i rotl8Avx2(__m256i x) {
+    const __m256i shuffle = _mm256_setr_epi8(3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14,
+                                             3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14);
+    return _mm256_shuffle_epi8(x, shuffle);
+}
+
+PHANTOM_TARGET_AVX2
+inline __m256i rotl12Avx2(__m256i x) {
+    return _mm256_or_si256(_mm256_slli_epi32(x, 12), _mm256_srli_epi32(x, 20));
+}
+
+PHANTOM_TARGET_AVX2
+inline __m256i rotl7Avx2(__m256i x) {
+    return _mm256_or_si256(_mm256_slli_epi32(x, 7), _mm256_srli_epi32(x, 25));
+}
+
+PHANTOM_TARGET_AVX2
+inline void quarterRoundAvx2(__m256i& a, __m256i& b, __m256i& c, __m256i& d) {
+    a = _mm256_add_epi32(a, b); d = rotl16Avx2(_mm256_xor_si256(d, a));
+    c = _mm256_add_epi32(c, d); b = rotl12Avx2(_mm256_xor_si256(b, c));
+    a = _mm256_add_epi32(a, b); d = rotl8Avx2(_mm256_xor_si256(d, a));
+    c = _mm256_add_epi32(c, d); b = rotl7Avx2(_mm256_xor_si256(b, c));
+}
+
+PHANTOM_TARGET_AVX2
+size_t chachaAvx2(u32 state[16], const u8* in, u8* out, size_t size) {
+    constexpr size_t STRIDE = 8 * CHACHA_BLOCK;
+    size_t done = 0;
+
+    for (; done + STRIDE <= size; done += STRIDE) {
+        __m256i x[16];
+        __m256i input[16];
+        for (int i = 0; i < 16; i++) {
+            input[i] = _mm256_set1_epi32(static_cast<int>(state[i]));
+        }
+        input[12] = _mm256_add_epi32(input[12], _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+        for (int i = 0; i < 16; i++) {
+            x[i] = input[i];
+        }
+
+        for (int round = 0; round < 10; round++) {
+            quarterRoundAvx2(x[0], x[4], x[8], x[12]);
+            quarterRoundAvx2(x[1], x[5], x[9], x[13]);
+            quarterRoundAvx2(x[2], x[6], x[10], x[14]);
+            quarterRoundAvx2(x[3], x[7], x[11], x[15]);
+            quarterRoundAvx2(x[0], x[5], x[10], x[15]);
+            quarterRoundAvx2(x[1], x[6], x[11], x[12]);
+            quarterRoundAvx2(x[2], x[7], x[8], x[13]);
+            quarterRoundAvx2(x[3], x[4], x[9], x[14]);
+        }
+
+        // rows[g][j]: words 4g..4g+3 of block j (low half) and block j + 4 (high half)
+        __m256i rows[4][4];
+        for (int g = 0; g < 4; g++) {
+            __m256i a0 = _mm256_add_epi32(x[4 * g], input[4 * g]);
+            __m256i a1 = _mm256_add_epi32(x[4 * g + 1], input[4 * g + 1]);
+            __m256i a2 = _mm256_add_epi32(x[4 * g + 2], input[4 * g + 2]);
+            __m256i a3 = _mm256_add_epi32(x[4 * g + 3], input[4 * g + 3]);
+
+            __m256i t0 = _mm256_unpacklo_epi32(a0, a1);
+            __m256i t1 = _mm256_unpackhi_epi32(a0, a1);
+            __m256i t2 = _mm256_unpacklo_epi32(a2, a3);
+            __m256i t3 = _mm256_unpackhi_epi32(a2, a3);
+
+            rows[g][0] = _mm256_unpacklo_epi64(t0, t2);
+            rows[g][1] = _mm256_unpackhi_epi64(t0, t2);
+            rows[g][2] = _mm256_unpacklo_epi64(t1, t3);
+            rows[g][3] = _mm256_unpackhi_epi64(t1, t3);
+        }
+
+        for (int j = 0; j < 4; j++) {
+            __m256i block[4] = {
+                _mm256_permute2x128_si256(rows[0][j], rows[1][j], 0x20),    // block j, words 0-7
+                _mm256_permute2x128_si256(rows[2][j], rows[3][j], 0x20),    // block j, words 8-15
+                _mm256_permute2x128_si256(rows[0][j], rows[1][j], 0x31),    // block j + 4, words 0-7
+                _mm256_permute2x128_si256(rows[2][j], rows[3][j], 0x31),    // block j + 4, words 8-15
+            };
+            size_t offsets[4] = {
+                done + j * CHACHA_BLOCK, done + j * CHACHA_BLOCK + 32,
+                done + (j + 4) * CHACHA_BLOCK, done + (j + 4) * CHACHA_BLOCK + 32,
+            };
+            for (int k = 0; k < 4; k++) {
+                __m256i data = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + offsets[k]));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + offsets[k]), _mm256_xor_si256(data, block[k]));
+            }
+        }
+
+        state[12] += 8;
+    }
+    return done;
+}
+
+bool detectAvx2() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    if (!osxsave || (_xgetbv(0) & 6) != 6) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+const bool g_avx2 = detectAvx2();
+
+#elif defined(PHANTOM_CHACHA_NEON)
+
+// NEON, 4 blocks: vector x[i] holds state word i of each block
+
+template <int N>
+inline uint32x4_t rotlNeon(uint32x4_t x) {
+    return vorrq_u32(vshlq_n_u32(x, N), vshrq_n_u32(x, 32 - N));
+}
+
+inline uint32x4_t rotl16Neon(uint32x4_t x) {
+    return vreinterpretq_u32_u16(vrev32q_u16(vreinterpretq_u16_u32(x)));
+}
+
+inline void quarterRoundNeon(uint32x4_t& a, uint32x4_t& b, uint32x4_t& c, uint32x4_t& d) {
+    a = vaddq_u32(a, b); d = rotl16Neon(veorq_u32(d, a));
+    c = vaddq_u32(c, d); b = rotlNeon<12>(veorq_u32(b, c));
+    a = vaddq_u32(a, b); d = rotlNeon<8>(veorq_u32(d, a));
+    c = vaddq_u32(c, d); b = rotlNeon<7>(veorq_u32(b, c));
+}
+
+size_t chachaNeon(u32 state[16], const u8* in, u8* out, size_t size) {
+    constexpr size_t STRIDE = 4 * CHACHA_BLOCK;
+    static const u32 LANES[4] = {0, 1, 2, 3};
+    size_t done = 0;
+
+    for (; done + STRIDE <= size; done += STRIDE) {
+        uint32x4_t x[16];
+        uint32x4_t input[16];
+        for (int i = 0; i < 16; i++) {
+            input[i] = vdupq_n_u32(state[i]);
+        }
+        input[12] = vaddq_u32(input[12], vld1q_u32(LANES));
+        for (int i = 0; i < 16; i++) {
+            x[i] = input[i];
+        }
+
+        for (int round = 0; round < 10; round++) {
+            quarterRoundNeon(x[0], x[4], x[8], x[12]);
+            quarterRoundNeon(x[1], x[5], x[9], x[13]);
+            quarterRoundNeon(x[2], x[6], x[10], x[14]);
+            quarterRoundNeon(x[3], x[7], x[11], x[15]);
+            quarterRoundNeon(x[0], x[5], x[10], x[15]);
+            quarterRoundNeon(x[1], x[6], x[11], x[12]);
+            quarterRoundNeon(x[2], x[7], x[8], x[13]);
+            quarterRoundNeon(x[3], x[4], x[9], x[14]);
+        }
+
+        for (int g = 0; g < 16; g += 4) {
+            uint32x4x2_t t01 = vtrnq_u32(vaddq_u32(x[g], input[g]), vaddq_u32(x[g + 1], input[g + 1]));
+            uint32x4x2_t t23 = vtrnq_u32(vaddq_u32(x[g + 2], input[g + 2]), vaddq_u32(x[g + 3], input[g + 3]));
+
+            uint32x4_t rows[4] = {
+                vcombine_u32(vget_low_u32(t01.val[0]), vget_low_u32(t23.val[0])),
+                vcombine_u32(vget_low_u32(t01.val[1]), vget_low_u32(t23.val[1])),
+                vcombine_u32(vget_high_u32(t01.val[0]), vget_high_u32(t23.val[0])),
+                vcombine_u32(vget_high_u32(t01.val[1]), vget_high_u32(t23.val[1])),
+            };
+            for (int j = 0; j < 4; j++) {
+                size_t offset = done + j * CHACHA_BLOCK + g * 4;
+                uint8x16_t data = vld1q_u8(in + offset);
+                vst1q_u8(out + offset, veorq_u8(data, vreinterpretq_u8_u32(rows[j])));
+            }
+        }
+
+        state[12] += 4;
+    }
+    return done;
+}
+
+#endif
+
+void chachaInit(u32 state[16], const u8 key[CHACHA20_KEY_SIZE], const u8 nonce[CHACHA20_NONCE_SIZE], u32 counter) {
+    state[0] = 0x61707865;  // "expand 32-byte k"
+    state[1] = 0x3320646e;
+    state[2] = 0x79622d32;
+    state[3] = 0x6b206574;
+    for (int i = 0; i < 8; i++) {
+        state[4 + i] = load32(key + i * 4);
+    }
+    state[12] = counter;
+    for (int i = 0; i < 3; i++) {
+        state[13 + i] = load32(nonce + i * 4);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Poly1305: h = (h + block) * r mod 2^130 - 5, in three 44/44/42-bit limbs
+// ---------------------------------------------------------------------------
+
+#if defined(__SIZEOF_INT128__)
+
+using u128 = unsigned __int128;
+
+inline u128 mul64(u64 a, u64 b) { return static_cast<u128>(a) * b; }
+inline void add128(u128& out, u128 in) { out += in; }
+inline void add64(u128& out, u64 in) { out += in; }
+inline u64 shr128(u128 in, int shift) { return static_cast<u64>(in >> shift); }
+inline u64 lo128(u128 in) { return static_cast<u64>(in); }
+
+#else
+
+struct u128 {
+    u64 lo;
+    u64 hi;
+};
+
+inline u128 mul64(u64 a, u64 b) {
+    u128 out;
+#if defined(_M_X64)
+    out.lo = _umul128(a, b, &out.hi);
+#else
+    out.lo = a * b;
+    out.hi = __umulh(a, b);
+#endif
+    return out;
+}
+
+inline void add128(u128& out, u128 in) {
+    u64 lo = out.lo;
+    out.lo += in.lo;
+    out.hi += in.hi + (out.lo < lo);
+}
+
+inline void add64(u128& out, u64 in) {
+    u64 lo = out.lo;
+    out.lo += in;
+    out.hi += (out.lo < lo);
+}
+
+inline u64 shr128(u128 in, int shift) { return (in.lo >> shift) | (in.hi << (64 - shift)); }
+inline u64 lo128(u128 in) { return in.lo; }
+
+#endif
+
+constexpr u64 MASK44 = 0xfffffffffffull;
+constexpr u64 MASK42 = 0x3ffffffffffull;
+
+class Poly1305 {
+public:
+    explicit Poly1305(const u8 key[32]) {
+        u64 t0 = load64(key);
+        u64 t1 = load64(key + 8);
+        r_[0] = t0 & 0xffc0fffffffull;
+        r_[1] = ((t0 >> 44) | (t1 << 20)) & 0xfffffc0ffffull;
+        r_[2] = (t1 >> 24) & 0x00ffffffc0full;
+        pad_[0] = load64(key + 16);
+        pad_[1] = load64(key + 24);
+    }
+
+    ~Poly1305() {
+        secureWipe(this, sizeof(*this));
+    }
+
+    // Absorb data followed by zero padding to a 16-byte boundary (the AEAD layout)
+    void updatePadded(const u8* data, size_t size) {
+        size_t whole = size & ~static_cast<size_t>(15);
+        blocks(data, whole, 1ull << 40);
+        if (size > whole) {
+            u8 last[16] = {};
+            std::memcpy(last, data + whole, size - whole);
+            blocks(last, 16, 1ull << 40);
+        }
+    }
+
+    void updateLengths(u64 aadSize, u64 size) {
+        u8 lengths[16];
+        store64(lengths, aadSize);
+        store64(lengths + 8, size);
+        blocks(lengths, 16, 1ull << 40);
+    }
+
+    void finish(u8 tag[POLY1305_TAG_SIZE]) {
+        u64 h0 = h_[0], h1 = h_[1], h2 = h_[2];
+        u64 c;
+
+        // Fully carry h
+        c = h1 >> 44; h1 &= MASK44;
+        h2 += c; c = h2 >> 42; h2 &= MASK42;
+        h0 += c * 5; c = h0 >> 44; h0 &= MASK44;
+        h1 += c; c = h1 >> 44; h1 &= MASK44;
+        h2 += c; c = h2 >> 42; h2 &= MASK42;
+        h0 += c * 5; c = h0 >> 44; h0 &= MASK44;
+        h1 += c;
+
+        // g = h - p; keep h if that went negative
+        u64 g0 = h0 + 5; c = g0 >> 44; g0 &= MASK44;
+        u64 g1 = h1 + c; c = g1 >> 44; g1 &= MASK44;
+        u64 g2 = h2 + c - (1ull << 42);
+        c = (g2 >> 63) - 1;
+        g0 &= c; g1 &= c; g2 &= c;
+        c = ~c;
+        h0 = (h0 & c) | g0;
+        h1 = (h1 & c) | g1;
+        h2 = (h2 & c) | g2;
+
+        // h + s mod 2^128
+        u64 t0 = pad_[0];
+        u64 t1 = pad_[1];
+        h0 += t0 & MASK44; c = h0 >> 44; h0 &= MASK44;
+        h1 += (((t0 >> 44) | (t1 << 20)) & MASK44) + c; c = h1 >> 44; h1 &= MASK44;
+        h2 += ((t1 >> 24) & MASK42) + c; h2 &= MASK42;
+
+        store64(tag, h0 | (h1 << 44));
+        store64(tag + 8, (h1 >> 20) | (h2 << 24));
+    }
+
+private:
+    void blocks(const u8* m, size_t bytes, u64 hibit) {
+        const u64 r0 = r_[0], r1 = r_[1], r2 = r_[2];
+        const u64 s1 = r1 * (5 << 2);
+        const u64 s2 = r2 * (5 << 2);
+        u64 h0 = h_[0], h1 = h_[1], h2 = h_[2];
+
+        for (; bytes >= 16; m += 16, bytes -= 16) {
+            u64 t0 = load64(m);
+            u64 t1 = load64(m + 8);
+            h0 += t0 & MASK44;
+            h1 += ((t0 >> 44) | (t1 << 20)) & MASK44;
+            h2 += ((t1 >> 24) & MASK42) | hibit;
+
+            u128 d0 = mul64(h0, r0); add128(d0, mul64(h1, s2)); add128(d0, mul64(h2, s1));
+            u128 d1 = mul64(h0, r1); add128(d1, mul64(h1, r0)); add128(d1, mul64(h2, s2));
+            u128 d2 = mul64(h0, r2); add128(d2, mul64(h1, r1)); add128(d2, mul64(h2, r0));
+
+            u64 c = shr128(d0, 44); h0 = lo128(d0) & MASK44;
+            add64(d1, c); c = shr128(d1, 44); h1 = lo128(d1) & MASK44;
+            add64(d2, c); c = shr128(d2, 42); h2 = lo128(d2) & MASK42;
+            h0 += c * 5; c = h0 >> 44; h0 &= MASK44;
+            h1 += c;
+        }
+
+        h_[0] = h0;
+        h_[1] = h1;
+        h_[2] = h2;
+    }
+
+    u64 r_[3];
+    u64 h_[3] = {0, 0, 0};
+    u64 pad_[2];
+};
+
+void computeTag(const u8 key[CHACHA20_KEY_SIZE], const u8 nonce[CHACHA20_NONCE_SIZE],
+                const u8* aad, size_t aadSize, const u8* ciphertext, size_t size, u8 tag[POLY1305_TAG_SIZE]) {
+    // The one-time Poly1305 key is the first half of keystream block 0
+    u32 state[16];
+    chachaInit(state, key, nonce, 0);
+    u8 block[CHACHA_BLOCK];
+    chachaBlock(state, block);
+
+    Poly1305 mac(block);
+    mac.updatePadded(aad, aadSize);
+    mac.updatePadded(ciphertext, size);
+    mac.updateLengths(aadSize, size);
+    mac.finish(tag);
+
+    secureWipe(state, sizeof(state));
+    secureWipe(block, sizeof(block));
+}
+
+} // namespace
+
+void chacha20Xor(const u8 key[CHACHA20_KEY_SIZE], const u8 nonce[CHACHA20_NONCE_SIZE], u32 counter,
+                 const u8* in, u8* out, size_t size) {
+    u32 state[16];
+    chachaInit(state, key, nonce, counter);
+
+    size_t done = 0;
+#if defined(PHANTOM_CHACHA_X86)
+    if (g_avx2) {
+        done = chachaAvx2(state, in, out, size);
+    }
+    done += chachaSse2(state, in + done, out + done, size - done);
+#elif defined(PHANTOM_CHACHA_NEON)
+    done = chachaNeon(state, in, out, size);
+#endif
+    chachaScalar(state, in + done, out + done, size - done);
+
+    secureWipe(state, sizeof(state));
+}
+
+void aeadSeal(const u8 key[CHACHA20_KEY_SIZE], const u8 nonce[CHACHA20_NONCE_SIZE],
+              const u8* aad, size_t aadSize, const u8* in, u8* out, size_t size,
+              u8 tag[POLY1305_TAG_SIZE]) {
+    chacha20Xor(key, nonce, 1, in, out, size);
+    computeTag(key, nonce, aad, aadSize, out, size, tag);
+}
+
+bool aeadOpen(const u8 key[CHACHA20_KEY_SIZE], const u8 nonce[CHACHA20_NONCE_SIZE],
+              const u8* aad, size_t aadSize, const u8* in, u8* out, size_t size,
+              const u8 tag[POLY1305_TAG_SIZE]) {
+    u8 expected[POLY1305_TAG_SIZE];
+    computeTag(key, nonce, aad, aadSize, in, size, expected);
+    if (!secureEqual(expected, tag, sizeof(expected))) {
+        return false;
+    }
+    chacha20Xor(key, nonce, 1, in, out, size);
+    return true;
+}
+
+const char* chacha20Implementation() {
+#if defined(PHANTOM_CHACHA_X86)
+    return g_avx2 ? "avx2" : "sse2";
+#elif defined(PHANTOM_CHACHA_NEON)
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
+
+} // namespace phantom
@@ -0,0 +1,40 @@
+#ifndef PHANTOM_CHACHA20_POLY1305_H
+#define PHANTOM_CHACHA20_POLY1305_H
+
+#include <phantom_writer/types.h>
+#include <cstddef>
+
+namespace phantom {
+
+// ChaCha20-Poly1305 authenticated encryption (RFC 8439).
+//
+// ChaCha20 computes 8 blocks per iteration with AVX2 (chosen at run time)
+// or 4 with SSE2/NEON, each vector lane holding one block's state word.
+// Poly1305 uses 44-bit limbs with 64x64->128 multiplies. A seal or open
+// makes one pass for the cipher and one for the MAC, so callers should
+// work in cache-sized pieces (see the 64 KiB chunks in encryption.h).
+
+constexpr size_t CHACHA20_KEY_SIZE = 32;
+constexpr size_t CHACHA20_NONCE_SIZE = 12;
+constexpr size_t POLY1305_TAG_SIZE = 16;
+
+// XOR the keystream starting at block `counter` into in; in and out may be equal
+void chacha20Xor(const u8 key[CHACHA20_KEY_SIZE], const u8 nonce[CHACHA20_NONCE_SIZE], u32 counter,
+                 const u8* in, u8* out, size_t size);
+
+// Encrypt size bytes (in and out may be equal) and authenticate them with aad
+void aeadSeal(const u8 key[CHACHA20_KEY_SIZE], const u8 nonce[CHACHA20_NONCE_SIZE],
+              const u8* aad, size_t aadSize, const u8* in, u8* out, size_t size,
+              u8 tag[POLY1305_TAG_SIZE]);
+
+// Check the tag, then decrypt. On a mismatch nothing is written and false is returned.
+bool aeadOpen(const u8 key[CHACHA20_KEY_SIZE], const u8 nonce[CHACHA20_NONCE_SIZE],
+              const u8* aad, size_t aadSize, const u8* in, u8* out, size_t size,
+              const u8 tag[POLY1305_TAG_SIZE]);
+
+// "avx2", "sse2", "neon" or "scalar"
+const char* chacha20Implementation();
+
+} // namespace phantom
+
+#endif // PHANTOM_CHACHA20_POLY1305_H
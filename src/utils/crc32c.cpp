@@ -0,0 +1,163 @@
+#include "crc32c.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+    #define PHANTOM_CRC32C_X86 1
+    #include <nmmintrin.h>
+    #ifdef _MSC_VER
+        #include <intrin.h>
+    #endif
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+    #define PHANTOM_CRC32C_ARM 1
+    #include <arm_acle.h>
+#endif
+
+namespace phantom {
+
+namespace {
+
+constexpr u32 CRC32C_POLY = 0x82F63B78u; // Reflected Castagnoli polynomial
+
+struct Crc32cTables {
+    u32 table[8][256];
+
+    Crc32cTables() {
+        for (u32 i = 0; i < 256; i++) {
+            u32 crc = i;
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLY : (crc >> 1);
+            }
+            table[0][i] = crc;
+        }
+        for (u32 i = 0; i < 256; i++) {
+            for (int t = 1; t < 8; t++) {
+                table[t][i] = (table[t - 1][i] >> 8) ^ table[0][table[t - 1][i] & 0xFF];
+            }
+        }
+    }
+};
+
+const Crc32cTables& tables() {
+    static const Crc32cTables instance;
+    return instance;
+}
+
+// Slicing-by-8: processes 8 bytes per iteration with 8 table lookups
+u32 crc32cSoftware(u32 crc, const u8* p, size_t length) {
+    const Crc32cTables& t = tables();
+
+    while (length >= 8) {
+        u32 lo, hi;
+        std::memcpy(&lo, p, 4);
+        std::memcpy(&hi, p + 4, 4);
+        lo ^= crc;
+        crc = t.table[7][lo & 0xFF] ^ t.table[6][(lo >> 8) & 0xFF] ^
+              t.table[5][(lo >> 16) & 0xFF] ^ t.table[4][lo >> 24] ^
+              t.table[3][hi & 0xFF] ^ t.table[2][(hi >> 8) & 0xFF] ^
+              t.table[1][(hi >> 16) & 0xFF] ^ t.table[0][hi >> 24];
+        p += 8;
+        length -= 8;
+    }
+
+    while (length--) {
+        crc = (crc >> 8) ^ t.table[0][(crc ^ *p++) & 0xFF];
+    }
+
+    return crc;
+}
+
+#if defined(PHANTOM_CRC32C_X86)
+
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((target("sse4.2")))
+#endif
+u32 crc32cHardware(u32 crc, const u8* p, size_t length) {
+    // Align to 8 bytes so the main loop uses aligned 64-bit loads
+    while (length > 0 && (reinterpret_cast<uintptr_t>(p) & 7) != 0) {
+        crc = _mm_crc32_u8(crc, *p++);
+        length--;
+    }
+
+    u64 crc64 = crc;
+    while (length >= 8) {
+        u64 word;
+        std::memcpy(&word, p, 8);
+        crc64 = _mm_crc32_u64(crc64, word);
+        p += 8;
+        length -= 8;
+    }
+    crc = static_cast<u32>(crc64);
+
+    while (length--) {
+        crc = _mm_crc32_u8(crc, *p++);
+    }
+
+    return crc;
+}
+
+bool detectHardware() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 20)) != 0;
+#else
+    return __builtin_cpu_supports("sse4.2");
+#endif
+}
+
+#elif defined(PHANTOM_CRC32C_ARM)
+
+u32 crc32cHardware(u32 crc, const u8* p, size_t length) {
+    while (length > 0 && (reinterpret_cast<uintptr_t>(p) & 7) != 0) {
+        crc = __crc32cb(crc, *p++);
+        length--;
+    }
+
+    while (length >= 8) {
+        u64 word;
+        std::memcpy(&word, p, 8);
+        crc = __crc32cd(crc, word);
+        p += 8;
+        length -= 8;
+    }
+
+    while (length--) {
+        crc = __crc32cb(crc, *p++);
+    }
+
+    return crc;
+}
+
+bool detectHardware() {
+    return true; // Compiled with +crc, so the instruction is guaranteed
+}
+
+#else
+
+u32 crc32cHardware(u32 crc, const u8* p, size_t length) {
+    return crc32cSoftware(crc, p, length);
+}
+
+bool detectHardware() {
+    return false;
+}
+
+#endif
+
+const bool g_hardwareCrc = detectHardware();
+
+} // namespace
+
+u32 crc32c(const void* data, size_t length, u32 crc) {
+    const u8* p = static_cast<const u8*>(data);
+    crc = ~crc;
+    crc = g_hardwareCrc ? crc32cHardware(crc, p, length) : crc32cSoftware(crc, p, length);
+    return ~crc;
+}
+
+bool crc32cIsHardwareAccelerated() {
+    return g_hardwareCrc;
+}
+
+} // namespace phantom
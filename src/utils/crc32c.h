@@ -0,0 +1,22 @@
+#ifndef PHANTOM_CRC32C_H
+#define PHANTOM_CRC32C_H
+
+#include <phantom_writer/types.h>
+#include <cstddef>
+
+namespace phantom {
+
+// CRC-32C (Castagnoli polynomial), as used by iSCSI/ext4/btrfs.
+// Uses the SSE4.2 or ARMv8 CRC instructions when available, otherwise a
+// slicing-by-8 table implementation.
+//
+// Chaining works like zlib's crc32(): pass the previous result as `crc` to
+// continue a running checksum over several buffers.
+u32 crc32c(const void* data, size_t length, u32 crc = 0);
+
+// True if crc32c() is using a hardware instruction on this CPU
+bool crc32cIsHardwareAccelerated();
+
+} // namespace phantom
+
+#endif // PHANTOM_CRC32C_H
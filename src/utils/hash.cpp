@@ -0,0 +1,101 @@
+#include "hash.h"
+
+#include <cstring>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+namespace phantom {
+
+namespace {
+
+constexpr u64 P0 = 0xa0761d6478bd642full;
+constexpr u64 P1 = 0xe7037ed1a0b428dbull;
+constexpr u64 P2 = 0x8ebc6af09c88c6e3ull;
+constexpr u64 P3 = 0x589965cc75374cc3ull;
+
+inline u64 read64(const u8* p) {
+    u64 v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline u64 read32(const u8* p) {
+    u32 v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// Full 128-bit product of a and b, returned as (low, high)
+inline void multiply128(u64& a, u64& b) {
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 r = static_cast<unsigned __int128>(a) * b;
+    a = static_cast<u64>(r);
+    b = static_cast<u64>(r >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    a = _umul128(a, b, &b);
+#else
+    u64 ha = a >> 32, hb = b >> 32, la = static_cast<u32>(a), lb = static_cast<u32>(b);
+    u64 rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    u64 t = rl + (rm0 << 32);
+    u64 carry = t < rl;
+    u64 lo = t + (rm1 << 32);
+    carry += lo < t;
+    a = lo;
+    b = rh + (rm0 >> 32) + (rm1 >> 32) + carry;
+#endif
+}
+
+inline u64 mix(u64 a, u64 b) {
+    multiply128(a, b);
+    return a ^ b;
+}
+
+} // namespace
+
+u64 hash64(const void* data, size_t length, u64 seed) {
+    const u8* p = static_cast<const u8*>(data);
+    seed ^= mix(seed ^ P0, P1);
+
+    u64 a, b;
+    if (length <= 16) {
+        if (length >= 4) {
+            size_t step = (length >> 3) << 2;
+            a = (read32(p) << 32) | read32(p + step);
+            b = (read32(p + length - 4) << 32) | read32(p + length - 4 - step);
+        } else if (length > 0) {
+            a = (static_cast<u64>(p[0]) << 16) | (static_cast<u64>(p[length >> 1]) << 8) | p[length - 1];
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = length;
+        if (i > 48) {
+            u64 s1 = seed, s2 = seed;
+            do {
+                seed = mix(read64(p) ^ P1, read64(p + 8) ^ seed);
+                s1 = mix(read64(p + 16) ^ P2, read64(p + 24) ^ s1);
+                s2 = mix(read64(p + 32) ^ P3, read64(p + 40) ^ s2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= s1 ^ s2;
+        }
+        while (i > 16) {
+            seed = mix(read64(p) ^ P1, read64(p + 8) ^ seed);
+            p += 16;
+            i -= 16;
+        }
+        a = read64(p + i - 16);
+        b = read64(p + i - 8);
+    }
+
+    a ^= P1;
+    b ^= seed;
+    multiply128(a, b);
+    return mix(a ^ P0 ^ length, b ^ P1);
+}
+
+} // namespace phantom
@@ -0,0 +1,16 @@
+#ifndef PHANTOM_HASH_H
+#define PHANTOM_HASH_H
+
+#include <phantom_writer/types.h>
+#include <cstddef>
+
+namespace phantom {
+
+// Fast non-cryptographic 64-bit hash (wyhash construction: 64x64->128
+// multiply-and-fold). Good for content fingerprints and hash tables, not
+// for anything an attacker controls.
+u64 hash64(const void* data, size_t length, u64 seed = 0);
+
+} // namespace phantom
+
+#endif // PHANTOM_HASH_H
@@ -0,0 +1,309 @@
+#include "lz_codec.h"
+
+#include <cstring>
+#include <algorithm>
+#include <utility>
+
+namespace phantom {
+
+namespace {
+
+constexpr int HASH_LOG = 14;
+constexpr size_t HASH_SIZE = size_t(1) << HASH_LOG;
+
+constexpr size_t MIN_MATCH = 4;
+constexpr size_t LAST_LITERALS = 5;   // The format requires the last 5 bytes to be literals
+constexpr size_t MF_LIMIT = 12;       // ...and the last match to start 12 bytes before the end
+constexpr size_t MAX_DISTANCE = 65535;
+constexpr u32 SKIP_TRIGGER = 6;       // Probe step grows after 2^6 misses in a row
+
+inline u32 read32(const u8* p) {
+    u32 v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline u64 read64(const u8* p) {
+    u64 v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline u32 hash4(u32 sequence) {
+    return (sequence * 2654435761u) >> (32 - HASH_LOG);
+}
+
+inline size_t countCommon(const u8* a, const u8* b, const u8* aLimit) {
+    const u8* start = a;
+    while (a + 8 <= aLimit) {
+        u64 diff = read64(a) ^ read64(b);
+        if (diff) {
+#if defined(__GNUC__) || defined(__clang__)
+            return static_cast<size_t>(a - start) + (__builtin_ctzll(diff) >> 3);
+#else
+            while (*a == *b) { a++; b++; }
+            return static_cast<size_t>(a - start);
+#endif
+        }
+        a += 8;
+        b += 8;
+    }
+    while (a < aLimit && *a == *b) {
+        a++;
+        b++;
+    }
+    return static_cast<size_t>(a - start);
+}
+
+inline u8* writeLength(u8* op, size_t length) {
+    while (length >= 255) {
+        *op++ = 255;
+        length -= 255;
+    }
+    *op++ = static_cast<u8>(length);
+    return op;
+}
+
+inline bool readLength(const u8*& ip, const u8* iend, size_t& length) {
+    u8 b;
+    do {
+        if (ip >= iend) {
+            return false;
+        }
+        b = *ip++;
+        length += b;
+    } while (b == 255);
+    return true;
+}
+
+} // namespace
+
+LzCompressor::LzCompressor()
+    : hashTable_(HASH_SIZE)
+{
+}
+
+size_t LzCompressor::compress(const u8* src, size_t size, u8* dst, size_t capacity) {
+    if (size > LZ_MAX_BLOCK_SIZE) {
+        return 0;
+    }
+
+    u8* op = dst;
+    u8* const oend = dst + capacity;
+    const u8* ip = src;
+    const u8* anchor = src;
+    const u8* const iend = src + size;
+
+    if (size >= MF_LIMIT + 1) {
+        u32* table = hashTable_.data();
+        std::fill(hashTable_.begin(), hashTable_.end(), 0);
+
+        const u8* const mflimit = iend - MF_LIMIT;
+        const u8* const matchlimit = iend - LAST_LITERALS;
+
+        ip++;
+        while (ip < mflimit) {
+            // Find a match, stepping faster through data that doesn't compress
+            const u8* match;
+            u32 misses = u32(1) << SKIP_TRIGGER;
+            for (;;) {
+                u32 h = hash4(read32(ip));
+                match = src + table[h];
+                table[h] = static_cast<u32>(ip - src);
+                if (static_cast<size_t>(ip - match) <= MAX_DISTANCE && read32(match) == read32(ip)) {
+                    break;
+                }
+                ip += misses++ >> SKIP_TRIGGER;
+                if (ip >= mflimit) {
+                    goto lastLiterals;
+                }
+            }
+
+            // Extend backwards over literals that also match
+            while (ip > anchor && match > src && ip[-1] == match[-1]) {
+                ip--;
+                match--;
+            }
+
+            size_t literalLength = static_cast<size_t>(ip - anchor);
+            size_t matchLength = countCommon(ip + MIN_MATCH, match + MIN_MATCH, matchlimit);
+
+            if (static_cast<size_t>(oend - op) < 1 + literalLength + literalLength / 255 + 1 + 2 + matchLength / 255 + 1) {
+                return 0;
+            }
+
+            u8* token = op++;
+            if (literalLength >= 15) {
+                *token = 15 << 4;
+                op = writeLength(op, literalLength - 15);
+            } else {
+                *token = static_cast<u8>(literalLength << 4);
+            }
+            std::memcpy(op, anchor, literalLength);
+            op += literalLength;
+
+            u16 offset = static_cast<u16>(ip - match);
+            *op++ = static_cast<u8>(offset);
+            *op++ = static_cast<u8>(offset >> 8);
+
+            if (matchLength >= 15) {
+                *token |= 15;
+                op = writeLength(op, matchLength - 15);
+            } else {
+                *token |= static_cast<u8>(matchLength);
+            }
+
+            ip += MIN_MATCH + matchLength;
+            anchor = ip;
+
+            // Seed the table with a position inside the match so runs chain
+            if (ip < mflimit) {
+                table[hash4(read32(ip - 2))] = static_cast<u32>(ip - 2 - src);
+            }
+        }
+    }
+
+lastLiterals:
+    size_t literalLength = static_cast<size_t>(iend - anchor);
+    if (static_cast<size_t>(oend - op) < 1 + literalLength + literalLength / 255 + 1) {
+        return 0;
+    }
+
+    if (literalLength >= 15) {
+        *op++ = 15 << 4;
+        op = writeLength(op, literalLength - 15);
+    } else {
+        *op++ = static_cast<u8>(literalLength << 4);
+    }
+    std::memcpy(op, anchor, literalLength);
+    op += literalLength;
+
+    return static_cast<size_t>(op - dst);
+}
+
+bool lzDecompress(const u8* src, size_t srcSize, u8* dst, size_t rawSize) {
+    const u8* ip = src;
+    const u8* const iend = src + srcSize;
+    u8* op = dst;
+    u8* const oend = dst + rawSize;
+
+    while (ip < iend) {
+        u8 token = *ip++;
+
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !readLength(ip, iend, literalLength)) {
+            return false;
+        }
+        if (literalLength > static_cast<size_t>(iend - ip) || literalLength > static_cast<size_t>(oend - op)) {
+            return false;
+        }
+        std::memcpy(op, ip, literalLength);
+        op += literalLength;
+        ip += literalLength;
+
+        // The final sequence has literals only
+        if (ip == iend) {
+            break;
+        }
+
+        if (iend - ip < 2) {
+            return false;
+        }
+        size_t offset = static_cast<size_t>(ip[0]) | (static_cast<size_t>(ip[1]) << 8);
+        ip += 2;
+        if (offset == 0 || offset > static_cast<size_t>(op - dst)) {
+            return false;
+        }
+
+        size_t matchLength = token & 15;
+        if (matchLength == 15 && !readLength(ip, iend, matchLength)) {
+            return false;
+        }
+        matchLength += MIN_MATCH;
+        if (matchLength > static_cast<size_t>(oend - op)) {
+            return false;
+        }
+
+        const u8* match = op - offset;
+        if (offset >= 8 && static_cast<size_t>(oend - op) >= matchLength + 8) {
+            // Non-overlapping 8-byte steps; may write up to 7 bytes past the match
+            for (size_t i = 0; i < matchLength; i += 8) {
+                std::memcpy(op + i, match + i, 8);
+            }
+        } else {
+            // Overlapping copy repeats the pattern, so it has to go byte by byte
+            for (size_t i = 0; i < matchLength; i++) {
+                op[i] = match[i];
+            }
+        }
+        op += matchLength;
+    }
+
+    return op == oend;
+}
+
+LzStreamCompressor::LzStreamCompressor(size_t blockSize, BlockSink sink)
+    : blockSize_(std::min(blockSize, LZ_MAX_BLOCK_SIZE))
+    , sink_(std::move(sink))
+{
+    staging_.reserve(blockSize_);
+    output_.resize(blockSize_);
+}
+
+bool LzStreamCompressor::write(const void* data, size_t size) {
+    const u8* bytes = static_cast<const u8*>(data);
+
+    while (size > 0) {
+        // Whole blocks are compressed in place
+        if (staging_.empty() && size >= blockSize_) {
+            if (!emit(bytes, blockSize_)) {
+                return false;
+            }
+            bytes += blockSize_;
+            size -= blockSize_;
+            continue;
+        }
+
+        size_t n = std::min(size, blockSize_ - staging_.size());
+        staging_.insert(staging_.end(), bytes, bytes + n);
+        bytes += n;
+        size -= n;
+
+        if (staging_.size() == blockSize_) {
+            if (!emit(staging_.data(), staging_.size())) {
+                return false;
+            }
+            staging_.clear();
+        }
+    }
+    return true;
+}
+
+bool LzStreamCompressor::finish() {
+    if (staging_.empty()) {
+        return true;
+    }
+    bool ok = emit(staging_.data(), staging_.size());
+    staging_.clear();
+    return ok;
+}
+
+bool LzStreamCompressor::emit(const u8* data, size_t size) {
+    // Only accept output that is strictly smaller than the input
+    size_t compressedSize = size > 1 ? compressor_.compress(data, size, output_.data(), size - 1) : 0;
+
+    LzBlock block;
+    block.rawSize = size;
+    if (compressedSize > 0) {
+        block.data = output_.data();
+        block.storedSize = compressedSize;
+        block.compressed = true;
+    } else {
+        block.data = data;
+        block.storedSize = size;
+        block.compressed = false;
+    }
+    return sink_(block);
+}
+
+} // namespace phantom
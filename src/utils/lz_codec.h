@@ -0,0 +1,82 @@
+#ifndef PHANTOM_LZ_CODEC_H
+#define PHANTOM_LZ_CODEC_H
+
+#include <phantom_writer/types.h>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+namespace phantom {
+
+// Fast LZ77 block codec using the LZ4 block format: a single hash probe per
+// position, 64 KiB window, no entropy stage. Typical prose compresses to
+// ~50-60% at several hundred MB/s, and decompresses at GB/s.
+//
+// Blocks are independent; nothing is shared between calls, so a damaged
+// block never affects its neighbours.
+
+// Largest input a single block may hold
+constexpr size_t LZ_MAX_BLOCK_SIZE = 0x7E000000;
+
+// Worst-case compressed size of an incompressible input
+constexpr size_t lzCompressBound(size_t size) {
+    return size + size / 255 + 16;
+}
+
+// Reusable compressor; keeps its hash table between calls to avoid reallocating
+class LzCompressor {
+public:
+    LzCompressor();
+
+    // Compress one block into dst. Returns the compressed size, or 0 if the
+    // result would not fit in capacity (pass capacity < size to only accept
+    // output that actually saves space).
+    size_t compress(const u8* src, size_t size, u8* dst, size_t capacity);
+
+private:
+    std::vector<u32> hashTable_;
+};
+
+// Decompress a block produced by LzCompressor. rawSize must be the exact
+// original size. Malformed input is rejected without reading or writing
+// out of bounds.
+bool lzDecompress(const u8* src, size_t srcSize, u8* dst, size_t rawSize);
+
+// One finished block of an LzStreamCompressor
+struct LzBlock {
+    const u8* data;       // Compressed bytes, or the raw input when compressed == false
+    size_t rawSize;
+    size_t storedSize;
+    bool compressed;
+};
+
+// Cuts a stream of arbitrary pieces (e.g. the two halves of a gap buffer)
+// into blocks of blockSize bytes and compresses each one. Pieces are only
+// copied when a block straddles two of them; everything else is compressed
+// straight from the caller's memory. Blocks that don't shrink are passed
+// through raw.
+class LzStreamCompressor {
+public:
+    // Return false from the sink to abort the stream
+    using BlockSink = std::function<bool(const LzBlock& block)>;
+
+    LzStreamCompressor(size_t blockSize, BlockSink sink);
+
+    bool write(const void* data, size_t size);
+
+    // Flush the final partial block
+    bool finish();
+
+private:
+    bool emit(const u8* data, size_t size);
+
+    size_t blockSize_;
+    BlockSink sink_;
+    LzCompressor compressor_;
+    std::vector<u8> staging_;
+    std::vector<u8> output_;
+};
+
+} // namespace phantom
+
+#endif // PHANTOM_LZ_CODEC_H
@@ -0,0 +1,43 @@
+#ifndef PHANTOM_MAPPED_FILE_H
+#define PHANTOM_MAPPED_FILE_H
+
+#include <phantom_writer/types.h>
+#include <string>
+#include <cstddef>
+
+namespace phantom {
+
+// Read-only memory mapping of a whole file.
+// An empty file opens successfully with data() == nullptr and size() == 0.
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    // Map the file at path (closes any previous mapping)
+    bool open(const std::string& path);
+    void close();
+
+    bool isOpen() const { return isOpen_; }
+    const u8* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const u8* data_ = nullptr;
+    size_t size_ = 0;
+    bool isOpen_ = false;
+
+#ifdef _WIN32
+    void* fileHandle_ = nullptr;
+    void* mappingHandle_ = nullptr;
+#endif
+};
+
+} // namespace phantom
+
+#endif // PHANTOM_MAPPED_FILE_H
@@ -0,0 +1,141 @@
+#ifndef PHANTOM_OPEN_HASH_MAP_H
+#define PHANTOM_OPEN_HASH_MAP_H
+
+#include <phantom_writer/types.h>
+#include <cstddef>
+#include <vector>
+
+namespace phantom {
+
+// Flat hash map for small integer keys: open addressing with linear probing
+// in a power-of-two array, backward-shift deletion (no tombstones) and a
+// load factor kept under 3/4. EMPTY_KEY marks a free bucket and cannot be
+// stored. Used behind the dense tables of GlyphIndex and KerningTable for
+// keys outside their dense range.
+template <typename Key, typename Value, Key EMPTY_KEY>
+class OpenHashMap {
+public:
+    // Value stored for key, or nullptr
+    const Value* find(Key key) const {
+        if (entries_.empty()) {
+            return nullptr;
+        }
+        size_t mask = entries_.size() - 1;
+        for (size_t i = bucketFor(key, mask);; i = (i + 1) & mask) {
+            const Entry& entry = entries_[i];
+            if (entry.key == key) {
+                return &entry.value;
+            }
+            if (entry.key == EMPTY_KEY) {
+                return nullptr;
+            }
+        }
+    }
+
+    // Add or replace the value for key; true if key was not present
+    bool insert(Key key, const Value& value) {
+        if ((count_ + 1) * 4 > entries_.size() * 3) {
+            grow();
+        }
+
+        size_t mask = entries_.size() - 1;
+        for (size_t i = bucketFor(key, mask);; i = (i + 1) & mask) {
+            Entry& entry = entries_[i];
+            if (entry.key == key) {
+                entry.value = value;
+                return false;
+            }
+            if (entry.key == EMPTY_KEY) {
+                entry = {key, value};
+                count_++;
+                return true;
+            }
+        }
+    }
+
+    // Remove key; true if it was present
+    bool erase(Key key) {
+        if (entries_.empty()) {
+            return false;
+        }
+
+        size_t mask = entries_.size() - 1;
+        size_t hole = bucketFor(key, mask);
+        while (entries_[hole].key != key) {
+            if (entries_[hole].key == EMPTY_KEY) {
+                return false;
+            }
+            hole = (hole + 1) & mask;
+        }
+
+        // Pull later entries of the probe run into the hole so lookups never
+        // need tombstones
+        for (size_t next = (hole + 1) & mask; entries_[next].key != EMPTY_KEY; next = (next + 1) & mask) {
+            size_t home = bucketFor(entries_[next].key, mask);
+            bool movable = hole <= next ? (home <= hole || home > next) : (home <= hole && home > next);
+            if (movable) {
+                entries_[hole] = entries_[next];
+                hole = next;
+            }
+        }
+        entries_[hole] = {EMPTY_KEY, Value()};
+        count_--;
+        return true;
+    }
+
+    void clear() {
+        entries_.clear();
+        count_ = 0;
+    }
+
+    size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+
+    // Call visit(key, value) for every entry, in bucket order
+    template <typename Visitor>
+    void forEach(Visitor visit) const {
+        for (const Entry& entry : entries_) {
+            if (entry.key != EMPTY_KEY) {
+                visit(entry.key, entry.value);
+            }
+        }
+    }
+
+private:
+    struct Entry {
+        Key key;
+        Value value;
+    };
+
+    static constexpr size_t INITIAL_CAPACITY = 64;
+
+    static size_t bucketFor(Key key, size_t mask) {
+        u64 h = static_cast<u64>(key) * 0x9E3779B97F4A7C15ull;
+        return static_cast<size_t>(h >> 32) & mask;
+    }
+
+    void grow() {
+        std::vector<Entry> old;
+        old.swap(entries_);
+        entries_.assign(old.empty() ? INITIAL_CAPACITY : old.size() * 2, Entry{EMPTY_KEY, Value()});
+
+        size_t mask = entries_.size() - 1;
+        for (const Entry& entry : old) {
+            if (entry.key == EMPTY_KEY) {
+                continue;
+            }
+            size_t i = bucketFor(entry.key, mask);
+            while (entries_[i].key != EMPTY_KEY) {
+                i = (i + 1) & mask;
+            }
+            entries_[i] = entry;
+        }
+    }
+
+    std::vector<Entry> entries_;    // Power-of-two capacity
+    size_t count_ = 0;
+};
+
+} // namespace phantom
+
+#endif // PHANTOM_OPEN_HASH_MAP_H
@@ -0,0 +1,88 @@
+#include "secure_memory.h"
+
+#include <phantom_writer/types.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+    #include <bcrypt.h>
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <cerrno>
+    #if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 25))
+        #define PHANTOM_HAVE_GETRANDOM 1
+        #include <sys/random.h>
+    #endif
+#endif
+
+namespace phantom {
+
+bool secureRandom(void* out, size_t size) {
+    u8* p = static_cast<u8*>(out);
+
+#ifdef _WIN32
+    while (size > 0) {
+        ULONG chunk = size > 0x10000000 ? 0x10000000 : static_cast<ULONG>(size);
+        if (!BCRYPT_SUCCESS(BCryptGenRandom(nullptr, p, chunk, BCRYPT_USE_SYSTEM_PREFERRED_RNG))) {
+            return false;
+        }
+        p += chunk;
+        size -= chunk;
+    }
+    return true;
+#else
+#ifdef PHANTOM_HAVE_GETRANDOM
+    while (size > 0) {
+        ssize_t got = getrandom(p, size, 0);
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;      // ENOSYS on old kernels: fall back to the device
+        }
+        p += got;
+        size -= static_cast<size_t>(got);
+    }
+    if (size == 0) {
+        return true;
+    }
+#endif
+    int fd = ::open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    while (size > 0) {
+        ssize_t got = ::read(fd, p, size);
+        if (got <= 0) {
+            if (got < 0 && errno == EINTR) {
+                continue;
+            }
+            ::close(fd);
+            return false;
+        }
+        p += got;
+        size -= static_cast<size_t>(got);
+    }
+    ::close(fd);
+    return true;
+#endif
+}
+
+void secureWipe(void* data, size_t size) {
+    volatile u8* p = static_cast<volatile u8*>(data);
+    while (size--) {
+        *p++ = 0;
+    }
+}
+
+bool secureEqual(const void* a, const void* b, size_t size) {
+    const u8* x = static_cast<const u8*>(a);
+    const u8* y = static_cast<const u8*>(b);
+    u8 diff = 0;
+    for (size_t i = 0; i < size; i++) {
+        diff |= x[i] ^ y[i];
+    }
+    return diff == 0;
+}
+
+} // namespace phantom
@@ -0,0 +1,20 @@
+#ifndef PHANTOM_SECURE_MEMORY_H
+#define PHANTOM_SECURE_MEMORY_H
+
+#include <cstddef>
+
+namespace phantom {
+
+// Fill out with bytes from the operating system's CSPRNG
+// (getrandom / arc4random / BCryptGenRandom). False if none is available.
+bool secureRandom(void* out, size_t size);
+
+// Zero memory that held key material; not removed by the optimizer
+void secureWipe(void* data, size_t size);
+
+// Constant-time comparison, for authentication tags
+bool secureEqual(const void* a, const void* b, size_t size);
+
+} // namespace phantom
+
+#endif // PHANTOM_SECURE_MEMORY_H
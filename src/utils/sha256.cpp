@@ -0,0 +1,219 @@
+#include "sha256.h"
+#include "secure_memory.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace phantom {
+
+namespace {
+
+const u32 K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+inline u32 rotr(u32 x, int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+inline u32 loadBe32(const u8* p) {
+    return (static_cast<u32>(p[0]) << 24) | (static_cast<u32>(p[1]) << 16) |
+           (static_cast<u32>(p[2]) << 8) | static_cast<u32>(p[3]);
+}
+
+inline void storeBe32(u8* p, u32 v) {
+    p[0] = static_cast<u8>(v >> 24);
+    p[1] = static_cast<u8>(v >> 16);
+    p[2] = static_cast<u8>(v >> 8);
+    p[3] = static_cast<u8>(v);
+}
+
+} // namespace
+
+Sha256::Sha256()
+    : state_{0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19}
+{
+}
+
+void Sha256::compress(const u8* blocks, size_t count) {
+    u32 w[64];
+
+    for (; count > 0; count--, blocks += SHA256_BLOCK_SIZE) {
+        for (int i = 0; i < 16; i++) {
+            w[i] = loadBe32(blocks + i * 4);
+        }
+        for (int i = 16; i < 64; i++) {
+            u32 s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            u32 s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        u32 a = state_[0], b = state_[1], c = state_[2], d = state_[3];
+        u32 e = state_[4], f = state_[5], g = state_[6], h = state_[7];
+
+        for (int i = 0; i < 64; i++) {
+            u32 t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+            u32 t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+
+        state_[0] += a; state_[1] += b; state_[2] += c; state_[3] += d;
+        state_[4] += e; state_[5] += f; state_[6] += g; state_[7] += h;
+    }
+}
+
+void Sha256::update(const void* data, size_t size) {
+    const u8* p = static_cast<const u8*>(data);
+    totalBytes_ += size;
+
+    if (buffered_ > 0) {
+        size_t take = std::min(size, SHA256_BLOCK_SIZE - buffered_);
+        std::memcpy(buffer_ + buffered_, p, take);
+        buffered_ += take;
+        p += take;
+        size -= take;
+        if (buffered_ < SHA256_BLOCK_SIZE) {
+            return;
+        }
+        compress(buffer_, 1);
+        buffered_ = 0;
+    }
+
+    size_t blocks = size / SHA256_BLOCK_SIZE;
+    compress(p, blocks);
+    p += blocks * SHA256_BLOCK_SIZE;
+    size -= blocks * SHA256_BLOCK_SIZE;
+
+    std::memcpy(buffer_, p, size);
+    buffered_ = size;
+}
+
+void Sha256::finish(u8 digest[SHA256_DIGEST_SIZE]) {
+    u64 bits = totalBytes_ * 8;
+
+    buffer_[buffered_++] = 0x80;
+    if (buffered_ > SHA256_BLOCK_SIZE - 8) {
+        std::memset(buffer_ + buffered_, 0, SHA256_BLOCK_SIZE - buffered_);
+        compress(buffer_, 1);
+        buffered_ = 0;
+    }
+    std::memset(buffer_ + buffered_, 0, SHA256_BLOCK_SIZE - 8 - buffered_);
+    storeBe32(buffer_ + 56, static_cast<u32>(bits >> 32));
+    storeBe32(buffer_ + 60, static_cast<u32>(bits));
+    compress(buffer_, 1);
+
+    for (int i = 0; i < 8; i++) {
+        storeBe32(digest + i * 4, state_[i]);
+    }
+    secureWipe(buffer_, sizeof(buffer_));
+}
+
+HmacSha256::HmacSha256(const void* key, size_t keySize) {
+    u8 block[SHA256_BLOCK_SIZE] = {};
+    if (keySize > SHA256_BLOCK_SIZE) {
+        Sha256 hash;
+        hash.update(key, keySize);
+        hash.finish(block);
+    } else {
+        std::memcpy(block, key, keySize);
+    }
+
+    u8 pad[SHA256_BLOCK_SIZE];
+    for (size_t i = 0; i < SHA256_BLOCK_SIZE; i++) {
+        pad[i] = block[i] ^ 0x36;
+    }
+    inner_.update(pad, sizeof(pad));
+    for (size_t i = 0; i < SHA256_BLOCK_SIZE; i++) {
+        pad[i] = block[i] ^ 0x5c;
+    }
+    outer_.update(pad, sizeof(pad));
+
+    secureWipe(block, sizeof(block));
+    secureWipe(pad, sizeof(pad));
+}
+
+HmacSha256::~HmacSha256() {
+    secureWipe(&inner_, sizeof(inner_));
+    secureWipe(&outer_, sizeof(outer_));
+}
+
+void HmacSha256::mac(const void* data, size_t size, u8 out[SHA256_DIGEST_SIZE]) const {
+    Sha256 inner = inner_;
+    inner.update(data, size);
+    u8 digest[SHA256_DIGEST_SIZE];
+    inner.finish(digest);
+
+    Sha256 outer = outer_;
+    outer.update(digest, sizeof(digest));
+    outer.finish(out);
+}
+
+void HmacSha256::macDigest(const u8 data[SHA256_DIGEST_SIZE], u8 out[SHA256_DIGEST_SIZE]) const {
+    // Both hashes are exactly one padded block on top of the keyed state
+    // (64 key bytes + 32 message bytes), so skip update()/finish()
+    u8 block[SHA256_BLOCK_SIZE] = {};
+    std::memcpy(block, data, SHA256_DIGEST_SIZE);
+    block[SHA256_DIGEST_SIZE] = 0x80;
+    storeBe32(block + 60, (SHA256_BLOCK_SIZE + SHA256_DIGEST_SIZE) * 8);
+
+    Sha256 inner = inner_;
+    inner.compress(block, 1);
+    for (int i = 0; i < 8; i++) {
+        storeBe32(block + i * 4, inner.state_[i]);
+    }
+
+    Sha256 outer = outer_;
+    outer.compress(block, 1);
+    for (int i = 0; i < 8; i++) {
+        storeBe32(out + i * 4, outer.state_[i]);
+    }
+}
+
+void pbkdf2Sha256(const void* password, size_t passwordSize, const u8* salt, size_t saltSize,
+                  u32 iterations, u8* out, size_t outSize) {
+    HmacSha256 hmac(password, passwordSize);
+
+    u8 saltBlock[256];
+    size_t saltUsed = std::min(saltSize, sizeof(saltBlock) - 4);
+    std::memcpy(saltBlock, salt, saltUsed);
+
+    for (u32 blockIndex = 1; outSize > 0; blockIndex++) {
+        storeBe32(saltBlock + saltUsed, blockIndex);
+
+        u8 u[SHA256_DIGEST_SIZE];
+        u8 t[SHA256_DIGEST_SIZE];
+        hmac.mac(saltBlock, saltUsed + 4, u);
+        std::memcpy(t, u, sizeof(t));
+
+        for (u32 i = 1; i < iterations; i++) {
+            hmac.macDigest(u, u);
+            for (size_t j = 0; j < SHA256_DIGEST_SIZE; j++) {
+                t[j] ^= u[j];
+            }
+        }
+
+        size_t take = std::min(outSize, SHA256_DIGEST_SIZE);
+        std::memcpy(out, t, take);
+        out += take;
+        outSize -= take;
+
+        secureWipe(u, sizeof(u));
+        secureWipe(t, sizeof(t));
+    }
+}
+
+} // namespace phantom
@@ -0,0 +1,54 @@
+#ifndef PHANTOM_SHA256_H
+#define PHANTOM_SHA256_H
+
+#include <phantom_writer/types.h>
+#include <cstddef>
+
+namespace phantom {
+
+constexpr size_t SHA256_DIGEST_SIZE = 32;
+constexpr size_t SHA256_BLOCK_SIZE = 64;
+
+// SHA-256 (FIPS 180-4). Used for key derivation, not for bulk data.
+class Sha256 {
+public:
+    Sha256();
+
+    void update(const void* data, size_t size);
+    void finish(u8 digest[SHA256_DIGEST_SIZE]);
+
+private:
+    friend class HmacSha256;
+
+    void compress(const u8* blocks, size_t count);
+
+    u32 state_[8];
+    u8 buffer_[SHA256_BLOCK_SIZE];
+    size_t buffered_ = 0;
+    u64 totalBytes_ = 0;
+};
+
+// HMAC-SHA256 (RFC 2104). The keyed inner/outer states are computed once,
+// so one instance can MAC many messages under the same key.
+class HmacSha256 {
+public:
+    HmacSha256(const void* key, size_t keySize);
+    ~HmacSha256();
+
+    void mac(const void* data, size_t size, u8 out[SHA256_DIGEST_SIZE]) const;
+
+    // mac() of a single 32-byte message, the PBKDF2 inner loop
+    void macDigest(const u8 data[SHA256_DIGEST_SIZE], u8 out[SHA256_DIGEST_SIZE]) const;
+
+private:
+    Sha256 inner_;
+    Sha256 outer_;
+};
+
+// PBKDF2-HMAC-SHA256 (RFC 8018)
+void pbkdf2Sha256(const void* password, size_t passwordSize, const u8* salt, size_t saltSize,
+                  u32 iterations, u8* out, size_t outSize);
+
+} // namespace phantom
+
+#endif // PHANTOM_SHA256_H
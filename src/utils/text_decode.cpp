@@ -0,0 +1,262 @@
+#include "text_decode.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+    #define PHANTOM_TEXT_SSE2 1
+    #include <emmintrin.h>
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+    #define PHANTOM_TEXT_NEON 1
+    #include <arm_neon.h>
+#endif
+
+namespace phantom {
+
+namespace {
+
+constexpr size_t BLOCK = 16;
+
+inline unsigned lowestBit(u32 mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+
+// Bit i set if byte i of the 16-byte block at p is >= 0x80 or '\r'
+inline u32 specialMask(const u8* p) {
+#if defined(PHANTOM_TEXT_SSE2)
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i cr = _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'));
+    return static_cast<u32>(_mm_movemask_epi8(_mm_or_si128(v, cr)));
+#elif defined(PHANTOM_TEXT_NEON)
+    uint8x16_t v = vld1q_u8(p);
+    uint8x16_t special = vorrq_u8(vcgeq_u8(v, vdupq_n_u8(0x80)), vceqq_u8(v, vdupq_n_u8('\r')));
+    if (vmaxvq_u8(special) == 0) {
+        return 0;
+    }
+    // Rare path: build the bitmask from the lanes
+    static const u8 weights[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+    uint8x16_t bits = vandq_u8(special, vld1q_u8(weights));
+    return static_cast<u32>(vaddv_u8(vget_low_u8(bits))) |
+           (static_cast<u32>(vaddv_u8(vget_high_u8(bits))) << 8);
+#else
+    // SWAR: high bit set, or byte equal to '\r' (exact zero-byte test, no false positives)
+    u32 mask = 0;
+    for (size_t half = 0; half < 2; half++) {
+        u64 word;
+        std::memcpy(&word, p + half * 8, 8);
+        u64 x = word ^ 0x0D0D0D0D0D0D0D0Dull;
+        u64 isCr = ~(((x & 0x7F7F7F7F7F7F7F7Full) + 0x7F7F7F7F7F7F7F7Full) | x) & 0x8080808080808080ull;
+        u64 special = (word & 0x8080808080808080ull) | isCr;
+        for (int i = 0; i < 8; i++) {
+            if (special & (0x80ull << (i * 8))) {
+                mask |= 1u << (half * 8 + i);
+            }
+        }
+    }
+    return mask;
+#endif
+}
+
+} // namespace
+
+bool textDecoderIsVectorized() {
+#if defined(PHANTOM_TEXT_SSE2) || defined(PHANTOM_TEXT_NEON)
+    return true;
+#else
+    return false;
+#endif
+}
+
+size_t countLineFeeds(const char* data, size_t size) {
+    const u8* p = reinterpret_cast<const u8*>(data);
+    size_t count = 0;
+    size_t i = 0;
+
+#if defined(PHANTOM_TEXT_SSE2)
+    // Per-lane counters are bytes: fold them into the total before they can wrap
+    const __m128i newline = _mm_set1_epi8('\n');
+    while (i + BLOCK <= size) {
+        size_t blocks = std::min<size_t>((size - i) / BLOCK, 255);
+        __m128i lanes = _mm_setzero_si128();
+        for (size_t b = 0; b < blocks; b++, i += BLOCK) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+            lanes = _mm_sub_epi8(lanes, _mm_cmpeq_epi8(v, newline));
+        }
+        __m128i sums = _mm_sad_epu8(lanes, _mm_setzero_si128());
+        count += static_cast<size_t>(_mm_cvtsi128_si32(sums)) +
+                 static_cast<size_t>(_mm_cvtsi128_si32(_mm_unpackhi_epi64(sums, sums)));
+    }
+#elif defined(PHANTOM_TEXT_NEON)
+    const uint8x16_t newline = vdupq_n_u8('\n');
+    while (i + BLOCK <= size) {
+        size_t blocks = std::min<size_t>((size - i) / BLOCK, 255);
+        uint8x16_t lanes = vdupq_n_u8(0);
+        for (size_t b = 0; b < blocks; b++, i += BLOCK) {
+            lanes = vsubq_u8(lanes, vceqq_u8(vld1q_u8(p + i), newline));
+        }
+        count += vaddlvq_u8(lanes);
+    }
+#endif
+
+    for (; i < size; i++) {
+        count += p[i] == '\n';
+    }
+    return count;
+}
+
+void TextDecoder::markInvalid(u64 offset) {
+    if (firstInvalid_ == VALID) {
+        firstInvalid_ = offset;
+    }
+}
+
+size_t TextDecoder::decode(const u8* src, size_t size, u8* dst, bool final, size_t& consumed) {
+    size_t in = 0;
+    size_t out = 0;
+
+    while (in < size) {
+        // Fast path: copy whole blocks of ASCII without '\r'
+        if (need_ == 0) {
+            while (in + BLOCK <= size) {
+                // Copy the block before looking at it: a block with a special
+                // byte still has its clean prefix in place, and the rest is
+                // overwritten as decoding continues (out <= in always)
+                std::memcpy(dst + out, src + in, BLOCK);
+                u32 mask = specialMask(src + in);
+                if (mask == 0) {
+                    in += BLOCK;
+                    out += BLOCK;
+                    continue;
+                }
+                unsigned clean = lowestBit(mask);
+                in += clean;
+                out += clean;
+                break;
+            }
+            if (in >= size) {
+                break;
+            }
+        }
+
+        u8 c = src[in];
+
+        if (need_ > 0) {
+            if (c >= lo_ && c <= hi_) {
+                dst[out++] = c;
+                in++;
+                need_--;
+                lo_ = 0x80;
+                hi_ = 0xBF;
+                continue;
+            }
+            // Truncated sequence: flag it and reread c as a new character
+            markInvalid(offset_ + in);
+            need_ = 0;
+            lo_ = 0x80;
+            hi_ = 0xBF;
+            continue;
+        }
+
+        if (c < 0x80) {
+            if (c == '\r') {
+                if (in + 1 < size) {
+                    if (src[in + 1] == '\n') {
+                        crlfCount_++;
+                        in++;       // Drop the '\r'; the '\n' is copied next
+                        continue;
+                    }
+                } else if (!final) {
+                    break;          // Might be half of a CRLF split across calls
+                }
+            }
+            dst[out++] = c;
+            in++;
+            continue;
+        }
+
+        // Lead byte: the allowed range of the first continuation byte
+        // excludes overlongs (E0, F0), surrogates (ED) and > U+10FFFF (F4)
+        if (c >= 0xC2 && c <= 0xDF) {
+            need_ = 1;
+        } else if (c >= 0xE0 && c <= 0xEF) {
+            need_ = 2;
+            lo_ = c == 0xE0 ? 0xA0 : 0x80;
+            hi_ = c == 0xED ? 0x9F : 0xBF;
+        } else if (c >= 0xF0 && c <= 0xF4) {
+            need_ = 3;
+            lo_ = c == 0xF0 ? 0x90 : 0x80;
+            hi_ = c == 0xF4 ? 0x8F : 0xBF;
+        } else {
+            markInvalid(offset_ + in);
+        }
+        dst[out++] = c;
+        in++;
+    }
+
+    if (final && need_ > 0) {
+        markInvalid(offset_ + in);
+        need_ = 0;
+        lo_ = 0x80;
+        hi_ = 0xBF;
+    }
+
+    consumed = in;
+    offset_ += in;
+    return out;
+}
+
+u32 nextCodepoint(const char*& it, const char* end) {
+    const u8* p = reinterpret_cast<const u8*>(it);
+    u8 c = p[0];
+    if (c < 0x80) {
+        it++;
+        return c;
+    }
+
+    // Same lead byte table and continuation ranges as TextDecoder
+    u32 need;
+    u32 codepoint;
+    u8 lo = 0x80;
+    u8 hi = 0xBF;
+    if (c >= 0xC2 && c <= 0xDF) {
+        need = 1;
+        codepoint = c & 0x1F;
+    } else if (c >= 0xE0 && c <= 0xEF) {
+        need = 2;
+        codepoint = c & 0x0F;
+        lo = c == 0xE0 ? 0xA0 : 0x80;
+        hi = c == 0xED ? 0x9F : 0xBF;
+    } else if (c >= 0xF0 && c <= 0xF4) {
+        need = 3;
+        codepoint = c & 0x07;
+        lo = c == 0xF0 ? 0x90 : 0x80;
+        hi = c == 0xF4 ? 0x8F : 0xBF;
+    } else {
+        it++;
+        return 0xFFFD;
+    }
+
+    if (static_cast<size_t>(end - it) <= need) {
+        it++;
+        return 0xFFFD;
+    }
+    for (u32 i = 1; i <= need; i++) {
+        if (p[i] < lo || p[i] > hi) {
+            it++;
+            return 0xFFFD;
+        }
+        codepoint = (codepoint << 6) | (p[i] & 0x3F);
+        lo = 0x80;
+        hi = 0xBF;
+    }
+    it += need + 1;
+    return codepoint;
+}
+
+} // namespace phantom
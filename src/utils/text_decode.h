@@ -0,0 +1,56 @@
+#ifndef PHANTOM_TEXT_DECODE_H
+#define PHANTOM_TEXT_DECODE_H
+
+#include <phantom_writer/types.h>
+#include <cstddef>
+
+namespace phantom {
+
+// Incremental decoder for UTF-8 text files: validates UTF-8 (RFC 3629,
+// rejecting overlongs and surrogates) and turns CRLF into LF in one pass.
+// Invalid bytes are kept as they are; only the first offending offset is
+// remembered, so a damaged file still loads and saves back unchanged.
+//
+// Runs of plain ASCII without '\r' are copied 16 bytes at a time with
+// SSE2/NEON compares; only bytes >= 0x80 and '\r' take the scalar path.
+class TextDecoder {
+public:
+    // Decode src into dst, which must not overlap src and must have room
+    // for size bytes (decoding never grows the text). Unless final is set, a trailing '\r' is left unconsumed because
+    // the next call may start with its '\n'. Returns bytes written to dst;
+    // consumed receives the number of src bytes used.
+    size_t decode(const u8* src, size_t size, u8* dst, bool final, size_t& consumed);
+
+    bool isValidUtf8() const { return firstInvalid_ == VALID; }
+    u64 getFirstInvalidOffset() const { return firstInvalid_; }
+    u64 getCrlfCount() const { return crlfCount_; }
+
+private:
+    void markInvalid(u64 offset);
+
+    static constexpr u64 VALID = ~0ull;
+
+    u64 offset_ = 0;            // Input bytes consumed by earlier calls
+    u64 firstInvalid_ = VALID;
+    u64 crlfCount_ = 0;
+
+    // Pending multi-byte sequence
+    u32 need_ = 0;              // Continuation bytes still expected
+    u8 lo_ = 0x80;              // Allowed range of the next continuation byte
+    u8 hi_ = 0xBF;
+};
+
+// True if TextDecoder uses SIMD on this build
+bool textDecoderIsVectorized();
+
+// Number of '\n' bytes in data, counted 16 bytes at a time like the
+// decoder's fast path
+size_t countLineFeeds(const char* data, size_t size);
+
+// Decode the UTF-8 sequence at it (it < end) and step past it. Malformed
+// or truncated input yields U+FFFD and consumes a single byte.
+u32 nextCodepoint(const char*& it, const char* end);
+
+} // namespace phantom
+
+#endif // PHANTOM_TEXT_DECODE_H
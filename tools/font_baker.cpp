@@ -0,0 +1,148 @@
+// Bakes a font and its atlas into C++ source for phantom_embedded_font.
+//
+// Usage: phantom_font_baker font.ttf output.cpp pixel-size coverage|sdf
+//
+// Runs FontLoader exactly as the application would at startup (printable
+// ASCII, default padding) and writes the font file, atlas bitmap, glyph
+// records and kerning pairs as constant arrays defining
+// embeddedDefaultFont(). Floats are written as hex literals so the baked
+// metrics match the loader's bit for bit.
+
+#include "rendering/core/font_loader.h"
+#include "utils/logger.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using namespace phantom;
+
+namespace {
+
+std::string hexFloat(float value) {
+    char text[48];
+    std::snprintf(text, sizeof(text), "%af", static_cast<double>(value));
+    return text;
+}
+
+void writeBytes(std::FILE* out, const char* name, const u8* data, size_t size) {
+    std::fprintf(out, "alignas(16) constexpr u8 %s[] = {", name);
+    for (size_t i = 0; i < size; i++) {
+        std::fprintf(out, "%s%u,", i % 24 == 0 ? "\n    " : "", data[i]);
+    }
+    if (size == 0) {
+        std::fprintf(out, "0");
+    }
+    std::fprintf(out, "\n};\n\n");
+}
+
+std::string baseName(const std::string& path) {
+    size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Logger::setConsoleOutput(false);
+    Logger::setFileOutput(false);
+
+    if (argc != 5) {
+        std::fprintf(stderr, "usage: %s font.ttf output.cpp pixel-size coverage|sdf\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    std::string fontPath = argv[1];
+    std::string outputPath = argv[2];
+    float fontSize = static_cast<float>(std::atof(argv[3]));
+    std::string format = argv[4];
+    if (fontSize <= 0.0f || (format != "coverage" && format != "sdf")) {
+        std::fprintf(stderr, "bad pixel size or format\n");
+        return EXIT_FAILURE;
+    }
+
+    std::ifstream file(fontPath, std::ios::binary);
+    std::vector<u8> fontData((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (fontData.empty()) {
+        std::fprintf(stderr, "cannot read %s\n", fontPath.c_str());
+        return EXIT_FAILURE;
+    }
+
+    FontLoader loader;
+    loader.setFormat(format == "sdf" ? GlyphFormat::SDF : GlyphFormat::Coverage);
+    if (!loader.loadFromMemory(fontData, fontSize)) {
+        std::fprintf(stderr, "cannot load %s\n", fontPath.c_str());
+        return EXIT_FAILURE;
+    }
+    const FontAtlas& atlas = loader.getAtlas();
+    std::vector<KerningPair> kerning = atlas.kerning.pairs();
+
+    // Written to a temp file first so an interrupted build never leaves a
+    // truncated source behind
+    std::string tempPath = outputPath + ".tmp";
+    std::FILE* out = std::fopen(tempPath.c_str(), "w");
+    if (!out) {
+        std::fprintf(stderr, "cannot write %s\n", tempPath.c_str());
+        return EXIT_FAILURE;
+    }
+
+    std::fprintf(out, "// Generated by phantom_font_baker from %s at %s px (%s). Do not edit.\n\n",
+                 baseName(fontPath).c_str(), argv[3], format.c_str());
+    std::fprintf(out, "#include \"rendering/core/embedded_font.h\"\n\n");
+    std::fprintf(out, "namespace phantom {\n\nnamespace {\n\n");
+
+    writeBytes(out, "FONT_FILE", fontData.data(), fontData.size());
+    writeBytes(out, "ATLAS_BITMAP", atlas.bitmap.data(), atlas.bitmap.size());
+
+    std::fprintf(out, "constexpr Glyph GLYPHS[] = {\n");
+    for (const Glyph& glyph : atlas.glyphs) {
+        std::fprintf(out, "    {%u, %s, %s, %s, %s, %s, %s, %s, %d, %d, %d, %d, %u, %u},\n",
+                     glyph.codepoint, hexFloat(glyph.x0).c_str(), hexFloat(glyph.y0).c_str(),
+                     hexFloat(glyph.x1).c_str(), hexFloat(glyph.y1).c_str(),
+                     hexFloat(glyph.xOffset).c_str(), hexFloat(glyph.yOffset).c_str(), hexFloat(glyph.advance).c_str(),
+                     glyph.width, glyph.height, glyph.atlasX, glyph.atlasY, glyph.page, glyph.face);
+    }
+    std::fprintf(out, "};\n\n");
+
+    // Zero-length arrays are not allowed; the count below stays 0
+    std::fprintf(out, "constexpr KerningPair KERNING[] = {\n");
+    for (const KerningPair& pair : kerning) {
+        std::fprintf(out, "    {%u, %u, %s},\n", pair.left, pair.right, hexFloat(pair.adjust).c_str());
+    }
+    if (kerning.empty()) {
+        std::fprintf(out, "    {0, 0, 0.0f},\n");
+    }
+    std::fprintf(out, "};\n\n");
+
+    std::fprintf(out, "constexpr EmbeddedFont FONT = {\n");
+    std::fprintf(out, "    \"%s\",\n", baseName(fontPath).c_str());
+    std::fprintf(out, "    FONT_FILE, %zu,\n", fontData.size());
+    std::fprintf(out, "    %s, GlyphFormat::%s, %d, %d,\n", hexFloat(fontSize).c_str(),
+                 format == "sdf" ? "SDF" : "Coverage", loader.getSdfSpread(), loader.getPadding());
+    std::fprintf(out, "    %s,\n", hexFloat(atlas.lineHeight).c_str());
+    std::fprintf(out, "    %d, %d, ATLAS_BITMAP,\n", atlas.width, atlas.height);
+    std::fprintf(out, "    GLYPHS, %zu,\n", atlas.glyphs.size());
+    std::fprintf(out, "    KERNING, %zu,\n", kerning.size());
+    std::fprintf(out, "};\n\n");
+
+    std::fprintf(out, "} // namespace\n\n");
+    std::fprintf(out, "const EmbeddedFont* embeddedDefaultFont() {\n    return &FONT;\n}\n\n");
+    std::fprintf(out, "} // namespace phantom\n");
+
+    bool written = std::ferror(out) == 0;
+    written = std::fclose(out) == 0 && written;
+
+    // Windows rename does not replace an existing file
+    std::remove(outputPath.c_str());
+    if (!written || std::rename(tempPath.c_str(), outputPath.c_str()) != 0) {
+        std::fprintf(stderr, "cannot write %s\n", outputPath.c_str());
+        std::remove(tempPath.c_str());
+        return EXIT_FAILURE;
+    }
+
+    std::printf("Baked %s: %zu glyphs, %dx%d atlas, %zu kerning pairs\n",
+                baseName(fontPath).c_str(), atlas.glyphs.size(), atlas.width, atlas.height, kerning.size());
+    return EXIT_SUCCESS;
+}